@@ -18,6 +18,7 @@
 #include "dsa/keyiterator.h"
 
 #include <cstddef>
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/EquivalenceClasses.h"
 #include "llvm/IR/CallSite.h"
 
@@ -54,7 +55,7 @@ private:
   svset<llvm::CallSite> completeCS;
 
   // Types for SCC construction
-  typedef std::map<const llvm::Function*, unsigned> TFMap;
+  typedef llvm::DenseMap<const llvm::Function*, unsigned> TFMap;
   typedef std::vector<const llvm::Function*> TFStack;
 
   // Tarjan's SCC algorithm
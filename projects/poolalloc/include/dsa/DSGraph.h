@@ -23,6 +23,8 @@
 #include <list>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace llvm {
 
@@ -40,8 +42,15 @@ class GlobalValue;
 /// of DSA.  In all of these cases, the DSA phase is really trying to identify
 /// globals or unique node handles active in the function.
 ///
+/// The value map is hashed.  Its nodes do not move, so references to the
+/// DSNodeHandles stay valid when entries are added, but iterators do not: code
+/// that can add entries while it walks the map must walk a copy instead.  The
+/// global set is ordered, so that the nodes made for globals, and thus the
+/// global pools, are made in the same order from one run to the next; code
+/// that creates nodes for globals walks the global set, not the value map.
+///
 class DSScalarMap {
-  typedef std::map<const Value*, DSNodeHandle> ValueMapTy;
+  typedef std::unordered_map<const Value*, DSNodeHandle> ValueMapTy;
   ValueMapTy ValueMap;
 
   typedef std::set<const GlobalValue*> GlobalSetTy;
@@ -124,8 +133,9 @@ public:
   void replaceScalar(const Value *Old, const Value *New) {
     iterator I = find(Old);
     assert(I != end() && "Old value is not in the map!");
-    ValueMap.insert(std::make_pair(New, I->second));
+    DSNodeHandle NH = I->second;
     erase(I);
+    ValueMap.insert(std::make_pair(New, NH));
   }
 
   /// copyScalarIfExists - If Old exists in the scalar map, make New point to
@@ -201,8 +211,8 @@ public:
 
   /// NodeMapTy - This data type is used when cloning one graph into another to
   /// keep track of the correspondence between the nodes in the old and new
-  /// graphs.
-  typedef std::map<const DSNode*, DSNodeHandle> NodeMapTy;
+  /// graphs.  References to its handles stay valid across insertion.
+  typedef std::unordered_map<const DSNode*, DSNodeHandle> NodeMapTy;
 
   // InvNodeMapTy - This data type is used to represent the inverse of a node
   // map.
@@ -650,8 +660,8 @@ class ReachabilityCloner {
   // NodeMap - A mapping from nodes in the source graph to the nodes that
   // represent them in the destination graph.
   // We cannot use a densemap here as references into it are not stable across
-  // insertion
-  typedef std::map<const DSNode*, DSNodeHandle> RCNodeMap;
+  // insertion; those into an unordered_map are.
+  typedef std::unordered_map<const DSNode*, DSNodeHandle> RCNodeMap;
   RCNodeMap NodeMap;
 
 public:
@@ -20,6 +20,7 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include "dsa/svset.h"
+#include "dsa/svmap.h"
 #include "dsa/super_set.h"
 #include "dsa/keyiterator.h"
 #include "dsa/DSGraph.h"
@@ -27,6 +28,7 @@
 
 #include <map>
 #include <set>
+#include <unordered_map>
 
 namespace llvm {
 
@@ -42,8 +44,12 @@ class DSNodeIterator;          // Data structure graph traversal iterator
 ///
 class DSNode : public ilist_node<DSNode> {
 public:
-  typedef std::map<unsigned, SuperSet<Type*>::setPtr> TyMapTy;
-  typedef std::map<unsigned, DSNodeHandle> LinkMapTy;
+  // Most nodes have a handful of fields, so the type and link maps are sorted
+  // vectors: one allocation per node instead of one per field.  Adding a
+  // field may move the others, so no reference to a link or type entry may be
+  // held across a call that can add one to the same node.
+  typedef svmap<unsigned, SuperSet<Type*>::setPtr> TyMapTy;
+  typedef svmap<unsigned, DSNodeHandle> LinkMapTy;
 
 private:
   friend struct ilist_sentinel_traits<DSNode>;
@@ -220,7 +226,9 @@ public:
     return Links.find(Offset) != Links.end();
   }
 
-  /// getLink - Return the link at the specified offset.
+  /// getLink - Return the link at the specified offset, creating a null link
+  /// if there is none.  The reference is only valid until a link is added to
+  /// this node.
   ///
   DSNodeHandle &getLink(unsigned Offset) {
     assert(Offset < getSize() && "Link index is out of range!");
@@ -283,7 +291,13 @@ public:
   ///
   void setLink(unsigned Offset, const DSNodeHandle &NH) {
     assert(Offset < getSize() && "Link index is out of range!");
-    Links[Offset] = NH;
+    // NH may be one of our own links, so copy it before adding a link can
+    // move it.
+    LinkMapTy::iterator I = Links.lower_bound(Offset);
+    if (I != Links.end() && I->first == Offset)
+      I->second = NH;
+    else
+      Links.insert(I, LinkMapTy::value_type(Offset, NH));
   }
 
   /// addEdgeTo - Add an edge from the current node to the specified node.  This
@@ -434,7 +448,7 @@ public:
   /// remapLinks - Change all of the Links in the current node according to the
   /// specified mapping.
   ///
-  void remapLinks(std::map<const DSNode*, DSNodeHandle> &OldNodeMap);
+  void remapLinks(std::unordered_map<const DSNode*, DSNodeHandle> &OldNodeMap);
 
   /// markReachableNodes - This method recursively traverses the specified
   /// DSNodes, marking any nodes which are reachable.  All reachable nodes it
@@ -448,6 +462,7 @@ public:
   void checkOffsetFoldIfNeeded(int Offset);
 private:
   friend class DSNodeHandle;
+  friend class DSSummaries;     // Restores saved nodes exactly
 
   // static mergeNodes - Helper for mergeWith()
   static void MergeNodes(DSNodeHandle& CurNodeH, DSNodeHandle& NH);
@@ -0,0 +1,171 @@
+//===- DSSummary.h - Saved bottom-up graphs of SCCs -------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines DSSummaries, which writes the bottom-up DSGraphs of the
+// SCCs of a module to a summary file and reads them back, so that the next
+// run of the bottom-up pass on the module reuses the graphs of the SCCs that
+// did not change instead of inlining them again.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_DSSUMMARY_H
+#define LLVM_DSSUMMARY_H
+
+#include "dsa/svset.h"
+#include "dsa/super_set.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/EquivalenceClasses.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/CallSite.h"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+class DSCallGraph;
+
+namespace llvm {
+
+class DSCallSite;
+class DSGraph;
+class DSNode;
+class DSNodeHandle;
+class Function;
+class GlobalValue;
+class Module;
+class Type;
+class Value;
+class raw_ostream;
+
+/// DSSummaries - The bottom-up graphs of the SCCs of a module as they are
+/// saved in a summary file.  A saved graph is reused if the graph of its SCC
+/// before inlining hashes to the same value as when it was saved, and the
+/// graphs that were inlined into it hash to the same values as well.  The
+/// hashes cover the graphs themselves rather than the IR, so the graph of an
+/// SCC is reused even if a callee changed in a way that its graph does not
+/// show.
+///
+/// With a graph, a summary saves what its SCC added to the globals graph and
+/// the call graph edges of its call sites; both are added again when the
+/// graph is reused.
+///
+class DSSummaries {
+public:
+  typedef svset<const Function*> FuncSet;
+
+  /// Record - The saved graph of an SCC.
+  struct Record {
+    std::string Root;      // The function that closed the SCC
+    std::string Local;     // The hash of its graph before inlining
+    std::string Key;       // The hash of its finished graph
+    std::vector<std::pair<std::string, std::string> > Callees;
+    std::string Body;      // The graphs and the call graph edges
+  };
+
+  /// Pending - An SCC whose graph is being inlined.  It keeps what the SCC
+  /// adds to the globals graph in a graph of its own until it is finished.
+  struct Pending {
+    const Function *Root;
+    std::string Local;
+    FuncSet Inlined;       // The callees whose graphs were inlined
+    DSGraph *Globals;
+  };
+
+private:
+  class Reader;
+
+  Module &M;
+  EquivalenceClasses<const GlobalValue*> &GlobalECs;
+  SuperSet<Type*> &TypeSS;
+
+  /// Environment - What every graph depends on besides its own contents.
+  std::string Environment;
+
+  std::map<std::string, Record> Saved;     // Read from the file, by root
+  std::vector<Record> Records;             // To write, in finishing order
+  DenseMap<const Function*, std::string> Keys;
+  std::map<const DSGraph*, Pending> PendingSCCs;
+
+  /// The arguments and instructions of the functions, numbered on demand
+  DenseMap<const Function*, std::vector<const Value*> > ValuesOf;
+  DenseMap<const Value*, unsigned> ValueIDs;
+
+  const std::vector<const Value*> &getValues(const Function *F);
+  bool writeValue(raw_ostream &OS, const Value *V);
+  void writeHandle(raw_ostream &OS, const DSNodeHandle &NH,
+                   const DenseMap<const DSNode*, unsigned> &IDs);
+  bool writeCall(raw_ostream &OS, const DSCallSite &CS,
+                 const DenseMap<const DSNode*, unsigned> &IDs);
+  bool writeGraph(raw_ostream &OS, const DSGraph &G);
+  bool writeEdges(raw_ostream &OS, const DSGraph &G, const DSCallGraph &CG);
+
+  const Value *readValue(Reader &R);
+  Type *readType(Reader &R);
+  bool readCall(Reader &R, const std::vector<DSNode*> &Nodes,
+                DSGraph &G, bool Aux);
+  bool readGraph(Reader &R, DSGraph &G);
+  bool readEdges(Reader &R,
+                 std::vector<std::pair<CallSite, const Function*> > &Edges);
+
+  std::string hash(StringRef Text) const;
+
+public:
+  DSSummaries(Module &M, EquivalenceClasses<const GlobalValue*> &ECs,
+              SuperSet<Type*> &TypeSS)
+    : M(M), GlobalECs(ECs), TypeSS(TypeSS) {}
+
+  /// setEnvironment - Hash what the graphs depend on besides their contents:
+  /// the data layout, the global equivalence classes, and the functions
+  /// whose address is taken.
+  void setEnvironment(const std::vector<const Function*> &GlobalFunctionList,
+                      bool FilterCallees);
+
+  /// read - Read a summary file.  A file that does not exist or that cannot
+  /// be read leaves no saved graphs; the caller inlines everything again.
+  bool read(StringRef Filename);
+
+  /// write - Write the graphs reused or saved in this run to a summary file.
+  bool write(StringRef Filename, std::string &Error) const;
+
+  /// hashGraph - Compute the hash of a graph.  Return false if the graph
+  /// holds values that a summary cannot name.
+  bool hashGraph(const DSGraph &G, std::string &Hash);
+
+  /// setKey - Make the hash of a finished graph the key of its functions.
+  void setKey(const DSGraph &G);
+
+  /// find - Return the saved graph of the SCC closed by Root if its graph
+  /// before inlining hashes to Local and the graphs inlined into it did not
+  /// change, or null.
+  const Record *find(const Function *Root, StringRef Local) const;
+
+  /// restore - Read the graph of a record into G and what its SCC added to
+  /// the globals graph into Globals, and return its call graph edges.  The
+  /// record is written again and its key becomes the key of its functions.
+  bool restore(const Record &R, DSGraph &G, DSGraph &Globals,
+               std::vector<std::pair<CallSite, const Function*> > &Edges);
+
+  /// save - Save the finished graph of a pending SCC.  Return false if it
+  /// cannot be saved because it calls SCCs without a key or holds values
+  /// that a summary cannot name.
+  bool save(const Pending &P, const DSGraph &G, const DSCallGraph &CG);
+
+  Pending *getPending(const DSGraph *G) {
+    std::map<const DSGraph*, Pending>::iterator I = PendingSCCs.find(G);
+    return I == PendingSCCs.end() ? 0 : &I->second;
+  }
+  Pending &addPending(const DSGraph *G) { return PendingSCCs[G]; }
+  void erasePending(const DSGraph *G) { PendingSCCs.erase(G); }
+};
+
+}
+
+#endif // LLVM_DSSUMMARY_H
@@ -18,6 +18,7 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <unordered_map>
 
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/IR/CallSite.h"
@@ -177,9 +178,10 @@ private:
   }
 
   static void InitNH(DSNodeHandle &NH, const DSNodeHandle &Src,
-                     const std::map<const DSNode*, DSNodeHandle> &NodeMap) {
+               const std::unordered_map<const DSNode*, DSNodeHandle> &NodeMap) {
     if (DSNode *N = Src.getNode()) {
-      std::map<const DSNode*, DSNodeHandle>::const_iterator I = NodeMap.find(N);
+      std::unordered_map<const DSNode*, DSNodeHandle>::const_iterator I =
+        NodeMap.find(N);
       assert(I != NodeMap.end() && "Node not in mapping!");
 
       DSNode *NN = I->second.getNode(); // Call getNode before getOffset()
@@ -287,6 +289,11 @@ public:
     CallArgs.push_back(NH);
   }
 
+  /// addMappedSite - Record that the given call was merged into this one.
+  void addMappedSite(CallSite CS) {
+    MappedSites.insert(CS);
+  }
+
   void swap(DSCallSite &CS) {
     if (this != &CS) {
       std::swap(Site, CS.Site);
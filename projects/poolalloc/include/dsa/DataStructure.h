@@ -24,6 +24,7 @@
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/Module.h"
 #include "llvm/ADT/EquivalenceClasses.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
 
 #include <map>
@@ -37,6 +38,7 @@ class DSGraph;
 class DSCallSite;
 class DSNode;
 class DSNodeHandle;
+class DSSummaries;
 
 FunctionPass *createDataStructureStatsPass();
 FunctionPass *createDataStructureGraphCheckerPass();
@@ -61,8 +63,6 @@ class DataStructures : public ModulePass {
 
   void buildGlobalECs(svset<const GlobalValue*>& ECGlobals);
 
-  void eliminateUsesOfECGlobals(DSGraph& G, const svset<const GlobalValue*> &ECGlobals);
-
   // DSInfo, one graph for each function
   DSInfoTy DSInfo;
 
@@ -90,6 +90,8 @@ protected:
   void init(const DataLayout* T);
 
   void formGlobalECs();
+
+  void eliminateUsesOfECGlobals(DSGraph& G, const svset<const GlobalValue*> &ECGlobals);
   
   void cloneIntoGlobals(DSGraph* G, unsigned cloneFlags);
   void cloneGlobalsInto(DSGraph* G, unsigned cloneFlags);
@@ -98,6 +100,15 @@ protected:
   
   void formGlobalFunctionList();
 
+  /// prepareForThreads - Compute the state that threads reading the graphs
+  /// would otherwise create lazily: the leaders of the global equivalence
+  /// classes and the struct layouts of the module.
+  void prepareForThreads(Module &M);
+
+  /// getThreadCount - Return the number of threads on which to process Work
+  /// items when Requested threads (0 for one per core) are asked for.
+  static unsigned getThreadCount(unsigned Requested, unsigned Work);
+
   DataStructures(char & id, const char* name) 
     : ModulePass(id), TD(0), GraphSource(0), printname(name), GlobalsGraph(0) {  
     // For now, the graphs are owned by this pass
@@ -177,6 +188,14 @@ public:
 //
 class LocalDataStructures : public DataStructures {
   AddressTakenAnalysis* addrAnalysis;
+
+  /// buildGraphsOnThreads - Build the local graphs of the functions on the
+  /// given number of threads without finishing them.
+  void buildGraphsOnThreads(const std::vector<Function*> &Functions,
+                            std::vector<DSGraph*> &Graphs, unsigned Threads);
+
+  /// finishThreadGraph - Finish a graph built by buildGraphsOnThreads.
+  void finishThreadGraph(DSGraph *G);
 public:
   static char ID;
   LocalDataStructures() : DataStructures(ID, "local.") {}
@@ -229,16 +248,20 @@ protected:
   // from the CallGraph.  This is useful while doing original BU,
   // but might be undesirable in other passes such as CBU/EQBU.
   bool filterCallees;
+
+  // Summaries -- The saved graphs of the SCCs, with -dsa-bu-summary only.
+  DSSummaries *Summaries;
 public:
   static char ID;
   //Child constructor (CBU)
   BUDataStructures(char & CID, const char* name, const char* printname,
       bool filter)
-    : DataStructures(CID, printname), debugname(name), filterCallees(filter) {}
+    : DataStructures(CID, printname), debugname(name), filterCallees(filter),
+      Summaries(0) {}
   //main constructor
   BUDataStructures()
     : DataStructures(ID, "bu."), debugname("dsa-bu"),
-    filterCallees(true) {}
+    filterCallees(true), Summaries(0) {}
   ~BUDataStructures() { releaseMemory(); }
 
   virtual bool runOnModule(Module &M);
@@ -253,17 +276,43 @@ protected:
 
 private:
   // Private typedefs
-  typedef std::map<const Function*, unsigned> TarjanMap;
+  typedef DenseMap<const Function*, unsigned> TarjanMap;
   typedef std::vector<const Function*>        TarjanStack;
   typedef svset<const Function*>              FuncSet;
 
+  /// SCCSchedule - The SCCs of the call graph and the state of inlining them
+  /// on threads (see BottomUpClosure.cpp).
+  struct SCCSchedule;
+
   void postOrderInline (Module & M);
+  void markGraphVisited (const Function *F, TarjanMap & ValMap);
   unsigned calculateGraphs (const Function *F,
                             TarjanStack & Stack,
                             unsigned & NextID,
-                            TarjanMap & ValMap);
-
-  void calculateGraph(DSGraph* G);
+                            TarjanMap & ValMap,
+                            SCCSchedule *Schedule = 0);
+  bool calculateSCC (const Function *F,
+                     FuncSet & CalleeFunctions,
+                     TarjanStack & Stack,
+                     TarjanMap & ValMap,
+                     SCCSchedule *Schedule);
+
+  void calculateGraph(DSGraph* G, SCCSchedule *Schedule = 0,
+                      unsigned Index = 0, FuncSet *Inlined = 0);
+
+  void inlineSCCsOnThreads (Module & M,
+                            TarjanStack & Stack,
+                            unsigned & NextID,
+                            TarjanMap & ValMap,
+                            DenseSet<const Function*> & Roots,
+                            unsigned Threads);
+  void inlineSCC (SCCSchedule & Schedule, unsigned Index);
+  void finishSCC (SCCSchedule & Schedule, unsigned Index);
+  void commitGlobals (DSGraph *Globals);
+
+  bool beginSummary (const Function *F, DSGraph *G);
+  void finishSummary (DSGraph *G);
+  void abandonSummary (DSGraph *G);
 
   void CloneAuxIntoGlobal(DSGraph* G);
 
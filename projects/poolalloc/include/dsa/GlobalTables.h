@@ -0,0 +1,24 @@
+//===- GlobalTables.h - Sections of tables of global variables --*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// SAFECode registers the global variables of a module with its run-time by
+// passing it a constant table of their addresses and sizes.  The table points
+// to every global, so DSA does not add its initializer to the globals graph;
+// otherwise every global would be merged into one node.  This file defines
+// the name of the section holding these tables, which both use.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_DSA_GLOBALTABLES_H
+#define LLVM_DSA_GLOBALTABLES_H
+
+// The section of the tables; Mach-O targets prefix it with a segment name
+#define DSA_GLOBAL_TABLE_SECTION "sc_globals"
+
+#endif
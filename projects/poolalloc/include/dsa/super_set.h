@@ -9,10 +9,13 @@
 #define	_SUPER_SET_H
 
 #include "dsa/svset.h"
+#include "llvm/Support/Mutex.h"
 #include <set>
 
 // Contains stable references to a set
 // The sets can be grown.
+// Graphs built on different threads share one SuperSet, so adding a set is
+// serialized; the sets themselves never change once added.
 
 template<typename Ty>
 class SuperSet {
@@ -20,11 +23,13 @@ class SuperSet {
   typedef svset<Ty> InnerSetTy;
   typedef std::set<InnerSetTy> OuterSetTy;
   OuterSetTy container;
+  llvm::sys::SmartMutex<true> Lock;
 public:
   typedef const typename OuterSetTy::value_type* setPtr;
 
   setPtr getOrCreate(svset<Ty>& S) {
     if (S.empty()) return 0;
+    llvm::sys::SmartScopedLock<true> Guard(Lock);
     return &(*container.insert(S).first);
   }
 
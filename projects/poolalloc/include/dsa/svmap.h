@@ -0,0 +1,165 @@
+#ifndef _SV_ORDERED_MAP_HH_
+#define _SV_ORDERED_MAP_HH_ 1
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// A map implemented atop a sorted vector of (key, value) pairs.
+/// Iterators are not stable accross insert or delete, and neither are
+/// references to the values: adding a key may move every value in the map.
+template< typename Key,
+        typename T,
+        typename Compare = std::less<Key> >
+class svmap {
+// Types
+public:
+
+  typedef Key     key_type;
+  typedef T       mapped_type;
+  typedef std::pair<Key, T> value_type;
+  typedef Compare key_compare;
+
+private:
+  typedef std::vector<value_type> internal_type;
+
+public:
+  typedef typename internal_type::reference reference;
+  typedef typename internal_type::const_reference const_reference;
+  typedef typename internal_type::const_iterator const_iterator;
+  typedef typename internal_type::iterator iterator;
+  typedef typename internal_type::size_type size_type;
+  typedef typename internal_type::difference_type difference_type;
+
+private:
+
+  /// Orders the pairs of the vector by key alone.
+  struct key_less {
+    bool operator()(const value_type& x, const key_type& k) const {
+      return Compare()(x.first, k);
+    }
+  };
+
+  internal_type container_;
+
+public:
+  /// Empty constructor.
+  svmap()
+  : container_() { }
+
+  /// Returns the beginning of the sorted vector.
+  const_iterator begin() const {
+    return container_.begin();
+  }
+
+  /// Returns the end of the sorted vector.
+  const_iterator end() const {
+    return container_.end();
+  }
+
+  /// Returns the beginning of the sorted vector.
+  iterator begin() {
+    return container_.begin();
+  }
+
+  /// Returns the end of the sorted vector.
+  iterator end() {
+    return container_.end();
+  }
+
+  bool empty() const {
+    return container_.empty();
+  }
+
+  size_type size() const {
+    return container_.size();
+  }
+
+  /// Returns the value of key k, inserting a default value if it is absent.
+  mapped_type& operator[](const key_type& k) {
+    iterator i = lower_bound(k);
+    if (i == end() || Compare()(k, i->first))
+      i = container_.insert(i, value_type(k, mapped_type()));
+    return i->second;
+  }
+
+  /// Insert a pair into the sorted vector unless its key is present.
+  std::pair<iterator,bool>
+  insert(const value_type& x) {
+    iterator i = lower_bound(x.first);
+    if (i != end() && !Compare()(x.first, i->first))
+      return std::make_pair(i, false);
+    return std::make_pair(container_.insert(i, x), true);
+  }
+
+  /// Insert a pair, starting the search at position.  As with std::map, the
+  /// position is only a hint.
+  iterator insert(iterator position, const value_type& x) {
+    if ((position == begin() || Compare()((position - 1)->first, x.first)) &&
+        (position == end() || Compare()(x.first, position->first)))
+      return container_.insert(position, x);
+    return insert(x).first;
+  }
+
+  iterator erase ( iterator position ) {
+    return container_.erase(position);
+  }
+
+  size_type erase(const key_type& x) {
+    iterator i = find(x);
+    if (i != end()) {
+      erase(i);
+      return 1;
+    }
+    return 0;
+  }
+
+  iterator erase ( iterator first, iterator last ) {
+    return container_.erase(first, last);
+  }
+
+  /// Swap the content of two maps.
+  void swap(svmap& s) {
+    container_.swap(s.container_);
+  }
+
+  /// Remove every pair and release the storage of the vector.
+  void clear() {
+    internal_type().swap(container_);
+  }
+
+  /// Find the key k.
+
+  const_iterator find(const key_type& k) const {
+    const_iterator i = lower_bound(k);
+    if (i != end() && !Compare()(k, i->first)) return i;
+    return end();
+  }
+
+  iterator find(const key_type& k) {
+    iterator i = lower_bound(k);
+    if (i != end() && !Compare()(k, i->first)) return i;
+    return end();
+  }
+
+  size_type count(const key_type& k) const {
+    return find(k) != end();
+  }
+
+  const_iterator lower_bound(const key_type& k) const {
+    return std::lower_bound(container_.begin(), container_.end(), k,
+                            key_less());
+  }
+
+  iterator lower_bound(const key_type& k) {
+    return std::lower_bound(container_.begin(), container_.end(), k,
+                            key_less());
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // _SV_ORDERED_MAP_HH_
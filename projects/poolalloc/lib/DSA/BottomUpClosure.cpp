@@ -18,10 +18,18 @@
 #include "llvm/IR/Constants.h"
 #include "dsa/DataStructure.h"
 #include "dsa/DSGraph.h"
+#include "dsa/DSSummary.h"
 #include "llvm/IR/Module.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/Timer.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 using namespace llvm;
 
@@ -35,9 +43,167 @@ namespace {
   STATISTIC (NumEmptyCalls, "Number of calls we know nothing about");
   STATISTIC (NumRecalculations, "Number of DSGraph recalculations");
   STATISTIC (NumRecalculationsSkipped, "Number of DSGraph recalculations skipped");
+  STATISTIC (NumSummariesReused, "Number of SCC graphs reused from summaries");
 
   RegisterPass<BUDataStructures>
   X("dsa-bu", "Bottom-up Data Structure Analysis");
+
+  cl::opt<unsigned> BUThreads("dsa-bu-threads",
+        cl::desc("Number of threads on which to inline the graphs of "
+                 "independent SCCs (0 = one per core)"),
+        cl::init(1));
+
+  cl::opt<std::string> SummaryFile("dsa-bu-summary",
+        cl::desc("Reuse the graphs saved in this file for the SCCs that did "
+                 "not change, and save the graphs of this run in it"),
+        cl::value_desc("filename"));
+
+  // A function whose callees calculateGraphs() is visiting.
+  struct TarjanFrame {
+    const Function *F;
+    svset<const Function*> Callees;
+    unsigned Next;       // The index of the next callee to visit
+    unsigned Min;        // The lowest ID reachable from F so far
+    unsigned MyID;
+  };
+
+  // Holds a mutex for its lifetime, if it is given one.
+  class OptionalLock {
+    std::mutex *M;
+  public:
+    explicit OptionalLock(std::mutex *M) : M(M) { if (M) M->lock(); }
+    ~OptionalLock() { if (M) M->unlock(); }
+  };
+}
+
+/// SCCSchedule - The SCCs of the call graph, found by calculateGraphs()
+/// before any of them is inlined so that the SCCs whose callees are finished
+/// can be inlined on threads.  The SCCs are numbered in the order in which
+/// the serial traversal finishes them, which is a post-order of their DAG.
+struct BUDataStructures::SCCSchedule {
+  struct SCC {
+    const Function *Root;           // The function that closed the SCC
+    DSGraph *Graph;                 // The graph of all of its functions
+    std::vector<const Function*> Functions;
+    FuncSet Callees;                // The callees of Root's own graph
+    std::vector<unsigned> Succs;    // The SCCs that its functions call
+    std::vector<unsigned> Callers;  // The SCCs whose functions call it
+    DenseSet<unsigned> Below;       // Every SCC under it, once computed
+    DSGraph *Globals;               // The globals that it adds to the GG
+    unsigned Pending;               // The Succs that are not finished yet
+    bool Deferred;                  // It calls SCCs that are not under it
+    bool Tainted;                   // It is left to the serial traversal
+  };
+
+  std::vector<SCC> SCCs;
+  DenseMap<const Function*, unsigned> SCCOf;
+  DenseMap<const DSGraph*, unsigned> SCCOfGraph;
+  // The callees of the functions that are not the root of their SCC
+  DenseMap<const Function*, FuncSet> CalleesOf;
+
+  // Guards Ready, Remaining, and the Pending and Tainted fields
+  std::mutex QueueLock;
+  std::condition_variable QueueChanged;
+  std::vector<unsigned> Ready;
+  unsigned Remaining;
+
+  // Guards the call graph
+  std::mutex CallGraphLock;
+
+  // Guards Finished, NextCommit, and the globals graph
+  std::mutex CommitLock;
+  std::vector<bool> Finished;
+  unsigned NextCommit;
+
+  // Guard the graphs of finished SCCs while they are inlined: copying a
+  // DSNodeHandle changes the node that it points to.
+  std::mutex GraphLocks[16];
+
+  std::mutex &getGraphLock(const DSGraph *G) {
+    return GraphLocks[(reinterpret_cast<uintptr_t>(G) >> 4) % 16];
+  }
+
+  void addSCC(const Function *Root, DSGraph *Graph, FuncSet &Callees,
+              const std::vector<const Function*> &Functions);
+  bool isBelow(unsigned Index, const Function *Callee);
+};
+
+//
+// Method: addSCC()
+//
+// Description:
+//  Add an SCC that calculateGraphs() has just found.  Every SCC that its
+//  functions call has been found before, so link it to them now.  An SCC
+//  whose graph is shared with an earlier SCC is left to the serial traversal.
+//
+void BUDataStructures::SCCSchedule::addSCC(
+    const Function *Root, DSGraph *Graph, FuncSet &Callees,
+    const std::vector<const Function*> &Functions) {
+  unsigned Index = SCCs.size();
+  SCCs.push_back(SCC());
+  SCC &C = SCCs.back();
+  C.Root = Root;
+  C.Graph = Graph;
+  C.Functions = Functions;
+  C.Callees.swap(Callees);
+  C.Globals = 0;
+  C.Deferred = false;
+  C.Tainted = !SCCOfGraph.insert(std::make_pair(Graph, Index)).second;
+
+  for (unsigned i = 0, e = Functions.size(); i != e; ++i)
+    SCCOf[Functions[i]] = Index;
+
+  for (unsigned i = 0, e = Functions.size(); i != e; ++i) {
+    const FuncSet *FCallees = &C.Callees;
+    if (Functions[i] != Root)
+      FCallees = &CalleesOf[Functions[i]];
+    for (FuncSet::const_iterator I = FCallees->begin(), E = FCallees->end();
+         I != E; ++I) {
+      DenseMap<const Function*, unsigned>::iterator It = SCCOf.find(*I);
+      if (It != SCCOf.end() && It->second != Index)
+        C.Succs.push_back(It->second);
+    }
+    if (Functions[i] != Root)
+      CalleesOf.erase(Functions[i]);
+  }
+
+  std::sort(C.Succs.begin(), C.Succs.end());
+  C.Succs.erase(std::unique(C.Succs.begin(), C.Succs.end()), C.Succs.end());
+  for (unsigned i = 0, e = C.Succs.size(); i != e; ++i)
+    SCCs[C.Succs[i]].Callers.push_back(Index);
+  C.Pending = C.Succs.size();
+}
+
+//
+// Method: isBelow()
+//
+// Description:
+//  Determine whether the graph of a callee is finished whenever the graph of
+//  an SCC is inlined: the callee is in the SCC itself, in one of the SCCs
+//  under it, or was finished before the schedule was made.
+//
+bool BUDataStructures::SCCSchedule::isBelow(unsigned Index,
+                                             const Function *Callee) {
+  DenseMap<const Function*, unsigned>::iterator It = SCCOf.find(Callee);
+  if (It == SCCOf.end() || It->second == Index)
+    return true;
+
+  // The SCCs under an SCC are found before it.
+  if (It->second > Index)
+    return false;
+
+  SCC &C = SCCs[Index];
+  if (C.Below.empty()) {
+    std::vector<unsigned> Worklist(C.Succs);
+    while (!Worklist.empty()) {
+      unsigned Succ = Worklist.back();
+      Worklist.pop_back();
+      if (C.Below.insert(Succ).second)
+        Worklist.insert(Worklist.end(), SCCs[Succ].Succs.begin(),
+                        SCCs[Succ].Succs.end());
+    }
+  }
+  return C.Below.count(It->second);
 }
 
 char BUDataStructures::ID;
@@ -48,7 +214,24 @@ char BUDataStructures::ID;
 bool BUDataStructures::runOnModule(Module &M) {
   init(&getAnalysis<StdLibDataStructures>(), true, true, false, false );
 
-  return runOnModuleInternal(M);
+  if (SummaryFile.empty())
+    return runOnModuleInternal(M);
+
+  //
+  // Reuse the graphs that the last run on this module saved for the SCCs
+  // that did not change, and save the graphs of this run for the next one.
+  //
+  DSSummaries S(M, GlobalECs, *TypeSS);
+  S.read(SummaryFile);
+  Summaries = &S;
+  bool Changed = runOnModuleInternal(M);
+  Summaries = 0;
+
+  std::string Error;
+  if (!S.write(SummaryFile, Error))
+    errs() << debugname << ": cannot write " << SummaryFile << ": "
+           << Error << "\n";
+  return Changed;
 }
 
 // BU:
@@ -230,10 +413,12 @@ void
 BUDataStructures::postOrderInline (Module & M) {
   // Variables used for Tarjan SCC-finding algorithm.  These are passed into
   // the recursive function used to find SCCs.
-  std::vector<const Function*> Stack;
-  std::map<const Function*, unsigned> ValMap;
+  TarjanStack Stack;
+  TarjanMap ValMap;
   unsigned NextID = 1;
 
+  if (Summaries)
+    Summaries->setEnvironment(GlobalFunctionList, filterCallees);
 
   // Do post order traversal on the global ctors. Use this information to update
   // the globals graph.
@@ -274,6 +459,8 @@ BUDataStructures::postOrderInline (Module & M) {
       // record one global per DSNode.
       //
       formGlobalECs();
+      if (Summaries)
+        Summaries->setEnvironment(GlobalFunctionList, filterCallees);
       // propogte information calculated 
       // from the globals graph to the other graphs.
       for (Module::iterator F = M.begin(); F != M.end(); ++F) {
@@ -287,11 +474,26 @@ BUDataStructures::postOrderInline (Module & M) {
                                      DSGraph::IgnoreGlobals);
           Graph->computeExternalFlags(DSGraph::DontMarkFormalsExternal);
           Graph->computeIntPtrFlags();
+
+          // The finished graphs changed, so their callers see new keys.
+          if (Summaries && ValMap.count(F))
+            Summaries->setKey(*Graph);
         }
       }
     }
   }
  
+  //
+  // With -dsa-bu-threads, find the SCCs of the remaining functions first and
+  // inline those whose callees are finished on threads.  The traversals below
+  // then only visit what the threads left to them.  Summaries are only made
+  // by the serial traversal.
+  //
+  DenseSet<const Function*> Roots;
+  unsigned Threads = Summaries ? 1 : getThreadCount(BUThreads, M.size());
+  if (Threads > 1)
+    inlineSCCsOnThreads(M, Stack, NextID, ValMap, Roots, Threads);
+
   //
   // Start the post order traversal with the main() function.  If there is no
   // main() function, don't worry; we'll have a separate traversal for inlining
@@ -299,35 +501,30 @@ BUDataStructures::postOrderInline (Module & M) {
   //
   Function *MainFunc = M.getFunction ("main");
   if (MainFunc && !MainFunc->isDeclaration()) {
-    calculateGraphs(MainFunc, Stack, NextID, ValMap);
+    if (!ValMap.count(MainFunc))
+      calculateGraphs(MainFunc, Stack, NextID, ValMap);
     CloneAuxIntoGlobal(getDSGraph(*MainFunc));
   }
 
   //
   // Calculate the graphs for any functions that are unreachable from main...
+  // Functions that started a traversal on the threads only have their
+  // unresolved calls added to the globals graph.
   //
   for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I)
-    if (!I->isDeclaration() && !ValMap.count(I)) {
+    if (!I->isDeclaration() && (!ValMap.count(I) || Roots.count(I))) {
       if (MainFunc)
         DEBUG(errs() << debugname << ": Function unreachable from main: "
         << I->getName() << "\n");
-      calculateGraphs(I, Stack, NextID, ValMap);     // Calculate all graphs.
+      if (!ValMap.count(I))
+        calculateGraphs(I, Stack, NextID, ValMap);   // Calculate all graphs.
       CloneAuxIntoGlobal(getDSGraph(*I));
 
       // Mark this graph as processed.  Do this by finding all functions
       // in the graph that map to it, and mark them visited.
       // Note that this really should be handled neatly by calculateGraphs
       // itself, not here.  However this catches the worst offenders.
-      DSGraph *G = getDSGraph(*I);
-      for(DSGraph::retnodes_iterator RI = G->retnodes_begin(),
-          RE = G->retnodes_end(); RI != RE; ++RI) {
-        if (getDSGraph(*RI->first) == G) {
-          if (!ValMap.count(RI->first))
-            ValMap[RI->first] = ~0U;
-          else
-            assert(ValMap[RI->first] == ~0U);
-        }
-      }
+      markGraphVisited(I, ValMap);
     }
   return;
 }
@@ -344,11 +541,35 @@ static bool hasNewCallees(svset<const Function*> &New,
   return false;
 }
 
+//
+// Method: markGraphVisited()
+//
+// Description:
+//  Mark the functions that share the graph of a function whose traversal has
+//  just ended as visited.
+//
+void BUDataStructures::markGraphVisited(const Function *F, TarjanMap &ValMap) {
+  DSGraph *G = getDSGraph(*F);
+  for(DSGraph::retnodes_iterator RI = G->retnodes_begin(),
+      RE = G->retnodes_end(); RI != RE; ++RI) {
+    if (getDSGraph(*RI->first) == G) {
+      if (!ValMap.count(RI->first))
+        ValMap[RI->first] = ~0U;
+      else
+        assert(ValMap[RI->first] == ~0U);
+    }
+  }
+}
+
 //
 // Method: calculateGraphs()
 //
 // Description:
-//  Perform recursive bottom-up inlining of DSGraphs from callee to caller.
+//  Perform bottom-up inlining of DSGraphs from callee to caller.  This is
+//  Tarjan's SCC-finding algorithm with an explicit stack of the functions
+//  whose callees are being visited, so that deep call graphs cannot overflow
+//  the native stack.  Each SCC is handed to calculateSCC() once all of its
+//  callees are finished.
 //
 // Inputs:
 //  F - The function which should have its callees' DSGraphs merged into its
@@ -356,117 +577,151 @@ static bool hasNewCallees(svset<const Function*> &New,
 //  Stack - The stack used for Tarjan's SCC-finding algorithm.
 //  NextID - The nextID value used for Tarjan's SCC-finding algorithm.
 //  ValMap - The map used for Tarjan's SCC-finding algorithm.
+//  Schedule - If not null, the SCCs are added to it instead of being inlined.
 //
 // Return value:
+//  The lowest ID of a function reachable from F that is still on the stack.
 //
 unsigned
 BUDataStructures::calculateGraphs (const Function *F,
                                    TarjanStack & Stack,
                                    unsigned & NextID,
-                                   TarjanMap & ValMap) {
-  assert(!ValMap.count(F) && "Shouldn't revisit functions!");
-  unsigned Min = NextID++, MyID = Min;
-  ValMap[F] = Min;
-  Stack.push_back(F);
+                                   TarjanMap & ValMap,
+                                   SCCSchedule *Schedule) {
+  std::vector<TarjanFrame> Frames;
 
   //
-  // FIXME: This test should be generalized to be any function that we have
-  // already processed in the case when there isn't a main() or there are
-  // unreachable functions!
+  // Assign the next ID to a function and push it on the stack.  Return the
+  // ID.
   //
-  if (F->isDeclaration()) {   // sprintf, fprintf, sscanf, etc...
-    // No callees!
-    Stack.pop_back();
-    ValMap[F] = ~0;
-    return Min;
-  }
+  auto Visit = [&](const Function *Fn) -> unsigned {
+    assert(!ValMap.count(Fn) && "Shouldn't revisit functions!");
+    unsigned MyID = NextID++;
+    ValMap[Fn] = MyID;
 
-  //
-  // Get the DSGraph of the current function.  Make one if one doesn't exist.
-  //
-  DSGraph* Graph = getOrCreateGraph(F);
+    //
+    // FIXME: This test should be generalized to be any function that we have
+    // already processed in the case when there isn't a main() or there are
+    // unreachable functions!
+    //
+    if (Fn->isDeclaration()) {   // sprintf, fprintf, sscanf, etc...
+      // No callees!
+      ValMap[Fn] = ~0;
+      return MyID;
+    }
+    Stack.push_back(Fn);
 
-  //
-  // Find all callee functions.  Use the DSGraph for this (do not use the call
-  // graph (DSCallgraph) as we're still in the process of constructing it).
-  //
-  FuncSet CalleeFunctions;
-  getAllAuxCallees(Graph, CalleeFunctions);
+    //
+    // Find all callee functions.  Use the DSGraph for this (do not use the
+    // call graph (DSCallgraph) as we're still in the process of constructing
+    // it).  Make the DSGraph of the function if it doesn't exist.
+    //
+    Frames.push_back(TarjanFrame());
+    TarjanFrame &Frame = Frames.back();
+    Frame.F = Fn;
+    Frame.Next = 0;
+    Frame.Min = Frame.MyID = MyID;
+    getAllAuxCallees(getOrCreateGraph(Fn), Frame.Callees);
+    return MyID;
+  };
+
+  unsigned Min = Visit(F);
+  while (!Frames.empty()) {
+    TarjanFrame &Top = Frames.back();
 
-  //
-  // Iterate through each call target (these are the edges out of the current
-  // node (i.e., the current function) in Tarjan graph parlance).  Find the
-  // minimum assigned ID.
-  //
-  for (FuncSet::iterator I = CalleeFunctions.begin(), E = CalleeFunctions.end();
-       I != E; ++I) {
-    const Function *Callee = *I;
-    unsigned M;
     //
-    // If we have not visited this callee before, visit it now (this is the
+    // Iterate through each call target (these are the edges out of the
+    // current node (i.e., the current function) in Tarjan graph parlance).
+    // If we have not visited a callee before, visit it now (this is the
     // post-order component of the Bottom-Up algorithm).  Otherwise, look up
-    // the assigned ID value from the Tarjan Value Map.
+    // the assigned ID value from the Tarjan Value Map, and record it if it is
+    // smaller than the minimum ID found so far.
     //
-    TarjanMap::iterator It = ValMap.find(Callee);
-    if (It == ValMap.end())  // No, visit it now.
-      M = calculateGraphs(Callee, Stack, NextID, ValMap);
-    else                    // Yes, get it's number.
-      M = It->second;
+    if (Top.Next != Top.Callees.size()) {
+      const Function *Callee = *(Top.Callees.begin() + Top.Next++);
+      TarjanMap::iterator It = ValMap.find(Callee);
+      if (It == ValMap.end())
+        Visit(Callee);
+      else if (It->second < Top.Min)
+        Top.Min = It->second;
+      continue;
+    }
+
+    const Function *Fn = Top.F;
+    Min = Top.Min;
+    assert(ValMap[Fn] == Top.MyID && "SCC construction assumption wrong!");
 
     //
-    // If we've found a function with a smaller ID than this funtion, record
-    // that ID as the minimum ID.
+    // If the minimum ID found is not this function's ID, then this function
+    // is part of a larger SCC.  Otherwise this is a new SCC; process it now,
+    // and visit the function again if it has new callees.
     //
-    if (M < Min) Min = M;
-  }
+    if (Min != Top.MyID) {
+      if (Schedule)
+        Schedule->CalleesOf[Fn].swap(Top.Callees);
+      Frames.pop_back();
+    } else {
+      FuncSet CalleeFunctions;
+      CalleeFunctions.swap(Top.Callees);
+      Frames.pop_back();
+      if (calculateSCC(Fn, CalleeFunctions, Stack, ValMap, Schedule)) {
+        ValMap.erase(Fn);
+        ++NumRecalculations;
+        Min = Visit(Fn);
+        continue;
+      }
+    }
 
-  assert(ValMap[F] == MyID && "SCC construction assumption wrong!");
+    if (!Frames.empty() && Min < Frames.back().Min)
+      Frames.back().Min = Min;
+  }
+  return Min;
+}
 
-  //
-  // If the minimum ID found is not this function's ID, then this function is
-  // part of a larger SCC.
-  //
-  if (Min != MyID)
-    return Min;
+//
+// Method: calculateSCC()
+//
+// Description:
+//  Merge the DSGraphs of the functions of an SCC into one and inline the
+//  DSGraphs of its callees into it.
+//
+// Inputs:
+//  F - The function that closes the SCC; it and the functions above it on the
+//      stack form the SCC.
+//  CalleeFunctions - The resolvable callees of F.
+//  Stack - The stack used for Tarjan's SCC-finding algorithm.
+//  ValMap - The map used for Tarjan's SCC-finding algorithm.
+//  Schedule - If not null, the SCC is added to it instead of being inlined.
+//
+// Return value:
+//  true  - Inlining found new callees; F must be visited again.
+//  false - The SCC is finished.
+//
+bool
+BUDataStructures::calculateSCC (const Function *F,
+                                FuncSet & CalleeFunctions,
+                                TarjanStack & Stack,
+                                TarjanMap & ValMap,
+                                SCCSchedule *Schedule) {
+  unsigned MyID = ValMap[F];
+  std::vector<const Function*> Functions;
+  DSGraph* SCCGraph;
 
-  //
-  // If this is a new SCC, process it now.
-  //
   if (Stack.back() == F) {           // Special case the single "SCC" case here.
     DEBUG(errs() << "Visiting single node SCC #: " << MyID << " fn: "
 	  << F->getName() << "\n");
     Stack.pop_back();
-    DEBUG(errs() << "  [BU] Calculating graph for: " << F->getName()<< "\n");
-    DSGraph* G = getOrCreateGraph(F);
-    calculateGraph(G);
-    DEBUG(errs() << "  [BU] Done inlining: " << F->getName() << " ["
-	  << G->getGraphSize() << "+" << G->getAuxFunctionCalls().size()
-	  << "]\n");
+    SCCGraph = getOrCreateGraph(F);
+    Functions.push_back(F);
 
     if (MaxSCC < 1) MaxSCC = 1;
-
-    //
-    // Should we revisit the graph?  Only do it if there are now new resolvable
-    // callees.
-    FuncSet NewCallees;
-    getAllAuxCallees(G, NewCallees);
-    if (!NewCallees.empty()) {
-      if (hasNewCallees(NewCallees, CalleeFunctions)) {
-        DEBUG(errs() << "Recalculating " << F->getName() << " due to new knowledge\n");
-        ValMap.erase(F);
-        ++NumRecalculations;
-        return calculateGraphs(F, Stack, NextID, ValMap);
-      }
-      ++NumRecalculationsSkipped;
-    }
-    ValMap[F] = ~0U;
-    return MyID;
   } else {
     unsigned SCCSize = 1;
     const Function *NF = Stack.back();
     if(NF != F)
       ValMap[NF] = ~0U;
-    DSGraph* SCCGraph = getDSGraph(*NF);
+    SCCGraph = getDSGraph(*NF);
+    Functions.push_back(NF);
 
     //
     // First thing first: collapse all of the DSGraphs into a single graph for
@@ -478,10 +733,17 @@ BUDataStructures::calculateGraphs (const Function *F,
       NF = Stack.back();
       if(NF != F)
         ValMap[NF] = ~0U;
+      Functions.push_back(NF);
 
       DSGraph* NFG = getDSGraph(*NF);
 
       if (NFG != SCCGraph) {
+        // Neither graph was recorded with the functions of the other.
+        if (Summaries) {
+          abandonSummary(NFG);
+          abandonSummary(SCCGraph);
+        }
+
         // Update the Function -> DSG map.
         for (DSGraph::retnodes_iterator I = NFG->retnodes_begin(),
                E = NFG->retnodes_end(); I != E; ++I)
@@ -500,30 +762,54 @@ BUDataStructures::calculateGraphs (const Function *F,
     // Compute the Max SCC Size.
     if (MaxSCC < SCCSize)
       MaxSCC = SCCSize;
+  }
+
+  //
+  // With -dsa-bu-summary, reuse the saved graph of the SCC if nothing in it or
+  // under it changed.
+  //
+  if (Summaries && !Schedule && beginSummary(F, SCCGraph)) {
+    ValMap[F] = ~0U;
+    return false;
+  }
 
-    // Clean up the graph before we start inlining a bunch again...
+  // Clean up the graph before we start inlining a bunch again...
+  if (Functions.size() > 1)
     SCCGraph->removeDeadNodes(DSGraph::KeepUnreachableGlobals);
 
-    // Now that we have one big happy family, resolve all of the call sites in
-    // the graph...
-    calculateGraph(SCCGraph);
-    DEBUG(errs() << "  [BU] Done inlining SCC  [" << SCCGraph->getGraphSize()
-	  << "+" << SCCGraph->getAuxFunctionCalls().size() << "]\n"
-	  << "DONE with SCC #: " << MyID << "\n");
-    FuncSet NewCallees;
-    getAllAuxCallees(SCCGraph, NewCallees);
-    if (!NewCallees.empty()) {
-      if (hasNewCallees(NewCallees, CalleeFunctions)) {
-        DEBUG(errs() << "Recalculating SCC Graph " << F->getName() << " due to new knowledge\n");
-        ValMap.erase(F);
-        ++NumRecalculations;
-        return calculateGraphs(F, Stack, NextID, ValMap);
-      }
-      ++NumRecalculationsSkipped;
-    }
+  if (Schedule) {
+    Schedule->addSCC(F, SCCGraph, CalleeFunctions, Functions);
     ValMap[F] = ~0U;
-    return MyID;
+    return false;
   }
+
+  // Now that we have one big happy family, resolve all of the call sites in
+  // the graph...
+  DEBUG(errs() << "  [BU] Calculating graph for: " << F->getName()<< "\n");
+  DSSummaries::Pending *P = Summaries ? Summaries->getPending(SCCGraph) : 0;
+  calculateGraph(SCCGraph, 0, 0, P ? &P->Inlined : 0);
+  DEBUG(errs() << "  [BU] Done inlining SCC #: " << MyID << " ["
+	<< SCCGraph->getGraphSize() << "+"
+	<< SCCGraph->getAuxFunctionCalls().size() << "]\n");
+
+  //
+  // Should we revisit the graph?  Only do it if there are now new resolvable
+  // callees.
+  //
+  FuncSet NewCallees;
+  getAllAuxCallees(SCCGraph, NewCallees);
+  if (!NewCallees.empty()) {
+    if (hasNewCallees(NewCallees, CalleeFunctions)) {
+      DEBUG(errs() << "Recalculating " << F->getName()
+            << " due to new knowledge\n");
+      return true;
+    }
+    ++NumRecalculationsSkipped;
+  }
+  if (Summaries)
+    finishSummary(SCCGraph);
+  ValMap[F] = ~0U;
+  return false;
 }
 
 //
@@ -620,11 +906,21 @@ void BUDataStructures::CloneAuxIntoGlobal(DSGraph* G) {
 //
 // Description:
 //  Inline all graphs in the callgraph and remove callsites that are completely
-//  dealt with
+//  dealt with.  When the graph is the graph of an SCC of a schedule, this runs
+//  on a thread: the call graph and the graphs of the callees are locked while
+//  they are used, and the globals go to the graph's own globals graph.  They
+//  also go there while a summary of the graph is recorded.
 //
-void BUDataStructures::calculateGraph(DSGraph* Graph) {
+// Outputs:
+//  Inlined - If not null, the callees whose graphs were inlined are added.
+//
+void BUDataStructures::calculateGraph(DSGraph* Graph, SCCSchedule *Schedule,
+                                      unsigned Index, FuncSet *Inlined) {
   DEBUG(Graph->AssertGraphOK(); Graph->getGlobalsGraph()->AssertGraphOK());
-  Graph->buildCallGraph(callgraph, GlobalFunctionList, filterCallees);
+  {
+    OptionalLock Lock(Schedule ? &Schedule->CallGraphLock : 0);
+    Graph->buildCallGraph(callgraph, GlobalFunctionList, filterCallees);
+  }
 
   // Move our call site list into TempFCs so that inline call sites go into the
   // new call site list and doesn't invalidate our iterators!
@@ -675,9 +971,16 @@ void BUDataStructures::calculateGraph(DSGraph* Graph) {
     DSGraph *GI;
 
     for (auto *Callee : CalledFuncs) {
+      assert((!Schedule || Schedule->isBelow(Index, Callee)) &&
+             "Inlining a graph that is not finished!");
+
       // Get the data structure graph for the called function.
 
       GI = getDSGraph(*Callee);  // Graph to inline
+      if (Inlined && GI != Graph)
+        Inlined->insert(Callee);
+      OptionalLock Lock(Schedule && GI != Graph ?
+                        &Schedule->getGraphLock(GI) : 0);
       DEBUG(GI->AssertGraphOK(); GI->getGlobalsGraph()->AssertGraphOK());
       DEBUG(errs() << "    Inlining graph for " << Callee->getName()
 	    << "[" << GI->getGraphSize() << "+"
@@ -712,15 +1015,313 @@ void BUDataStructures::calculateGraph(DSGraph* Graph) {
   // Update the callgraph with the new information that we have gleaned.
   // NOTE : This must be called before removeDeadNodes, so that no 
   // information is lost due to deletion of DSCallNodes.
-  Graph->buildCallGraph(callgraph, GlobalFunctionList, filterCallees);
+  {
+    OptionalLock Lock(Schedule ? &Schedule->CallGraphLock : 0);
+    Graph->buildCallGraph(callgraph, GlobalFunctionList, filterCallees);
+  }
 
   // Delete dead nodes.  Treat globals that are unreachable but that can
   // reach live nodes as live.
   Graph->removeDeadNodes(DSGraph::KeepUnreachableGlobals);
 
-  cloneIntoGlobals(Graph, DSGraph::DontCloneCallNodes |
-                        DSGraph::DontCloneAuxCallNodes |
-                        DSGraph::StripAllocaBit);
+  if (!Schedule && Graph->getGlobalsGraph() == GlobalsGraph) {
+    cloneIntoGlobals(Graph, DSGraph::DontCloneCallNodes |
+                          DSGraph::DontCloneAuxCallNodes |
+                          DSGraph::StripAllocaBit);
+  } else {
+    DSScalarMap &MainSM = Graph->getScalarMap();
+    ReachabilityCloner RC(Graph->getGlobalsGraph(), Graph,
+                          DSGraph::DontCloneCallNodes |
+                          DSGraph::DontCloneAuxCallNodes |
+                          DSGraph::StripAllocaBit);
+    for (DSScalarMap::global_iterator I = MainSM.global_begin(),
+         E = MainSM.global_end(); I != E; ++I)
+      RC.getClonedNH(MainSM[*I]);
+  }
   //Graph->writeGraphToFile(cerr, "bu_" + F.getName());
 }
 
+//
+// Method: inlineSCCsOnThreads()
+//
+// Description:
+//  Find the SCCs of the functions that the serial traversals of
+//  postOrderInline() would visit, and inline the graphs of the SCCs on
+//  threads.  An SCC is inlined once the SCCs that it calls are finished, so
+//  every SCC is inlined from the same graphs whatever the threads do, and
+//  what the SCCs add to the globals graph is merged into it in the order of
+//  the SCCs.  The result is the same for any number of threads.
+//
+//  An SCC that finds callees that are not under it is finished by the serial
+//  traversal, and so are the SCCs that call it; they are removed from ValMap
+//  on return.
+//
+// Outputs:
+//  Roots - The functions other than main() that started a traversal.
+//
+void
+BUDataStructures::inlineSCCsOnThreads (Module & M,
+                                       TarjanStack & Stack,
+                                       unsigned & NextID,
+                                       TarjanMap & ValMap,
+                                       DenseSet<const Function*> & Roots,
+                                       unsigned Threads) {
+  SCCSchedule Schedule;
+  Function *MainFunc = M.getFunction ("main");
+  if (MainFunc && !MainFunc->isDeclaration() && !ValMap.count(MainFunc))
+    calculateGraphs(MainFunc, Stack, NextID, ValMap, &Schedule);
+  for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I)
+    if (!I->isDeclaration() && !ValMap.count(I)) {
+      Roots.insert(I);
+      calculateGraphs(I, Stack, NextID, ValMap, &Schedule);
+      markGraphVisited(I, ValMap);
+    }
+
+  unsigned NumSCCs = Schedule.SCCs.size();
+  Schedule.Remaining = NumSCCs;
+  Schedule.Finished.assign(NumSCCs, false);
+  Schedule.NextCommit = 0;
+  for (unsigned i = NumSCCs; i != 0; --i)
+    if (!Schedule.SCCs[i - 1].Pending)
+      Schedule.Ready.push_back(i - 1);
+
+  {
+    NamedRegionTimer T("Inline SCCs on threads", "Bottom-up DSA",
+                       TimePassesIsEnabled);
+    prepareForThreads(M);
+
+    auto Work = [&]() {
+      std::unique_lock<std::mutex> Lock(Schedule.QueueLock);
+      while (true) {
+        while (Schedule.Ready.empty() && Schedule.Remaining)
+          Schedule.QueueChanged.wait(Lock);
+        if (Schedule.Ready.empty())
+          return;
+
+        unsigned Index = Schedule.Ready.back();
+        Schedule.Ready.pop_back();
+        bool Tainted = Schedule.SCCs[Index].Tainted;
+        Lock.unlock();
+        if (!Tainted)
+          inlineSCC(Schedule, Index);
+        finishSCC(Schedule, Index);
+        Lock.lock();
+      }
+    };
+
+    if (Threads > NumSCCs)
+      Threads = NumSCCs;
+    std::vector<std::thread> Workers;
+    for (unsigned T = 1; T < Threads; ++T)
+      Workers.push_back(std::thread(Work));
+    Work();
+    for (unsigned T = 0; T < Workers.size(); ++T)
+      Workers[T].join();
+  }
+
+  //
+  // Leave the SCCs that could not be finished to the serial traversal.  An
+  // SCC with new callees is visited again like the serial traversal visits
+  // it again, and the SCCs above it are visited from the start.
+  //
+  for (unsigned i = 0; i != NumSCCs; ++i) {
+    SCCSchedule::SCC &C = Schedule.SCCs[i];
+    if (C.Tainted) {
+      for (unsigned f = 0, e = C.Functions.size(); f != e; ++f)
+        ValMap.erase(C.Functions[f]);
+    } else if (C.Deferred) {
+      ValMap.erase(C.Root);
+    }
+  }
+}
+
+//
+// Method: inlineSCC()
+//
+// Description:
+//  Inline the graphs of the callees of an SCC into its graph on a thread, as
+//  calculateSCC() does, until it has no new callees.  If inlining finds
+//  callees that are not under the SCC, their calls are left for the serial
+//  traversal and the SCC is marked deferred.
+//
+void BUDataStructures::inlineSCC(SCCSchedule &Schedule, unsigned Index) {
+  SCCSchedule::SCC &C = Schedule.SCCs[Index];
+  DSGraph *Graph = C.Graph;
+  DSGraph *GG = Graph->getGlobalsGraph();
+  C.Globals = new DSGraph(GlobalECs, getDataLayout(), *TypeSS);
+  Graph->setGlobalsGraph(C.Globals);
+
+  while (true) {
+    calculateGraph(Graph, &Schedule, Index);
+
+    FuncSet NewCallees;
+    getAllAuxCallees(Graph, NewCallees);
+    if (NewCallees.empty())
+      break;
+    if (!hasNewCallees(NewCallees, C.Callees)) {
+      ++NumRecalculationsSkipped;
+      break;
+    }
+    ++NumRecalculations;
+
+    for (FuncSet::iterator I = NewCallees.begin(), E = NewCallees.end();
+         I != E; ++I)
+      if (!Schedule.isBelow(Index, *I))
+        C.Deferred = true;
+    if (C.Deferred)
+      break;
+    C.Callees.swap(NewCallees);
+  }
+
+  Graph->setGlobalsGraph(GG);
+}
+
+//
+// Method: finishSCC()
+//
+// Description:
+//  Record that an SCC is finished: schedule the SCCs whose callees are now
+//  all finished, and merge the globals of the SCCs finished so far into the
+//  globals graph in the order of the SCCs.
+//
+void BUDataStructures::finishSCC(SCCSchedule &Schedule, unsigned Index) {
+  SCCSchedule::SCC &C = Schedule.SCCs[Index];
+  {
+    std::lock_guard<std::mutex> Lock(Schedule.QueueLock);
+    for (unsigned i = 0, e = C.Callers.size(); i != e; ++i) {
+      SCCSchedule::SCC &Caller = Schedule.SCCs[C.Callers[i]];
+      if (C.Deferred || C.Tainted)
+        Caller.Tainted = true;
+      if (!--Caller.Pending)
+        Schedule.Ready.push_back(C.Callers[i]);
+    }
+    --Schedule.Remaining;
+  }
+  Schedule.QueueChanged.notify_all();
+
+  std::lock_guard<std::mutex> Lock(Schedule.CommitLock);
+  Schedule.Finished[Index] = true;
+  while (Schedule.NextCommit != Schedule.SCCs.size() &&
+         Schedule.Finished[Schedule.NextCommit]) {
+    DSGraph *Globals = Schedule.SCCs[Schedule.NextCommit++].Globals;
+    if (!Globals)
+      continue;
+    commitGlobals(Globals);
+    delete Globals;
+  }
+}
+
+//
+// Method: commitGlobals()
+//
+// Description:
+//  Merge what an SCC added to a globals graph of its own into the globals
+//  graph.
+//
+void BUDataStructures::commitGlobals(DSGraph *Globals) {
+  DSScalarMap &SM = Globals->getScalarMap();
+  ReachabilityCloner RC(GlobalsGraph, Globals, 0);
+  for (DSScalarMap::global_iterator I = SM.global_begin(),
+       E = SM.global_end(); I != E; ++I)
+    RC.getClonedNH(SM[*I]);
+  for (DSGraph::afc_iterator I = Globals->afc_begin(),
+       E = Globals->afc_end(); I != E; ++I)
+    GlobalsGraph->getAuxFunctionCalls().push_back(DSCallSite(*I, RC));
+}
+
+//
+// Method: beginSummary()
+//
+// Description:
+//  Replace the graph of an SCC with its saved graph if the SCC did not change
+//  since it was saved.  Otherwise record what the SCC adds to the globals
+//  graph so that its graph can be saved once it is finished.  An SCC that is
+//  visited again keeps recording; the graph of an SCC that took over a graph
+//  still being recorded for another SCC is not saved.
+//
+// Return value:
+//  true  - The graph of the SCC is its saved graph.
+//  false - The graph of the SCC must be inlined.
+//
+bool BUDataStructures::beginSummary(const Function *F, DSGraph *G) {
+  if (DSSummaries::Pending *P = Summaries->getPending(G)) {
+    if (P->Root != F)
+      abandonSummary(G);
+    return false;
+  }
+
+  std::string Local;
+  if (!Summaries->hashGraph(*G, Local))
+    return false;
+
+  if (const DSSummaries::Record *R = Summaries->find(F, Local)) {
+    DSGraph *Saved = new DSGraph(GlobalECs, getDataLayout(), *TypeSS,
+                                 GlobalsGraph);
+    DSGraph *Globals = new DSGraph(GlobalECs, getDataLayout(), *TypeSS);
+    std::vector<std::pair<CallSite, const Function*> > Edges;
+    if (Summaries->restore(*R, *Saved, *Globals, Edges)) {
+      Saved->setUseAuxCalls();
+      for (DSGraph::retnodes_iterator I = G->retnodes_begin(),
+           E = G->retnodes_end(); I != E; ++I)
+        setDSGraph(*I->first, Saved);
+      delete G;
+
+      for (unsigned i = 0, e = Edges.size(); i != e; ++i)
+        callgraph.insert(Edges[i].first, Edges[i].second);
+      commitGlobals(Globals);
+      delete Globals;
+      ++NumSummariesReused;
+      return true;
+    }
+    delete Saved;
+    delete Globals;
+  }
+
+  DSSummaries::Pending &P = Summaries->addPending(G);
+  P.Root = F;
+  P.Local = Local;
+  P.Globals = new DSGraph(GlobalECs, getDataLayout(), *TypeSS);
+  G->setGlobalsGraph(P.Globals);
+  return false;
+}
+
+//
+// Method: finishSummary()
+//
+// Description:
+//  Save the graph of a finished SCC.  If it cannot be saved, still give its
+//  functions the key of their graph so that the SCCs above it can be saved.
+//
+void BUDataStructures::finishSummary(DSGraph *G) {
+  DSSummaries::Pending *P = Summaries->getPending(G);
+  if (!P) {
+    Summaries->setKey(*G);
+    return;
+  }
+
+  G->setGlobalsGraph(GlobalsGraph);
+  if (!Summaries->save(*P, *G, callgraph))
+    Summaries->setKey(*G);
+  commitGlobals(P->Globals);
+  delete P->Globals;
+  Summaries->erasePending(G);
+}
+
+//
+// Method: abandonSummary()
+//
+// Description:
+//  Stop recording the SCC of a graph without saving it, and merge what it
+//  added to the globals graph so far into the globals graph.
+//
+void BUDataStructures::abandonSummary(DSGraph *G) {
+  DSSummaries::Pending *P = Summaries->getPending(G);
+  if (!P)
+    return;
+
+  G->setGlobalsGraph(GlobalsGraph);
+  commitGlobals(P->Globals);
+  delete P->Globals;
+  Summaries->erasePending(G);
+}
+
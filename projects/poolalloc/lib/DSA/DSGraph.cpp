@@ -215,15 +215,28 @@ void DSGraph::cloneInto( DSGraph* G, unsigned CloneFlags) {
        I != E; ++I)
     I->second.getNode()->remapLinks(OldNodeMap);
 
-  // Copy the scalar map... merging all of the global nodes...
+  // Copy the scalar map... merging all of the global nodes...  The globals
+  // are merged in the order of the global set so that the merges, unlike the
+  // walk of the hashed value map, happen in the same order in every run.
   for (DSScalarMap::const_iterator I = G->ScalarMap.begin(),
          E = G->ScalarMap.end(); I != E; ++I) {
+    if (isa<GlobalValue>(I->first))
+      continue;
     DSNodeHandle &MappedNode = OldNodeMap[I->second.getNode()];
     DSNodeHandle &H = ScalarMap.getRawEntryRef(I->first);
     DSNode *MappedNodeN = MappedNode.getNode();
     H.mergeWith(DSNodeHandle(MappedNodeN,
                              I->second.getOffset()+MappedNode.getOffset()));
   }
+  for (DSScalarMap::global_iterator I = G->ScalarMap.global_begin(),
+         E = G->ScalarMap.global_end(); I != E; ++I) {
+    const DSNodeHandle &GH = G->ScalarMap.find(*I)->second;
+    DSNodeHandle &MappedNode = OldNodeMap[GH.getNode()];
+    DSNodeHandle &H = ScalarMap.getRawEntryRef(*I);
+    DSNode *MappedNodeN = MappedNode.getNode();
+    H.mergeWith(DSNodeHandle(MappedNodeN,
+                             GH.getOffset()+MappedNode.getOffset()));
+  }
 
   if (!(CloneFlags & DontCloneCallNodes)) {
     // Copy the function calls list.
@@ -919,12 +932,16 @@ void DSGraph::removeTriviallyDeadNodes() {
   // Loop over all of the nodes in the graph, calling getNode on each field.
   // This will cause all nodes to update their forwarding edges, causing
   // forwarded nodes to be delete-able.  Further, reclaim any memory used by
-  // useless edge or type entries
+  // useless edge or type entries.  Cleaning a node erases its null links, so
+  // collect the nodes first: a node may link to itself.
+  std::vector<DSNode*> LinkedNodes;
   for (node_iterator NI = node_begin(), E = node_end(); NI != E; ++NI)
     for (DSNode::edge_iterator ii = NI->edge_begin(), ee = NI->edge_end();
-         ii != ee; ++ii) {
-      ii->second.getNode()->cleanEdges();
-    }
+         ii != ee; ++ii)
+      if (DSNode *N = ii->second.getNode())
+        LinkedNodes.push_back(N);
+  for (unsigned i = 0, e = LinkedNodes.size(); i != e; ++i)
+    LinkedNodes[i]->cleanEdges();
 
   // Likewise, forward any edges from the scalar nodes.  While we are at it,
   // clean house a bit.
@@ -1079,18 +1096,24 @@ void DSGraph::removeDeadNodes(unsigned Flags) {
   // Mark all nodes reachable by (non-global) scalar nodes as alive...
   for (DSScalarMap::iterator I = ScalarMap.begin(), E = ScalarMap.end();
           I != E; ++I)
-    if (isa<GlobalValue > (I->first)) { // Keep track of global nodes
-      assert(!I->second.isNull() && "Null global node?");
-      assert(I->second.getNode()->isGlobalNode() && "Should be a global node!");
-      GlobalNodes.push_back(std::make_pair(I->first, I->second.getNode()));
-
-      // Make sure that all globals are cloned over as roots.
-      if (!(Flags & DSGraph::RemoveUnreachableGlobals) && GlobalsGraph) {
-          GGCloner.getClonedNH(I->second);
-      }
-    } else {
+    if (!isa<GlobalValue>(I->first))
       I->second.getNode()->markReachableNodes(Alive);
+
+  // Keep track of global nodes.  Walk the global set rather than the hashed
+  // value map so that the globals graph gets its nodes in the same order in
+  // every run.
+  for (DSScalarMap::global_iterator I = ScalarMap.global_begin(),
+         E = ScalarMap.global_end(); I != E; ++I) {
+    DSNodeHandle &GH = ScalarMap.find(*I)->second;
+    assert(!GH.isNull() && "Null global node?");
+    assert(GH.getNode()->isGlobalNode() && "Should be a global node!");
+    GlobalNodes.push_back(std::make_pair(*I, GH.getNode()));
+
+    // Make sure that all globals are cloned over as roots.
+    if (!(Flags & DSGraph::RemoveUnreachableGlobals) && GlobalsGraph) {
+        GGCloner.getClonedNH(GH);
     }
+  }
 
   // The return values are alive as well.
   for (ReturnNodesTy::iterator I = ReturnNodes.begin(), E = ReturnNodes.end();
@@ -1332,7 +1355,11 @@ void DSGraph::computeNodeMapping(const DSNodeHandle &NH1,
   //
   int N2Idx = NH2.getOffset()-NH1.getOffset();
   for (unsigned i = 0, e = N1->getSize(); i < e; ++i) {
-    const DSNodeHandle &N1NH = N1->getLink(i);
+    // Skip the offsets without a link instead of adding null links to N1,
+    // and copy the links: mapping them can add links to N1 and N2, which may
+    // be the same node.
+    if (!N1->hasLink(i)) continue;
+    DSNodeHandle N1NH = N1->getLink(i);
     //
     // Don't call N2->getLink if not needed (avoiding crash if N2Idx is not
     // aligned correctly).
@@ -1350,7 +1377,8 @@ void DSGraph::computeNodeMapping(const DSNodeHandle &NH1,
       //
       // Compute the node mapping for the link.
       //
-      computeNodeMapping (N1NH, N2->getLink(offset), NodeMap, StrictChecking);
+      DSNodeHandle N2NH = N2->getLink(offset);
+      computeNodeMapping (N1NH, N2NH, NodeMap, StrictChecking);
     }
   }
 }
@@ -1449,12 +1477,14 @@ void DSGraph::computeCalleeCallerMapping(DSCallSite CS, const Function &Callee,
 void DSGraph::updateFromGlobalGraph() {
   ReachabilityCloner RC(this, GlobalsGraph, 0);
 
-  // Clone the non-up-to-date global nodes into this graph.
-  for (DSScalarMap::global_iterator I = getScalarMap().global_begin(),
-         E = getScalarMap().global_end(); I != E; ++I) {
-    DSScalarMap::iterator It = GlobalsGraph->ScalarMap.find(*I);
+  // Clone the non-up-to-date global nodes into this graph.  Merging can add
+  // globals to the scalar map, so walk a copy of its globals.
+  std::vector<const GlobalValue*> Globals(getScalarMap().global_begin(),
+                                          getScalarMap().global_end());
+  for (unsigned i = 0, e = Globals.size(); i != e; ++i) {
+    DSScalarMap::iterator It = GlobalsGraph->ScalarMap.find(Globals[i]);
     if (It != GlobalsGraph->ScalarMap.end())
-      RC.merge(getNodeForValue(*I), It->second);
+      RC.merge(getNodeForValue(Globals[i]), It->second);
   }
 }
 
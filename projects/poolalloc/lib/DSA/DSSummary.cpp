@@ -0,0 +1,1037 @@
+//===- DSSummary.cpp - Save and reuse bottom-up graphs of SCCs ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the summary files of the bottom-up pass.  A summary
+// file is text: a header line, then one line per SCC with its root, its
+// hashes, the keys of the graphs inlined into it, and a body that holds its
+// graph, what it added to the globals graph, and its call graph edges.
+// Strings are written as <length>:<bytes> so that any name can be read back.
+//
+// Nodes are numbered in the order in which they are reached from the sorted
+// scalars, return nodes, and call sites, and type sets and globals are
+// sorted by name, so equal graphs are written the same way whatever the
+// order of the maps and of the node list.  This is what makes the hashes
+// stable from one run to the next.
+//
+//===----------------------------------------------------------------------===//
+
+#include "dsa/DSSummary.h"
+#include "dsa/DSCallGraph.h"
+#include "dsa/DSGraph.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+// Change this whenever the format or the meaning of a summary changes.
+static const unsigned SummaryVersion = 1;
+
+static void writeString(raw_ostream &OS, StringRef S) {
+  OS << ' ' << S.size() << ':' << S;
+}
+
+//
+// Function: writeType()
+//
+// Description:
+//  Write a type so that readType() can make it again.  Identified structures
+//  are written by name; return false for one without a name.
+//
+static bool writeType(raw_ostream &OS, Type *T) {
+  switch (T->getTypeID()) {
+  case Type::VoidTyID:      OS << " v"; return true;
+  case Type::HalfTyID:      OS << " h"; return true;
+  case Type::FloatTyID:     OS << " f"; return true;
+  case Type::DoubleTyID:    OS << " d"; return true;
+  case Type::X86_FP80TyID:  OS << " x"; return true;
+  case Type::FP128TyID:     OS << " q"; return true;
+  case Type::PPC_FP128TyID: OS << " p"; return true;
+  case Type::LabelTyID:     OS << " l"; return true;
+  case Type::MetadataTyID:  OS << " m"; return true;
+  case Type::X86_MMXTyID:   OS << " X"; return true;
+  case Type::IntegerTyID:
+    OS << " i" << cast<IntegerType>(T)->getBitWidth();
+    return true;
+  case Type::PointerTyID:
+    OS << " *" << cast<PointerType>(T)->getAddressSpace();
+    return writeType(OS, T->getPointerElementType());
+  case Type::ArrayTyID:
+    OS << " [" << T->getArrayNumElements();
+    return writeType(OS, T->getArrayElementType());
+  case Type::VectorTyID:
+    OS << " <" << T->getVectorNumElements();
+    return writeType(OS, T->getVectorElementType());
+  case Type::FunctionTyID: {
+    FunctionType *FT = cast<FunctionType>(T);
+    OS << " F" << FT->getNumParams() << ' ' << FT->isVarArg();
+    if (!writeType(OS, FT->getReturnType()))
+      return false;
+    for (unsigned i = 0, e = FT->getNumParams(); i != e; ++i)
+      if (!writeType(OS, FT->getParamType(i)))
+        return false;
+    return true;
+  }
+  case Type::StructTyID: {
+    StructType *ST = cast<StructType>(T);
+    if (!ST->isLiteral()) {
+      if (!ST->hasName())
+        return false;
+      OS << " %";
+      writeString(OS, ST->getName());
+      return true;
+    }
+    OS << " {" << ST->getNumElements() << ' ' << ST->isPacked();
+    for (unsigned i = 0, e = ST->getNumElements(); i != e; ++i)
+      if (!writeType(OS, ST->getElementType(i)))
+        return false;
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+//
+// Class: DSSummaries::Reader
+//
+// Description:
+//  Reads the tokens and strings of a summary.  An error is remembered rather
+//  than reported at once; the callers check failed() before they trust what
+//  they read, and stop their loops when it is set.
+//
+class DSSummaries::Reader {
+  StringRef Buffer;
+  bool Failed;
+
+public:
+  explicit Reader(StringRef Buffer) : Buffer(Buffer), Failed(false) {}
+
+  bool failed() const { return Failed; }
+  void fail() { Failed = true; }
+  size_t size() const { return Buffer.size(); }
+
+  bool atEnd() {
+    Buffer = Buffer.ltrim();
+    return Buffer.empty();
+  }
+
+  StringRef token() {
+    Buffer = Buffer.ltrim();
+    StringRef Token = Buffer.substr(0, Buffer.find_first_of(" \t\n"));
+    Buffer = Buffer.substr(Token.size());
+    if (Token.empty())
+      Failed = true;
+    return Token;
+  }
+
+  unsigned number() {
+    unsigned N = 0;
+    if (token().getAsInteger(10, N))
+      Failed = true;
+    return N;
+  }
+
+  void expect(StringRef Token) {
+    if (token() != Token)
+      Failed = true;
+  }
+
+  StringRef string() {
+    Buffer = Buffer.ltrim();
+    size_t Colon = Buffer.find(':');
+    size_t Length;
+    if (Colon == StringRef::npos ||
+        Buffer.substr(0, Colon).getAsInteger(10, Length) ||
+        Length > Buffer.size() - Colon - 1) {
+      Failed = true;
+      return StringRef();
+    }
+    StringRef S = Buffer.substr(Colon + 1, Length);
+    Buffer = Buffer.substr(Colon + 1 + Length);
+    return S;
+  }
+
+  //
+  // Method: handle()
+  //
+  // Description:
+  //  Read a node handle written by writeHandle().  Return false if it names a
+  //  node that does not exist or an offset that the node cannot have.
+  //
+  bool handle(const std::vector<DSNode*> &Nodes, DSNodeHandle &NH) {
+    unsigned ID = number();
+    unsigned Offset = number();
+    if (Failed || ID > Nodes.size())
+      return false;
+    if (!ID) {
+      NH.setTo(0, 0);
+      return true;
+    }
+    DSNode *N = Nodes[ID - 1];
+    if (Offset && Offset >= N->getSize())
+      return false;
+    NH.setTo(N, Offset);
+    return true;
+  }
+};
+
+//
+// Method: getValues()
+//
+// Description:
+//  Return the arguments and instructions of a function in order.  A value
+//  of a function is written as the name of the function and its index here.
+//
+const std::vector<const Value*> &DSSummaries::getValues(const Function *F) {
+  std::vector<const Value*> &Values = ValuesOf[F];
+  if (Values.empty()) {
+    for (Function::const_arg_iterator I = F->arg_begin(), E = F->arg_end();
+         I != E; ++I)
+      Values.push_back(&*I);
+    for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+      Values.push_back(&*I);
+    for (unsigned i = 0, e = Values.size(); i != e; ++i)
+      ValueIDs[Values[i]] = i;
+  }
+  return Values;
+}
+
+//
+// Method: writeValue()
+//
+// Description:
+//  Write a global by name, or an argument or instruction by its function and
+//  its index.  Return false for any other value.
+//
+bool DSSummaries::writeValue(raw_ostream &OS, const Value *V) {
+  if (const GlobalValue *GV = dyn_cast<GlobalValue>(V)) {
+    if (!GV->hasName())
+      return false;
+    OS << " g";
+    writeString(OS, GV->getName());
+    return true;
+  }
+
+  const Function *F = 0;
+  if (const Argument *A = dyn_cast<Argument>(V))
+    F = A->getParent();
+  else if (const Instruction *I = dyn_cast<Instruction>(V))
+    if (I->getParent())
+      F = I->getParent()->getParent();
+  if (!F || !F->hasName())
+    return false;
+
+  getValues(F);
+  OS << " v";
+  writeString(OS, F->getName());
+  OS << ' ' << ValueIDs[V];
+  return true;
+}
+
+const Value *DSSummaries::readValue(Reader &R) {
+  StringRef Kind = R.token();
+  if (Kind == "-")
+    return 0;
+  if (Kind == "g") {
+    if (const GlobalValue *GV = M.getNamedValue(R.string()))
+      return GV;
+  } else if (Kind == "v") {
+    const Function *F = M.getFunction(R.string());
+    unsigned ID = R.number();
+    if (F && !R.failed()) {
+      const std::vector<const Value*> &Values = getValues(F);
+      if (ID < Values.size())
+        return Values[ID];
+    }
+  }
+  R.fail();
+  return 0;
+}
+
+Type *DSSummaries::readType(Reader &R) {
+  StringRef Token = R.token();
+  if (R.failed())
+    return 0;
+
+  LLVMContext &C = M.getContext();
+  unsigned N = 0;
+  if (Token.size() > 1 && Token.substr(1).getAsInteger(10, N)) {
+    R.fail();
+    return 0;
+  }
+
+  switch (Token[0]) {
+  case 'v': return Type::getVoidTy(C);
+  case 'h': return Type::getHalfTy(C);
+  case 'f': return Type::getFloatTy(C);
+  case 'd': return Type::getDoubleTy(C);
+  case 'x': return Type::getX86_FP80Ty(C);
+  case 'q': return Type::getFP128Ty(C);
+  case 'p': return Type::getPPC_FP128Ty(C);
+  case 'l': return Type::getLabelTy(C);
+  case 'm': return Type::getMetadataTy(C);
+  case 'X': return Type::getX86_MMXTy(C);
+  case 'i':
+    if (N >= IntegerType::MIN_INT_BITS && N <= IntegerType::MAX_INT_BITS)
+      return IntegerType::get(C, N);
+    break;
+  case '*':
+    if (Type *Elt = readType(R))
+      if (PointerType::isValidElementType(Elt))
+        return PointerType::get(Elt, N);
+    break;
+  case '[':
+    if (Type *Elt = readType(R))
+      if (ArrayType::isValidElementType(Elt))
+        return ArrayType::get(Elt, N);
+    break;
+  case '<':
+    if (Type *Elt = readType(R))
+      if (N && VectorType::isValidElementType(Elt))
+        return VectorType::get(Elt, N);
+    break;
+  case 'F': {
+    bool VarArg = R.number();
+    Type *Ret = readType(R);
+    if (!Ret || !FunctionType::isValidReturnType(Ret))
+      break;
+    std::vector<Type*> Params;
+    for (unsigned i = 0; i != N && !R.failed(); ++i) {
+      Type *Param = readType(R);
+      if (!Param || !FunctionType::isValidArgumentType(Param))
+        break;
+      Params.push_back(Param);
+    }
+    if (Params.size() == N)
+      return FunctionType::get(Ret, Params, VarArg);
+    break;
+  }
+  case '{': {
+    bool Packed = R.number();
+    std::vector<Type*> Elts;
+    for (unsigned i = 0; i != N && !R.failed(); ++i) {
+      Type *Elt = readType(R);
+      if (!Elt || !StructType::isValidElementType(Elt))
+        break;
+      Elts.push_back(Elt);
+    }
+    if (Elts.size() == N)
+      return StructType::get(C, Elts, Packed);
+    break;
+  }
+  case '%':
+    if (StructType *ST = M.getTypeByName(R.string()))
+      return ST;
+    break;
+  }
+
+  R.fail();
+  return 0;
+}
+
+void DSSummaries::writeHandle(raw_ostream &OS, const DSNodeHandle &NH,
+                              const DenseMap<const DSNode*, unsigned> &IDs) {
+  if (DSNode *N = NH.getNode())
+    OS << ' ' << IDs.lookup(N) << ' ' << NH.getOffset();
+  else
+    OS << " 0 0";
+}
+
+//
+// Method: writeCall()
+//
+// Description:
+//  Write a call site: the call, its callee, its return and var-arg nodes, its
+//  pointer arguments, and the calls merged into it.
+//
+bool DSSummaries::writeCall(raw_ostream &OS, const DSCallSite &CS,
+                            const DenseMap<const DSNode*, unsigned> &IDs) {
+  if (const Instruction *I = CS.getCallSite().getInstruction()) {
+    if (!writeValue(OS, I))
+      return false;
+  } else {
+    OS << " -";
+  }
+
+  if (CS.isDirectCall()) {
+    OS << " f";
+    if (!writeValue(OS, CS.getCalleeFunc()))
+      return false;
+  } else {
+    OS << " n " << IDs.lookup(CS.getCalleeNode());
+  }
+
+  writeHandle(OS, CS.getRetVal(), IDs);
+  writeHandle(OS, CS.getVAVal(), IDs);
+  OS << ' ' << CS.getNumPtrArgs();
+  for (unsigned i = 0, e = CS.getNumPtrArgs(); i != e; ++i)
+    writeHandle(OS, CS.getPtrArg(i), IDs);
+
+  std::vector<std::string> Mapped;
+  for (DSCallSite::MappedSites_t::iterator I = CS.ms_begin(),
+       E = CS.ms_end(); I != E; ++I) {
+    std::string Name;
+    raw_string_ostream NOS(Name);
+    if (!I->getInstruction() || !writeValue(NOS, I->getInstruction()))
+      return false;
+    Mapped.push_back(NOS.str());
+  }
+  std::sort(Mapped.begin(), Mapped.end());
+  OS << ' ' << Mapped.size();
+  for (unsigned i = 0, e = Mapped.size(); i != e; ++i)
+    OS << Mapped[i];
+  return true;
+}
+
+bool DSSummaries::readCall(Reader &R, const std::vector<DSNode*> &Nodes,
+                           DSGraph &G, bool Aux) {
+  CallSite Site;
+  if (const Value *V = readValue(R))
+    Site = CallSite(const_cast<Value*>(V));
+  if (R.failed())
+    return false;
+
+  const Function *CalleeF = 0;
+  DSNode *CalleeN = 0;
+  StringRef Kind = R.token();
+  if (Kind == "f") {
+    CalleeF = dyn_cast_or_null<Function>(readValue(R));
+  } else if (Kind == "n") {
+    unsigned ID = R.number();
+    if (ID && ID <= Nodes.size())
+      CalleeN = Nodes[ID - 1];
+  }
+  if (!CalleeF && !CalleeN)
+    return false;
+
+  DSNodeHandle RetVal, VarArgVal;
+  if (!R.handle(Nodes, RetVal) || !R.handle(Nodes, VarArgVal))
+    return false;
+  unsigned NumArgs = R.number();
+  if (R.failed() || NumArgs > R.size())
+    return false;
+  std::vector<DSNodeHandle> Args(NumArgs);
+  for (unsigned i = 0; i != NumArgs; ++i)
+    if (!R.handle(Nodes, Args[i]))
+      return false;
+
+  DSCallSite CS = CalleeF ?
+    DSCallSite(Site, RetVal, VarArgVal, CalleeF, Args) :
+    DSCallSite(Site, RetVal, VarArgVal, CalleeN, Args);
+
+  unsigned NumMapped = R.number();
+  for (unsigned i = 0; i != NumMapped && !R.failed(); ++i) {
+    const Value *V = readValue(R);
+    if (!V || !CallSite(const_cast<Value*>(V)).getInstruction())
+      return false;
+    CS.addMappedSite(CallSite(const_cast<Value*>(V)));
+  }
+  if (R.failed())
+    return false;
+
+  if (Aux)
+    G.getAuxFunctionCalls().push_back(CS);
+  else
+    G.getFunctionCalls().push_back(CS);
+  return true;
+}
+
+//
+// Method: writeGraph()
+//
+// Description:
+//  Write a graph: its nodes, their links, its scalar map, its return and
+//  var-arg nodes, and its call sites.  Return false if the graph holds a
+//  value or a type that a summary cannot name.
+//
+bool DSSummaries::writeGraph(raw_ostream &OS, const DSGraph &G) {
+  typedef std::pair<std::string, const DSNodeHandle*> NamedHandle;
+
+  std::vector<NamedHandle> Scalars;
+  const DSScalarMap &SM = G.getScalarMap();
+  for (DSScalarMap::const_iterator I = SM.begin(), E = SM.end(); I != E; ++I) {
+    std::string Name;
+    raw_string_ostream NOS(Name);
+    if (!writeValue(NOS, I->first))
+      return false;
+    Scalars.push_back(NamedHandle(NOS.str(), &I->second));
+  }
+  std::sort(Scalars.begin(), Scalars.end(), less_first());
+
+  std::vector<NamedHandle> Returns, VarArgs;
+  for (DSGraph::ReturnNodesTy::const_iterator I = G.getReturnNodes().begin(),
+       E = G.getReturnNodes().end(); I != E; ++I) {
+    std::string Name;
+    raw_string_ostream NOS(Name);
+    if (!writeValue(NOS, I->first))
+      return false;
+    Returns.push_back(NamedHandle(NOS.str(), &I->second));
+  }
+  for (DSGraph::VANodesTy::const_iterator I = G.getVANodes().begin(),
+       E = G.getVANodes().end(); I != E; ++I) {
+    std::string Name;
+    raw_string_ostream NOS(Name);
+    if (!writeValue(NOS, I->first))
+      return false;
+    VarArgs.push_back(NamedHandle(NOS.str(), &I->second));
+  }
+  std::sort(Returns.begin(), Returns.end(), less_first());
+  std::sort(VarArgs.begin(), VarArgs.end(), less_first());
+
+  //
+  // Number the nodes breadth first from the roots, then the nodes that no
+  // root reaches in the order of the node list.
+  //
+  DenseMap<const DSNode*, unsigned> IDs;
+  std::vector<const DSNode*> Order;
+  unsigned Next = 0;
+  auto Reach = [&](const DSNode *N) {
+    if (!N || !IDs.insert(std::make_pair(N, Order.size() + 1)).second)
+      return;
+    Order.push_back(N);
+    for (; Next != Order.size(); ++Next)
+      for (DSNode::const_edge_iterator I = Order[Next]->edge_begin(),
+           E = Order[Next]->edge_end(); I != E; ++I)
+        if (DSNode *L = I->second.getNode())
+          if (IDs.insert(std::make_pair(L, Order.size() + 1)).second)
+            Order.push_back(L);
+  };
+  auto ReachCalls = [&](const DSGraph::FunctionListTy &Calls) {
+    for (DSGraph::FunctionListTy::const_iterator I = Calls.begin(),
+         E = Calls.end(); I != E; ++I) {
+      if (I->isIndirectCall())
+        Reach(I->getCalleeNode());
+      Reach(I->getRetVal().getNode());
+      Reach(I->getVAVal().getNode());
+      for (unsigned i = 0, e = I->getNumPtrArgs(); i != e; ++i)
+        Reach(I->getPtrArg(i).getNode());
+    }
+  };
+  for (unsigned i = 0, e = Scalars.size(); i != e; ++i)
+    Reach(Scalars[i].second->getNode());
+  for (unsigned i = 0, e = Returns.size(); i != e; ++i)
+    Reach(Returns[i].second->getNode());
+  for (unsigned i = 0, e = VarArgs.size(); i != e; ++i)
+    Reach(VarArgs[i].second->getNode());
+  ReachCalls(G.getFunctionCalls());
+  ReachCalls(G.getAuxFunctionCalls());
+  for (DSGraph::node_const_iterator I = G.node_begin(), E = G.node_end();
+       I != E; ++I)
+    Reach(&*I);
+
+  OS << "graph " << Order.size() << '\n';
+  for (unsigned n = 0, ne = Order.size(); n != ne; ++n) {
+    const DSNode *N = Order[n];
+    OS << "n " << N->getNodeFlags() << ' ' << N->getSize() << ' '
+       << (N->type_end() - N->type_begin());
+    for (DSNode::const_type_iterator I = N->type_begin(), E = N->type_end();
+         I != E; ++I) {
+      OS << ' ' << I->first;
+      if (!I->second) {
+        OS << " 0";
+        continue;
+      }
+      std::vector<std::string> Types;
+      for (svset<Type*>::const_iterator T = I->second->begin(),
+           TE = I->second->end(); T != TE; ++T) {
+        std::string Name;
+        raw_string_ostream NOS(Name);
+        if (!writeType(NOS, *T))
+          return false;
+        Types.push_back(NOS.str());
+      }
+      std::sort(Types.begin(), Types.end());
+      OS << ' ' << Types.size();
+      for (unsigned i = 0, e = Types.size(); i != e; ++i)
+        OS << Types[i];
+    }
+
+    std::vector<std::string> Globals;
+    for (DSNode::globals_iterator I = N->globals_begin(),
+         E = N->globals_end(); I != E; ++I) {
+      std::string Name;
+      raw_string_ostream NOS(Name);
+      if (!writeValue(NOS, *I))
+        return false;
+      Globals.push_back(NOS.str());
+    }
+    std::sort(Globals.begin(), Globals.end());
+    OS << ' ' << Globals.size();
+    for (unsigned i = 0, e = Globals.size(); i != e; ++i)
+      OS << Globals[i];
+    OS << '\n';
+  }
+
+  for (unsigned n = 0, ne = Order.size(); n != ne; ++n) {
+    const DSNode *N = Order[n];
+    OS << "l " << (N->edge_end() - N->edge_begin());
+    for (DSNode::const_edge_iterator I = N->edge_begin(), E = N->edge_end();
+         I != E; ++I) {
+      OS << ' ' << I->first;
+      writeHandle(OS, I->second, IDs);
+    }
+    OS << '\n';
+  }
+
+  OS << "scalars " << Scalars.size() << '\n';
+  for (unsigned i = 0, e = Scalars.size(); i != e; ++i) {
+    OS << Scalars[i].first;
+    writeHandle(OS, *Scalars[i].second, IDs);
+    OS << '\n';
+  }
+  OS << "returns " << Returns.size() << '\n';
+  for (unsigned i = 0, e = Returns.size(); i != e; ++i) {
+    OS << Returns[i].first;
+    writeHandle(OS, *Returns[i].second, IDs);
+    OS << '\n';
+  }
+  OS << "varargs " << VarArgs.size() << '\n';
+  for (unsigned i = 0, e = VarArgs.size(); i != e; ++i) {
+    OS << VarArgs[i].first;
+    writeHandle(OS, *VarArgs[i].second, IDs);
+    OS << '\n';
+  }
+
+  OS << "calls " << G.getFunctionCalls().size() << '\n';
+  for (DSGraph::fc_iterator I = G.fc_begin(), E = G.fc_end(); I != E; ++I) {
+    if (!writeCall(OS, *I, IDs))
+      return false;
+    OS << '\n';
+  }
+  OS << "aux " << G.getAuxFunctionCalls().size() << '\n';
+  for (DSGraph::afc_const_iterator I = G.afc_begin(), E = G.afc_end();
+       I != E; ++I) {
+    if (!writeCall(OS, *I, IDs))
+      return false;
+    OS << '\n';
+  }
+  return true;
+}
+
+//
+// Method: readGraph()
+//
+// Description:
+//  Read a graph written by writeGraph() into an empty graph.  The nodes are
+//  made exactly as they were written, which their public methods do not
+//  allow: growing a node or merging types into it changes its flags.
+//
+bool DSSummaries::readGraph(Reader &R, DSGraph &G) {
+  R.expect("graph");
+  unsigned NumNodes = R.number();
+  if (R.failed() || NumNodes > R.size())
+    return false;
+
+  std::vector<DSNode*> Nodes;
+  for (unsigned n = 0; n != NumNodes; ++n)
+    Nodes.push_back(new DSNode(&G));
+
+  for (unsigned n = 0; n != NumNodes && !R.failed(); ++n) {
+    DSNode *N = Nodes[n];
+    R.expect("n");
+    N->NodeType = R.number() & ~DSNode::DeadNode;
+    N->Size = R.number();
+    unsigned NumTypes = R.number();
+    for (unsigned t = 0; t != NumTypes && !R.failed(); ++t) {
+      unsigned Offset = R.number();
+      unsigned Count = R.number();
+      if (!Count) {
+        N->TyMap[Offset] = 0;
+        continue;
+      }
+      svset<Type*> Types;
+      for (unsigned i = 0; i != Count && !R.failed(); ++i)
+        if (Type *T = readType(R))
+          Types.insert(T);
+      if (!R.failed())
+        N->TyMap[Offset] = TypeSS.getOrCreate(Types);
+    }
+    unsigned NumGlobals = R.number();
+    for (unsigned i = 0; i != NumGlobals && !R.failed(); ++i)
+      if (const GlobalValue *GV = dyn_cast_or_null<GlobalValue>(readValue(R)))
+        N->Globals.insert(GV);
+      else
+        R.fail();
+  }
+
+  for (unsigned n = 0; n != NumNodes && !R.failed(); ++n) {
+    DSNode *N = Nodes[n];
+    R.expect("l");
+    unsigned NumLinks = R.number();
+    for (unsigned i = 0; i != NumLinks && !R.failed(); ++i) {
+      unsigned Offset = R.number();
+      DSNodeHandle NH;
+      if (!R.handle(Nodes, NH) || Offset >= N->getSize())
+        return false;
+      N->setLink(Offset, NH);
+    }
+  }
+
+  R.expect("scalars");
+  unsigned NumScalars = R.number();
+  for (unsigned i = 0; i != NumScalars && !R.failed(); ++i) {
+    const Value *V = readValue(R);
+    if (!V || !R.handle(Nodes, G.getScalarMap().getRawEntryRef(V)))
+      return false;
+  }
+
+  R.expect("returns");
+  unsigned NumReturns = R.number();
+  for (unsigned i = 0; i != NumReturns && !R.failed(); ++i) {
+    const Function *F = dyn_cast_or_null<Function>(readValue(R));
+    if (!F || !R.handle(Nodes, G.getReturnNodes()[F]))
+      return false;
+  }
+
+  R.expect("varargs");
+  unsigned NumVarArgs = R.number();
+  for (unsigned i = 0; i != NumVarArgs && !R.failed(); ++i) {
+    const Function *F = dyn_cast_or_null<Function>(readValue(R));
+    if (!F || !R.handle(Nodes, G.getVANodes()[F]))
+      return false;
+  }
+
+  R.expect("calls");
+  unsigned NumCalls = R.number();
+  for (unsigned i = 0; i != NumCalls && !R.failed(); ++i)
+    if (!readCall(R, Nodes, G, false))
+      return false;
+
+  R.expect("aux");
+  unsigned NumAux = R.number();
+  for (unsigned i = 0; i != NumAux && !R.failed(); ++i)
+    if (!readCall(R, Nodes, G, true))
+      return false;
+
+  return !R.failed();
+}
+
+//
+// Method: writeEdges()
+//
+// Description:
+//  Write the call graph edges of the call sites of the functions of a graph.
+//
+bool DSSummaries::writeEdges(raw_ostream &OS, const DSGraph &G,
+                             const DSCallGraph &CG) {
+  std::vector<std::pair<std::string, const Function*> > Functions;
+  for (DSGraph::ReturnNodesTy::const_iterator I = G.getReturnNodes().begin(),
+       E = G.getReturnNodes().end(); I != E; ++I)
+    Functions.push_back(std::make_pair(I->first->getName().str(), I->first));
+  std::sort(Functions.begin(), Functions.end(), less_first());
+
+  std::string Text;
+  raw_string_ostream EOS(Text);
+  unsigned NumEdges = 0;
+  for (unsigned f = 0, fe = Functions.size(); f != fe; ++f) {
+    for (const_inst_iterator I = inst_begin(Functions[f].second),
+         E = inst_end(Functions[f].second); I != E; ++I) {
+      CallSite CS(const_cast<Instruction*>(&*I));
+      if (!CS.getInstruction() || !CG.callee_size(CS))
+        continue;
+
+      std::vector<std::string> Callees;
+      for (DSCallGraph::callee_iterator C = CG.callee_begin(CS),
+           CE = CG.callee_end(CS); C != CE; ++C) {
+        std::string Name;
+        raw_string_ostream NOS(Name);
+        if (!writeValue(NOS, *C))
+          return false;
+        Callees.push_back(NOS.str());
+      }
+      std::sort(Callees.begin(), Callees.end());
+
+      if (!writeValue(EOS, &*I))
+        return false;
+      EOS << ' ' << Callees.size();
+      for (unsigned i = 0, e = Callees.size(); i != e; ++i)
+        EOS << Callees[i];
+      EOS << '\n';
+      ++NumEdges;
+    }
+  }
+
+  OS << "edges " << NumEdges << '\n' << EOS.str();
+  return true;
+}
+
+bool DSSummaries::readEdges(
+    Reader &R, std::vector<std::pair<CallSite, const Function*> > &Edges) {
+  R.expect("edges");
+  unsigned NumEdges = R.number();
+  for (unsigned i = 0; i != NumEdges && !R.failed(); ++i) {
+    const Value *V = readValue(R);
+    if (!V || !CallSite(const_cast<Value*>(V)).getInstruction())
+      return false;
+    CallSite CS(const_cast<Value*>(V));
+    unsigned NumCallees = R.number();
+    for (unsigned c = 0; c != NumCallees && !R.failed(); ++c) {
+      const Function *F = dyn_cast_or_null<Function>(readValue(R));
+      if (!F)
+        return false;
+      Edges.push_back(std::make_pair(CS, F));
+    }
+  }
+  return !R.failed();
+}
+
+std::string DSSummaries::hash(StringRef Text) const {
+  MD5 Hash;
+  Hash.update(Environment);
+  Hash.update(Text);
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Str;
+  MD5::stringifyResult(Result, Str);
+  return Str.str();
+}
+
+//
+// Method: setEnvironment()
+//
+// Description:
+//  Hash what inlining depends on besides the graphs themselves.  The bottom-up
+//  pass calls this again when it changes the global equivalence classes, so
+//  the graphs hashed after that do not match the ones hashed before.
+//
+void DSSummaries::setEnvironment(
+    const std::vector<const Function*> &GlobalFunctionList,
+    bool FilterCallees) {
+  std::string Text;
+  raw_string_ostream OS(Text);
+  OS << "dsa-summary " << SummaryVersion << ' ' << FilterCallees;
+  writeString(OS, M.getDataLayoutStr());
+
+  // The global equivalence classes that merge globals
+  std::vector<std::string> Classes;
+  for (EquivalenceClasses<const GlobalValue*>::iterator I = GlobalECs.begin(),
+       E = GlobalECs.end(); I != E; ++I) {
+    if (!I->isLeader())
+      continue;
+    std::vector<std::string> Members;
+    for (EquivalenceClasses<const GlobalValue*>::member_iterator
+         MI = GlobalECs.member_begin(I), ME = GlobalECs.member_end();
+         MI != ME; ++MI)
+      Members.push_back((*MI)->getName());
+    if (Members.size() < 2)
+      continue;
+    std::sort(Members.begin(), Members.end());
+    std::string Class;
+    raw_string_ostream COS(Class);
+    COS << " ec " << Members.size();
+    for (unsigned i = 0, e = Members.size(); i != e; ++i)
+      writeString(COS, Members[i]);
+    Classes.push_back(COS.str());
+  }
+
+  // The functions whose address is taken
+  std::vector<std::string> Functions;
+  for (unsigned i = 0, e = GlobalFunctionList.size(); i != e; ++i)
+    Functions.push_back(GlobalFunctionList[i]->getName());
+
+  // The bodies of the structures, which types name
+  std::vector<std::string> Structs;
+  std::vector<StructType*> Types = M.getIdentifiedStructTypes();
+  for (unsigned i = 0, e = Types.size(); i != e; ++i) {
+    if (!Types[i]->hasName())
+      continue;
+    std::string Struct;
+    raw_string_ostream SOS(Struct);
+    SOS << " struct";
+    writeString(SOS, Types[i]->getName());
+    if (Types[i]->isOpaque())
+      SOS << " opaque";
+    else
+      writeType(SOS, StructType::get(M.getContext(), Types[i]->elements(),
+                                     Types[i]->isPacked()));
+    Structs.push_back(SOS.str());
+  }
+
+  std::sort(Classes.begin(), Classes.end());
+  std::sort(Functions.begin(), Functions.end());
+  std::sort(Structs.begin(), Structs.end());
+  for (unsigned i = 0, e = Classes.size(); i != e; ++i)
+    OS << Classes[i];
+  OS << " functions " << Functions.size();
+  for (unsigned i = 0, e = Functions.size(); i != e; ++i)
+    writeString(OS, Functions[i]);
+  for (unsigned i = 0, e = Structs.size(); i != e; ++i)
+    OS << Structs[i];
+
+  // hash() starts with the environment, so forget the previous one first.
+  Environment.clear();
+  Environment = hash(OS.str());
+}
+
+//
+// Method: read()
+//
+// Description:
+//  Read the records of a summary file.  The graphs themselves are only read
+//  when they are reused.
+//
+bool DSSummaries::read(StringRef Filename) {
+  ErrorOr<std::unique_ptr<MemoryBuffer> > File =
+    MemoryBuffer::getFile(Filename);
+  if (!File)
+    return false;
+
+  Reader R((*File)->getBuffer());
+  R.expect("dsa-summary");
+  if (R.number() != SummaryVersion || R.failed())
+    return false;
+
+  std::map<std::string, Record> Records;
+  while (!R.atEnd()) {
+    Record Rec;
+    R.expect("scc");
+    Rec.Root = R.string();
+    Rec.Local = R.token();
+    Rec.Key = R.token();
+    unsigned NumCallees = R.number();
+    for (unsigned i = 0; i != NumCallees && !R.failed(); ++i) {
+      std::string Name = R.string();
+      Rec.Callees.push_back(std::make_pair(Name, R.token().str()));
+    }
+    Rec.Body = R.string();
+    if (R.failed())
+      return false;
+    Records[Rec.Root] = Rec;
+  }
+
+  Saved.swap(Records);
+  return true;
+}
+
+bool DSSummaries::write(StringRef Filename, std::string &Error) const {
+  std::error_code EC;
+  raw_fd_ostream OS(Filename, EC, sys::fs::F_None);
+  if (EC) {
+    Error = EC.message();
+    return false;
+  }
+
+  OS << "dsa-summary " << SummaryVersion << '\n';
+  for (unsigned r = 0, re = Records.size(); r != re; ++r) {
+    const Record &Rec = Records[r];
+    OS << "scc";
+    writeString(OS, Rec.Root);
+    OS << ' ' << Rec.Local << ' ' << Rec.Key << ' ' << Rec.Callees.size();
+    for (unsigned i = 0, e = Rec.Callees.size(); i != e; ++i) {
+      writeString(OS, Rec.Callees[i].first);
+      OS << ' ' << Rec.Callees[i].second;
+    }
+    writeString(OS, Rec.Body);
+    OS << '\n';
+  }
+
+  OS.close();
+  if (OS.has_error()) {
+    OS.clear_error();
+    Error = "error writing the file";
+    return false;
+  }
+  return true;
+}
+
+bool DSSummaries::hashGraph(const DSGraph &G, std::string &Hash) {
+  std::string Text;
+  raw_string_ostream OS(Text);
+  if (!writeGraph(OS, G))
+    return false;
+  Hash = hash(OS.str());
+  return true;
+}
+
+void DSSummaries::setKey(const DSGraph &G) {
+  std::string Key;
+  bool HasKey = hashGraph(G, Key);
+  for (DSGraph::ReturnNodesTy::const_iterator I = G.getReturnNodes().begin(),
+       E = G.getReturnNodes().end(); I != E; ++I)
+    if (HasKey)
+      Keys[I->first] = Key;
+    else
+      Keys.erase(I->first);
+}
+
+const DSSummaries::Record *
+DSSummaries::find(const Function *Root, StringRef Local) const {
+  std::map<std::string, Record>::const_iterator I =
+    Saved.find(Root->getName());
+  if (I == Saved.end() || I->second.Local != Local)
+    return 0;
+
+  const Record &Rec = I->second;
+  for (unsigned i = 0, e = Rec.Callees.size(); i != e; ++i) {
+    const Function *F = M.getFunction(Rec.Callees[i].first);
+    DenseMap<const Function*, std::string>::const_iterator K = Keys.find(F);
+    if (!F || K == Keys.end() || K->second != Rec.Callees[i].second)
+      return 0;
+  }
+  return &Rec;
+}
+
+bool DSSummaries::restore(
+    const Record &Rec, DSGraph &G, DSGraph &Globals,
+    std::vector<std::pair<CallSite, const Function*> > &Edges) {
+  Reader R(Rec.Body);
+  if (!readGraph(R, G) || !readGraph(R, Globals) || !readEdges(R, Edges) ||
+      !R.atEnd())
+    return false;
+
+  for (DSGraph::ReturnNodesTy::const_iterator I = G.getReturnNodes().begin(),
+       E = G.getReturnNodes().end(); I != E; ++I)
+    Keys[I->first] = Rec.Key;
+  Records.push_back(Rec);
+  return true;
+}
+
+bool DSSummaries::save(const Pending &P, const DSGraph &G,
+                       const DSCallGraph &CG) {
+  std::vector<std::pair<std::string, std::string> > Callees;
+  for (FuncSet::const_iterator I = P.Inlined.begin(), E = P.Inlined.end();
+       I != E; ++I) {
+    DenseMap<const Function*, std::string>::iterator K = Keys.find(*I);
+    if (K == Keys.end() || !(*I)->hasName())
+      return false;
+    Callees.push_back(std::make_pair((*I)->getName().str(), K->second));
+  }
+  std::sort(Callees.begin(), Callees.end());
+
+  std::string Body;
+  raw_string_ostream OS(Body);
+  if (!writeGraph(OS, G))
+    return false;
+  std::string Key = hash(OS.str());
+  if (!writeGraph(OS, *P.Globals) || !writeEdges(OS, G, CG))
+    return false;
+
+  Records.push_back(Record());
+  Record &Rec = Records.back();
+  Rec.Root = P.Root->getName();
+  Rec.Local = P.Local;
+  Rec.Key = Key;
+  Rec.Callees.swap(Callees);
+  Rec.Body = OS.str();
+
+  for (DSGraph::ReturnNodesTy::const_iterator I = G.getReturnNodes().begin(),
+       E = G.getReturnNodes().end(); I != E; ++I)
+    Keys[I->first] = Key;
+  return true;
+}
@@ -45,6 +45,9 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/ValueSymbolTable.h"
+
+#include <algorithm>
+
 using namespace llvm;
 
 namespace {
@@ -253,25 +256,30 @@ static void printAllValuesForNode(llvm::raw_ostream &O, NodeValue &NV) {
   // Look for values that have an equivalent NH
   DSNodeHandle &NH = NV.getNodeH();
   const DSGraph::ScalarMapTy &SM = NV.getGraph()->getScalarMap();
-  bool first = true;
 
+  // The scalar map is hashed, so sort the names to print them in the same
+  // order every time.
+  std::vector<std::string> Names;
   for (DSGraph::ScalarMapTy::const_iterator I = SM.begin(), E = SM.end();
       I != E; ++I )
     if (NH == I->second) {
       //Found one!
       const Value *V = I->first;
 
-      //Print them out, separated by commas
-      if (!first) O << ",";
-      first = false;
-
-      // Print out name, if it has one.
+      // Record the name, if it has one.
       // FIXME: Get "%0, "%1", naming like the .ll has?
       if (V->hasName())
-        O << V->getName();
+        Names.push_back(V->getName().str());
       else
-        O << "<tmp>";
+        Names.push_back("<tmp>");
     }
+  std::sort(Names.begin(), Names.end());
+
+  //Print them out, separated by commas
+  for (unsigned i = 0, e = Names.size(); i != e; ++i) {
+    if (i) O << ",";
+    O << Names[i];
+  }
 
   //FIXME: Search globals in this graph too (not just scalarMap)?
 }
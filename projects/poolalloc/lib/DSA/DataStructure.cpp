@@ -24,17 +24,20 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/TypeFinder.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <iostream>
 #include <algorithm>
+#include <thread>
 using namespace llvm;
 
 #define COLLAPSE_ARRAYS_AGGRESSIVELY 0
@@ -495,10 +498,12 @@ void DSNode::addEdgeTo(unsigned Offset, const DSNodeHandle &NH) {
   if (isNodeCompletelyFolded())
     Offset = 0;
 
-  DSNodeHandle &ExistingEdge = getLink(Offset);
-  if (!ExistingEdge.isNull()) {
+  // Look the edge up without adding it: adding a link could move NH if it is
+  // one of our own links.
+  LinkMapTy::iterator ExistingEdge = Links.find(Offset);
+  if (ExistingEdge != Links.end() && !ExistingEdge->second.isNull()) {
     // Merge the two nodes...
-    ExistingEdge.mergeWith(NH);
+    ExistingEdge->second.mergeWith(NH);
   } else {                             // No merging to perform...
     setLink(Offset, NH);               // Just force a link in there...
   }
@@ -706,21 +711,14 @@ void DSNode::cleanEdges() {
   for (type_iterator ii = type_begin(); ii != type_end(); ) {
     if (ii->second)
       ++ii;
-    else {
-      type_iterator backup = ii;
-      ++backup;
-      TyMap.erase(ii);
-      ii = backup;
-    }
+    else
+      ii = TyMap.erase(ii);
   }
   //get rid of any node edge pointing to nothing
   for (edge_iterator ii = edge_begin(); ii != edge_end(); ) {
-    if (ii->second.isNull()) {
-      edge_iterator backup = ii;
-      ++backup;
-      Links.erase(ii);
-      ii = backup;
-    } else
+    if (ii->second.isNull())
+      ii = Links.erase(ii);
+    else
       ++ii;
   }
 }
@@ -1454,10 +1452,12 @@ void DataStructures::cloneGlobalsInto(DSGraph* Graph, unsigned cloneFlags) {
   const DSGraph* GG = Graph->getGlobalsGraph();
   ReachabilityCloner RC(Graph, GG, cloneFlags);
 
-  // Clone the global nodes into this graph.
-  for (DSScalarMap::global_iterator I = Graph->getScalarMap().global_begin(),
-       E = Graph->getScalarMap().global_end(); I != E; ++I)
-    RC.getClonedNH(GG->getNodeForValue(*I));
+  // Clone the global nodes into this graph.  Cloning can add globals to the
+  // scalar map of the graph, so walk a copy of its globals.
+  std::vector<const GlobalValue*> Globals(Graph->getScalarMap().global_begin(),
+                                          Graph->getScalarMap().global_end());
+  for (unsigned i = 0, e = Globals.size(); i != e; ++i)
+    RC.getClonedNH(GG->getNodeForValue(Globals[i]));
 }
 
 //For all graphs
@@ -1474,6 +1474,36 @@ void DataStructures::cloneIntoGlobals(DSGraph* Graph, unsigned cloneFlags) {
     RC.getClonedNH(MainSM[*I]);
 }
 
+// prepareForThreads - Finding the leader of a global equivalence class
+// compresses the path to it, and the DataLayout computes struct layouts the
+// first time that they are asked for.  Do both now so that threads building
+// or inlining graphs only read them.
+void DataStructures::prepareForThreads(Module &M) {
+  for (EquivalenceClasses<const GlobalValue*>::iterator I = GlobalECs.begin(),
+       E = GlobalECs.end(); I != E; ++I)
+    GlobalECs.findLeader(I);
+
+  TypeFinder StructTypes;
+  StructTypes.run(M, false);
+  for (TypeFinder::iterator I = StructTypes.begin(), E = StructTypes.end();
+       I != E; ++I)
+    if (!(*I)->isOpaque() && (*I)->isSized())
+      getDataLayout().getStructLayout(*I);
+}
+
+// getThreadCount - Threads are only used if LLVM was started multithreaded,
+// and never outnumber the work items.
+unsigned DataStructures::getThreadCount(unsigned Requested, unsigned Work) {
+  if (!llvm_is_multithreaded())
+    return 1;
+
+  unsigned Threads = Requested;
+  if (Threads == 0)
+    Threads = std::thread::hardware_concurrency();
+  if (Threads > Work)
+    Threads = Work;
+  return Threads ? Threads : 1;
+}
 
 void DataStructures::init(DataStructures* D, bool clone, bool useAuxCalls, 
                           bool copyGlobalAuxCalls, bool resetAux) {
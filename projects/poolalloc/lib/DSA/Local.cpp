@@ -16,6 +16,7 @@
 
 #include "dsa/DataStructure.h"
 #include "dsa/DSGraph.h"
+#include "dsa/GlobalTables.h"
 
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/DenseSet.h"
@@ -35,7 +36,9 @@
 #include "llvm/IR/InstVisitor.h"
 #include "llvm/Support/Timer.h"
 
+#include <atomic>
 #include <fstream>
+#include <thread>
 
 // FIXME: This should eventually be a FunctionPass that is automatically
 // aggregated into a Pass.
@@ -58,6 +61,11 @@ X("dsa-local", "Local Data Structure Analysis");
 
 cl::opt<std::string> hasMagicSections("dsa-magic-sections",
         cl::desc("File with section to global mapping")); //, cl::ReallyHidden);
+
+cl::opt<unsigned> LocalThreads("dsa-local-threads",
+        cl::desc("Number of threads on which to build the local graphs "
+                 "(0 = one per core)"),
+        cl::init(1));
 }
 cl::opt<bool> TypeInferenceOptimize("enable-type-inference-opts",
                                     cl::desc("Enable Type Inference Optimizations added to DSA."),
@@ -145,7 +153,8 @@ namespace {
     void visitVAStartNode(DSNode* N);
 
   public:
-    GraphBuilder(Function &f, DSGraph &g, LocalDataStructures& DSi)
+    GraphBuilder(Function &f, DSGraph &g, LocalDataStructures& DSi,
+                 bool Finish = true)
       : G(g), FB(&f), DS(&DSi), TD(g.getDataLayout()), VAArrayNH(0) {
       // Create scalar nodes for all pointer arguments...
       for (Function::arg_iterator I = f.arg_begin(), E = f.arg_end();
@@ -176,20 +185,32 @@ namespace {
 
       visit(f);  // Single pass over the function
 
+      if (Finish)
+        finishGraph(g);
+    }
+
+    /// finishGraph - Complete a graph built by the GraphBuilder ctor.  This
+    /// reads the globals graph, so graphs that are built on threads are
+    /// finished one at a time once all of them have been built.
+    static void finishGraph(DSGraph &g) {
       // If there are any constant globals referenced in this function, merge
       // their initializers into the local graph from the globals graph.
       // This resolves indirect calls in some common cases
       // Only merge info for nodes that already exist in the local pass
       // otherwise leaf functions could contain less collapsing than the globals
-      // graph
+      // graph.  Merging can add globals to the scalar map, so walk a copy.
       if (g.getScalarMap().global_begin() != g.getScalarMap().global_end()) {
         ReachabilityCloner RC(&g, g.getGlobalsGraph(), 0);
+        std::vector<const GlobalVariable*> Constants;
         for (DSScalarMap::global_iterator I = g.getScalarMap().global_begin(),
              E = g.getScalarMap().global_end(); I != E; ++I) {
           if (const GlobalVariable * GV = dyn_cast<GlobalVariable > (*I))
             if (GV->isConstant())
-              RC.merge(g.getNodeForValue(GV), g.getGlobalsGraph()->getNodeForValue(GV));
+              Constants.push_back(GV);
         }
+        for (unsigned i = 0, e = Constants.size(); i != e; ++i)
+          RC.merge(g.getNodeForValue(Constants[i]),
+                   g.getGlobalsGraph()->getNodeForValue(Constants[i]));
       }
 
       g.markIncompleteNodes(DSGraph::MarkFormalArgs);
@@ -1439,6 +1460,56 @@ void handleMagicSections(DSGraph* GlobalsGraph, Module& M) {
   }
 }
 
+/// buildGraphsOnThreads - Run the GraphBuilder on each function, taking the
+/// functions from a shared counter on several threads.  Building a graph only
+/// reads the IR, the global equivalence classes, and the struct layouts of
+/// the DataLayout, and the TypeSS is locked, so none of them may change until
+/// the threads are done: the leaders of the classes are found and the layouts
+/// are computed here, before any thread starts.  The parts of building a
+/// graph that read the globals graph are left to finishThreadGraph.
+void LocalDataStructures::buildGraphsOnThreads(
+    const std::vector<Function*> &Functions,
+    std::vector<DSGraph*> &Graphs, unsigned Threads) {
+  prepareForThreads(*Functions[0]->getParent());
+
+  std::atomic<unsigned> Next(0);
+  auto Build = [&]() {
+    unsigned Index;
+    while ((Index = Next.fetch_add(1, std::memory_order_relaxed)) <
+           Functions.size()) {
+      DSGraph* G = new DSGraph(GlobalECs, getDataLayout(), *TypeSS,
+                               GlobalsGraph);
+      GraphBuilder GGB(*Functions[Index], *G, *this, false);
+      Graphs[Index] = G;
+    }
+  };
+
+  std::vector<std::thread> Workers;
+  for (unsigned T = 1; T < Threads; ++T)
+    Workers.push_back(std::thread(Build));
+  Build();
+  for (unsigned T = 0; T < Workers.size(); ++T)
+    Workers[T].join();
+}
+
+/// finishThreadGraph - Bring a graph built by buildGraphsOnThreads to the
+/// state that the serial build leaves it in.  The serial build maps globals
+/// that earlier functions put in the same equivalence class to the leader of
+/// the class, so merge them here before finishing the graph.
+void LocalDataStructures::finishThreadGraph(DSGraph *G) {
+  DSScalarMap &SM = G->getScalarMap();
+  svset<const GlobalValue*> ECGlobals;
+  for (DSScalarMap::global_iterator I = SM.global_begin(),
+       E = SM.global_end(); I != E; ++I)
+    if (GlobalECs.findValue(*I) != GlobalECs.end() &&
+        GlobalECs.getLeaderValue(*I) != *I)
+      ECGlobals.insert(*I);
+  if (!ECGlobals.empty())
+    eliminateUsesOfECGlobals(*G, ECGlobals);
+
+  GraphBuilder::finishGraph(*G);
+}
+
 char LocalDataStructures::ID;
 
 bool LocalDataStructures::runOnModule(Module &M) {
@@ -1449,15 +1520,20 @@ bool LocalDataStructures::runOnModule(Module &M) {
   {
     GraphBuilder GGB(*GlobalsGraph);
 
-    // Add initializers for all of the globals to the globals graph.
+    // Add initializers for all of the globals to the globals graph.  Skip
+    // the tables of globals that SAFECode registers with its run-time; they
+    // point to every global and would merge them all into one node.
     for (Module::global_iterator I = M.global_begin(), E = M.global_end();
-         I != E; ++I)
+         I != E; ++I) {
+      if (I->hasSection() && StringRef(I->getSection()).endswith(DSA_GLOBAL_TABLE_SECTION))
+        continue;
       if (!(I->hasSection() && StringRef(I->getSection()) == "llvm.metadata")) {
         if (I->isDeclaration())
           GGB.mergeExternalGlobal(I);
         else
           GGB.mergeInGlobalInitializer(I);
       }
+    }
     // Add Functions to the globals graph.
     for (Module::iterator FI = M.begin(), FE = M.end(); FI != FE; ++FI){
       if(addrAnalysis->hasAddressTaken(FI)) {
@@ -1480,10 +1556,35 @@ bool LocalDataStructures::runOnModule(Module &M) {
   GlobalsGraph->maskIncompleteMarkers();
 
   // Calculate all of the graphs...
+  std::vector<Function*> Functions;
   for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I)
-    if (!I->isDeclaration()) {
-      DSGraph* G = new DSGraph(GlobalECs, getDataLayout(), *TypeSS, GlobalsGraph);
-      GraphBuilder GGB(*I, *G, *this);
+    if (!I->isDeclaration())
+      Functions.push_back(I);
+
+  // With -dsa-local-threads, build the graphs on threads first.  Everything
+  // that depends on the graphs of earlier functions is then done below in
+  // module order, so the result is the same as that of the serial build.
+  std::vector<DSGraph*> Graphs(Functions.size());
+  unsigned Threads = getThreadCount(LocalThreads, Functions.size());
+  if (Threads > 1) {
+    NamedRegionTimer T("Build graphs on threads", "Local DSA",
+                       TimePassesIsEnabled);
+    buildGraphsOnThreads(Functions, Graphs, Threads);
+  }
+
+  {
+    NamedRegionTimer T(Threads > 1 ? "Finish graphs in module order"
+                                   : "Build graphs", "Local DSA",
+                       TimePassesIsEnabled);
+    for (unsigned Index = 0; Index < Functions.size(); ++Index) {
+      Function *I = Functions[Index];
+      DSGraph* G = Graphs[Index];
+      if (G) {
+        finishThreadGraph(G);
+      } else {
+        G = new DSGraph(GlobalECs, getDataLayout(), *TypeSS, GlobalsGraph);
+        GraphBuilder GGB(*I, *G, *this);
+      }
       G->getAuxFunctionCalls() = G->getFunctionCalls();
       setDSGraph(*I, G);
       propagateUnknownFlag(G);
@@ -1498,6 +1599,7 @@ bool LocalDataStructures::runOnModule(Module &M) {
       formGlobalECs();
       DEBUG(G->AssertGraphOK());
     }
+  }
 
   //GlobalsGraph->removeTriviallyDeadNodes();
   GlobalsGraph->markIncompleteNodes(DSGraph::MarkFormalArgs
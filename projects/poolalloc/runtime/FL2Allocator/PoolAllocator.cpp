@@ -27,6 +27,21 @@ typedef unsigned long uintptr_t;
 #define INITIAL_SLAB_SIZE 4096
 #define LARGE_SLAB_SIZE   4096
 
+// USE_THREAD_MAGAZINES - Give each thread a cache of free objects of recently
+// used sizes, so that threads sharing a pool can allocate and free without
+// taking the pool lock.  Objects left in the cache of an exiting thread are
+// only reclaimed when their pool is destroyed.
+//#define USE_THREAD_MAGAZINES
+#define MAGAZINE_SIZE     32
+#define NUM_MAGAZINES     16
+
+// The compiler reserves 16 pointers for a pool descriptor (see getPoolType()
+// and PointerCompress::InitializePoolLibraryFunctions()).
+static_assert(sizeof(PoolTy<NormalPoolTraits>) <= 16*sizeof(void*),
+              "Pool descriptor does not fit in the space reserved for it");
+static_assert(sizeof(PoolTy<CompressedPoolTraits>) <= 16*sizeof(void*),
+              "Pool descriptor does not fit in the space reserved for it");
+
 #ifndef NDEBUG
 #define NDEBUG
 #endif
@@ -177,14 +192,76 @@ static void InitPrintNumPools() {
 //===----------------------------------------------------------------------===//
 
 
+// The free nodes of a pool are kept in segregated lists.  Nodes smaller than
+// SMALL_BIN_LIMIT bytes are binned by size in steps of 8 bytes, and larger
+// nodes are binned by the power of two below their size.  A bitmap records
+// which bins are non-empty, so that allocation and free take constant time.
+#define NUM_SMALL_BINS  64
+#define SMALL_BIN_LIMIT (NUM_SMALL_BINS*8)
+#define NUM_BINS        (NUM_SMALL_BINS+23)
+#define NUM_BIN_WORDS   ((NUM_BINS+63)/64)
+
+template<typename PoolTraits>
+struct FreeBins {
+  // Heads - The first node of the free list of each size class.
+  typename PoolTraits::FreeNodeHeaderPtrTy Heads[NUM_BINS];
+
+  // NonEmpty - One bit for each size class, set if its list is not empty.
+  unsigned long long NonEmpty[NUM_BIN_WORDS];
+
+  // LastFreed - The node most recently put on a free list by poolfree, if it
+  // is still free.  Objects freed in allocation order are merged into it.
+  typename PoolTraits::FreeNodeHeaderPtrTy LastFreed;
+
+  // ID - A number that no other pool has had, used to tell the pools apart in
+  // the thread-local magazines.
+  unsigned long ID;
+};
+
+// NextPoolID - The ID of the next pool to get free lists.
+static unsigned long NextPoolID = 0;
+
+/// getBinIndex - Return the size class of a free node of the specified size.
+static inline unsigned getBinIndex(unsigned Size) {
+  if (Size < SMALL_BIN_LIMIT)
+    return Size >> 3;
+  unsigned Log2 = 31 - __builtin_clz(Size);
+  return NUM_SMALL_BINS + Log2 - 9;
+}
+
+/// findNonEmptyBin - Return the first size class at or above Bin whose free
+/// list is not empty, or NUM_BINS if there is none.
+template<typename PoolTraits>
+static inline unsigned findNonEmptyBin(FreeBins<PoolTraits> *Bins,
+                                       unsigned Bin) {
+  for (unsigned Word = Bin / 64; Word < NUM_BIN_WORDS; ++Word) {
+    unsigned long long Bits = Bins->NonEmpty[Word];
+    if (Word == Bin / 64)
+      Bits &= ~0ULL << (Bin % 64);
+    if (Bits)
+      return Word * 64 + __builtin_ctzll(Bits);
+  }
+  return NUM_BINS;
+}
+
+/// getFreeBins - Return the free lists of the pool, allocating them if the
+/// pool does not have any yet.
+template<typename PoolTraits>
+static FreeBins<PoolTraits> *getFreeBins(PoolTy<PoolTraits> *Pool) {
+  if (!Pool->FreeLists) {
+    Pool->FreeLists =
+      (FreeBins<PoolTraits>*)calloc(1, sizeof(FreeBins<PoolTraits>));
+    Pool->FreeLists->ID = __sync_add_and_fetch(&NextPoolID, 1);
+  }
+  return Pool->FreeLists;
+}
+
 template<typename PoolTraits>
 static void AddNodeToFreeList(PoolTy<PoolTraits> *Pool,
                               FreedNodeHeader<PoolTraits> *FreeNode) {
-  typename PoolTraits::FreeNodeHeaderPtrTy *FreeList;
-  if (FreeNode->Header.Size == Pool->DeclaredSize)
-    FreeList = &Pool->ObjFreeList;
-  else
-    FreeList = &Pool->OtherFreeList;
+  FreeBins<PoolTraits> *Bins = Pool->FreeLists;
+  unsigned Bin = getBinIndex(FreeNode->Header.Size);
+  typename PoolTraits::FreeNodeHeaderPtrTy *FreeList = &Bins->Heads[Bin];
 
   void *PoolBase = Pool->Slabs;
 
@@ -196,33 +273,62 @@ static void AddNodeToFreeList(PoolTy<PoolTraits> *Pool,
   *FreeList = FreeNodeIdx;
   if (FreeNode->Next)
     PoolTraits::IndexToFNHPtr(FreeNode->Next, PoolBase)->Prev = FreeNodeIdx;
+  else
+    Bins->NonEmpty[Bin / 64] |= 1ULL << (Bin % 64);
 }
 
+// UnlinkFreeNode - Remove a node from its free list.  The size of the node
+// must not have changed since it was added to the list.
 template<typename PoolTraits>
 static void UnlinkFreeNode(PoolTy<PoolTraits> *Pool,
                            FreedNodeHeader<PoolTraits> *FNH) {
+  FreeBins<PoolTraits> *Bins = Pool->FreeLists;
   void *PoolBase = Pool->Slabs;
+  typename PoolTraits::FreeNodeHeaderPtrTy NodeIdx = 
+    PoolTraits::FNHPtrToIndex(FNH, PoolBase);
+
+  if (Bins->LastFreed == NodeIdx)
+    Bins->LastFreed = 0;
 
   // Make the predecessor point to our next node.
   if (FNH->Prev)
     PoolTraits::IndexToFNHPtr(FNH->Prev, PoolBase)->Next = FNH->Next;
   else {
-    typename PoolTraits::FreeNodeHeaderPtrTy NodeIdx = 
-      PoolTraits::FNHPtrToIndex(FNH, PoolBase);
-
-    if (Pool->ObjFreeList == NodeIdx)
-      Pool->ObjFreeList = FNH->Next;
-    else {
-      assert(Pool->OtherFreeList == NodeIdx &&
-             "Prev Ptr is null but not at head of free list?");
-      Pool->OtherFreeList = FNH->Next;
-    }
+    unsigned Bin = getBinIndex(FNH->Header.Size);
+    assert(Bins->Heads[Bin] == NodeIdx &&
+           "Prev Ptr is null but not at head of free list?");
+    Bins->Heads[Bin] = FNH->Next;
+    if (!FNH->Next)
+      Bins->NonEmpty[Bin / 64] &= ~(1ULL << (Bin % 64));
   }
 
   if (FNH->Next)
     PoolTraits::IndexToFNHPtr(FNH->Next, PoolBase)->Prev = FNH->Prev;
 }
 
+// FindFreeNode - Return a free node of at least NumBytes bytes, or null if
+// the pool has none.  Only the first node of the size class of NumBytes is
+// considered; every node in a larger size class is big enough.
+template<typename PoolTraits>
+static FreedNodeHeader<PoolTraits> *FindFreeNode(PoolTy<PoolTraits> *Pool,
+                                                 unsigned NumBytes) {
+  FreeBins<PoolTraits> *Bins = Pool->FreeLists;
+  if (!Bins) return 0;
+
+  void *PoolBase = Pool->Slabs;
+  unsigned Bin = getBinIndex(NumBytes);
+  if (Bins->Heads[Bin]) {
+    FreedNodeHeader<PoolTraits> *Node =
+      PoolTraits::IndexToFNHPtr(Bins->Heads[Bin], PoolBase);
+    if (Node->Header.Size >= NumBytes)
+      return Node;
+  }
+
+  Bin = findNonEmptyBin(Bins, Bin+1);
+  if (Bin == NUM_BINS) return 0;
+  return PoolTraits::IndexToFNHPtr(Bins->Heads[Bin], PoolBase);
+}
+
 
 // PoolSlab Structure - Hold multiple objects of the current node type.
 // Invariants: FirstUnused <= UsedEnd
@@ -277,6 +383,7 @@ void PoolSlab<PoolTraits>::create(PoolTy<PoolTraits> *Pool, unsigned SizeHint) {
   // Add the body of the slab to the free list.
   FreedNodeHeader<PoolTraits> *SlabBody =(FreedNodeHeader<PoolTraits>*)PoolBody;
   SlabBody->Header.Size = Size;
+  getFreeBins(Pool);
   AddNodeToFreeList(Pool, SlabBody);
 
   // Make sure to add a marker at the end of the slab to prevent the coallescer
@@ -341,6 +448,7 @@ void PoolSlab<PoolTraits>::create_for_ptrcomp(PoolTy<PoolTraits> *Pool,
   // Add the body of the slab to the free list.
   FreedNodeHeader<PoolTraits> *SlabBody =(FreedNodeHeader<PoolTraits>*)PoolBody;
   SlabBody->Header.Size = Size;
+  getFreeBins(Pool);
   AddNodeToFreeList(Pool, SlabBody);
 
   // Make sure to add a marker at the end of the slab to prevent the coallescer
@@ -521,6 +629,49 @@ void poolinit(PoolTy<NormalPoolTraits> *Pool,
   poolinit_internal(Pool, DeclaredSize, ObjAlignment);
 }
 
+//===----------------------------------------------------------------------===//
+// Thread-local magazines
+//===----------------------------------------------------------------------===//
+
+#ifdef USE_THREAD_MAGAZINES
+// Magazine - A stack of allocated objects of one node size from one pool that
+// the owning thread has freed.  The pool does not know about them, so they are
+// neither merged nor handed out to other threads.
+struct Magazine {
+  PoolTy<NormalPoolTraits> *Pool;
+  unsigned long PoolID;
+  unsigned NodeSize;
+  unsigned Count;
+  void *Nodes[MAGAZINE_SIZE];
+};
+
+static __thread Magazine Magazines[NUM_MAGAZINES];
+
+static inline Magazine *getMagazine(PoolTy<NormalPoolTraits> *Pool,
+                                    unsigned NodeSize) {
+  uintptr_t Hash = ((uintptr_t)Pool >> 4) ^ (NodeSize >> 3);
+  return &Magazines[Hash % NUM_MAGAZINES];
+}
+
+// The pool ID tells a pool apart from a destroyed pool that used the same
+// descriptor, whose objects may still be in a magazine.
+static inline bool isMagazineOf(Magazine *M, PoolTy<NormalPoolTraits> *Pool,
+                                unsigned NodeSize) {
+  return M->Pool == Pool && M->NodeSize == NodeSize &&
+         M->PoolID == Pool->FreeLists->ID;
+}
+
+// dropMagazines - Forget the objects of a pool that is being destroyed that
+// are in the magazines of the calling thread.
+static void dropMagazines(PoolTy<NormalPoolTraits> *Pool) {
+  if (!Pool->FreeLists) return;
+  for (unsigned i = 0; i != NUM_MAGAZINES; ++i)
+    if (Magazines[i].Pool == Pool &&
+        Magazines[i].PoolID == Pool->FreeLists->ID)
+      Magazines[i].Count = 0;
+}
+#endif
+
 // pooldestroy - Release all memory allocated for a pool
 //
 void pooldestroy(PoolTy<NormalPoolTraits> *Pool) {
@@ -534,6 +685,9 @@ void pooldestroy(PoolTy<NormalPoolTraits> *Pool) {
   if(Pool->thread_refcount)
 	  return;
 
+#ifdef USE_THREAD_MAGAZINES
+  dropMagazines(Pool);
+#endif
   pthread_mutex_destroy(&Pool->pool_lock);
 
 #ifdef ENABLE_POOL_IDS
@@ -543,6 +697,8 @@ void pooldestroy(PoolTy<NormalPoolTraits> *Pool) {
 #endif
   DO_IF_POOLDESTROY_STATS(PrintPoolStats(Pool));
 
+  free(Pool->FreeLists);
+
   // Free all allocated slabs.
   PoolSlab<NormalPoolTraits> *PS = Pool->Slabs;
   while (PS) {
@@ -560,6 +716,27 @@ void pooldestroy(PoolTy<NormalPoolTraits> *Pool) {
   }
 }
 
+// getNodeSize - Return the size of the node that poolalloc uses for an object
+// of NumBytes bytes.
+template<typename PoolTraits>
+static inline unsigned getNodeSize(PoolTy<PoolTraits> *Pool,
+                                   unsigned NumBytes) {
+  // Objects must be at least 8 bytes to hold the FreedNodeHeader object when
+  // they are freed.  This also handles allocations of 0 bytes.
+  if (NumBytes < (sizeof(FreedNodeHeader<PoolTraits>) - 
+                  sizeof(NodeHeader<PoolTraits>)))
+    NumBytes = sizeof(FreedNodeHeader<PoolTraits>) - 
+               sizeof(NodeHeader<PoolTraits>);
+
+  // Adjust the size so that memory allocated from the pool is always on the
+  // proper alignment boundary.
+  unsigned Alignment = Pool->Alignment;
+  NumBytes = NumBytes+sizeof(FreedNodeHeader<PoolTraits>) + 
+             (Alignment-1);      // Round up
+  return (NumBytes & ~(Alignment-1)) - 
+         sizeof(FreedNodeHeader<PoolTraits>); // Truncate
+}
+
 template<typename PoolTraits>
 static void *poolalloc_internal(PoolTy<PoolTraits> *Pool, unsigned NumBytesA) {
   DO_IF_TRACE(fprintf(stderr, "[%d] poolalloc%s(%d) -> ",
@@ -576,20 +753,7 @@ static void *poolalloc_internal(PoolTy<PoolTraits> *Pool, unsigned NumBytesA) {
   }
   DO_IF_PNP(if (Pool->NumObjects == 0) ++PoolCounter);  // Track # pools.
 
-  // Objects must be at least 8 bytes to hold the FreedNodeHeader object when
-  // they are freed.  This also handles allocations of 0 bytes.
-  if (NumBytes < (sizeof(FreedNodeHeader<PoolTraits>) - 
-                  sizeof(NodeHeader<PoolTraits>)))
-    NumBytes = sizeof(FreedNodeHeader<PoolTraits>) - 
-               sizeof(NodeHeader<PoolTraits>);
-
-  // Adjust the size so that memory allocated from the pool is always on the
-  // proper alignment boundary.
-  unsigned Alignment = Pool->Alignment;
-  NumBytes = NumBytes+sizeof(FreedNodeHeader<PoolTraits>) + 
-             (Alignment-1);      // Round up
-  NumBytes = (NumBytes & ~(Alignment-1)) - 
-             sizeof(FreedNodeHeader<PoolTraits>); // Truncate
+  NumBytes = getNodeSize(Pool, NumBytes);
 
   DO_IF_PNP(CurHeapSize += (NumBytes + sizeof(NodeHeader<PoolTraits>)));
   DO_IF_PNP(if (CurHeapSize > MaxHeapSize) MaxHeapSize = CurHeapSize);
@@ -597,94 +761,32 @@ static void *poolalloc_internal(PoolTy<PoolTraits> *Pool, unsigned NumBytesA) {
   DO_IF_PNP(++Pool->NumObjects);
   DO_IF_PNP(Pool->BytesAllocated += NumBytes);
 
-  // Fast path - allocate objects off the object list.
-  if (NumBytes == Pool->DeclaredSize && Pool->ObjFreeList != 0) {
-    typename PoolTraits::FreeNodeHeaderPtrTy NodeIdx = Pool->ObjFreeList;
-    void *PoolBase = Pool->Slabs;
-    FreedNodeHeader<PoolTraits> *Node =
-      PoolTraits::IndexToFNHPtr(NodeIdx, PoolBase);
-    UnlinkFreeNode(Pool, Node);
-    assert(NumBytes == Node->Header.Size);
-
-    Node->Header.Size = NumBytes|1;   // Mark as allocated
-    DO_IF_TRACE(fprintf(stderr, "0x%X\n", &Node->Header+1));
-    return &Node->Header+1;
-  }
-
   if (PoolTraits::UseLargeArrayObjects &&
       NumBytes >= LARGE_SLAB_SIZE-sizeof(PoolSlab<PoolTraits>) - 
       sizeof(NodeHeader<PoolTraits>))
     goto LargeObject;
 
-  // Fast path.  In the common case, we can allocate a portion of the node at
-  // the front of the free list.
   do {
-    void *PoolBase = Pool->Slabs;
-    FreedNodeHeader<PoolTraits> *FirstNode =
-      PoolTraits::IndexToFNHPtr(Pool->OtherFreeList, PoolBase);
-    if (FirstNode) {
-      unsigned FirstNodeSize = FirstNode->Header.Size;
-      if (FirstNodeSize >= NumBytes) {
-        if (FirstNodeSize >= 2*NumBytes+sizeof(NodeHeader<PoolTraits>)) {
-          // Put the remainder back on the list...
-          FreedNodeHeader<PoolTraits> *NextNodes =
-            (FreedNodeHeader<PoolTraits>*)((char*)FirstNode +
-                                   sizeof(NodeHeader<PoolTraits>) +NumBytes);
-          
-          // Remove from list
-          UnlinkFreeNode(Pool, FirstNode);
-          
-          NextNodes->Header.Size = FirstNodeSize-NumBytes -
-                                   sizeof(NodeHeader<PoolTraits>);
-          AddNodeToFreeList(Pool, NextNodes);
-          
-        } else {
-          UnlinkFreeNode(Pool, FirstNode);
-          NumBytes = FirstNodeSize;
-        }
-        FirstNode->Header.Size = NumBytes|1;   // Mark as allocated
-        DO_IF_TRACE(fprintf(stderr, "0x%X\n", &FirstNode->Header+1));
-        return &FirstNode->Header+1;
-      }
-
-      // Perform a search of the free list, taking the front of the first free
-      // chunk that is big enough.
-      typename PoolTraits::FreeNodeHeaderPtrTy *FN = &Pool->OtherFreeList;
-      FreedNodeHeader<PoolTraits> *FNN = FirstNode;
-      
-      // Search the list for the first-fit.
-      while (FNN && FNN->Header.Size < NumBytes) {
-        // Advance FN to point to the Next field of FNN.
-        FN = &FNN->Next;
-
-        // Advance FNN to point to whatever the next node points to (null or the
-        // next node in the free list).
-        FNN = PoolTraits::IndexToFNHPtr(*FN, PoolBase);
-      }
-      
-      if (FNN) {
-        // We found a slab big enough.  If it's a perfect fit, just unlink
-        // from the free list, otherwise, slice a little bit off and adjust
-        // the free list.
-        if (FNN->Header.Size > 2*NumBytes+sizeof(NodeHeader<PoolTraits>)) {
-          UnlinkFreeNode(Pool, FNN);
-          
-          // Put the remainder back on the list...
-          FreedNodeHeader<PoolTraits> *NextNodes =
-            (FreedNodeHeader<PoolTraits>*)((char*)FNN +
-                                           sizeof(NodeHeader<PoolTraits>) +
-                                           NumBytes);
-          NextNodes->Header.Size = FNN->Header.Size-NumBytes -
-            sizeof(NodeHeader<PoolTraits>);
-          AddNodeToFreeList(Pool, NextNodes);
-        } else {
-          UnlinkFreeNode(Pool, FNN);
-          NumBytes = FNN->Header.Size;
-        }
-        FNN->Header.Size = NumBytes|1;   // Mark as allocated
-        DO_IF_TRACE(fprintf(stderr, "0x%X\n", &FNN->Header+1));
-        return &FNN->Header+1;
+    if (FreedNodeHeader<PoolTraits> *Node = FindFreeNode(Pool, NumBytes)) {
+      unsigned NodeSize = Node->Header.Size;
+      UnlinkFreeNode(Pool, Node);
+
+      // If the rest of the node can hold a free node, put it back on the free
+      // lists, otherwise hand out the whole node.
+      if (NodeSize >= NumBytes+sizeof(FreedNodeHeader<PoolTraits>)) {
+        FreedNodeHeader<PoolTraits> *NextNodes =
+          (FreedNodeHeader<PoolTraits>*)((char*)Node +
+                                         sizeof(NodeHeader<PoolTraits>) +
+                                         NumBytes);
+        NextNodes->Header.Size = NodeSize-NumBytes -
+                                 sizeof(NodeHeader<PoolTraits>);
+        AddNodeToFreeList(Pool, NextNodes);
+      } else {
+        NumBytes = NodeSize;
       }
+      Node->Header.Size = NumBytes|1;   // Mark as allocated
+      DO_IF_TRACE(fprintf(stderr, "0x%X\n", &Node->Header+1));
+      return &Node->Header+1;
     }
 
     // If we are not allowed to grow this pool, don't.
@@ -746,43 +848,30 @@ static void poolfree_internal(PoolTy<PoolTraits> *Pool, void *Node) {
     NextFNH = (FreedNodeHeader<PoolTraits>*)((char*)Node+Size);
   }
 
-  // If there are already nodes on the freelist, see if these blocks can be
-  // coallesced into one of the early blocks on the front of the list.  This is
-  // a simple check that prevents many horrible forms of fragmentation,
-  // particularly when freeing objects in allocation order.
-  //
-  if (Pool->ObjFreeList) {
-    void *PoolBase = Pool->Slabs;
-    FreedNodeHeader<PoolTraits> *ObjFNH = 
-      PoolTraits::IndexToFNHPtr(Pool->ObjFreeList, PoolBase);
-
-    if ((char*)ObjFNH + sizeof(NodeHeader<PoolTraits>) +
-        ObjFNH->Header.Size == (char*)FNH) {
-      // Merge this with a node that is already on the object size free list.
-      // Because the object is growing, we will never be able to find it if we
-      // leave it on the object freelist.
-      UnlinkFreeNode(Pool, ObjFNH);
-      ObjFNH->Header.Size += Size+sizeof(NodeHeader<PoolTraits>);
-      AddNodeToFreeList(Pool, ObjFNH);
-      return;
-    }
-  }
-
-  if (Pool->OtherFreeList) {
+  // If this node immediately follows the node freed last, merge it into that
+  // node.  This is a simple check that prevents many horrible forms of
+  // fragmentation, particularly when freeing objects in allocation order.
+  FreeBins<PoolTraits> *Bins;
+  Bins = Pool->FreeLists;
+  if (Bins->LastFreed) {
     void *PoolBase = Pool->Slabs;
-    FreedNodeHeader<PoolTraits> *OFNH = 
-      PoolTraits::IndexToFNHPtr(Pool->OtherFreeList, PoolBase);
-
-    if ((char*)OFNH + sizeof(NodeHeader<PoolTraits>) +
-        OFNH->Header.Size == (char*)FNH) {
-      // Merge this with a node that is already on the object size free list.
-      OFNH->Header.Size += Size+sizeof(NodeHeader<PoolTraits>);
+    FreedNodeHeader<PoolTraits> *LastFNH = 
+      PoolTraits::IndexToFNHPtr(Bins->LastFreed, PoolBase);
+
+    if ((char*)LastFNH + sizeof(NodeHeader<PoolTraits>) +
+        LastFNH->Header.Size == (char*)FNH) {
+      // The node is growing, so it has to move to the list of its new size.
+      UnlinkFreeNode(Pool, LastFNH);
+      LastFNH->Header.Size += Size+sizeof(NodeHeader<PoolTraits>);
+      AddNodeToFreeList(Pool, LastFNH);
+      Bins->LastFreed = PoolTraits::FNHPtrToIndex(LastFNH, PoolBase);
       return;
     }
   }
 
   FNH->Header.Size = Size;
   AddNodeToFreeList(Pool, FNH);
+  Bins->LastFreed = PoolTraits::FNHPtrToIndex(FNH, Pool->Slabs);
   return;
 
 LargeArrayCase:
@@ -875,8 +964,74 @@ unsigned poolobjsize(PoolTy<NormalPoolTraits> *Pool, void *Node) {
 }
 
 
+#ifdef USE_THREAD_MAGAZINES
+// allocFromMagazine - Allocate an object from the calling thread's magazine
+// for its size, refilling the magazine from the pool if it is empty.  Returns
+// null if the object has to be allocated from the pool directly.
+static void *allocFromMagazine(PoolTy<NormalPoolTraits> *Pool,
+                               unsigned NumBytes) {
+  if (!Pool->FreeLists) return 0;
+  unsigned NodeSize = getNodeSize(Pool, NumBytes);
+  if (NodeSize >= LARGE_SLAB_SIZE-sizeof(PoolSlab<NormalPoolTraits>) -
+                  sizeof(NodeHeader<NormalPoolTraits>))
+    return 0;
+
+  Magazine *M = getMagazine(Pool, NodeSize);
+  if (M->Count == 0) {
+    M->Pool = Pool;
+    M->PoolID = Pool->FreeLists->ID;
+    M->NodeSize = NodeSize;
+  } else if (!isMagazineOf(M, Pool, NodeSize))
+    return 0;
+
+  if (M->Count)
+    return M->Nodes[--M->Count];
+
+  pthread_mutex_lock(&Pool->pool_lock);
+  while (M->Count != MAGAZINE_SIZE/2)
+    M->Nodes[M->Count++] = poolalloc_internal(Pool, NumBytes);
+  void *Result = poolalloc_internal(Pool, NumBytes);
+  pthread_mutex_unlock(&Pool->pool_lock);
+  return Result;
+}
+
+// freeToMagazine - Put an object into the calling thread's magazine for its
+// size, returning half of the magazine to the pool if it is full.  Returns
+// false if the object has to be returned to the pool directly.
+static bool freeToMagazine(PoolTy<NormalPoolTraits> *Pool, void *Node) {
+  FreedNodeHeader<NormalPoolTraits> *FNH =
+    (FreedNodeHeader<NormalPoolTraits>*)((char*)Node -
+                                         sizeof(NodeHeader<NormalPoolTraits>));
+  unsigned NodeSize = FNH->Header.Size & ~1;
+  if (NodeSize == ~1U) return false;
+
+  Magazine *M = getMagazine(Pool, NodeSize);
+  if (M->Count == 0) {
+    M->Pool = Pool;
+    M->PoolID = Pool->FreeLists->ID;
+    M->NodeSize = NodeSize;
+  } else if (!isMagazineOf(M, Pool, NodeSize))
+    return false;
+
+  if (M->Count == MAGAZINE_SIZE) {
+    pthread_mutex_lock(&Pool->pool_lock);
+    while (M->Count != MAGAZINE_SIZE/2)
+      poolfree_internal(Pool, M->Nodes[--M->Count]);
+    pthread_mutex_unlock(&Pool->pool_lock);
+  }
+  M->Nodes[M->Count++] = Node;
+  return true;
+}
+
+#endif
+
 void *poolalloc(PoolTy<NormalPoolTraits> *Pool, unsigned NumBytes) {
   DO_IF_FORCE_MALLOCFREE(return malloc(NumBytes));
+#ifdef USE_THREAD_MAGAZINES
+  if (Pool)
+    if (void *Result = allocFromMagazine(Pool, NumBytes))
+      return Result;
+#endif
   if (Pool) pthread_mutex_lock(&Pool->pool_lock);
   void* to_return = poolalloc_internal(Pool, NumBytes);
   if (Pool) pthread_mutex_unlock(&Pool->pool_lock);
@@ -905,6 +1060,10 @@ void *poolmemalign(PoolTy<NormalPoolTraits> *Pool,
 
 void poolfree(PoolTy<NormalPoolTraits> *Pool, void *Node) {
   DO_IF_FORCE_MALLOCFREE(free(Node); return);
+#ifdef USE_THREAD_MAGAZINES
+  if (Pool && Node && freeToMagazine(Pool, Node))
+    return;
+#endif
   if (Pool) pthread_mutex_lock(&Pool->pool_lock);
   poolfree_internal(Pool, Node);
   if (Pool) pthread_mutex_unlock(&Pool->pool_lock);
@@ -1058,6 +1217,8 @@ void pooldestroy_pc(PoolTy<CompressedPoolTraits> *Pool) {
 #endif
   DO_IF_POOLDESTROY_STATS(PrintPoolStats(Pool));
 
+  free(Pool->FreeLists);
+
   // If there is space to remember this pool, do so.
   for (unsigned i = 0; i != 4; ++i)
     if (Pools[i] == 0) {
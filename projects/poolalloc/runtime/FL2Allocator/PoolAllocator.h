@@ -29,6 +29,8 @@ template<typename PoolTraits>
 struct PoolSlab;
 template<typename PoolTraits>
 struct FreedNodeHeader;
+template<typename PoolTraits>
+struct FreeBins;
 
 // NormalPoolTraits - This describes normal pool allocation pools, which can
 // address the entire heap, and are made out of multiple chunks of memory.  The
@@ -152,7 +154,8 @@ struct PoolTy {
   // memory of this structure for the pointer compression pass.
   PoolSlab<PoolTraits> *Slabs;
 
-  // The free node lists for objects of various sizes.  
+  // The bump pointer and the end pointer of a bump pointer pool.  Other pools
+  // keep their free nodes in the size class bins of FreeLists.
   typename PoolTraits::FreeNodeHeaderPtrTy ObjFreeList;
   typename PoolTraits::FreeNodeHeaderPtrTy OtherFreeList;
 
@@ -181,6 +184,11 @@ struct PoolTy {
 
   // Thread reference count for the pool
   int thread_refcount;
+
+  // FreeLists - The free lists of the pool, segregated by size class.  They
+  // are allocated with the first slab and kept out of line so that the pool
+  // descriptor still fits in the space reserved for it by the compiler.
+  FreeBins<PoolTraits> *FreeLists;
 };
 
 extern "C" {
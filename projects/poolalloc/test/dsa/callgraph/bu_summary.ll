@@ -0,0 +1,107 @@
+; The graphs saved by -dsa-bu-summary are reused only for the SCCs that did
+; not change.  The first run saves the graphs of the five SCCs (@leaf1, @mid,
+; @leaf2, {@A, @B}, and @main), and a second run on the same module reuses all
+; of them and gives the same graphs as inlining them again.
+;
+; The module is then edited so that @leaf1 stores its argument into @g1, which
+; makes @main:p and @main:q the same node.  The graph of @leaf1 changed, so it
+; is inlined again, and so are @mid and @main, which inlined it; only @leaf2
+; and {@A, @B} are reused.  The run on the edited module updates the summary,
+; so the next run reuses all five SCCs again.
+
+; The reuse counts are read from -stats, which only counts in builds with
+; assertions.
+;REQUIRES: asserts
+
+;RUN: rm -f %t.sum
+;RUN: dsaopt %s -dsa-bu -analyze -print-only-flags -print-only-types \
+;RUN:   -print-node-for-value=main:p,main:q,main:r,mid:x,A:a,B:b > %t.1
+;RUN: dsaopt %s -dsa-bu -analyze -print-only-flags -print-only-types \
+;RUN:   -dsa-bu-summary=%t.sum \
+;RUN:   -print-node-for-value=main:p,main:q,main:r,mid:x,A:a,B:b > %t.2
+;RUN: diff %t.1 %t.2
+;RUN: dsaopt %s -dsa-bu -analyze -print-only-flags -print-only-types \
+;RUN:   -dsa-bu-summary=%t.sum -stats \
+;RUN:   -print-node-for-value=main:p,main:q,main:r,mid:x,A:a,B:b \
+;RUN:   > %t.3 2> %t.3.stats
+;RUN: diff %t.1 %t.3
+;RUN: FileCheck %s -check-prefix=ALL < %t.3.stats
+;RUN: dsaopt %s -dsa-bu -analyze -dsa-bu-summary=%t.sum \
+;RUN:   -check-not-same-node=main:p,main:q
+;RUN: dsaopt %s -dsa-bu -analyze -dsa-bu-summary=%t.sum \
+;RUN:   -check-callees=main,mid,A
+;RUN: dsaopt %s -dsa-bu -analyze -dsa-bu-summary=%t.sum \
+;RUN:   -check-callees=mid,leaf1
+
+;RUN: sed -e 's/store i32 7, i32\* %%p/store i32* %%p, i32** @g1/' %s \
+;RUN:   > %t.edit.ll
+;RUN: dsaopt %t.edit.ll -dsa-bu -analyze -print-only-flags -print-only-types \
+;RUN:   -print-node-for-value=main:p,main:q,main:r,mid:x,A:a,B:b > %t.4
+;RUN: not diff %t.1 %t.4
+;RUN: dsaopt %t.edit.ll -dsa-bu -analyze -print-only-flags -print-only-types \
+;RUN:   -dsa-bu-summary=%t.sum -stats \
+;RUN:   -print-node-for-value=main:p,main:q,main:r,mid:x,A:a,B:b \
+;RUN:   > %t.5 2> %t.5.stats
+;RUN: diff %t.4 %t.5
+;RUN: FileCheck %s -check-prefix=EDIT < %t.5.stats
+;RUN: dsaopt %t.edit.ll -dsa-bu -analyze -dsa-bu-summary=%t.sum -stats \
+;RUN:   -check-same-node=main:p,main:q 2> %t.6.stats
+;RUN: FileCheck %s -check-prefix=ALL < %t.6.stats
+
+; ALL: {{^ *}}5 dsa-bu - Number of SCC graphs reused from summaries
+; EDIT: {{^ *}}2 dsa-bu - Number of SCC graphs reused from summaries
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@g1 = internal global i32* null
+
+define internal void @leaf1(i32* %p) {
+entry:
+  store i32 7, i32* %p
+  ret void
+}
+
+define internal void @mid(i32* %x) {
+entry:
+  call void @leaf1(i32* %x)
+  ret void
+}
+
+define internal void @leaf2(i32* %p) {
+entry:
+  store i32 0, i32* %p
+  ret void
+}
+
+define internal void @A(i32* %a, i32 %n) {
+entry:
+  %c = icmp eq i32 %n, 0
+  br i1 %c, label %done, label %rec
+
+rec:
+  %m = sub i32 %n, 1
+  call void @B(i32* %a, i32 %m)
+  br label %done
+
+done:
+  call void @leaf2(i32* %a)
+  ret void
+}
+
+define internal void @B(i32* %b, i32 %n) {
+entry:
+  call void @A(i32* %b, i32 %n)
+  ret void
+}
+
+define i32 @main() {
+entry:
+  %p = alloca i32
+  %r = alloca i32
+  call void @mid(i32* %p)
+  call void @A(i32* %r, i32 3)
+  %q = load i32*, i32** @g1
+  store i32 1, i32* %q
+  ret i32 0
+}
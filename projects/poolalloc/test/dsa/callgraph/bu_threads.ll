@@ -0,0 +1,95 @@
+; Inlining the graphs of independent SCCs on threads must give the same
+; graphs as the serial traversal.  @use only learns that it calls @f1 once
+; the graph of @get is inlined into it; @f1 is not under @use, so @use and
+; @main are finished by the serial traversal after the threads.  @main:q is
+; @main:p once the graph of @leaf1 is inlined into @main.
+
+;RUN: dsaopt %s -dsa-bu -analyze -check-callees=use,f1
+;RUN: dsaopt %s -dsa-bu -analyze -dsa-bu-threads=4 -check-callees=use,f1
+;RUN: dsaopt %s -dsa-bu -analyze -check-callees=main,use,A,leaf1,leaf2
+;RUN: dsaopt %s -dsa-bu -analyze -dsa-bu-threads=4 \
+;RUN:   -check-callees=main,use,A,leaf1,leaf2
+;RUN: dsaopt %s -dsa-bu -analyze -check-same-node=main:p,main:q
+;RUN: dsaopt %s -dsa-bu -analyze -dsa-bu-threads=4 \
+;RUN:   -check-same-node=main:p,main:q
+;RUN: dsaopt %s -dsa-bu -analyze -print-only-flags -print-only-types \
+;RUN:   -print-node-for-value=main:p,main:q,main:r,use:x,A:a,B:b > %t.1
+;RUN: dsaopt %s -dsa-bu -analyze -print-only-flags -print-only-types \
+;RUN:   -dsa-bu-threads=4 \
+;RUN:   -print-node-for-value=main:p,main:q,main:r,use:x,A:a,B:b > %t.2
+;RUN: diff %t.1 %t.2
+;RUN: dsaopt %s -dsa-cbu -analyze -print-only-flags -print-only-types \
+;RUN:   -print-node-for-value=main:p,main:q,main:r,use:x,A:a,B:b > %t.3
+;RUN: dsaopt %s -dsa-cbu -analyze -print-only-flags -print-only-types \
+;RUN:   -dsa-bu-threads=4 \
+;RUN:   -print-node-for-value=main:p,main:q,main:r,use:x,A:a,B:b > %t.4
+;RUN: diff %t.3 %t.4
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@g1 = internal global i32* null
+@g2 = internal global i32* null
+
+define internal void @f1(i32* %x) {
+entry:
+  store i32* %x, i32** @g1
+  ret void
+}
+
+define internal void (i32*)* @get() {
+entry:
+  ret void (i32*)* @f1
+}
+
+define internal void @use(i32* %x) {
+entry:
+  %fp = call void (i32*)* ()* @get()
+  call void %fp(i32* %x)
+  ret void
+}
+
+define internal void @leaf1(i32* %p) {
+entry:
+  store i32* %p, i32** @g2
+  ret void
+}
+
+define internal void @leaf2(i32* %p) {
+entry:
+  store i32 0, i32* %p
+  ret void
+}
+
+define internal void @A(i32* %a, i32 %n) {
+entry:
+  %c = icmp eq i32 %n, 0
+  br i1 %c, label %done, label %rec
+
+rec:
+  %m = sub i32 %n, 1
+  call void @B(i32* %a, i32 %m)
+  br label %done
+
+done:
+  call void @leaf2(i32* %a)
+  ret void
+}
+
+define internal void @B(i32* %b, i32 %n) {
+entry:
+  call void @A(i32* %b, i32 %n)
+  ret void
+}
+
+define i32 @main() {
+entry:
+  %p = alloca i32
+  %r = alloca i32
+  call void @use(i32* %p)
+  call void @leaf1(i32* %p)
+  call void @A(i32* %r, i32 3)
+  %q = load i32*, i32** @g2
+  store i32 1, i32* %q
+  ret i32 0
+}
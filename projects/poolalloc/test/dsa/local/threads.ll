@@ -0,0 +1,77 @@
+; Building the local graphs on threads must give the same graphs as building
+; them one function at a time.  @merge puts @a and @b in one equivalence
+; class, which the graphs of the functions before and after it must reflect.
+
+;RUN: dsaopt %s -dsa-local -analyze -check-same-node=early:x,early:y
+;RUN: dsaopt %s -dsa-local -analyze -dsa-local-threads=4 \
+;RUN:   -check-same-node=early:x,early:y
+;RUN: dsaopt %s -dsa-local -analyze -check-same-node=late:x,late:y
+;RUN: dsaopt %s -dsa-local -analyze -dsa-local-threads=4 \
+;RUN:   -check-same-node=late:x,late:y
+;RUN: dsaopt %s -dsa-local -analyze -check-not-same-node=late:x,late:p
+;RUN: dsaopt %s -dsa-local -analyze -dsa-local-threads=4 \
+;RUN:   -check-not-same-node=late:x,late:p
+;RUN: dsaopt %s -dsa-local -analyze -check-callees=call,f1,f2
+;RUN: dsaopt %s -dsa-local -analyze -dsa-local-threads=4 \
+;RUN:   -check-callees=call,f1,f2
+;RUN: dsaopt %s -dsa-local -analyze -print-only-flags -print-only-types \
+;RUN:   -print-node-for-value=early:x,late:x,late:p,merge:s,call:fp > %t.1
+;RUN: dsaopt %s -dsa-local -analyze -print-only-flags -print-only-types \
+;RUN:   -dsa-local-threads=4 \
+;RUN:   -print-node-for-value=early:x,late:x,late:p,merge:s,call:fp > %t.2
+;RUN: diff %t.1 %t.2
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@a = internal global i32* null
+@b = internal global i32* null
+@table = internal constant [2 x void ()*] [void ()* @f1, void ()* @f2]
+
+define void @early() {
+entry:
+  %x = bitcast i32** @a to i8*
+  %y = bitcast i32** @b to i8*
+  store i8 0, i8* %x
+  store i8 0, i8* %y
+  ret void
+}
+
+define void @merge(i1 %c) {
+entry:
+  %s = select i1 %c, i32** @a, i32** @b
+  %m = call i8* @malloc(i64 4)
+  %i = bitcast i8* %m to i32*
+  store i32* %i, i32** %s
+  ret void
+}
+
+define void @late(i32* %p) {
+entry:
+  %x = bitcast i32** @a to i8*
+  %y = bitcast i32** @b to i8*
+  %l = load i32*, i32** @b
+  store i32 0, i32* %l
+  store i32 1, i32* %p
+  ret void
+}
+
+define void @f1() {
+entry:
+  ret void
+}
+
+define void @f2() {
+entry:
+  ret void
+}
+
+define void @call(i64 %n) {
+entry:
+  %slot = getelementptr [2 x void ()*], [2 x void ()*]* @table, i64 0, i64 %n
+  %fp = load void ()*, void ()** %slot
+  call void %fp()
+  ret void
+}
+
+declare noalias i8* @malloc(i64)
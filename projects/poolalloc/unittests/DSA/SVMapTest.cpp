@@ -0,0 +1,208 @@
+//===- SVMapTest.cpp - Tests of the sorted-vector map ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// These tests run random sequences of operations on an svmap and a std::map
+// and check after every operation that the two maps hold the same pairs in
+// the same order.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+#include "dsa/svmap.h"
+
+#include <functional>
+#include <map>
+#include <random>
+
+namespace {
+
+// Check that the maps hold the same pairs in the same order.
+template <typename Key, typename T, typename Compare>
+::testing::AssertionResult sameMap(const svmap<Key, T, Compare> &SV,
+                                   const std::map<Key, T, Compare> &M) {
+  if (SV.size() != M.size() || SV.empty() != M.empty())
+    return ::testing::AssertionFailure()
+           << "sizes differ: " << SV.size() << " != " << M.size();
+
+  typename svmap<Key, T, Compare>::const_iterator I = SV.begin();
+  for (typename std::map<Key, T, Compare>::const_iterator
+         J = M.begin(), E = M.end(); J != E; ++I, ++J)
+    if (I->first != J->first || I->second != J->second)
+      return ::testing::AssertionFailure()
+             << "pair (" << I->first << ", " << I->second << ") != ("
+             << J->first << ", " << J->second << ")";
+  return ::testing::AssertionSuccess();
+}
+
+// Run Steps random operations on keys below KeyRange.
+template <typename Compare>
+void runRandomOperations(unsigned Seed, unsigned Steps, unsigned KeyRange) {
+  typedef svmap<unsigned, int, Compare> SVMap;
+  typedef std::map<unsigned, int, Compare> Map;
+
+  std::mt19937 Random(Seed);
+  SVMap SV;
+  Map M;
+
+  for (unsigned Step = 0; Step < Steps; ++Step) {
+    unsigned Key = Random() % KeyRange;
+    int Value = (int)Step;
+
+    switch (Random() % 10) {
+    case 0:
+      SV[Key] = Value;
+      M[Key] = Value;
+      break;
+
+    case 1: {
+      // operator[] inserts a default value for an absent key.
+      ++SV[Key];
+      ++M[Key];
+      break;
+    }
+
+    case 2: {
+      std::pair<typename SVMap::iterator, bool> R =
+          SV.insert(std::make_pair(Key, Value));
+      std::pair<typename Map::iterator, bool> S =
+          M.insert(std::make_pair(Key, Value));
+      ASSERT_EQ(S.second, R.second);
+      ASSERT_EQ(S.first->first, R.first->first);
+      ASSERT_EQ(S.first->second, R.first->second);
+      break;
+    }
+
+    case 3: {
+      // Insert with a hint that is right, wrong, or at either end.
+      typename SVMap::iterator Hint;
+      switch (Random() % 4) {
+      case 0: Hint = SV.lower_bound(Key); break;
+      case 1: Hint = SV.begin(); break;
+      case 2: Hint = SV.end(); break;
+      default: Hint = SV.begin() + (Random() % (SV.size() + 1)); break;
+      }
+      typename SVMap::iterator R = SV.insert(Hint, std::make_pair(Key, Value));
+      typename Map::iterator S = M.insert(std::make_pair(Key, Value)).first;
+      ASSERT_EQ(S->first, R->first);
+      ASSERT_EQ(S->second, R->second);
+      break;
+    }
+
+    case 4:
+      ASSERT_EQ(M.erase(Key), SV.erase(Key));
+      break;
+
+    case 5: {
+      typename SVMap::iterator R = SV.find(Key);
+      typename Map::iterator S = M.find(Key);
+      ASSERT_EQ(S == M.end(), R == SV.end());
+      if (R != SV.end()) {
+        ASSERT_EQ(S->second, R->second);
+        typename SVMap::iterator Next = SV.erase(R);
+        S = M.erase(S);
+        ASSERT_EQ(S == M.end(), Next == SV.end());
+        if (Next != SV.end()) {
+          ASSERT_EQ(S->first, Next->first);
+        }
+      }
+      break;
+    }
+
+    case 6: {
+      const SVMap &CSV = SV;
+      const Map &CM = M;
+      ASSERT_EQ(CM.count(Key), CSV.count(Key));
+      typename SVMap::const_iterator R = CSV.lower_bound(Key);
+      typename Map::const_iterator S = CM.lower_bound(Key);
+      ASSERT_EQ(S == CM.end(), R == CSV.end());
+      if (R != CSV.end()) {
+        ASSERT_EQ(S->first, R->first);
+      }
+      ASSERT_EQ(CM.find(Key) == CM.end(), CSV.find(Key) == CSV.end());
+      break;
+    }
+
+    case 7: {
+      // Erase the range of keys between two random keys.
+      unsigned Last = Random() % KeyRange;
+      if (Compare()(Last, Key))
+        std::swap(Key, Last);
+      SV.erase(SV.lower_bound(Key), SV.lower_bound(Last));
+      M.erase(M.lower_bound(Key), M.lower_bound(Last));
+      break;
+    }
+
+    case 8:
+      // Erase every pair with an odd value while iterating.
+      if (Random() % 20 == 0) {
+        for (typename SVMap::iterator I = SV.begin(); I != SV.end();)
+          I = (I->second % 2) ? SV.erase(I) : I + 1;
+        for (typename Map::iterator I = M.begin(); I != M.end();)
+          if (I->second % 2)
+            M.erase(I++);
+          else
+            ++I;
+      }
+      break;
+
+    case 9:
+      if (Random() % 200 == 0) {
+        SVMap Other;
+        Other.swap(SV);
+        ASSERT_TRUE(SV.empty());
+        ASSERT_TRUE(sameMap(Other, M));
+        if (Random() % 2) {
+          Other.clear();
+          M.clear();
+        }
+        SV.swap(Other);
+      }
+      break;
+    }
+
+    ASSERT_TRUE(sameMap(SV, M)) << "after step " << Step;
+  }
+}
+
+TEST(SVMapTest, EmptyMap) {
+  svmap<unsigned, int> SV;
+  EXPECT_TRUE(SV.empty());
+  EXPECT_EQ(0u, SV.size());
+  EXPECT_TRUE(SV.begin() == SV.end());
+  EXPECT_TRUE(SV.find(0) == SV.end());
+  EXPECT_TRUE(SV.lower_bound(0) == SV.end());
+  EXPECT_EQ(0u, SV.count(0));
+  EXPECT_EQ(0u, SV.erase(0));
+}
+
+TEST(SVMapTest, InsertKeepsExistingValue) {
+  svmap<unsigned, int> SV;
+  EXPECT_TRUE(SV.insert(std::make_pair(3u, 1)).second);
+  EXPECT_FALSE(SV.insert(std::make_pair(3u, 2)).second);
+  EXPECT_EQ(1, SV.insert(SV.begin(), std::make_pair(3u, 4))->second);
+  EXPECT_EQ(1, SV[3]);
+  EXPECT_EQ(1u, SV.size());
+}
+
+// Few keys: most operations hit existing pairs.
+TEST(SVMapTest, RandomDense) {
+  runRandomOperations<std::less<unsigned> >(1, 100000, 64);
+}
+
+// Many keys: the map grows large and most lookups miss.
+TEST(SVMapTest, RandomSparse) {
+  runRandomOperations<std::less<unsigned> >(2, 100000, 4096);
+}
+
+// A comparison other than the default orders the vector.
+TEST(SVMapTest, RandomGreater) {
+  runRandomOperations<std::greater<unsigned> >(3, 50000, 256);
+}
+
+}
@@ -38,7 +38,7 @@ ModulePass *createExactCheckOptPass();
 void initializeExactCheckOptPass(PassRegistry&);
 
 // Remove identical load/store checks in basic blocks where possible.
-FunctionPass *createOptimizeIdenticalLSChecksPass();
+ModulePass *createOptimizeIdenticalLSChecksPass();
 void initializeOptimizeIdenticalLSChecksPass(PassRegistry&);
 
 // Remove implied fast load/store checks where possible.
@@ -271,6 +271,7 @@ class SoftBoundCETSPass: public ModulePass {
   void handleGlobalStructTypeInitializer(Module& , StructType* , Constant* , GlobalVariable*, std::vector<Constant*>, int) ;
   void addBaseBoundGlobals(Module&);
   Instruction* getGlobalInitInstruction(Module&);
+  void addMetadataEncodingCheck(Module&);
   void identifyInitialGlobals(Module&);
   void getGlobalVariableBaseBound(Value*, Value* &, Value* &);
   void dissociateBaseBound(Value*);
@@ -88,7 +88,7 @@ struct CheckInfo {
 //
 // Create a table describing all of the SAFECode run-time checks.
 //
-static const unsigned numChecks = 24;
+static const unsigned numChecks = 26;
 
 static const struct CheckInfo RuntimeChecks[numChecks] = {
   // Regular checking functions
@@ -104,6 +104,7 @@ static const struct CheckInfo RuntimeChecks[numChecks] = {
   {"fastlscheck",      "fastlscheck",    1, memcheck,  3, true,  0},
   {"funccheck",        "funccheck",      0, funccheck, 0, true,  0},
   {"funccheckui",      "funccheck",      0, funccheck, 0, false, 0},
+  {"funccheck_set",    "funccheck_set",  0, funccheck, 0, true,  0},
 
   // Debug versions of the above
   {"poolcheck_debug",        "poolcheck_debug",      1, memcheck, 2, true,  0},
@@ -117,7 +118,8 @@ static const struct CheckInfo RuntimeChecks[numChecks] = {
   {"exactcheck2_debug",      "exactcheck2_debug",    2, gepcheck, 0, true,  1},
   {"fastlscheck_debug",      "fastlscheck_debug",    1, memcheck, 3, true,  0},
   {"funccheck_debug",        "funccheck_debug",     0, funccheck, 0, true,  0},
-  {"funccheckui_debug",      "funccheck_debug",     0, funccheck, 0, false, 0}
+  {"funccheckui_debug",      "funccheck_debug",     0, funccheck, 0, false, 0},
+  {"funccheck_set_debug",    "funccheck_set_debug", 0, funccheck, 0, true,  0}
 };
 
 //
@@ -0,0 +1,149 @@
+//===- CheckProfile.h - Profile-guided SAFECode check selection --*- C++ -*---//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines passes that estimate how often each run-time check is
+// executed and use the estimates to select cheaper checks on hot paths.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _SAFECODE_CHECKPROFILE_H_
+#define _SAFECODE_CHECKPROFILE_H_
+
+#include "safecode/CheckInfo.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+#include <string>
+
+namespace llvm {
+
+//
+// Pass: CheckProfile
+//
+// Description:
+//  This analysis pass estimates the number of times that each basic block of
+//  the program is executed.  The execution count of a function is taken from
+//  its entry count (which the front end records when it uses an
+//  instrumentation profile) or from the profile given with -sc-profile.  The
+//  count of each basic block is the count of its function scaled by the
+//  block's frequency relative to the function's entry block.  Functions for
+//  which there is no profile are assumed to be executed once.
+//
+struct CheckProfile : public ModulePass {
+  public:
+    static char ID;
+    CheckProfile() : ModulePass(ID), MaxCount(0), Profiled(false) {}
+    virtual bool runOnModule (Module & M);
+
+    const char *getPassName() const {
+      return "SAFECode Check Execution Profile";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const;
+
+    // Return the estimated number of executions of a basic block
+    double getCount (const BasicBlock * BB) const {
+      DenseMap<const BasicBlock *, double>::const_iterator I = Counts.find (BB);
+      return (I != Counts.end()) ? I->second : 0;
+    }
+
+    // Determine whether a basic block is executed often enough to be hot
+    bool isHot (const BasicBlock * BB) const;
+
+    // Determine whether the estimates come from a profile
+    bool hasProfile (void) const {
+      return Profiled;
+    }
+
+  private:
+    // Function entry counts read from the profile file
+    StringMap<uint64_t> EntryCounts;
+
+    // Estimated execution count of each basic block
+    DenseMap<const BasicBlock *, double> Counts;
+    double MaxCount;
+    bool Profiled;
+
+    // Private methods
+    void readProfile (void);
+    bool getEntryCount (const Function & F, double & Count);
+};
+
+//
+// Pass: DynamicCheckReport
+//
+// Description:
+//  This pass prints the number of run-time checks of each kind in the program
+//  together with the estimated number of times that they are executed.  It is
+//  run before and after the check optimizations to report their effect.
+//
+struct DynamicCheckReport : public ModulePass {
+  public:
+    static char ID;
+    DynamicCheckReport (const char * label = "") :
+      ModulePass(ID), Label(label) {}
+    virtual bool runOnModule (Module & M);
+
+    const char *getPassName() const {
+      return "SAFECode Dynamic Check Report";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<CheckProfile>();
+      AU.setPreservesAll();
+    }
+
+  private:
+    // The point in the pipeline at which the report is made
+    const char * Label;
+};
+
+//
+// Pass: ProfileGuidedChecks
+//
+// Description:
+//  This pass replaces the run-time checks on hot paths with cheaper forms.  A
+//  load/store or bounds check on a stack or global object of known size does
+//  not need to look up the object at run-time; it is replaced by a
+//  fastlscheck() or an exactcheck2() that the compiler can later inline.
+//  Checks on cold paths are left alone to keep the code small.
+//
+struct ProfileGuidedChecks : public ModulePass {
+  public:
+    static char ID;
+    ProfileGuidedChecks() : ModulePass(ID) {}
+    virtual bool runOnModule (Module & M);
+
+    const char *getPassName() const {
+      return "Profile-Guided SAFECode Check Selection";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<CheckProfile>();
+      AU.addPreserved<CheckProfile>();
+      AU.setPreservesCFG();
+    }
+
+  private:
+    // Information about the target's data layout
+    const DataLayout * DL;
+
+    // Private methods
+    Value * getStaticObject (Value * Ptr, uint64_t & Size);
+    bool convertMemCheck (CallInst * CI, const CheckInfo * Info);
+    bool convertGEPCheck (CallInst * CI, const CheckInfo * Info);
+};
+
+}
+#endif
@@ -43,8 +43,8 @@ struct CompleteChecks : public ModulePass {
       AU.addRequired<CallGraphWrapperPass>();
       AU.addRequired<EQTDDataStructures>();
 
-      // Preserved passes
-      AU.setPreservesCFG();
+      // Inline checks on indirect function calls split basic blocks, so this
+      // pass does not preserve the CFG.
     };
 
   protected:
@@ -53,7 +53,13 @@ struct CompleteChecks : public ModulePass {
     void makeComplete (Module & M, const struct CheckInfo & CheckInfo);
     void makeCStdLibCallsComplete(Function *, unsigned, bool);
     void makeFSParameterCallsComplete(Module &M);
-    void fixupCFIChecks (Module & M, std::string name);
+    void fixupCFIChecks (Module & M, std::string name, std::string setName);
+    GlobalVariable * createTargetList (Module & M,
+                                       const std::vector<Function *> & T);
+    GlobalVariable * createTargetSet (Module & M,
+                                      const std::vector<Function *> & T);
+    void inlineTargetCompares (CallInst * CI,
+                               const std::vector<Function *> & T);
     void getFunctionTargets (CallSite CS, std::vector<const Function *> & T);
 };
 
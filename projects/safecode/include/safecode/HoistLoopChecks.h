@@ -0,0 +1,81 @@
+//===- HoistLoopChecks.h - Hoist SAFECode checks out of loops ----*- C++ -*---//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a pass that replaces the run-time checks performed on
+// every iteration of a loop with checks of the whole accessed range in the
+// loop's preheader.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _SAFECODE_HOISTLOOPCHECKS_H_
+#define _SAFECODE_HOISTLOOPCHECKS_H_
+
+#include "safecode/CheckInfo.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+
+namespace llvm {
+
+//
+// Pass: HoistLoopChecks
+//
+// Description:
+//  This pass uses scalar evolution to find run-time checks on pointers that
+//  are affine functions of a loop's induction variable.  Each such check is
+//  replaced by checks of the first and last pointer (or by one check of the
+//  whole range for load/store checks) placed in the loop's preheader.  Loops
+//  are processed from the innermost outwards, so the checks that are hoisted
+//  out of an inner loop may be hoisted again out of the loops around it.
+//
+struct HoistLoopChecks : public FunctionPass {
+  public:
+    static char ID;
+    HoistLoopChecks() : FunctionPass(ID) {}
+    virtual bool runOnFunction (Function & F);
+
+    const char *getPassName() const {
+      return "Hoist SAFECode Run-time Checks out of Loops";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<DominatorTreeWrapperPass>();
+      AU.addRequired<LoopInfoWrapperPass>();
+      AU.addRequired<ScalarEvolution>();
+      AU.addPreserved<DominatorTreeWrapperPass>();
+      AU.addPreserved<LoopInfoWrapperPass>();
+      AU.setPreservesCFG();
+    }
+
+  private:
+    // Pointers to required analysis passes
+    DominatorTree * DT;
+    LoopInfo * LI;
+    ScalarEvolution * SE;
+
+    // Private methods
+    bool processLoopNest (Loop * L, unsigned & Hoisted, unsigned & Removed);
+    bool processLoop (Loop * L, unsigned & Hoisted, unsigned & Removed);
+    bool isEligibleLoop (Loop * L);
+    const SCEVAddRecExpr * getAffinePointer (Loop * L, Value * Ptr);
+    bool hasInvariantOperands (Loop * L, CallInst * CI, unsigned except);
+    void hoistMemCheck (Loop * L, CallInst * CI, const CheckInfo * Info,
+                        const SCEVAddRecExpr * AR, const SCEV * Last,
+                        SCEVExpander & Rewriter, unsigned & Hoisted);
+    void hoistGEPCheck (Loop * L, CallInst * CI, const CheckInfo * Info,
+                        const SCEV * First, const SCEV * Last,
+                        SCEVExpander & Rewriter, unsigned & Hoisted);
+};
+
+}
+#endif
@@ -0,0 +1,128 @@
+//===- IPCheckElimination.h - Interprocedural check elimination --*- C++ -*---//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a pass that removes the run-time checks on pointers passed
+// into a function when every caller passes a large enough object.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _SAFECODE_IPCHECKELIMINATION_H_
+#define _SAFECODE_IPCHECKELIMINATION_H_
+
+#include "safecode/CheckInfo.h"
+
+#include "dsa/DataStructure.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+#include <vector>
+
+namespace llvm {
+
+//
+// Pass: IPCheckElimination
+//
+// Description:
+//  This pass computes, for every pointer argument of every function, the
+//  number of bytes from the argument that the function's load/store and
+//  bounds checks on the argument access.  The summaries are computed
+//  bottom-up over the strongly connected components of the DSA call graph;
+//  a pointer passed on to a callee adds the callee's requirement to the
+//  requirement of the caller's argument.
+//
+//  An argument is safe if every call passes a pointer into a stack or global
+//  object with at least the required number of bytes after it, or passes a
+//  safe argument of the caller with enough bytes remaining.  The checks on
+//  safe arguments are removed.  Optionally, a function with unsafe arguments
+//  is cloned without those checks for the call sites that pass large enough
+//  objects.
+//
+struct IPCheckElimination : public ModulePass {
+  public:
+    static char ID;
+    IPCheckElimination() : ModulePass(ID) {}
+    virtual bool runOnModule (Module & M);
+
+    const char *getPassName() const {
+      return "Interprocedural SAFECode Check Elimination";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<EQTDDataStructures>();
+      AU.addRequired<ScalarEvolution>();
+    }
+
+  private:
+    // The requirement of an argument that cannot be summarized
+    static const uint64_t Unknown = ~0ull;
+
+    // A check on a pointer argument and the number of bytes it accesses
+    struct ArgCheck {
+      CallInst * Check;
+      unsigned Arg;
+      uint64_t Extent;
+    };
+
+    // What a call passes as a pointer argument
+    struct Actual {
+      enum { None, Object, Argument } Kind;
+      // The bytes of an object after the pointer, or the argument of the
+      // caller from which the pointer is derived
+      uint64_t Value;
+      // The largest offset of the pointer from the caller's argument
+      uint64_t Offset;
+    };
+
+    // A direct call of a function and what it passes to the function
+    struct CallInfo {
+      CallInst * Call;
+      Function * Caller;
+      std::vector<Actual> Actuals;
+    };
+
+    // Information about the target's data layout
+    const DataLayout * DL;
+
+    // The checks on the arguments of each function that may be removed
+    DenseMap<const Function *, std::vector<ArgCheck> > ArgChecks;
+
+    // The direct calls of defined functions, indexed by callee and by caller
+    std::vector<CallInfo> CallInfos;
+    DenseMap<const Function *, std::vector<unsigned> > CallsOf;
+    DenseMap<const Function *, std::vector<unsigned> > CallsFrom;
+
+    // Whether each function is only used as the callee of direct calls
+    DenseMap<const Function *, bool> DirectOnly;
+
+    // The number of bytes required from each argument of each function and
+    // whether every call provides them
+    DenseMap<const Function *, std::vector<uint64_t> > Needs;
+    DenseMap<const Function *, std::vector<bool> > Safe;
+
+    // Private methods
+    bool getOffsetRange (ScalarEvolution * SE, Value * Ptr, Value *& Base,
+                         uint64_t & Low, uint64_t & High);
+    uint64_t getStaticObjectSize (Value * V);
+    void summarizeFunction (Function & F, ScalarEvolution * SE);
+    void findCheck (CallInst * CI, ScalarEvolution * SE);
+    void findCall (CallInst * CI, ScalarEvolution * SE);
+    void computeNeeds (const std::vector<Function *> & SCC);
+    uint64_t getProvided (const CallInfo & Call, unsigned Arg);
+    void computeSafety (Module & M);
+    unsigned removeChecks (void);
+    unsigned specializeFunctions (Module & M);
+};
+
+}
+#endif
@@ -0,0 +1,96 @@
+//===- LoopVersionChecks.h - Version loops to remove checks ------*- C++ -*---//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a pass that duplicates loops into a checked and an
+// unchecked version and selects between them with a test of the whole range
+// of pointers that the loop's checks would check.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _SAFECODE_LOOPVERSIONCHECKS_H_
+#define _SAFECODE_LOOPVERSIONCHECKS_H_
+
+#include "safecode/CheckInfo.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+
+#include <vector>
+
+namespace llvm {
+
+//
+// Pass: LoopVersionChecks
+//
+// Description:
+//  This pass handles the loops whose checks HoistLoopChecks cannot hoist
+//  because they are not performed on every iteration or because their results
+//  are used.  If the pointers checked by such checks are affine functions of
+//  the induction variable, the preheader can look up the objects that they
+//  point into and test whether all of the pointers that the loop can check
+//  are within them.  The loop is cloned: the original loop loses these checks
+//  and is run when the test passes, and the clone keeps all of its checks and
+//  is run otherwise so that errors are still reported where they occur.
+//
+//  A loop is only versioned if its size is small relative to the number of
+//  checks removed, and the growth of each function is limited.
+//
+struct LoopVersionChecks : public FunctionPass {
+  public:
+    static char ID;
+    LoopVersionChecks() : FunctionPass(ID) {}
+    virtual bool runOnFunction (Function & F);
+
+    const char *getPassName() const {
+      return "Version Loops to Remove SAFECode Run-time Checks";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<DominatorTreeWrapperPass>();
+      AU.addRequired<LoopInfoWrapperPass>();
+      AU.addRequired<ScalarEvolution>();
+      AU.addPreserved<DominatorTreeWrapperPass>();
+      AU.addPreserved<LoopInfoWrapperPass>();
+    }
+
+  private:
+    // The range of pointers that a check can check within a loop
+    struct PointerRange {
+      const SCEV * Low;
+      const SCEV * High;
+    };
+
+    // Pointers to required analysis passes
+    DominatorTree * DT;
+    LoopInfo * LI;
+    ScalarEvolution * SE;
+
+    // The cache that the run-time fills with the bounds of an object
+    AllocaInst * Bounds;
+
+    // Private methods
+    bool isEligibleLoop (Loop * L);
+    bool getPointerRange (Loop * L, Value * Ptr, PointerRange & Range);
+    bool canRemoveCheck (Loop * L, CallInst * CI, const CheckInfo * Info);
+    void findChecks (Loop * L, std::vector<CallInst *> & Checks);
+    unsigned getLoopSize (Loop * L);
+    Value * addRangeTest (Loop * L, CallInst * CI, const CheckInfo * Info,
+                          SCEVExpander & Rewriter, Instruction * InsertPt);
+    void addObjectLookup (Value * Pool, Value * Ptr,
+                          Value *& Lower, Value *& Upper,
+                          Instruction * InsertPt);
+    void versionLoop (Loop * L, const std::vector<CallInst *> & Checks);
+};
+
+}
+#endif
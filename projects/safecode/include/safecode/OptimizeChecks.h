@@ -57,7 +57,8 @@ struct OptimizeChecks : public ModulePass {
 // Description:
 //  This pass looks for global variables that are never used in run-time checks
 //  that perform lookups.  Such global variables do not need to be registered
-//  with pool_register_global(), so we remove such registrations.
+//  with pool_register_global() or listed in the tables passed to
+//  pool_register_globals(), so we remove such registrations.
 //
 struct GlobalRegisterOpt : public ModulePass {
   private:
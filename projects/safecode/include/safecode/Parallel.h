@@ -0,0 +1,78 @@
+//===- Parallel.h - Run the analysis of SAFECode passes on threads -*- C++ -*-//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a helper that lets the SAFECode passes analyze functions
+// or check calls on several threads.
+//
+// An LLVMContext is not thread-safe: creating constants, types, or metadata
+// and modifying instructions or use lists must not happen on more than one
+// thread.  Passes therefore only run code that reads the IR on the threads
+// and make their changes once all of the threads have finished.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _SAFECODE_PARALLEL_H_
+#define _SAFECODE_PARALLEL_H_
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace llvm {
+
+// Return the number of threads to use for the given number of work items
+unsigned getAnalysisThreads (unsigned Items);
+
+namespace detail {
+  //
+  // Function: parallelWorker()
+  //
+  // Description:
+  //  Call the function on work items taken from a shared counter until all of
+  //  them have been taken.
+  //
+  template <typename FuncTy>
+  void parallelWorker (FuncTy * Func,
+                       std::atomic<unsigned> * Next,
+                       unsigned Count) {
+    unsigned index;
+    while ((index = Next->fetch_add (1, std::memory_order_relaxed)) < Count)
+      (*Func) (index);
+  }
+}
+
+//
+// Function: parallelFor()
+//
+// Description:
+//  Call a function on each index from zero up to the given count.  The calls
+//  are made on as many threads as -sc-threads allows and in no particular
+//  order, so the function must only read the IR and must write its results
+//  to storage that belongs to the index.
+//
+template <typename FuncTy>
+void parallelFor (unsigned Count, FuncTy Func) {
+  unsigned NumThreads = getAnalysisThreads (Count);
+  std::atomic<unsigned> Next (0);
+  if (NumThreads <= 1) {
+    detail::parallelWorker (&Func, &Next, Count);
+    return;
+  }
+
+  std::vector<std::thread> Threads;
+  for (unsigned thread = 1; thread < NumThreads; ++thread)
+    Threads.push_back (std::thread (detail::parallelWorker<FuncTy>,
+                                    &Func, &Next, Count));
+  detail::parallelWorker (&Func, &Next, Count);
+  for (unsigned thread = 0; thread < Threads.size(); ++thread)
+    Threads[thread].join();
+}
+
+}
+#endif
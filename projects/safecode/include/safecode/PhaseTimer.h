@@ -0,0 +1,56 @@
+//===- PhaseTimer.h - Time the phases of the SAFECode pipeline ---*- C++ -*---//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a pass that marks the start of a phase of the SAFECode
+// pass pipeline so that the compile time of each phase can be reported.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _SAFECODE_PHASETIMER_H_
+#define _SAFECODE_PHASETIMER_H_
+
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+namespace llvm {
+
+//
+// Pass: PhaseTimer
+//
+// Description:
+//  This pass stops the timer of the phase that is running and starts the
+//  timer of the named phase.  A pass without a phase name ends the last phase
+//  and prints the time of every phase.  The passes do nothing unless
+//  -sc-time-phases or -time-passes is given.
+//
+//  The analyses that a pass requires are run after the marker before it, so
+//  their time (e.g., the time of DSA) is counted in the phase of the first
+//  pass that requires them.
+//
+struct PhaseTimer : public ModulePass {
+  public:
+    static char ID;
+    PhaseTimer (const char * Phase = 0) : ModulePass(ID), Phase(Phase) {}
+    virtual bool runOnModule (Module & M);
+
+    const char *getPassName() const {
+      return "SAFECode Phase Timer";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesAll();
+    }
+
+  private:
+    // The name of the phase that starts at this pass
+    const char * Phase;
+};
+
+}
+#endif
@@ -0,0 +1,106 @@
+//===- RedundantChecks.h - Remove redundant SAFECode checks ------*- C++ -*---//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a pass that removes run-time checks that are implied by
+// checks performed earlier on every path through a function.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _SAFECODE_REDUNDANTCHECKS_H_
+#define _SAFECODE_REDUNDANTCHECKS_H_
+
+#include "safecode/CheckInfo.h"
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+#include <vector>
+
+namespace llvm {
+
+//
+// Pass: RedundantCheckElimination
+//
+// Description:
+//  This pass computes, for every point of a function, the set of run-time
+//  checks that have been performed on every path reaching that point and that
+//  have not been invalidated since.  A check is removed if one of the
+//  available checks verifies the same property on a range that contains the
+//  range that it verifies.
+//
+//  A check on a memory object is invalidated by the calls that may free the
+//  object.  Whether a call may free memory is determined by a bottom-up
+//  summary of the call graph, and alias analysis is used to restrict the
+//  checks that a call to a deallocator invalidates.
+//
+struct RedundantCheckElimination : public ModulePass {
+  public:
+    static char ID;
+    RedundantCheckElimination() : ModulePass(ID) {}
+    virtual bool runOnModule (Module & M);
+
+    const char *getPassName() const {
+      return "Remove Redundant SAFECode Run-time Checks";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<AliasAnalysis>();
+      AU.addRequired<CallGraphWrapperPass>();
+      AU.setPreservesCFG();
+    }
+
+  private:
+    // The ways in which an instruction can invalidate checks
+    enum KillKind {
+      KillAll,       // Frees or unregisters any object
+      KillFreed,     // Frees the object of a pointer
+      KillMayFree,   // Calls a function that may free objects
+      KillWritten    // Writes memory (only affects string checks)
+    };
+
+    // Pointers to required analysis passes
+    AliasAnalysis * AA;
+    const DataLayout * DL;
+
+    // The functions that may free memory when called
+    SmallPtrSet<const Function *, 32> MayFree;
+
+    // The checks of the function being processed, the indices of their
+    // entries in RuntimeChecks[], and their indices in Checks
+    std::vector<CallInst *> Checks;
+    std::vector<unsigned> CheckKinds;
+    DenseMap<const CallInst *, unsigned> CheckIndex;
+
+    // The checks invalidated by each instruction of the function
+    DenseMap<const Instruction *, BitVector> Kills;
+
+    // Private methods
+    void computeMayFree (Module & M);
+    bool mayFreeMemory (CallSite CS);
+    bool processFunction (Function & F, unsigned & Removed);
+    void findChecks (Function & F);
+    void computeKills (Function & F);
+    void killAliasingChecks (Instruction * I, KillKind How, Value * Ptr = 0);
+    bool subsumes (unsigned Avail, unsigned Index);
+    bool sameContext (unsigned Avail, unsigned Index);
+    const CheckInfo * getCheckInfo (unsigned Index);
+    unsigned getNumArgs (unsigned Index);
+    Value * getCheckedObject (unsigned Index);
+};
+
+}
+#endif
@@ -56,7 +56,8 @@ protected:
 };
 
 /// Register the bound information of global variables.
-/// All registeration are placed at sc.register_globals
+/// The globals are listed in a constant table in the sc_globals section that
+/// sc.register_globals passes to the run-time with one call.
 class RegisterGlobalVariables : public RegisterVariables {
 public:
   static char ID;
@@ -75,8 +76,11 @@ private:
   // Other passes which we query
   const DataLayout * TD;
 
+  // The type of an entry of the table of registered globals
+  StructType * EntryType;
+
   // Private methods
-  void registerGV(GlobalVariable * GV, Instruction * InsertBefore);
+  void registerGV(GlobalVariable * GV, std::vector<Constant *> & Entries);
 };
 
 /// Register the bound information of argv[] in main().
@@ -171,6 +171,7 @@ extern "C" {
                                unsigned size, TAG, SRC_INFO);
 
   void __sc_bb_funccheck (unsigned num, void *f, void *g, ...);
+  void __sc_bb_funccheck_set (void *f, struct TargetSet * Set, TAG, SRC_INFO);
   void * pchk_getActualValue (PPOOL, void * src);
 
   // Change memory protections to detect dangling pointers
@@ -14,6 +14,9 @@
 #ifndef _SCUTILS_H_
 #define _SCUTILS_H_
 
+#include "dsa/GlobalTables.h"
+
+#include "llvm/ADT/Triple.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Instructions.h"
@@ -63,6 +66,24 @@ PointerType * getVoidPtrType(LLVMContext & Context) {
   return PointerType::getUnqual(Int8Type);
 }
 
+//
+// Function: getSiteCacheType()
+//
+// Description:
+//  Return the LLVM type of the SiteCache structure that the run-time fills in
+//  (see runtime/include/SiteCache.h): the pool, the address of the first byte
+//  of the cached object and the address one past its end, and the epoch in
+//  which the object was cached.
+//
+static inline
+StructType * getSiteCacheType(Module & M) {
+  LLVMContext & Context = M.getContext();
+  Type * VoidPtrTy = getVoidPtrType (Context);
+  Type * IntPtrTy = M.getDataLayout().getIntPtrType (Context);
+  Type * FieldTypes[] = {VoidPtrTy, VoidPtrTy, VoidPtrTy, IntPtrTy};
+  return StructType::get (Context, ArrayRef<Type *>(FieldTypes));
+}
+
 //
 // Function: castTo()
 //
@@ -319,6 +340,47 @@ destroyFunction (Function * F) {
   return;
 }
 
+//
+// Function: getGlobalTableSection()
+//
+// Description:
+//  Return the name of the section that holds the tables of global variables
+//  that sc.register_globals() passes to pool_register_globals().
+//
+static inline const char *
+getGlobalTableSection (const Module & M) {
+  if (Triple (M.getTargetTriple()).isOSBinFormatMachO())
+    return "__DATA," DSA_GLOBAL_TABLE_SECTION;
+  return DSA_GLOBAL_TABLE_SECTION;
+}
+
+//
+// Function: isGlobalTableEntry()
+//
+// Description:
+//  Determine whether a value is an entry in a table of global variables that
+//  are registered with pool_register_globals().  Such an entry only tells the
+//  run-time the bounds of a global; it does not let the global escape.
+//
+static inline bool
+isGlobalTableEntry (Value * V) {
+  if (!isa<ConstantStruct>(V))
+    return false;
+
+  for (Value::user_iterator UI = V->user_begin(); UI != V->user_end(); ++UI) {
+    if (!isa<ConstantArray>(*UI))
+      return false;
+    for (Value::user_iterator TI = UI->user_begin(); TI != UI->user_end();
+         ++TI) {
+      GlobalVariable * Table = dyn_cast<GlobalVariable>(*TI);
+      if (!Table || !StringRef (Table->getSection()).endswith (DSA_GLOBAL_TABLE_SECTION))
+        return false;
+    }
+  }
+
+  return true;
+}
+
 //
 // Function: escapesToMemory()
 //
@@ -410,6 +472,13 @@ escapesToMemory (Value * V) {
         continue;
       }
 
+      //
+      // Entries of the table of registered global variables are okay.
+      //
+      if (isGlobalTableEntry (*UI)) {
+        continue;
+      }
+
       //
       // Call instructions are okay if we understand the semantics of the
       // called function.  Otherwise, assume they call a function that allows
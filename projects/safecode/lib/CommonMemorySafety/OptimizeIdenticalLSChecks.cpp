@@ -10,7 +10,8 @@
 // This pass removes identical load/store checks by removing all but the
 // first instances of repeating (base ptr, access size) pairs in segments of
 // basic blocks where the segments are ended by function calls that may
-// deallocate memory.
+// deallocate memory.  The functions are searched on several threads since
+// the search only reads the IR; the checks are removed afterwards.
 //
 //===----------------------------------------------------------------------===//
 
@@ -26,19 +27,27 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/Transforms/Instrumentation.h"
+#include "safecode/Parallel.h"
+
+#include <vector>
 
 using namespace llvm;
 
 STATISTIC(MemoryChecksRemoved, "Load/store checks removed");
 
 namespace {
-  class OptimizeIdenticalLSChecks : public FunctionPass {
+  typedef SmallVector <CallInst*, 16> CheckList;
+
+  class OptimizeIdenticalLSChecks : public ModulePass {
+    MSCInfo *MSCI;
+
     bool mayDeallocateMemory(CallInst *CI);
+    void findIdenticalChecks(Function &F, CheckList &ToRemove);
 
   public:
     static char ID;
-    OptimizeIdenticalLSChecks(): FunctionPass(ID) { }
-    virtual bool runOnFunction(Function &F);
+    OptimizeIdenticalLSChecks(): ModulePass(ID) { }
+    virtual bool runOnModule(Module &M);
 
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.addRequired<MSCInfo>();
@@ -59,14 +68,43 @@ INITIALIZE_PASS(OptimizeIdenticalLSChecks, "optimize-identical-ls-checks",
                 "Remove identical load/store checks where possible", false,
                 false)
 
-FunctionPass *llvm::createOptimizeIdenticalLSChecksPass() {
+ModulePass *llvm::createOptimizeIdenticalLSChecksPass() {
   return new OptimizeIdenticalLSChecks();
 }
 
-bool OptimizeIdenticalLSChecks::runOnFunction(Function &F) {
-  MSCInfo *MSCI = &getAnalysis<MSCInfo>();
+bool OptimizeIdenticalLSChecks::runOnModule(Module &M) {
+  MSCI = &getAnalysis<MSCInfo>();
+
+  std::vector <Function*> Functions;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    if (!F->isDeclaration())
+      Functions.push_back(F);
+
+  // Search the functions in parallel; each one gets its own list of checks.
+  std::vector <CheckList> ToRemove(Functions.size());
+  parallelFor(Functions.size(), [&](unsigned i) {
+    findIdenticalChecks(*Functions[i], ToRemove[i]);
+  });
+
+  // Erase the checks scheduled for removal.
+  bool Modified = false;
+  for (size_t i = 0, N = ToRemove.size(); i != N; ++i) {
+    for (size_t j = 0, NC = ToRemove[i].size(); j != NC; ++j) {
+      ToRemove[i][j]->eraseFromParent();
+      ++MemoryChecksRemoved;
+      Modified = true;
+    }
+  }
+
+  return Modified;
+}
+
+/// findIdenticalChecks - find the load/store checks of a function that repeat
+/// an earlier check in their segment of a basic block.  This only reads the
+/// IR so that it can run on several functions at once.
+void OptimizeIdenticalLSChecks::findIdenticalChecks(Function &F,
+                                                    CheckList &ToRemove) {
   SmallSet <ValuePair, 32> PreviousChecks;
-  SmallVector <CallInst*, 64> ToRemove;
 
   for (Function::iterator BB = F.begin(), BBE = F.end(); BB != BBE; ++BB) {
     for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I) {
@@ -99,13 +137,6 @@ bool OptimizeIdenticalLSChecks::runOnFunction(Function &F) {
 
     PreviousChecks.clear();
   }
-
-  for (size_t i = 0, N = ToRemove.size(); i != N; ++i) {
-    ToRemove[i]->eraseFromParent();
-    ++MemoryChecksRemoved;
-  }
-
-  return !ToRemove.empty();
 }
 
 bool OptimizeIdenticalLSChecks::mayDeallocateMemory(CallInst *CI) {
@@ -19,9 +19,13 @@
 #include "safecode/CompleteChecks.h"
 #include "safecode/Utility.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 #include <stdint.h>
 
@@ -32,9 +36,24 @@ char CompleteChecks::ID = 0;
 static RegisterPass<CompleteChecks>
 X ("compchecks", "Make run-time checks complete");
 
+// Command line options
+static cl::opt<unsigned>
+InlineFuncCheckLimit ("sc-inline-funccheck-limit",
+                      cl::desc ("Most targets of an indirect call to check "
+                                "with inline compares"),
+                      cl::init (4));
+
+static cl::opt<unsigned>
+SetFuncCheckLimit ("sc-sorted-funccheck-limit",
+                   cl::desc ("Fewest targets of an indirect call to check "
+                             "with a sorted target set"),
+                   cl::init (64));
+
 // Pass Statistics
 namespace {
   STATISTIC (CompLSChecks, "Complete Load/Store Checks");
+  STATISTIC (InlinedFuncChecks, "Indirect call checks done inline");
+  STATISTIC (SetFuncChecks, "Indirect call checks using sorted target sets");
 }
 
 //
@@ -534,6 +553,144 @@ CompleteChecks::getFunctionTargets (CallSite CS,
 
 #endif
 
+//
+// Method: createTargetList()
+//
+// Description:
+//  Create a global variable holding a null-terminated list of the targets of
+//  an indirect function call.  This is the table that funccheck() searches.
+//
+// Inputs:
+//  M       - The module in which to create the global variable.
+//  Targets - The potential targets of the indirect function call.
+//
+// Return value:
+//  The new global variable.
+//
+GlobalVariable *
+CompleteChecks::createTargetList (Module & M,
+                                  const std::vector<Function *> & Targets) {
+  PointerType * VoidPtrType = getVoidPtrType(M.getContext());
+  std::vector<Constant *> GoodTargets;
+  for (unsigned index = 0; index < Targets.size(); ++index) {
+    Constant * C = Targets[index];
+    GoodTargets.push_back(ConstantExpr::getZExtOrBitCast(C, VoidPtrType));
+  }
+  GoodTargets.push_back (ConstantPointerNull::get (VoidPtrType));
+
+  ArrayType * AT = ArrayType::get (VoidPtrType, GoodTargets.size());
+  Constant * TargetArray = ConstantArray::get (AT, GoodTargets);
+  return new GlobalVariable (M,
+                             AT,
+                             true,
+                             GlobalValue::InternalLinkage,
+                             TargetArray,
+                             "TargetList");
+}
+
+//
+// Method: createTargetSet()
+//
+// Description:
+//  Create a global variable holding the TargetSet structure (see the run-time's
+//  TargetSet.h) of the targets of an indirect function call.  The structure is
+//  { count, state, [2 * count x i8*] } where the second half of the array is
+//  space into which the run-time sorts the targets when the set is first used;
+//  the global variable is therefore not constant.
+//
+// Inputs:
+//  M       - The module in which to create the global variable.
+//  Targets - The potential targets of the indirect function call.
+//
+// Return value:
+//  The new global variable.
+//
+GlobalVariable *
+CompleteChecks::createTargetSet (Module & M,
+                                 const std::vector<Function *> & Targets) {
+  PointerType * VoidPtrType = getVoidPtrType(M.getContext());
+  Type * IntPtrType = M.getDataLayout().getIntPtrType(M.getContext());
+
+  std::vector<Constant *> Slots;
+  for (unsigned index = 0; index < Targets.size(); ++index) {
+    Constant * C = Targets[index];
+    Slots.push_back(ConstantExpr::getZExtOrBitCast(C, VoidPtrType));
+  }
+  Slots.resize (2 * Targets.size(), ConstantPointerNull::get (VoidPtrType));
+
+  ArrayType * AT = ArrayType::get (VoidPtrType, Slots.size());
+  StructType * ST = StructType::get (IntPtrType, IntPtrType, AT, NULL);
+  Constant * Fields[] = {
+    ConstantInt::get (IntPtrType, Targets.size()),
+    ConstantInt::get (IntPtrType, 0),
+    ConstantArray::get (AT, Slots)
+  };
+  return new GlobalVariable (M,
+                             ST,
+                             false,
+                             GlobalValue::InternalLinkage,
+                             ConstantStruct::get (ST, Fields),
+                             "TargetSet");
+}
+
+//
+// Method: inlineTargetCompares()
+//
+// Description:
+//  Compare the function pointer checked by a funccheck() call against each of
+//  its targets inline and only call funccheck() when none of them match.  The
+//  call then only happens on the way to reporting an error.
+//
+// Inputs:
+//  CI      - The call to funccheck().
+//  Targets - The potential targets of the indirect function call.
+//
+void
+CompleteChecks::inlineTargetCompares (CallInst * CI,
+                                      const std::vector<Function *> & Targets) {
+  //
+  // Split the block so that the check is alone in a block of its own:
+  //
+  //  BB:     compare the pointer against the targets
+  //  Fail:   call funccheck() to report the error
+  //  Cont:   the rest of the original block
+  //
+  BasicBlock * BB = CI->getParent();
+  BasicBlock * Fail = SplitBlock (BB, CI);
+  BasicBlock::iterator Next = CI;
+  BasicBlock * Cont = SplitBlock (Fail, ++Next);
+  Fail->setName ("funccheck.fail");
+
+  TerminatorInst * OldBranch = BB->getTerminator();
+  PointerType * VoidPtrType = getVoidPtrType(CI->getContext());
+  Value * FP = castTo (CI->getArgOperand(0), VoidPtrType, OldBranch);
+  Value * Match = 0;
+  for (unsigned index = 0; index < Targets.size(); ++index) {
+    Constant * Target = ConstantExpr::getZExtOrBitCast (Targets[index],
+                                                        VoidPtrType);
+    Instruction * Cmp = new ICmpInst (OldBranch,
+                                      CmpInst::ICMP_EQ,
+                                      FP,
+                                      Target,
+                                      "funccheck.cmp");
+    Cmp->setDebugLoc (CI->getDebugLoc());
+    if (Match) {
+      Match = BinaryOperator::Create (Instruction::Or,
+                                      Match,
+                                      Cmp,
+                                      "funccheck.match",
+                                      OldBranch);
+    } else {
+      Match = Cmp;
+    }
+  }
+
+  BranchInst * Branch = BranchInst::Create (Cont, Fail, Match, OldBranch);
+  Branch->setDebugLoc (CI->getDebugLoc());
+  OldBranch->eraseFromParent();
+  return;
+}
+
 //
 // Method: fixupCFIChecks()
 //
@@ -543,12 +700,23 @@ CompleteChecks::getFunctionTargets (CallSite CS,
 //  because we don't have a complete call graph when analyzing individual
 //  compilation units.
 //
+//  Searching a list of targets takes time linear in the number of targets,
+//  so checks with only a few targets are done with inline compares and
+//  checks with many targets are changed to search a sorted set of targets.
+//
+// Inputs:
+//  M       - The module to transform.
+//  name    - The name of the funccheck() function to fix up.
+//  setName - The name of the version of the function that takes a TargetSet.
+//
 // Preconditions:
 //  This method assumes that we have already converted incomplete checks to
 //  complete checks.
 //
 void
-CompleteChecks::fixupCFIChecks (Module & M, std::string name) {
+CompleteChecks::fixupCFIChecks (Module & M,
+                                std::string name,
+                                std::string setName) {
   //
   // See if this run-time check is used in this program.  If not, do nothing.
   //
@@ -556,58 +724,81 @@ CompleteChecks::fixupCFIChecks (Module & M, std::string name) {
   if (!FuncCheck) return;
 
   //
-  // Scan through all uses of the funccheck() function.
+  // Find all of the calls to the funccheck() function.  Some of them will be
+  // replaced, so find them before changing any of them.
   //
-  PointerType * VoidPtrType = getVoidPtrType(M.getContext());
+  std::vector<CallInst *> Checks;
   Value::use_iterator UI = FuncCheck->use_begin();
   Value::use_iterator  E = FuncCheck->use_end();
   for (; UI != E; ++UI) {
     if (CallInst * CI = dyn_cast<CallInst>(*UI)) {
       if (CI->getCalledValue()->stripPointerCasts() == FuncCheck) {
-        //
-        // Get the call instruction following this call instruction.
-        //
-        BasicBlock::iterator I = CI;
-        CallInst * ICI;
-        do {
-          ++I;
-          assert (!isa<TerminatorInst>(I));
-        } while ((ICI = dyn_cast<CallInst>(I)) == 0);
+        Checks.push_back (CI);
+      }
+    }
+  }
 
-        //
-        // Get the list of potential function targets.  Note that we have to
-        // do some silly things to get rid of the "const"-ness of the functions
-        // that we find.
-        //
-        //
-        std::vector<const Function *> Targets;
-        getFunctionTargets (ICI, Targets);
-        std::vector<Constant *> GoodTargets;
-        for (unsigned index = 0; index < Targets.size(); ++index) {
-          Constant * C = M.getFunction (Targets[index]->getName());
-          GoodTargets.push_back(ConstantExpr::getZExtOrBitCast(C, VoidPtrType));
-        }
-        GoodTargets.push_back (ConstantPointerNull::get (VoidPtrType));
+  PointerType * VoidPtrType = getVoidPtrType(M.getContext());
+  for (unsigned index = 0; index < Checks.size(); ++index) {
+    CallInst * CI = Checks[index];
 
-        //
-        // Create a new global variable containing the list of targets.
-        //
-        ArrayType * AT = ArrayType::get (VoidPtrType, GoodTargets.size());
-        Constant * TargetArray = ConstantArray::get (AT, GoodTargets);
-        Value * NewTable = new GlobalVariable (M,
-                                               AT,
-                                               true,
-                                               GlobalValue::InternalLinkage,
-                                               TargetArray,
-                                               "TargetList");
+    //
+    // Get the call instruction following this call instruction.
+    //
+    BasicBlock::iterator I = CI;
+    CallInst * ICI;
+    do {
+      ++I;
+      assert (!isa<TerminatorInst>(I));
+    } while ((ICI = dyn_cast<CallInst>(I)) == 0);
 
-        //
-        // Install the new target list into the check.
-        //
-        NewTable = castTo (NewTable, VoidPtrType, ICI);
-        CI->setArgOperand (1, NewTable);
+    //
+    // Get the list of potential function targets.  Note that we have to do
+    // some silly things to get rid of the "const"-ness of the functions that
+    // we find.  The call graph may report a target more than once.
+    //
+    std::vector<const Function *> Targets;
+    getFunctionTargets (ICI, Targets);
+    std::vector<Function *> GoodTargets;
+    SmallPtrSet<const Function *, 16> Seen;
+    for (unsigned target = 0; target < Targets.size(); ++target) {
+      if (Seen.insert (Targets[target]).second)
+        GoodTargets.push_back (M.getFunction (Targets[target]->getName()));
+    }
+
+    //
+    // A check with no targets always fails; leave it searching an empty list.
+    // A check with a few targets searches a list only once the inline
+    // compares have failed.  A linear search of a list is still faster than
+    // a binary search of a set below about 64 targets (see debugbench).
+    //
+    if (GoodTargets.size() < SetFuncCheckLimit) {
+      Value * NewTable = createTargetList (M, GoodTargets);
+      NewTable = castTo (NewTable, VoidPtrType, ICI);
+      CI->setArgOperand (1, NewTable);
+      if (GoodTargets.size() && GoodTargets.size() <= InlineFuncCheckLimit) {
+        inlineTargetCompares (CI, GoodTargets);
+        ++InlinedFuncChecks;
       }
+      continue;
     }
+
+    //
+    // Replace the check with one that searches a sorted set of the targets.
+    // The version that takes a set has the same type as the one that takes a
+    // list.
+    //
+    Constant * SetCheck = M.getOrInsertFunction (setName,
+                                                 FuncCheck->getFunctionType());
+    std::vector<Value *> Args;
+    Args.push_back (CI->getArgOperand (0));
+    Args.push_back (castTo (createTargetSet (M, GoodTargets), VoidPtrType, CI));
+    for (unsigned arg = 2; arg < CI->getNumArgOperands(); ++arg)
+      Args.push_back (CI->getArgOperand (arg));
+    CallInst * NewCI = CallInst::Create (SetCheck, Args, "", CI);
+    NewCI->setDebugLoc (CI->getDebugLoc());
+    CI->eraseFromParent();
+    ++SetFuncChecks;
   }
 
   return;
@@ -668,8 +859,8 @@ CompleteChecks::runOnModule (Module & M) {
   //
   // Fixup the targets of indirect function calls.
   //
-  fixupCFIChecks(M, "funccheck");
-  fixupCFIChecks(M, "funccheck_debug");
+  fixupCFIChecks(M, "funccheck", "funccheck_set");
+  fixupCFIChecks(M, "funccheck_debug", "funccheck_set_debug");
   return true;
 }
 
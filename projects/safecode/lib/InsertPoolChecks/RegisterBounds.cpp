@@ -55,12 +55,18 @@ X4 ("reg-byval-args", "Register byval arguments for functions", true);
 // Method: registerGV()
 //
 // Description:
-//  This method adds code into a program to register a global variable into its
-//  pool.
+//  This method adds an entry for a global variable to the table of globals
+//  that are registered into their pools when the program starts.
+//
+// Inputs:
+//  GV      - The global variable to register.
+//
+// Outputs:
+//  Entries - The entry for the global variable is appended to this list.
 //
 void
 RegisterGlobalVariables::registerGV (GlobalVariable * GV,
-                                     Instruction * InsertBefore) {
+                                     std::vector<Constant *> & Entries) {
   //
   // Do not register the global variable if it has opaque type.  This is
   // because we cannot determine the size of an opaque type.
@@ -71,9 +77,15 @@ RegisterGlobalVariables::registerGV (GlobalVariable * GV,
       return;
 
   //
-  // Get the pool into which the global should be registered.
+  // Get the pool into which the global should be registered.  SAFECode does
+  // not assign globals to pools, so the pool is null and the run-time puts
+  // the global into its set of external objects, which every check searches
+  // when the object is not in the check's pool.  This is where the globals
+  // went when each was registered with its own call.  The field is kept so
+  // that a pass that assigns pools can fill it in.
   //
-  Value * PH = ConstantPointerNull::get (getVoidPtrType(GV->getContext()));
+  PointerType * VoidPtrType = getVoidPtrType(GV->getContext());
+  Constant * PH = ConstantPointerNull::get (VoidPtrType);
   Type* csiType = IntegerType::getInt32Ty(GV->getContext());
   unsigned TypeSize = TD->getTypeAllocSize((GlobalType));
   if (!TypeSize) {
@@ -81,26 +93,56 @@ RegisterGlobalVariables::registerGV (GlobalVariable * GV,
     GV->dump();
     return;
   }
-  Value * AllocSize = ConstantInt::get (csiType, TypeSize);
-  RegisterVariableIntoPool(PH, GV, AllocSize, InsertBefore);
+
+  //
+  // Create the entry.  Its layout must match GlobalTableEntry in the
+  // run-time.
+  //
+  Constant * Fields[] = {
+    PH,
+    ConstantExpr::getPointerCast (GV, VoidPtrType),
+    ConstantInt::get (csiType, TypeSize)
+  };
+  Entries.push_back (ConstantStruct::get (EntryType, Fields));
 
   // Update statistics
   ++RegisteredGVs;
 }
 
+//
+// Method: runOnModule()
+//
+// Description:
+//  Entry point for this pass.  Build a constant table of the global variables
+//  of the module and make sc.register_globals() pass the whole table to the
+//  run-time with a single call to pool_register_globals().  The run-time can
+//  then sort the table once instead of inserting the globals one at a time.
+//
 bool
 RegisterGlobalVariables::runOnModule(Module & M) {
-  init(M, "pool_register_global");
-
   //
   // Get required analysis passes.
   //
   TD       = &M.getDataLayout();
 
+  //
+  // Create the type of the table entries and the function that registers the
+  // table.
+  //
+  LLVMContext & Context = M.getContext();
+  Type * VoidTy = Type::getVoidTy (Context);
+  Type * Int32Type = IntegerType::getInt32Ty(Context);
+  PointerType * VoidPtrType = getVoidPtrType(Context);
+  EntryType = StructType::get (VoidPtrType, VoidPtrType, Int32Type, NULL);
+  Constant * RegisterTable = M.getOrInsertFunction ("pool_register_globals",
+                                                    VoidTy,
+                                                    VoidPtrType,
+                                                    Int32Type,
+                                                    NULL);
+
   //
   // Create a skeleton function that will register the global variables.
   //
-  Type * VoidTy = Type::getVoidTy (M.getContext());
   Constant * CF = M.getOrInsertFunction ("sc.register_globals", VoidTy, NULL);
   Function * F = dyn_cast<Function>(CF);
 
@@ -122,6 +164,7 @@ RegisterGlobalVariables::runOnModule(Module & M) {
   // within the program.  This transform must ensure, then, that it is
   // never used, even if such a use would otherwise be innocuous.
   //
+  std::vector<Constant *> Entries;
   Module::global_iterator GI = M.global_begin(), GE = M.global_end();
   for ( ; GI != GE; ++GI) {
     GlobalVariable *GV = dyn_cast<GlobalVariable>(GI);
@@ -134,6 +177,7 @@ RegisterGlobalVariables::runOnModule(Module & M) {
 
     // Skip globals in special sections
     if (!strcmp((GV->getSection()), "llvm.metadata")) continue;
+    if (!strcmp(GV->getSection(), getGlobalTableSection (M))) continue;
 
     if (strncmp(name.c_str(), "llvm.", 5) == 0) continue;
     if (strncmp(name.c_str(), "__poolalloc", 11) == 0) continue;
@@ -146,9 +190,29 @@ RegisterGlobalVariables::runOnModule(Module & M) {
     // Skip globals that may not be emitted into the final executable.
     //
     if (GV->hasAvailableExternallyLinkage()) continue;
-    registerGV(GV, InsertPt);    
+    registerGV(GV, Entries);
   }
 
+  if (Entries.empty())
+    return true;
+
+  //
+  // Create the table in its own section and register it.
+  //
+  ArrayType * AT = ArrayType::get (EntryType, Entries.size());
+  GlobalVariable * Table = new GlobalVariable (M,
+                                               AT,
+                                               true,
+                                               GlobalValue::InternalLinkage,
+                                               ConstantArray::get (AT, Entries),
+                                               "sc.registered_globals");
+  Table->setSection (getGlobalTableSection (M));
+
+  Value * args[] = {
+    ConstantExpr::getPointerCast (Table, VoidPtrType),
+    ConstantInt::get (Int32Type, Entries.size())
+  };
+  CallInst::Create (RegisterTable, args, "", InsertPt);
   return true;
 }
 
@@ -17,6 +17,7 @@
 #include "llvm/ADT/Statistic.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/Instruction.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Transforms/Utils/PromoteMemToReg.h"
 
@@ -287,97 +288,81 @@ RegisterStackObjPass::registerAllocaInst (AllocaInst *AI) {
   //
   // Determine if any use (direct or indirect) escapes this function.  If
   // not, then none of the checks will consult the MetaPool, and we can
-  // forego registering the alloca.
+  // forego registering the alloca.  Note that the run-time checks which
+  // search for the object are calls that take the pointer as an argument, so
+  // any such check forces the alloca to be registered.
   //
-#if 0
   bool MustRegisterAlloca = false;
-#else
-  //
-  // FIXME: For now, register all allocas.  The reason is that this
-  // optimization requires that other optimizations be executed, and those are
-  // not integrated into LLVM yet.
-  //
-  bool MustRegisterAlloca = true;
-#endif
   std::vector<Value *> AllocaWorkList;
   AllocaWorkList.push_back (AI);
   while ((!MustRegisterAlloca) && (AllocaWorkList.size())) {
     Value * V = AllocaWorkList.back();
     AllocaWorkList.pop_back();
-    Value::use_iterator UI = V->use_begin();
-    for (; UI != V->use_end(); ++UI) {
-      // We cannot handle PHI nodes or Select instructions
-      if (isa<PHINode>(*UI) || isa<SelectInst>(*UI)) {
-        MustRegisterAlloca = true;
+    Value::user_iterator UI = V->user_begin();
+    for (; (!MustRegisterAlloca) && (UI != V->user_end()); ++UI) {
+      User * U = *UI;
+
+      // Loading from the pointer or comparing it does not let it escape
+      if (isa<LoadInst>(U) || isa<ICmpInst>(U))
         continue;
-      }
 
       // The pointer escapes if it's stored to memory somewhere.
-      StoreInst * SI;
-      if ((SI = dyn_cast<StoreInst>(*UI)) && (SI->getOperand(0) == V)) {
-        MustRegisterAlloca = true;
+      if (StoreInst * SI = dyn_cast<StoreInst>(U)) {
+        if (SI->getOperand(0) == V)
+          MustRegisterAlloca = true;
         continue;
       }
 
-      // GEP instructions are okay, but need to be added to the worklist
-      if (isa<GetElementPtrInst>(*UI)) {
-        AllocaWorkList.push_back (*UI);
+      // GEP instructions and pointer casts are okay, but need to be added to
+      // the worklist
+      if (isa<GetElementPtrInst>(U) || isa<BitCastInst>(U)) {
+        AllocaWorkList.push_back (U);
         continue;
       }
 
-      // Cast instructions are okay as long as they cast to another pointer
-      // type
-      if (CastInst * CI = dyn_cast<CastInst>(*UI)) {
-        if (isa<PointerType>(CI->getType())) {
-          AllocaWorkList.push_back (*UI);
-          continue;
-        } else {
-          MustRegisterAlloca = true;
-          continue;
+      // Memory intrinsics and lifetime markers only access the object
+      if (IntrinsicInst * II = dyn_cast<IntrinsicInst>(U)) {
+        switch (II->getIntrinsicID()) {
+          case Intrinsic::memcpy:
+          case Intrinsic::memmove:
+          case Intrinsic::memset:
+          case Intrinsic::lifetime_start:
+          case Intrinsic::lifetime_end:
+            continue;
+          default:
+            MustRegisterAlloca = true;
+            continue;
         }
       }
 
-#if 0
-      if (ConstantExpr *cExpr = dyn_cast<ConstantExpr>(*UI)) {
-        if (cExpr->getOpcode() == Instruction::Cast) {
-          AllocaWorkList.push_back (*UI);
-          continue;
-        } else {
-          MustRegisterAlloca = true;
-          continue;
-        }
+      CallInst * CI1 = dyn_cast<CallInst>(U);
+      if ((!CI1) || (!(CI1->getCalledFunction()))) {
+        MustRegisterAlloca = true;
+        continue;
       }
-#endif
-
-      CallInst * CI1;
-      if ((CI1 = dyn_cast<CallInst>(*UI))) {
-        if (!(CI1->getCalledFunction())) {
-          MustRegisterAlloca = true;
-          continue;
-        }
 
-        std::string FuncName = CI1->getCalledFunction()->getName();
-        if (FuncName == "exactcheck3") {
-          AllocaWorkList.push_back (*UI);
-          continue;
-        } else if ((FuncName == "llvm.memcpy.i32")    || 
-                   (FuncName == "llvm.memcpy.i64")    ||
-                   (FuncName == "llvm.memset.i32")    ||
-                   (FuncName == "llvm.memset.i64")    ||
-                   (FuncName == "llvm.memmove.i32")   ||
-                   (FuncName == "llvm.memmove.i64")   ||
-                   (FuncName == "llva_memcpy")        ||
-                   (FuncName == "llva_memset")        ||
-                   (FuncName == "llva_strncpy")       ||
-                   (FuncName == "llva_invokememcpy")  ||
-                   (FuncName == "llva_invokestrncpy") ||
-                   (FuncName == "llva_invokememset")  ||
-                   (FuncName == "memcmp")) {
-          continue;
-        } else {
-          MustRegisterAlloca = true;
-          continue;
-        }
+      //
+      // Exact checks are given the bounds of the object, so they do not need
+      // it to be registered.  Calls other than the known ones may let the
+      // pointer escape.
+      //
+      std::string FuncName = CI1->getCalledFunction()->getName();
+      if ((FuncName == "exactcheck2") ||
+          (FuncName == "exactcheck2_debug") ||
+          (FuncName == "exactcheck3")) {
+        AllocaWorkList.push_back (CI1);
+      } else if ((FuncName == "fastlscheck")        ||
+                 (FuncName == "fastlscheck_debug")  ||
+                 (FuncName == "llva_memcpy")        ||
+                 (FuncName == "llva_memset")        ||
+                 (FuncName == "llva_strncpy")       ||
+                 (FuncName == "llva_invokememcpy")  ||
+                 (FuncName == "llva_invokestrncpy") ||
+                 (FuncName == "llva_invokememset")  ||
+                 (FuncName == "memcmp")) {
+        continue;
+      } else {
+        MustRegisterAlloca = true;
       }
     }
   }
@@ -0,0 +1,238 @@
+//===- CheckProfile.cpp - Estimate the execution counts of checks ---------===//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements an analysis that estimates how often each basic block
+// is executed from an LLVM instrumentation profile and a pass that reports the
+// estimated number of run-time checks executed by the program.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "sc-profile"
+
+#include "safecode/CheckProfile.h"
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/ProfileData/InstrProfReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+
+namespace llvm {
+
+char CheckProfile::ID = 0;
+char DynamicCheckReport::ID = 0;
+
+static RegisterPass<CheckProfile>
+X ("sc-check-profile", "Estimate the execution counts of SAFECode checks",
+   false, true);
+
+static RegisterPass<DynamicCheckReport>
+Y ("sc-check-report", "Report the estimated number of executed checks",
+   false, true);
+
+static cl::opt<std::string>
+ProfileFile ("sc-profile",
+             cl::desc("Instrumentation profile used to place checks"),
+             cl::value_desc("filename"),
+             cl::init(""));
+
+static cl::opt<double>
+HotThreshold ("sc-hot-threshold",
+              cl::desc("Percentage of the highest block count above which "
+                       "a block is hot"),
+              cl::init(1.0));
+
+void
+CheckProfile::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<BlockFrequencyInfo>();
+  AU.setPreservesAll();
+}
+
+//
+// Method: readProfile()
+//
+// Description:
+//  Read the function counts from the profile file given on the command line.
+//  The first counter of each function counts the calls of the function.  The
+//  front end prefixes the names of static functions with their file name, so
+//  these functions are also recorded under their plain name unless another
+//  function already has it.
+//
+void
+CheckProfile::readProfile (void) {
+  ErrorOr<std::unique_ptr<InstrProfReader>> ReaderOrErr =
+    InstrProfReader::create (ProfileFile);
+  if (std::error_code EC = ReaderOrErr.getError()) {
+    errs() << "SAFECode: cannot read profile " << ProfileFile << ": "
+           << EC.message() << "\n";
+    return;
+  }
+
+  InstrProfReader & Reader = *(ReaderOrErr.get());
+  for (InstrProfIterator I = Reader.begin(), E = Reader.end(); I != E; ++I) {
+    if (I->Counts.empty())
+      continue;
+
+    StringRef Name = I->Name;
+    EntryCounts[Name] += I->Counts[0];
+
+    size_t colon = Name.rfind (':');
+    if (colon != StringRef::npos) {
+      StringRef PlainName = Name.substr (colon + 1);
+      if (!EntryCounts.count (PlainName))
+        EntryCounts[PlainName] = I->Counts[0];
+    }
+  }
+
+  if (Reader.hasError()) {
+    errs() << "SAFECode: error reading profile " << ProfileFile << ": "
+           << Reader.getError().message() << "\n";
+  }
+
+  return;
+}
+
+//
+// Method: getEntryCount()
+//
+// Description:
+//  Find the number of times that the specified function is called.
+//
+// Outputs:
+//  Count - The number of calls of the function.
+//
+// Return value:
+//  true  - The count comes from a profile.
+//  false - There is no profile for the function; Count is set to one.
+//
+bool
+CheckProfile::getEntryCount (const Function & F, double & Count) {
+  Optional<uint64_t> EntryCount = F.getEntryCount();
+  if (EntryCount.hasValue()) {
+    Count = EntryCount.getValue();
+    return true;
+  }
+
+  StringMap<uint64_t>::iterator I = EntryCounts.find (F.getName());
+  if (I != EntryCounts.end()) {
+    Count = I->second;
+    return true;
+  }
+
+  Count = 1;
+  return false;
+}
+
+bool
+CheckProfile::runOnModule (Module & M) {
+  //
+  // Read the profile the first time that the analysis is run; the counts of
+  // the basic blocks are recomputed whenever the code has changed.
+  //
+  if (!ProfileFile.empty() && EntryCounts.empty())
+    readProfile();
+
+  Counts.clear();
+  MaxCount = 0;
+  Profiled = false;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (F->isDeclaration())
+      continue;
+
+    double EntryCount;
+    Profiled |= getEntryCount (*F, EntryCount);
+
+    BlockFrequencyInfo & BFI = getAnalysis<BlockFrequencyInfo>(*F);
+    double EntryFreq = BFI.getEntryFreq();
+    if (EntryFreq == 0)
+      EntryFreq = 1;
+
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB) {
+      double Count = EntryCount * BFI.getBlockFreq(BB).getFrequency() /
+                     EntryFreq;
+      Counts[BB] = Count;
+      if (Count > MaxCount)
+        MaxCount = Count;
+    }
+  }
+
+  return false;
+}
+
+//
+// Method: isHot()
+//
+// Description:
+//  Determine whether the specified basic block is executed at least the
+//  percentage of the highest block count given by -sc-hot-threshold.
+//
+bool
+CheckProfile::isHot (const BasicBlock * BB) const {
+  double Count = getCount (BB);
+  return (Count > 0) && (Count * 100 >= MaxCount * HotThreshold);
+}
+
+bool
+DynamicCheckReport::runOnModule (Module & M) {
+  CheckProfile & Profile = getAnalysis<CheckProfile>();
+
+  //
+  // Count the checks of each kind and the number of times they are executed.
+  //
+  std::map<std::string, std::pair<unsigned, double> > Checks;
+  unsigned StaticTotal = 0;
+  double DynamicTotal = 0;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    for (inst_iterator I = inst_begin (*F), IE = inst_end (*F); I != IE; ++I) {
+      CallInst * CI = dyn_cast<CallInst>(&*I);
+      if (!CI)
+        continue;
+
+      Function * Callee = CI->getCalledFunction();
+      if (!Callee)
+        continue;
+
+      if (const CheckInfo * Info = findRuntimeCheck (Callee)) {
+        double Count = Profile.getCount (CI->getParent());
+        std::pair<unsigned, double> & Entry = Checks[Info->name];
+        ++(Entry.first);
+        Entry.second += Count;
+        ++StaticTotal;
+        DynamicTotal += Count;
+      }
+    }
+  }
+
+  //
+  // Print the report in the format of the LLVM statistics.
+  //
+  raw_ostream & OS = errs();
+  OS << "===" << std::string(73, '-') << "===\n"
+     << "  SAFECode estimated check executions";
+  if (*Label)
+    OS << " (" << Label << ")";
+  if (!Profile.hasProfile())
+    OS << " per call, no profile";
+  OS << "\n===" << std::string(73, '-') << "===\n\n";
+
+  std::map<std::string, std::pair<unsigned, double> >::iterator I;
+  for (I = Checks.begin(); I != Checks.end(); ++I) {
+    OS << format ("%8u %16.0f - ", I->second.first, I->second.second)
+       << I->first << "\n";
+  }
+  OS << format ("%8u %16.0f - ", StaticTotal, DynamicTotal) << "total\n\n";
+  OS.flush();
+  return false;
+}
+
+}
@@ -7,7 +7,8 @@
 // 
 //===----------------------------------------------------------------------===//
 //
-//  This pass eliminates unnessary pool_register_global() calls in the code.
+//  This pass eliminates unnessary pool_register_global() calls and entries of
+//  the tables passed to pool_register_globals() in the code.
 //
 //===----------------------------------------------------------------------===//
 
@@ -136,14 +137,118 @@ removeUnusedRegistrations (Function * F, std::set<Value *> & SafeValues) {
   return;
 }
 
+//
+// Method: pruneGlobalTables()
+//
+// Description:
+//  Remove the entries for pointers that are never checked from the tables of
+//  globals that are registered with pool_register_globals().  Each pruned
+//  table is replaced with a smaller one, and the calls that register it are
+//  updated with its new size or removed if the table became empty.
+//
+// Inputs:
+//  M          - The module containing the tables.
+//  SafeValues - The set of values that are never checked.
+//
+static void
+pruneGlobalTables (Module & M, std::set<Value *> & SafeValues) {
+  Function * RegisterTable = M.getFunction ("pool_register_globals");
+  if (!RegisterTable)
+    return;
+
+  //
+  // Find the calls that register tables.  Pruning a table replaces it, so
+  // find them all before changing any of them.
+  //
+  std::vector<CallInst *> Calls;
+  for (Value::user_iterator UI = RegisterTable->user_begin(),
+                            UE = RegisterTable->user_end();
+       UI != UE;
+       ++UI) {
+    CallInst * CI = dyn_cast<CallInst>(*UI);
+    if (CI && (CI->getCalledValue() == RegisterTable))
+      Calls.push_back (CI);
+  }
+
+  for (unsigned index = 0; index < Calls.size(); ++index) {
+    CallInst * CI = Calls[index];
+    Value * TableArg = CI->getArgOperand (0)->stripPointerCasts();
+    GlobalVariable * Table = dyn_cast<GlobalVariable>(TableArg);
+    if (!Table || !Table->hasInitializer())
+      continue;
+    ConstantArray * Entries = dyn_cast<ConstantArray>(Table->getInitializer());
+    if (!Entries)
+      continue;
+
+    //
+    // Keep the entries of the globals that may be checked.
+    //
+    std::vector<Constant *> Kept;
+    for (unsigned entry = 0; entry < Entries->getNumOperands(); ++entry) {
+      Constant * Entry = Entries->getOperand (entry);
+      if (!isSafeToRemove (Entry->getOperand (1), SafeValues))
+        Kept.push_back (Entry);
+    }
+
+    unsigned Removed = Entries->getNumOperands() - Kept.size();
+    if (!Removed)
+      continue;
+    RemovedRegistration += Removed;
+
+    //
+    // If no entries remain, the table does not need to be registered at all.
+    //
+    if (Kept.empty()) {
+      CI->eraseFromParent();
+      continue;
+    }
+
+    //
+    // Create the smaller table and register it instead.
+    //
+    ArrayType * AT = ArrayType::get (Entries->getType()->getElementType(),
+                                     Kept.size());
+    GlobalVariable * NewTable = new GlobalVariable (M,
+                                                    AT,
+                                                    true,
+                                                    Table->getLinkage(),
+                                                    ConstantArray::get (AT,
+                                                                        Kept),
+                                                    Table->getName());
+    NewTable->setSection (Table->getSection());
+    Type * ArgType = CI->getArgOperand (0)->getType();
+    Type * SizeType = CI->getArgOperand (1)->getType();
+    CI->setArgOperand (0, ConstantExpr::getPointerCast (NewTable, ArgType));
+    CI->setArgOperand (1, ConstantInt::get (SizeType, Kept.size()));
+  }
+
+  //
+  // Remove the tables that are no longer registered.
+  //
+  std::vector<GlobalVariable *> DeadTables;
+  for (Module::global_iterator GV = M.global_begin();
+       GV != M.global_end();
+       ++GV) {
+    GV->removeDeadConstantUsers();
+    if (GV->use_empty() && GV->hasLocalLinkage() &&
+        StringRef (GV->getSection()).endswith (DSA_GLOBAL_TABLE_SECTION))
+      DeadTables.push_back (GV);
+  }
+  for (unsigned index = 0; index < DeadTables.size(); ++index)
+    DeadTables[index]->eraseFromParent();
+
+  return;
+}
+
 namespace llvm {
 
 //
 // Method: runOnModule()
 //
 // Description:
-//  Entry point for this pass.  Find calls to pool_register_global() that are
-//  unneeded and eliminate them.
+//  Entry point for this pass.  Find calls to pool_register_global() and
+//  entries of tables of registered globals that are unneeded and eliminate
+//  them.
 //
 bool
 GlobalRegisterOpt::runOnModule(Module & M) {
@@ -153,8 +258,9 @@ GlobalRegisterOpt::runOnModule(Module & M) {
   //
   Function * RegisterGlobal      = M.getFunction ("pool_register_global");
   Function * RegisterGlobalDebug = M.getFunction ("pool_register_global_debug");
+  Function * RegisterTable       = M.getFunction ("pool_register_globals");
 
-  if (!RegisterGlobal && !RegisterGlobalDebug)
+  if (!RegisterGlobal && !RegisterGlobalDebug && !RegisterTable)
     return false;
 
   //
@@ -168,6 +274,7 @@ GlobalRegisterOpt::runOnModule(Module & M) {
   //
   removeUnusedRegistrations (RegisterGlobal, SafeGlobals);
   removeUnusedRegistrations (RegisterGlobalDebug, SafeGlobals);
+  pruneGlobalTables (M, SafeGlobals);
 
   return true;
 }
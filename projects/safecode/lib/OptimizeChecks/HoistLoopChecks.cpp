@@ -0,0 +1,417 @@
+//===- HoistLoopChecks.cpp - Hoist SAFECode checks out of loops -----------===//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass replaces run-time checks inside of loops with checks of the whole
+// range of pointers that they would check.  A check is hoisted out of a loop
+// if:
+//
+//  o The loop has a preheader, a single exiting block, and a backedge-taken
+//    count that scalar evolution can compute (possibly as an expression that
+//    is only known at run-time).
+//
+//  o The check is performed on every iteration of the loop, i.e., it
+//    dominates the exiting block, and the loop contains no calls that may
+//    free memory or leave the loop other than through the exiting block.
+//
+//  o The checked pointer is an affine function of the loop's induction
+//    variable and all other arguments of the check are loop invariant.
+//
+//  o The result of the check is not used (i.e., the pass runs before the
+//    pointers are rewritten to use the results of bounds checks).
+//
+// Since the checked pointers advance by a fixed stride, the pointers checked
+// on all iterations lie within one object if the first and the last do.  A
+// bounds check is therefore replaced with checks of the first and the last
+// pointer, and a load/store check is replaced with one check whose length
+// covers every byte accessed by the loop.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "sc-hoist"
+
+#include "safecode/HoistLoopChecks.h"
+
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+
+#include <vector>
+
+namespace {
+  STATISTIC (ChecksHoisted, "Number of checks inserted into loop preheaders");
+  STATISTIC (ChecksRemoved, "Number of checks removed from loops");
+  STATISTIC (LoopNests,     "Number of loop nests with hoisted checks");
+}
+
+namespace llvm {
+
+char HoistLoopChecks::ID = 0;
+
+static RegisterPass<HoistLoopChecks>
+X ("sc-hoist-loop-checks", "Hoist SAFECode run-time checks out of loops");
+
+//
+// Method: isEligibleLoop()
+//
+// Description:
+//  Determine whether checks can be hoisted out of the specified loop.
+//
+// Return value:
+//  true  - The loop has the structure required by this pass and nothing in
+//          it can invalidate a memory object or end the loop early.
+//  false - No checks may be hoisted out of the loop.
+//
+bool
+HoistLoopChecks::isEligibleLoop (Loop * L) {
+  //
+  // The new checks are placed in the preheader, and the last iteration of the
+  // loop must leave through the single exiting block.
+  //
+  if (!(L->getLoopPreheader()) || !(L->getExitingBlock()))
+    return false;
+
+  //
+  // Scalar evolution must know how often the loop iterates, although the
+  // iteration count does not have to be a constant.
+  //
+  if (!(SE->hasLoopInvariantBackedgeTakenCount (L)))
+    return false;
+
+  //
+  // Scan the loop (including its subloops) for calls.  Calls to run-time
+  // checks and intrinsics cannot free memory; neither can functions that do
+  // not write memory.  Anything else could free the checked object or exit
+  // the program before the pointers checked in the preheader are used.
+  //
+  for (Loop::block_iterator I = L->block_begin(), E = L->block_end();
+       I != E; ++I) {
+    for (BasicBlock::iterator BI = (*I)->begin(), BE = (*I)->end();
+         BI != BE; ++BI) {
+      if (isa<InvokeInst>(BI))
+        return false;
+
+      CallInst * CI = dyn_cast<CallInst>(BI);
+      if (!CI || isa<IntrinsicInst>(CI))
+        continue;
+
+      Value * Callee = CI->getCalledValue()->stripPointerCasts();
+      Function * F = dyn_cast<Function>(Callee);
+      if (F && isRuntimeCheck (F))
+        continue;
+      if (CI->onlyReadsMemory() && CI->doesNotThrow())
+        continue;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//
+// Method: getAffinePointer()
+//
+// Description:
+//  Determine whether the pointer is an affine function of the loop's
+//  induction variable that does not wrap around the address space.
+//
+// Return value:
+//  0 - The pointer is not such a function.
+//  Otherwise, the scalar evolution expression of the pointer is returned.
+//
+const SCEVAddRecExpr *
+HoistLoopChecks::getAffinePointer (Loop * L, Value * Ptr) {
+  if (!(SE->isSCEVable (Ptr->getType())))
+    return 0;
+
+  const SCEVAddRecExpr * AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV (Ptr));
+  if (!AR || (AR->getLoop() != L) || !(AR->isAffine()))
+    return 0;
+
+  if (!(AR->getNoWrapFlags (SCEV::NoWrapMask)))
+    return 0;
+
+  return AR;
+}
+
+//
+// Method: hasInvariantOperands()
+//
+// Description:
+//  Determine whether all arguments of the check except for the specified one
+//  are invariant in the loop.
+//
+bool
+HoistLoopChecks::hasInvariantOperands (Loop * L, CallInst * CI,
+                                       unsigned except) {
+  for (unsigned index = 0; index < CI->getNumArgOperands(); ++index) {
+    if (index == except)
+      continue;
+    if (!(L->isLoopInvariant (CI->getArgOperand (index))))
+      return false;
+  }
+
+  return true;
+}
+
+//
+// Method: hoistGEPCheck()
+//
+// Description:
+//  Replace a bounds check inside of the loop with bounds checks of the first
+//  and last pointers it would check.  Both are checked against the same
+//  source pointer, so every pointer in between is within the same object.
+//
+void
+HoistLoopChecks::hoistGEPCheck (Loop * L, CallInst * CI,
+                                const CheckInfo * Info,
+                                const SCEV * First, const SCEV * Last,
+                                SCEVExpander & Rewriter, unsigned & Hoisted) {
+  Instruction * InsertPt = L->getLoopPreheader()->getTerminator();
+  Type * PtrType = Info->getCheckedPointer (CI)->getType();
+
+  const SCEV * Bounds[2] = {First, Last};
+  unsigned Count = (First == Last) ? 1 : 2;
+  for (unsigned index = 0; index < Count; ++index) {
+    Value * Ptr = Rewriter.expandCodeFor (Bounds[index], PtrType, InsertPt);
+    CallInst * NewCheck = cast<CallInst>(CI->clone());
+    NewCheck->setArgOperand (Info->argno, Ptr);
+    NewCheck->insertBefore (InsertPt);
+    ++Hoisted;
+  }
+}
+
+//
+// Method: hoistMemCheck()
+//
+// Description:
+//  Replace a load/store check inside of the loop with one check of all the
+//  bytes that the loop accesses.  The length of the new check is the distance
+//  between the lowest and highest pointers plus the length of one access.
+//  The run-time describes object sizes with the type of the length argument,
+//  so a length too large for that type is replaced by the largest length.
+//
+void
+HoistLoopChecks::hoistMemCheck (Loop * L, CallInst * CI,
+                                const CheckInfo * Info,
+                                const SCEVAddRecExpr * AR, const SCEV * Last,
+                                SCEVExpander & Rewriter, unsigned & Hoisted) {
+  Instruction * InsertPt = L->getLoopPreheader()->getTerminator();
+  Type * PtrType = Info->getCheckedPointer (CI)->getType();
+  Value * Length = Info->getCheckedLength (CI);
+  IntegerType * LengthType = cast<IntegerType>(Length->getType());
+  const DataLayout & DL = InsertPt->getModule()->getDataLayout();
+  IntegerType * IntPtrType = DL.getIntPtrType (CI->getContext());
+
+  //
+  // Find the lowest and highest pointers from the direction of the stride.
+  //
+  const SCEV * Step = AR->getStepRecurrence (*SE);
+  const SCEV * Low = AR->getStart();
+  const SCEV * High = Last;
+  if (SE->isKnownNegative (Step)) {
+    std::swap (Low, High);
+  } else if (!(SE->isKnownNonNegative (Step))) {
+    Low = SE->getUMinExpr (AR->getStart(), Last);
+    High = SE->getUMaxExpr (AR->getStart(), Last);
+  }
+
+  IRBuilder<> Builder (InsertPt);
+  Value * LowPtr = Rewriter.expandCodeFor (Low, PtrType, InsertPt);
+  Value * HighPtr = Rewriter.expandCodeFor (High, PtrType, InsertPt);
+  Value * Span = Builder.CreateSub (Builder.CreatePtrToInt (HighPtr,
+                                                            IntPtrType),
+                                    Builder.CreatePtrToInt (LowPtr,
+                                                            IntPtrType),
+                                    "sc.span");
+  Value * Total = Builder.CreateAdd (Span,
+                                     Builder.CreateZExtOrTrunc (Length,
+                                                                IntPtrType),
+                                     "sc.range");
+  if (LengthType->getBitWidth() < IntPtrType->getBitWidth()) {
+    Constant * Max = ConstantInt::get (IntPtrType, LengthType->getBitMask());
+    Value * TooLarge = Builder.CreateICmpUGT (Total, Max);
+    Total = Builder.CreateSelect (TooLarge, Max, Total);
+  }
+
+  CallInst * NewCheck = cast<CallInst>(CI->clone());
+  NewCheck->setArgOperand (Info->argno, LowPtr);
+  NewCheck->setArgOperand (Info->lenArg,
+                           Builder.CreateZExtOrTrunc (Total, LengthType));
+  NewCheck->insertBefore (InsertPt);
+  ++Hoisted;
+}
+
+//
+// Method: processLoop()
+//
+// Description:
+//  Hoist the checks that are in the specified loop but not in its subloops.
+//
+// Outputs:
+//  Hoisted - Incremented by the number of checks added to the preheader.
+//  Removed - Incremented by the number of checks removed from the loop.
+//
+// Return value:
+//  true  - The loop was modified.
+//  false - The loop was not modified.
+//
+bool
+HoistLoopChecks::processLoop (Loop * L, unsigned & Hoisted,
+                              unsigned & Removed) {
+  if (!isEligibleLoop (L))
+    return false;
+
+  BasicBlock * Exiting = L->getExitingBlock();
+  Instruction * InsertPt = L->getLoopPreheader()->getTerminator();
+  const SCEV * TripCount = SE->getBackedgeTakenCount (L);
+  SCEVExpander Rewriter (*SE, InsertPt->getModule()->getDataLayout(),
+                         "sc.hoist");
+
+  std::vector<CallInst *> toBeRemoved;
+  std::vector<CallInst *> toBeMoved;
+  for (Loop::block_iterator I = L->block_begin(), E = L->block_end();
+       I != E; ++I) {
+    BasicBlock * BB = *I;
+
+    //
+    // Checks in subloops were handled when the subloop was processed.  Checks
+    // that may be skipped on some iterations must stay in the loop.
+    //
+    if ((LI->getLoopFor (BB) != L) || !(DT->dominates (BB, Exiting)))
+      continue;
+
+    for (BasicBlock::iterator BI = BB->begin(), BE = BB->end();
+         BI != BE; ++BI) {
+      CallInst * CI = dyn_cast<CallInst>(BI);
+      if (!CI || !(CI->use_empty()))
+        continue;
+
+      Value * Callee = CI->getCalledValue()->stripPointerCasts();
+      Function * F = dyn_cast<Function>(Callee);
+      if (!F)
+        continue;
+      const CheckInfo * Info = findRuntimeCheck (F);
+      if (!Info)
+        continue;
+
+      //
+      // Only bounds checks and load/store checks with a length are handled.
+      //
+      bool isMemCheck = Info->isMemCheck() && Info->lenArg;
+      if (!isMemCheck && !(Info->isGEPCheck()))
+        continue;
+
+      if (!hasInvariantOperands (L, CI, Info->argno))
+        continue;
+
+      //
+      // A check of a loop invariant pointer can simply be moved.
+      //
+      Value * Ptr = Info->getCheckedPointer (CI);
+      if (L->isLoopInvariant (Ptr)) {
+        toBeMoved.push_back (CI);
+        continue;
+      }
+
+      const SCEVAddRecExpr * AR = getAffinePointer (L, Ptr);
+      if (!AR)
+        continue;
+
+      const SCEV * Last = AR->evaluateAtIteration (TripCount, *SE);
+      if (!isSafeToExpand (AR->getStart(), *SE) || !isSafeToExpand (Last, *SE))
+        continue;
+
+      //
+      // An access of zero bytes is not checked by the run-time, so the check
+      // of the whole range could fail where the original checks would not.
+      //
+      if (isMemCheck) {
+        if (!(SE->isKnownNonZero (SE->getSCEV (Info->getCheckedLength (CI)))))
+          continue;
+        hoistMemCheck (L, CI, Info, AR, Last, Rewriter, Hoisted);
+      } else {
+        hoistGEPCheck (L, CI, Info, AR->getStart(), Last, Rewriter, Hoisted);
+      }
+
+      toBeRemoved.push_back (CI);
+    }
+  }
+
+  for (unsigned index = 0; index < toBeMoved.size(); ++index)
+    toBeMoved[index]->moveBefore (InsertPt);
+  for (unsigned index = 0; index < toBeRemoved.size(); ++index)
+    toBeRemoved[index]->eraseFromParent();
+
+  Hoisted += toBeMoved.size();
+  Removed += toBeMoved.size() + toBeRemoved.size();
+  return !(toBeMoved.empty() && toBeRemoved.empty());
+}
+
+//
+// Method: processLoopNest()
+//
+// Description:
+//  Hoist checks out of the specified loop and all of its subloops, starting
+//  with the innermost loops.  A check hoisted out of a subloop lands in the
+//  subloop's preheader, which is part of the enclosing loop, and so it can
+//  be hoisted again when the enclosing loop is processed.
+//
+bool
+HoistLoopChecks::processLoopNest (Loop * L, unsigned & Hoisted,
+                                  unsigned & Removed) {
+  bool modified = false;
+  for (Loop::iterator I = L->begin(), E = L->end(); I != E; ++I)
+    modified |= processLoopNest (*I, Hoisted, Removed);
+
+  modified |= processLoop (L, Hoisted, Removed);
+  return modified;
+}
+
+//
+// Method: runOnFunction()
+//
+// Description:
+//  Entry point for this LLVM pass.
+//
+bool
+HoistLoopChecks::runOnFunction (Function & F) {
+  //
+  // Get references to required passes.
+  //
+  DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  LI = &getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  SE = &getAnalysis<ScalarEvolution>();
+
+  bool modified = false;
+  for (LoopInfo::iterator I = LI->begin(), E = LI->end(); I != E; ++I) {
+    unsigned Hoisted = 0;
+    unsigned Removed = 0;
+    if (!processLoopNest (*I, Hoisted, Removed))
+      continue;
+
+    //
+    // Record the effect on each loop nest.  A check hoisted out of several
+    // loops of the nest is counted once for each loop.
+    //
+    DEBUG (dbgs() << "sc-hoist: " << F.getName() << ": loop nest at "
+                  << (*I)->getHeader()->getName() << ": "
+                  << Removed << " checks removed, "
+                  << Hoisted << " checks hoisted\n");
+    ChecksHoisted += Hoisted;
+    ChecksRemoved += Removed;
+    ++LoopNests;
+    modified = true;
+  }
+
+  return modified;
+}
+
+}
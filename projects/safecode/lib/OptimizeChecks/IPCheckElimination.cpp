@@ -0,0 +1,621 @@
+//===- IPCheckElimination.cpp - Interprocedural check elimination ---------===//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass summarizes the number of bytes that each function accesses through
+// its pointer arguments and removes the checks on arguments for which every
+// caller passes a large enough object.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "sc-ipce"
+
+#include "safecode/IPCheckElimination.h"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include <algorithm>
+
+namespace llvm {
+
+char IPCheckElimination::ID = 0;
+
+static RegisterPass<IPCheckElimination>
+X ("sc-ip-checks", "Remove SAFECode checks on arguments safe at every call");
+
+// Command line options
+static cl::opt<bool>
+SpecializeSafeCallers ("sc-specialize-safe-callers",
+                       cl::desc ("Clone functions without their argument "
+                                 "checks for callers passing large objects"),
+                       cl::init (false));
+
+// Pass Statistics
+namespace {
+  STATISTIC (ChecksRemoved,   "Number of checks on safe arguments removed");
+  STATISTIC (ArgsProvenSafe,  "Number of pointer arguments proven safe");
+  STATISTIC (FunctionsCloned, "Number of functions cloned for safe callers");
+  STATISTIC (CallsRedirected, "Number of calls redirected to safe clones");
+}
+
+// The number of times the summaries of a recursive SCC are recomputed
+static const unsigned MaxSCCRounds = 8;
+
+//
+// Function: removeCheck()
+//
+// Description:
+//  Remove a check.  The result of a bounds check is replaced by the pointer
+//  that it checks.
+//
+static void
+removeCheck (CallInst * CI) {
+  const CheckInfo * Info = findRuntimeCheck (CI->getCalledFunction());
+  if (!(CI->use_empty())) {
+    Value * Dest = Info->getCheckedPointer (CI);
+    if (Dest->getType() != CI->getType())
+      Dest = CastInst::CreatePointerCast (Dest, CI->getType(), "", CI);
+    CI->replaceAllUsesWith (Dest);
+  }
+  CI->eraseFromParent();
+}
+
+//
+// Function: isDirectOnly()
+//
+// Description:
+//  Determine whether every use of a function is as the callee of a direct
+//  call, so that all of the values passed to it are known.
+//
+static bool
+isDirectOnly (Function & F) {
+  for (Value::user_iterator U = F.user_begin(); U != F.user_end(); ++U) {
+    CallInst * CI = dyn_cast<CallInst>(*U);
+    if (!CI || CI->getCalledValue() != &F)
+      return false;
+    for (unsigned arg = 0; arg < CI->getNumArgOperands(); ++arg)
+      if (CI->getArgOperand (arg) == &F)
+        return false;
+  }
+  return true;
+}
+
+//
+// Method: getOffsetRange()
+//
+// Description:
+//  Find the object or argument from which a pointer is derived and the range
+//  of offsets of the pointer from it.
+//
+// Outputs:
+//  Base - The underlying object of the pointer.
+//  Low  - The smallest offset of the pointer from the base.
+//  High - The largest offset of the pointer from the base.
+//
+// Return value:
+//  true  - The offsets are known, not negative, and fit in 32 bits.
+//  false - The offsets are not known.
+//
+bool
+IPCheckElimination::getOffsetRange (ScalarEvolution * SE,
+                                    Value * Ptr,
+                                    Value *& Base,
+                                    uint64_t & Low,
+                                    uint64_t & High) {
+  Base = GetUnderlyingObject (Ptr, *DL, 0);
+  if (!(SE->isSCEVable (Ptr->getType())))
+    return false;
+
+  const SCEV * Offset = SE->getMinusSCEV (SE->getSCEV (Ptr),
+                                          SE->getSCEV (Base));
+  ConstantRange Range = SE->getSignedRange (Offset);
+  if (Range.isFullSet() || Range.getSignedMin().isNegative())
+    return false;
+  APInt Max = Range.getSignedMax();
+  if (Max.getActiveBits() > 32)
+    return false;
+
+  Low = Range.getSignedMin().getZExtValue();
+  High = Max.getZExtValue();
+  return true;
+}
+
+//
+// Method: getStaticObjectSize()
+//
+// Description:
+//  Find the size of a stack object allocated on entry to its function or of
+//  a global variable that cannot be replaced at link time.  Heap objects are
+//  not considered since a callee may free them before it uses them.
+//
+// Return value:
+//  0         - The value is not a known object.
+//  Otherwise - The size of the object in bytes.
+//
+uint64_t
+IPCheckElimination::getStaticObjectSize (Value * V) {
+  if (AllocaInst * AI = dyn_cast<AllocaInst>(V)) {
+    if (!(AI->isStaticAlloca()))
+      return 0;
+    ConstantInt * Count = cast<ConstantInt>(AI->getArraySize());
+    return DL->getTypeAllocSize (AI->getAllocatedType()) *
+           Count->getZExtValue();
+  }
+
+  if (GlobalVariable * GV = dyn_cast<GlobalVariable>(V)) {
+    if (GV->isDeclaration() || GV->mayBeOverridden())
+      return 0;
+    return DL->getTypeAllocSize (GV->getType()->getElementType());
+  }
+
+  return 0;
+}
+
+//
+// Method: findCheck()
+//
+// Description:
+//  Record a load/store or bounds check whose pointers are at known offsets
+//  from an argument of the function, together with the number of bytes from
+//  the argument that the check requires.
+//
+void
+IPCheckElimination::findCheck (CallInst * CI, ScalarEvolution * SE) {
+  const CheckInfo * Info = findRuntimeCheck (CI->getCalledFunction());
+  StringRef Name = Info->completeName;
+  Value * Base;
+  uint64_t Low, High;
+  uint64_t Extent;
+
+  if (Info->isMemCheck()) {
+    if (Name.substr(0, 9) != "poolcheck" || !(Info->lenArg))
+      return;
+    ConstantInt * Len = dyn_cast<ConstantInt>(Info->getCheckedLength (CI));
+    if (!Len || Len->getZExtValue() > UINT32_MAX)
+      return;
+    if (!getOffsetRange (SE, Info->getCheckedPointer (CI), Base, Low, High))
+      return;
+    Extent = High + Len->getZExtValue();
+  } else if (Info->isGEPCheck()) {
+    if (Name.substr(0, 11) != "boundscheck")
+      return;
+    Value * SrcBase;
+    uint64_t SrcLow, SrcHigh;
+    if (!getOffsetRange (SE, Info->getSourcePointer (CI),
+                         SrcBase, SrcLow, SrcHigh))
+      return;
+    if (!getOffsetRange (SE, Info->getCheckedPointer (CI), Base, Low, High))
+      return;
+    if (SrcBase != Base)
+      return;
+    Extent = std::max (SrcHigh, High) + 1;
+  } else {
+    return;
+  }
+
+  //
+  // Only checks on pointers derived from arguments can be removed.
+  //
+  Argument * Arg = dyn_cast<Argument>(Base);
+  if (!Arg || Extent == 0)
+    return;
+
+  ArgCheck Check = {CI, Arg->getArgNo(), Extent};
+  ArgChecks[CI->getParent()->getParent()].push_back (Check);
+}
+
+//
+// Method: findCall()
+//
+// Description:
+//  Record what a direct call of a defined function passes in each of the
+//  function's pointer arguments.
+//
+void
+IPCheckElimination::findCall (CallInst * CI, ScalarEvolution * SE) {
+  Function * Callee = CI->getCalledFunction();
+  CallInfo Info;
+  Info.Call = CI;
+  Info.Caller = CI->getParent()->getParent();
+
+  for (unsigned arg = 0; arg < Callee->arg_size(); ++arg) {
+    Actual A = {Actual::None, 0, 0};
+    Value * V = CI->getArgOperand (arg);
+    Value * Base;
+    uint64_t Low, High;
+    if (V->getType()->isPointerTy() &&
+        getOffsetRange (SE, V, Base, Low, High)) {
+      if (Argument * Formal = dyn_cast<Argument>(Base)) {
+        A.Kind = Actual::Argument;
+        A.Value = Formal->getArgNo();
+        A.Offset = High;
+      } else if (uint64_t Size = getStaticObjectSize (Base)) {
+        if (High < Size) {
+          A.Kind = Actual::Object;
+          A.Value = Size - High;
+        }
+      }
+    }
+    Info.Actuals.push_back (A);
+  }
+
+  unsigned Index = CallInfos.size();
+  CallInfos.push_back (Info);
+  CallsOf[Callee].push_back (Index);
+  CallsFrom[Info.Caller].push_back (Index);
+}
+
+//
+// Method: summarizeFunction()
+//
+// Description:
+//  Record the removable checks of a function, the direct calls that it makes
+//  to defined functions, and the requirements of its own checks.
+//
+void
+IPCheckElimination::summarizeFunction (Function & F, ScalarEvolution * SE) {
+  for (inst_iterator I = inst_begin (F), E = inst_end (F); I != E; ++I) {
+    CallInst * CI = dyn_cast<CallInst>(&*I);
+    if (!CI)
+      continue;
+    Function * Callee = CI->getCalledFunction();
+    if (!Callee)
+      continue;
+    if (isRuntimeCheck (Callee))
+      findCheck (CI, SE);
+    else if (!(Callee->isDeclaration()))
+      findCall (CI, SE);
+  }
+
+  std::vector<uint64_t> & Need = Needs[&F];
+  Need.assign (F.arg_size(), 0);
+  std::vector<ArgCheck> & Checks = ArgChecks[&F];
+  for (unsigned index = 0; index < Checks.size(); ++index)
+    Need[Checks[index].Arg] = std::max (Need[Checks[index].Arg],
+                                        Checks[index].Extent);
+}
+
+//
+// Method: computeNeeds()
+//
+// Description:
+//  Add the requirements of the callees of the functions in an SCC of the call
+//  graph to the requirements of their arguments.  The callees outside of the
+//  SCC have already been summarized.  The summaries of a recursive SCC are
+//  recomputed until they do not change; the arguments whose requirements keep
+//  growing are marked as unknown.
+//
+void
+IPCheckElimination::computeNeeds (const std::vector<Function *> & SCC) {
+  //
+  // Remember the requirements of the functions' own checks.
+  //
+  std::vector<std::vector<uint64_t> > Local;
+  for (unsigned index = 0; index < SCC.size(); ++index)
+    Local.push_back (Needs[SCC[index]]);
+
+  std::vector<bool> Changed (SCC.size(), true);
+  for (unsigned round = 0; round < MaxSCCRounds; ++round) {
+    bool changed = false;
+    for (unsigned index = 0; index < SCC.size(); ++index) {
+      Function * F = SCC[index];
+      std::vector<uint64_t> Need = Local[index];
+      std::vector<unsigned> & Calls = CallsFrom[F];
+      for (unsigned call = 0; call < Calls.size(); ++call) {
+        const CallInfo & Call = CallInfos[Calls[call]];
+        std::vector<uint64_t> & CalleeNeed =
+          Needs[Call.Call->getCalledFunction()];
+        for (unsigned arg = 0; arg < Call.Actuals.size(); ++arg) {
+          const Actual & A = Call.Actuals[arg];
+          if (A.Kind != Actual::Argument || arg >= CalleeNeed.size())
+            continue;
+          uint64_t N = CalleeNeed[arg];
+          if (N == 0 || N == Unknown)
+            continue;
+          uint64_t Total = (N > UINT32_MAX) ? Unknown : A.Offset + N;
+          Need[A.Value] = std::max (Need[A.Value], Total);
+        }
+      }
+
+      Changed[index] = (Need != Needs[F]);
+      changed |= Changed[index];
+      Needs[F] = Need;
+    }
+
+    if (!changed)
+      return;
+  }
+
+  //
+  // The summaries did not converge; give up on the functions that changed in
+  // the last round.
+  //
+  for (unsigned index = 0; index < SCC.size(); ++index)
+    if (Changed[index])
+      Needs[SCC[index]].assign (SCC[index]->arg_size(), Unknown);
+}
+
+//
+// Method: getProvided()
+//
+// Description:
+//  Determine the number of bytes that a call is known to pass in an argument.
+//
+uint64_t
+IPCheckElimination::getProvided (const CallInfo & Call, unsigned Arg) {
+  if (Arg >= Call.Actuals.size())
+    return 0;
+
+  const Actual & A = Call.Actuals[Arg];
+  switch (A.Kind) {
+    case Actual::Object:
+      return A.Value;
+
+    case Actual::Argument: {
+      //
+      // A pointer derived from an argument of the caller is only as large as
+      // the caller's requirement if every call of the caller provides it.
+      //
+      if (!(Safe[Call.Caller][A.Value]))
+        return 0;
+      uint64_t N = Needs[Call.Caller][A.Value];
+      return (N > A.Offset) ? N - A.Offset : 0;
+    }
+
+    default:
+      return 0;
+  }
+}
+
+//
+// Method: computeSafety()
+//
+// Description:
+//  Find the arguments for which every call provides the required number of
+//  bytes.  Safety is assumed for all candidate arguments and withdrawn until
+//  no call fails, so that arguments passed around a recursive cycle can be
+//  proven safe.
+//
+void
+IPCheckElimination::computeSafety (Module & M) {
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (F->isDeclaration())
+      continue;
+
+    std::vector<bool> & S = Safe[F];
+    S.assign (F->arg_size(), false);
+    if (!(F->hasLocalLinkage()) || !(DirectOnly[F]) || CallsOf[F].empty())
+      continue;
+
+    std::vector<uint64_t> & Need = Needs[F];
+    for (unsigned arg = 0; arg < F->arg_size(); ++arg)
+      S[arg] = (Need[arg] != 0) && (Need[arg] != Unknown);
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+      if (F->isDeclaration())
+        continue;
+      std::vector<bool> & S = Safe[F];
+      std::vector<unsigned> & Calls = CallsOf[F];
+      for (unsigned arg = 0; arg < S.size(); ++arg) {
+        if (!S[arg])
+          continue;
+        for (unsigned call = 0; call < Calls.size(); ++call) {
+          if (getProvided (CallInfos[Calls[call]], arg) < Needs[F][arg]) {
+            S[arg] = false;
+            changed = true;
+            break;
+          }
+        }
+      }
+    }
+  }
+}
+
+//
+// Method: removeChecks()
+//
+// Description:
+//  Remove the checks on the arguments proven safe.
+//
+// Return value:
+//  The number of checks removed.
+//
+unsigned
+IPCheckElimination::removeChecks (void) {
+  unsigned removed = 0;
+  for (DenseMap<const Function *, std::vector<bool> >::iterator
+       I = Safe.begin(), E = Safe.end(); I != E; ++I) {
+    for (unsigned arg = 0; arg < I->second.size(); ++arg)
+      if (I->second[arg])
+        ++ArgsProvenSafe;
+
+    std::vector<ArgCheck> & Checks = ArgChecks[I->first];
+    for (unsigned index = 0; index < Checks.size(); ++index) {
+      if (I->second[Checks[index].Arg]) {
+        removeCheck (Checks[index].Check);
+        Checks[index].Check = 0;
+        ++removed;
+      }
+    }
+  }
+
+  ChecksRemoved += removed;
+  return removed;
+}
+
+//
+// Method: specializeFunctions()
+//
+// Description:
+//  Clone each function with unsafe arguments without the checks on them and
+//  call the clone from the call sites that provide the required number of
+//  bytes in all of these arguments.
+//
+// Return value:
+//  The number of checks removed from the clones.
+//
+unsigned
+IPCheckElimination::specializeFunctions (Module & M) {
+  //
+  // Find the functions to clone first since cloning adds to the module.
+  //
+  std::vector<Function *> Functions;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    if (!(F->isDeclaration()) && !(ArgChecks[F].empty()))
+      Functions.push_back (F);
+
+  unsigned removed = 0;
+  for (unsigned index = 0; index < Functions.size(); ++index) {
+    Function * F = Functions[index];
+    std::vector<bool> & S = Safe[F];
+    std::vector<uint64_t> & Need = Needs[F];
+    std::vector<ArgCheck> & Checks = ArgChecks[F];
+
+    //
+    // Find the arguments whose checks remain.
+    //
+    std::vector<bool> Unsafe (F->arg_size(), false);
+    bool hasUnsafe = false;
+    for (unsigned check = 0; check < Checks.size(); ++check) {
+      unsigned arg = Checks[check].Arg;
+      if (Checks[check].Check && !S[arg] && Need[arg] != Unknown) {
+        Unsafe[arg] = true;
+        hasUnsafe = true;
+      }
+    }
+    if (!hasUnsafe)
+      continue;
+
+    //
+    // Find the calls that provide all of these arguments.
+    //
+    std::vector<CallInst *> SafeCalls;
+    std::vector<unsigned> & Calls = CallsOf[F];
+    for (unsigned call = 0; call < Calls.size(); ++call) {
+      const CallInfo & Call = CallInfos[Calls[call]];
+      bool provides = true;
+      for (unsigned arg = 0; provides && arg < Unsafe.size(); ++arg)
+        if (Unsafe[arg] && getProvided (Call, arg) < Need[arg])
+          provides = false;
+      if (provides)
+        SafeCalls.push_back (Call.Call);
+    }
+    if (SafeCalls.empty())
+      continue;
+
+    ValueToValueMapTy VMap;
+    Function * Clone = CloneFunction (F, VMap, false);
+    Clone->setName (F->getName() + ".sc.safe");
+    Clone->setLinkage (GlobalValue::InternalLinkage);
+    M.getFunctionList().push_back (Clone);
+    ++FunctionsCloned;
+
+    for (unsigned check = 0; check < Checks.size(); ++check) {
+      if (Checks[check].Check && Unsafe[Checks[check].Arg]) {
+        removeCheck (cast<CallInst>(VMap[Checks[check].Check]));
+        ++removed;
+      }
+    }
+
+    for (unsigned call = 0; call < SafeCalls.size(); ++call) {
+      SafeCalls[call]->setCalledFunction (Clone);
+      ++CallsRedirected;
+    }
+  }
+
+  ChecksRemoved += removed;
+  return removed;
+}
+
+//
+// Function: addPostOrder()
+//
+// Description:
+//  Add the SCC leaders reachable from an SCC leader to a list so that every
+//  SCC appears after the SCCs that it calls.
+//
+static void
+addPostOrder (const DSCallGraph & CG,
+              const Function * Leader,
+              SmallPtrSet<const Function *, 64> & Visited,
+              std::vector<const Function *> & Order) {
+  if (!(Visited.insert (Leader).second))
+    return;
+  for (DSCallGraph::flat_iterator I = CG.flat_callee_begin (Leader),
+       E = CG.flat_callee_end (Leader); I != E; ++I)
+    addPostOrder (CG, CG.sccLeader (*I), Visited, Order);
+  Order.push_back (Leader);
+}
+
+bool
+IPCheckElimination::runOnModule (Module & M) {
+  DL = &(M.getDataLayout());
+  ArgChecks.clear();
+  CallInfos.clear();
+  CallsOf.clear();
+  CallsFrom.clear();
+  DirectOnly.clear();
+  Needs.clear();
+  Safe.clear();
+
+  const DSCallGraph & CG = getAnalysis<EQTDDataStructures>().getCallGraph();
+
+  //
+  // Order the SCCs of the call graph bottom-up.
+  //
+  SmallPtrSet<const Function *, 64> Visited;
+  std::vector<const Function *> Order;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (F->isDeclaration())
+      continue;
+    DirectOnly[F] = isDirectOnly (*F);
+    addPostOrder (CG, CG.sccLeader (F), Visited, Order);
+  }
+
+  //
+  // Summarize each SCC once all of its callees are summarized.
+  //
+  for (unsigned index = 0; index < Order.size(); ++index) {
+    std::vector<Function *> SCC;
+    for (DSCallGraph::scc_iterator I = CG.scc_begin (Order[index]),
+         E = CG.scc_end (Order[index]); I != E; ++I) {
+      Function * F = const_cast<Function *>(*I);
+      if (!(F->isDeclaration()))
+        SCC.push_back (F);
+    }
+
+    for (unsigned member = 0; member < SCC.size(); ++member)
+      summarizeFunction (*SCC[member],
+                         &getAnalysis<ScalarEvolution>(*SCC[member]));
+    computeNeeds (SCC);
+  }
+
+  computeSafety (M);
+  unsigned removed = removeChecks();
+  if (SpecializeSafeCallers)
+    removed += specializeFunctions (M);
+
+  DEBUG(dbgs() << "sc-ipce: " << ArgsProvenSafe << " safe arguments, "
+               << removed << " checks removed\n");
+  return (removed != 0);
+}
+
+}
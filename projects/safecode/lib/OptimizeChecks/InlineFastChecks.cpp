@@ -10,23 +10,79 @@
 // This pass replaces calls to fastlscheck within inline code to perform the
 // check.  It is designed to provide the advantage of libLTO without libLTO.
 //
+// It can also give each poolcheck() and boundscheck() call a thread-local
+// cache of the last object that it checked and test the checked pointers
+// against the cached object inline; the run-time is only called when the
+// test fails.  The interface with the run-time is defined in
+// runtime/include/SiteCache.h.
+//
 //===----------------------------------------------------------------------===//
 
 #define DEBUG_TYPE "inline-fastchecks"
 
+#include "safecode/Utility.h"
+
 #include "llvm/ADT/Statistic.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Instruction.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 
 #include <vector>
 
 namespace {
   STATISTIC (Inlined, "Number of Fast Checks Inlined");
+  STATISTIC (Cached,  "Number of Checks Given a Site Cache");
+
+  llvm::cl::opt<bool>
+  InlineCachedChecks ("inline-cached-checks",
+                      llvm::cl::desc("Test poolcheck() and boundscheck() "
+                                     "pointers against a per-site object "
+                                     "cache before calling the run-time"),
+                      llvm::cl::init(false));
+
+  //
+  // Structure: CachedCheck
+  //
+  // Description:
+  //  A run-time check that can be given a site cache.  The checks of both the
+  //  debug and the baggy bounds run-times are listed.
+  //
+  struct CachedCheck {
+    // The name of the run-time check
+    const char * name;
+
+    // Whether the check is a bounds check (pool, source, dest)
+    bool isBoundsCheck;
+
+    // The argument of the length of a load/store check; zero if the check
+    // always checks a single byte
+    unsigned char lenArg;
+  };
+
+  const CachedCheck CachedChecks[] = {
+    {"poolcheck",              false, 2},
+    {"poolcheckui",            false, 2},
+    {"poolcheck_debug",        false, 2},
+    {"poolcheckui_debug",      false, 2},
+    {"boundscheck",            true,  0},
+    {"boundscheckui",          true,  0},
+    {"boundscheck_debug",      true,  0},
+    {"boundscheckui_debug",    true,  0},
+    {"bb_poolcheck",           false, 0},
+    {"bb_poolcheckui",         false, 0},
+    {"bb_poolcheck_debug",     false, 2},
+    {"bb_poolcheckui_debug",   false, 2},
+    {"bb_boundscheck",         true,  0},
+    {"bb_boundscheckui",       true,  0},
+    {"bb_boundscheck_debug",   true,  0},
+    {"bb_boundscheckui_debug", true,  0}
+  };
 }
 
 namespace llvm {
@@ -56,6 +112,8 @@ namespace llvm {
      bool createDebugBodyFor (Function * F);
      Value * castToInt (Value * Pointer, BasicBlock * BB);
      Value * addComparisons (BasicBlock *, Value *, Value *, Value *);
+     bool addSiteCaches (Module & M);
+     void addSiteCache (CallInst * CI, const CachedCheck & Check);
   };
 }
 
@@ -482,6 +540,171 @@ llvm::InlineFastChecks::createDebugBodyFor (Function * F) {
   return true;
 }
 
+//
+// Method: addSiteCache()
+//
+// Description:
+//  Give a poolcheck() or boundscheck() call its own object cache.  The code
+//  before the call is changed to:
+//
+//    if (the checked pointers are within the cached object)
+//      result = dest;
+//    else {
+//      result = check (...);
+//      __sc_fill_site_cache (pool, pointer, &cache);
+//    }
+//
+//  The cached object is only used if the check passed the same pool and no
+//  object was unregistered since the object was cached.
+//
+void
+llvm::InlineFastChecks::addSiteCache (CallInst * CI,
+                                      const CachedCheck & Check) {
+  BasicBlock * Head = CI->getParent();
+  Module * M = Head->getModule();
+  LLVMContext & Context = M->getContext();
+  const DataLayout & TD = M->getDataLayout();
+  Type * VoidPtrTy = Type::getInt8PtrTy (Context);
+  Type * IntPtrTy = TD.getIntPtrType (Context);
+
+  //
+  // Create the thread-local cache of the call site.  Its layout must match
+  // the SiteCache structure of the run-times.
+  //
+  StructType * SiteCacheTy = getSiteCacheType (*M);
+  GlobalVariable * SiteCache =
+    new GlobalVariable (*M, SiteCacheTy, false, GlobalValue::InternalLinkage,
+                        ConstantAggregateZero::get (SiteCacheTy),
+                        "sc.sitecache", 0,
+                        GlobalVariable::GeneralDynamicTLSModel);
+
+  //
+  // Split the block so that the call is alone in the block taken on a miss.
+  //
+  BasicBlock * Miss = Head->splitBasicBlock (CI, "cache.miss");
+  BasicBlock * Cont = Miss->splitBasicBlock (++BasicBlock::iterator(CI),
+                                             "cache.cont");
+  Head->getTerminator()->eraseFromParent();
+
+  //
+  // Load the cached object and the current epoch.
+  //
+  IRBuilder<> Builder (Head);
+  Value * Pool = Builder.CreatePointerCast (CI->getArgOperand (0), VoidPtrTy);
+  Value * Fields[4];
+  for (unsigned field = 0; field < 4; ++field) {
+    Value * FieldPtr = Builder.CreateStructGEP (SiteCacheTy, SiteCache, field);
+    Fields[field] = Builder.CreateLoad (FieldPtr);
+  }
+  Value * CachedPool = Fields[0];
+  Value * Lower = Fields[1];
+  Value * Upper = Fields[2];
+  Value * CachedEpoch = Fields[3];
+  Constant * EpochVar = M->getOrInsertGlobal ("__sc_site_cache_epoch",
+                                              IntPtrTy);
+  LoadInst * Epoch = Builder.CreateLoad (EpochVar);
+  Epoch->setAtomic (Monotonic);
+  Epoch->setAlignment (TD.getPointerABIAlignment());
+  Lower = Builder.CreatePtrToInt (Lower, IntPtrTy);
+  Upper = Builder.CreatePtrToInt (Upper, IntPtrTy);
+
+  Value * Hit = Builder.CreateAnd (Builder.CreateICmpEQ (CachedPool, Pool),
+                                   Builder.CreateICmpEQ (CachedEpoch, Epoch));
+
+  //
+  // A load/store check hits if all of the accessed bytes are within the
+  // cached object.  A bounds check hits if both the source and destination
+  // pointers are within it.
+  //
+  Value * Checked;
+  Value * Dest = 0;
+  if (Check.isBoundsCheck) {
+    Checked = CI->getArgOperand (1);
+    Dest = CI->getArgOperand (2);
+    Value * SrcInt = Builder.CreatePtrToInt (Checked, IntPtrTy);
+    Value * DestInt = Builder.CreatePtrToInt (Dest, IntPtrTy);
+    Hit = Builder.CreateAnd (Hit, Builder.CreateICmpULE (Lower, SrcInt));
+    Hit = Builder.CreateAnd (Hit, Builder.CreateICmpULT (SrcInt, Upper));
+    Hit = Builder.CreateAnd (Hit, Builder.CreateICmpULE (Lower, DestInt));
+    Hit = Builder.CreateAnd (Hit, Builder.CreateICmpULT (DestInt, Upper));
+  } else {
+    Checked = CI->getArgOperand (1);
+    Value * Len = ConstantInt::get (IntPtrTy, 1);
+    if (Check.lenArg)
+      Len = Builder.CreateZExtOrTrunc (CI->getArgOperand (Check.lenArg),
+                                       IntPtrTy);
+    Value * PtrInt = Builder.CreatePtrToInt (Checked, IntPtrTy);
+    Value * EndInt = Builder.CreateAdd (PtrInt, Len);
+    Hit = Builder.CreateAnd (Hit, Builder.CreateICmpULE (Lower, PtrInt));
+    Hit = Builder.CreateAnd (Hit, Builder.CreateICmpULE (PtrInt, EndInt));
+    Hit = Builder.CreateAnd (Hit, Builder.CreateICmpULE (EndInt, Upper));
+  }
+  Builder.CreateCondBr (Hit, Cont, Miss);
+
+  //
+  // On a miss, cache the object after the check has been performed.
+  //
+  Type * FillArgs[] = {VoidPtrTy, VoidPtrTy, SiteCacheTy->getPointerTo()};
+  FunctionType * FillTy = FunctionType::get (Type::getVoidTy (Context),
+                                             FillArgs,
+                                             false);
+  Constant * Fill = M->getOrInsertFunction ("__sc_fill_site_cache", FillTy);
+  Builder.SetInsertPoint (Miss->getTerminator());
+  Value * Args[] = {Pool,
+                    Builder.CreatePointerCast (Checked, VoidPtrTy),
+                    SiteCache};
+  Builder.CreateCall (Fill, Args);
+
+  //
+  // The result of a bounds check on a hit is the destination pointer.
+  //
+  if (Check.isBoundsCheck && !(CI->use_empty())) {
+    Builder.SetInsertPoint (Cont, Cont->begin());
+    PHINode * Result = Builder.CreatePHI (CI->getType(), 2);
+    CI->replaceAllUsesWith (Result);
+    Builder.SetInsertPoint (Head->getTerminator());
+    Result->addIncoming (Builder.CreatePointerCast (Dest, CI->getType()),
+                         Head);
+    Result->addIncoming (CI, Miss);
+  }
+
+  ++Cached;
+  return;
+}
+
+//
+// Method: addSiteCaches()
+//
+// Description:
+//  Give every poolcheck() and boundscheck() call a site cache.
+//
+// Return value:
+//  true  - One or more calls were given a site cache.
+//  false - The module was not modified.
+//
+bool
+llvm::InlineFastChecks::addSiteCaches (Module & M) {
+  bool modified = false;
+  unsigned numChecks = sizeof (CachedChecks) / sizeof (CachedChecks[0]);
+  for (unsigned index = 0; index < numChecks; ++index) {
+    Function * F = M.getFunction (CachedChecks[index].name);
+    if (!F) continue;
+
+    std::vector<CallInst *> Calls;
+    for (Value::user_iterator U = F->user_begin(); U != F->user_end(); ++U) {
+      if (CallInst * CI = dyn_cast<CallInst>(*U))
+        if (CI->getCalledValue() == F)
+          Calls.push_back (CI);
+    }
+
+    for (unsigned call = 0; call < Calls.size(); ++call)
+      addSiteCache (Calls[call], CachedChecks[index]);
+    modified |= !Calls.empty();
+  }
+
+  return modified;
+}
+
 bool
 llvm::InlineFastChecks::runOnModule (Module & M) {
   //
@@ -495,6 +718,12 @@ llvm::InlineFastChecks::runOnModule (Module & M) {
   //
   inlineCheck (M.getFunction ("fastlscheck"));
   inlineCheck (M.getFunction ("fastlscheck_debug"));
+
+  //
+  // Give the checks that look up objects a cache if requested.
+  //
+  if (InlineCachedChecks)
+    addSiteCaches (M);
   return true;
 }
 
@@ -0,0 +1,615 @@
+//===- LoopVersionChecks.cpp - Version loops to remove SAFECode checks ----===//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass duplicates innermost loops so that the loop normally executed
+// performs fewer run-time checks.  A loop is versioned if:
+//
+//  o The loop has a preheader, a single exiting block whose successor outside
+//    of the loop has no other predecessors, and a backedge-taken count that
+//    scalar evolution can compute (possibly as an expression that is only
+//    known at run-time).
+//
+//  o The loop contains no calls that may free memory.
+//
+//  o The loop contains load/store or bounds checks whose checked pointers are
+//    loop invariant or affine functions of the induction variable and whose
+//    other arguments are loop invariant.  Unlike HoistLoopChecks, this pass
+//    can remove checks that are not performed on every iteration and checks
+//    whose results are used.
+//
+// The preheader looks up the object of the lowest pointer of each such check
+// with __sc_fill_site_cache() (see runtime/include/SiteCache.h) and tests
+// whether every pointer that the check can be given lies within that object.
+// If all tests pass, the original loop is run without these checks.
+// Otherwise, a copy of the loop that performs all of its checks is run, so
+// that a memory safety error is reported exactly where it occurs.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "sc-version"
+
+#include "safecode/LoopVersionChecks.h"
+#include "safecode/Utility.h"
+
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+namespace {
+  STATISTIC (LoopsVersioned, "Number of loops versioned");
+  STATISTIC (ChecksVersioned, "Number of checks removed from versioned loops");
+  STATISTIC (LoopsTooLarge, "Number of loops too large to version");
+}
+
+namespace llvm {
+
+char LoopVersionChecks::ID = 0;
+
+static RegisterPass<LoopVersionChecks>
+X ("sc-version-loops", "Version loops to remove SAFECode run-time checks");
+
+static cl::opt<unsigned>
+SizePerCheck ("sc-version-size-per-check",
+              cl::desc("Largest number of instructions of a versioned loop "
+                       "per check removed from it"),
+              cl::init(50));
+
+static cl::opt<unsigned>
+MaxGrowth ("sc-version-max-growth",
+           cl::desc("Largest percentage by which loop versioning may grow "
+                    "a function"),
+           cl::init(100));
+
+//
+// Function: collectInnermostLoops()
+//
+// Description:
+//  Add the innermost loops of the specified loop nest to a list.
+//
+static void
+collectInnermostLoops (Loop * L, std::vector<Loop *> & Loops) {
+  if (L->empty()) {
+    Loops.push_back (L);
+    return;
+  }
+
+  for (Loop::iterator I = L->begin(), E = L->end(); I != E; ++I)
+    collectInnermostLoops (*I, Loops);
+}
+
+//
+// Method: isEligibleLoop()
+//
+// Description:
+//  Determine whether the specified loop can be versioned.
+//
+// Return value:
+//  true  - The loop has the structure required by this pass and nothing in
+//          it can invalidate a memory object.
+//  false - The loop cannot be versioned.
+//
+bool
+LoopVersionChecks::isEligibleLoop (Loop * L) {
+  //
+  // The test is placed in the preheader, and both versions of the loop leave
+  // through the same exit block.
+  //
+  BasicBlock * Exiting = L->getExitingBlock();
+  BasicBlock * Exit = L->getExitBlock();
+  if (!(L->getLoopPreheader()) || !Exiting || !Exit)
+    return false;
+  if (Exit->getSinglePredecessor() != Exiting)
+    return false;
+
+  if (!(L->isSafeToClone()))
+    return false;
+
+  //
+  // Scalar evolution must know how often the loop iterates to compute the
+  // last pointer that a check can be given.
+  //
+  if (!(SE->hasLoopInvariantBackedgeTakenCount (L)))
+    return false;
+
+  //
+  // An object tested in the preheader must stay allocated while the loop
+  // runs, so the loop may only call run-time checks, intrinsics, and
+  // functions that do not write memory.
+  //
+  for (Loop::block_iterator I = L->block_begin(), E = L->block_end();
+       I != E; ++I) {
+    for (BasicBlock::iterator BI = (*I)->begin(), BE = (*I)->end();
+         BI != BE; ++BI) {
+      if (isa<InvokeInst>(BI))
+        return false;
+
+      CallInst * CI = dyn_cast<CallInst>(BI);
+      if (!CI || isa<IntrinsicInst>(CI))
+        continue;
+
+      Value * Callee = CI->getCalledValue()->stripPointerCasts();
+      Function * F = dyn_cast<Function>(Callee);
+      if (F && isRuntimeCheck (F))
+        continue;
+      if (CI->onlyReadsMemory() && CI->doesNotThrow())
+        continue;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//
+// Method: getPointerRange()
+//
+// Description:
+//  Find the lowest and highest values that the specified pointer can have
+//  within the loop.
+//
+// Outputs:
+//  Range - The bounds of the pointer as expressions that can be expanded in
+//          the loop's preheader.
+//
+// Return value:
+//  true  - The range of the pointer was found.
+//  false - The pointer is not loop invariant or an affine function of the
+//          induction variable that does not wrap around the address space.
+//
+bool
+LoopVersionChecks::getPointerRange (Loop * L, Value * Ptr,
+                                    PointerRange & Range) {
+  if (!(SE->isSCEVable (Ptr->getType())))
+    return false;
+
+  if (L->isLoopInvariant (Ptr)) {
+    Range.Low = Range.High = SE->getSCEV (Ptr);
+    return isSafeToExpand (Range.Low, *SE);
+  }
+
+  const SCEVAddRecExpr * AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV (Ptr));
+  if (!AR || (AR->getLoop() != L) || !(AR->isAffine()))
+    return false;
+  if (!(AR->getNoWrapFlags (SCEV::NoWrapMask)))
+    return false;
+
+  //
+  // Find the lowest and highest pointers from the direction of the stride.
+  //
+  const SCEV * Last = AR->evaluateAtIteration (SE->getBackedgeTakenCount (L),
+                                               *SE);
+  const SCEV * Step = AR->getStepRecurrence (*SE);
+  Range.Low = AR->getStart();
+  Range.High = Last;
+  if (SE->isKnownNegative (Step)) {
+    std::swap (Range.Low, Range.High);
+  } else if (!(SE->isKnownNonNegative (Step))) {
+    Range.Low = SE->getUMinExpr (AR->getStart(), Last);
+    Range.High = SE->getUMaxExpr (AR->getStart(), Last);
+  }
+
+  return isSafeToExpand (Range.Low, *SE) && isSafeToExpand (Range.High, *SE);
+}
+
+//
+// Method: canRemoveCheck()
+//
+// Description:
+//  Determine whether the specified check can be replaced by a test in the
+//  loop's preheader.  Only the checks that look up the object of the checked
+//  pointer in a pool are considered; the other checks are already cheap.
+//
+bool
+LoopVersionChecks::canRemoveCheck (Loop * L, CallInst * CI,
+                                   const CheckInfo * Info) {
+  StringRef Name = Info->completeName;
+  if (Info->isMemCheck()) {
+    if (!(Name.startswith ("poolcheck")) || !(Info->lenArg))
+      return false;
+  } else if (Info->isGEPCheck()) {
+    if (!(Name.startswith ("boundscheck")))
+      return false;
+  } else {
+    return false;
+  }
+
+  //
+  // Only the pointers may vary within the loop.
+  //
+  for (unsigned index = 0; index < CI->getNumArgOperands(); ++index) {
+    if ((index == Info->argno) || (Info->srcArg && index == Info->srcArg))
+      continue;
+    if (!(L->isLoopInvariant (CI->getArgOperand (index))))
+      return false;
+  }
+
+  PointerRange Range;
+  if (!getPointerRange (L, Info->getCheckedPointer (CI), Range))
+    return false;
+  if (Info->isGEPCheck() &&
+      !getPointerRange (L, Info->getSourcePointer (CI), Range))
+    return false;
+  return true;
+}
+
+//
+// Method: findChecks()
+//
+// Description:
+//  Find the checks in the specified loop that the range tests can replace.
+//
+void
+LoopVersionChecks::findChecks (Loop * L, std::vector<CallInst *> & Checks) {
+  for (Loop::block_iterator I = L->block_begin(), E = L->block_end();
+       I != E; ++I) {
+    for (BasicBlock::iterator BI = (*I)->begin(), BE = (*I)->end();
+         BI != BE; ++BI) {
+      CallInst * CI = dyn_cast<CallInst>(BI);
+      if (!CI)
+        continue;
+
+      Value * Callee = CI->getCalledValue()->stripPointerCasts();
+      Function * F = dyn_cast<Function>(Callee);
+      if (!F)
+        continue;
+
+      const CheckInfo * Info = findRuntimeCheck (F);
+      if (Info && canRemoveCheck (L, CI, Info))
+        Checks.push_back (CI);
+    }
+  }
+}
+
+//
+// Method: getLoopSize()
+//
+// Description:
+//  Return the number of instructions in the specified loop.
+//
+unsigned
+LoopVersionChecks::getLoopSize (Loop * L) {
+  unsigned Size = 0;
+  for (Loop::block_iterator I = L->block_begin(), E = L->block_end();
+       I != E; ++I)
+    Size += (*I)->size();
+  return Size;
+}
+
+//
+// Method: addObjectLookup()
+//
+// Description:
+//  Add code to look up the bounds of the object into which the specified
+//  pointer points.  The run-time leaves the bounds untouched if it does not
+//  find the object, so they are cleared first; a pointer then never appears
+//  to be within them.
+//
+// Outputs:
+//  Lower - The address of the first byte of the object as an integer.
+//  Upper - The address of the first byte after the object as an integer.
+//
+void
+LoopVersionChecks::addObjectLookup (Value * Pool, Value * Ptr,
+                                    Value *& Lower, Value *& Upper,
+                                    Instruction * InsertPt) {
+  Module * M = InsertPt->getModule();
+  LLVMContext & Context = M->getContext();
+  Type * VoidPtrTy = Type::getInt8PtrTy (Context);
+  Type * IntPtrTy = M->getDataLayout().getIntPtrType (Context);
+
+  //
+  // The run-time fills in a site cache structure; one is allocated on the
+  // stack for all of the lookups of the function.
+  //
+  StructType * SiteCacheTy = getSiteCacheType (*M);
+  if (!Bounds) {
+    Function * F = InsertPt->getParent()->getParent();
+    Bounds = new AllocaInst (SiteCacheTy, "sc.bounds",
+                             F->getEntryBlock().getFirstInsertionPt());
+  }
+
+  IRBuilder<> Builder (InsertPt);
+  Value * LowerPtr = Builder.CreateStructGEP (SiteCacheTy, Bounds, 1);
+  Value * UpperPtr = Builder.CreateStructGEP (SiteCacheTy, Bounds, 2);
+  Constant * Null = ConstantPointerNull::get (cast<PointerType>(VoidPtrTy));
+  Builder.CreateStore (Null, LowerPtr);
+  Builder.CreateStore (Null, UpperPtr);
+
+  Type * FillArgs[] = {VoidPtrTy, VoidPtrTy, SiteCacheTy->getPointerTo()};
+  FunctionType * FillTy = FunctionType::get (Type::getVoidTy (Context),
+                                             FillArgs,
+                                             false);
+  Constant * Fill = M->getOrInsertFunction ("__sc_fill_site_cache", FillTy);
+  Value * Args[] = {Builder.CreatePointerCast (Pool, VoidPtrTy),
+                    Builder.CreatePointerCast (Ptr, VoidPtrTy),
+                    Bounds};
+  Builder.CreateCall (Fill, Args);
+
+  Lower = Builder.CreatePtrToInt (Builder.CreateLoad (LowerPtr), IntPtrTy);
+  Upper = Builder.CreatePtrToInt (Builder.CreateLoad (UpperPtr), IntPtrTy);
+  return;
+}
+
+//
+// Method: addRangeTest()
+//
+// Description:
+//  Add code to test whether the specified check would pass on every pointer
+//  that it can be given in the loop.
+//
+// Return value:
+//  A boolean value that is true if the check can be removed.
+//
+Value *
+LoopVersionChecks::addRangeTest (Loop * L, CallInst * CI,
+                                 const CheckInfo * Info,
+                                 SCEVExpander & Rewriter,
+                                 Instruction * InsertPt) {
+  const DataLayout & DL = InsertPt->getModule()->getDataLayout();
+  Type * IntPtrTy = DL.getIntPtrType (CI->getContext());
+  Value * Pool = CI->getArgOperand (0);
+
+  //
+  // Bounds checks look up the object of the source pointer; load/store checks
+  // look up the object of the checked pointer.
+  //
+  Value * Ptr = Info->getCheckedPointer (CI);
+  Value * Lookup = Info->isGEPCheck() ? Info->getSourcePointer (CI) : Ptr;
+  PointerRange LookupRange;
+  getPointerRange (L, Lookup, LookupRange);
+  Value * LookupLow = Rewriter.expandCodeFor (LookupRange.Low,
+                                              Lookup->getType(),
+                                              InsertPt);
+  Value * LookupHigh = Rewriter.expandCodeFor (LookupRange.High,
+                                               Lookup->getType(),
+                                               InsertPt);
+
+  Value * Lower;
+  Value * Upper;
+  addObjectLookup (Pool, LookupLow, Lower, Upper, InsertPt);
+
+  IRBuilder<> Builder (InsertPt);
+  Value * Low = Builder.CreatePtrToInt (LookupLow, IntPtrTy);
+  Value * High = Builder.CreatePtrToInt (LookupHigh, IntPtrTy);
+  Value * Safe = Builder.CreateICmpULE (Lower, Low);
+
+  if (Info->isMemCheck()) {
+    //
+    // Every byte accessed must be within the object.
+    //
+    Value * Length = Builder.CreateZExtOrTrunc (Info->getCheckedLength (CI),
+                                                IntPtrTy);
+    Value * End = Builder.CreateAdd (High, Length);
+    Safe = Builder.CreateAnd (Safe, Builder.CreateICmpULE (High, End));
+    Safe = Builder.CreateAnd (Safe, Builder.CreateICmpULE (End, Upper));
+  } else {
+    //
+    // The source and destination pointers must both be within the object.
+    //
+    PointerRange DestRange;
+    getPointerRange (L, Ptr, DestRange);
+    Value * DestLow = Rewriter.expandCodeFor (DestRange.Low, Ptr->getType(),
+                                              InsertPt);
+    Value * DestHigh = Rewriter.expandCodeFor (DestRange.High, Ptr->getType(),
+                                               InsertPt);
+    DestLow = Builder.CreatePtrToInt (DestLow, IntPtrTy);
+    DestHigh = Builder.CreatePtrToInt (DestHigh, IntPtrTy);
+    Safe = Builder.CreateAnd (Safe, Builder.CreateICmpULT (High, Upper));
+    Safe = Builder.CreateAnd (Safe, Builder.CreateICmpULE (Lower, DestLow));
+    Safe = Builder.CreateAnd (Safe, Builder.CreateICmpULT (DestHigh, Upper));
+  }
+
+  return Safe;
+}
+
+//
+// Method: versionLoop()
+//
+// Description:
+//  Clone the specified loop, add the range tests of the specified checks to
+//  the preheader to select one of the two loops, and remove the checks from
+//  the loop run when the tests pass.
+//
+void
+LoopVersionChecks::versionLoop (Loop * L,
+                                const std::vector<CallInst *> & Checks) {
+  BasicBlock * TestBB = L->getLoopPreheader();
+  BasicBlock * Exiting = L->getExitingBlock();
+  BasicBlock * Exit = L->getExitBlock();
+
+  //
+  // Find the values defined in the loop that are used after it; they will be
+  // merged with their copies from the checked loop.
+  //
+  std::vector<Instruction *> DefsUsedOutside;
+  for (Loop::block_iterator I = L->block_begin(), E = L->block_end();
+       I != E; ++I) {
+    for (BasicBlock::iterator BI = (*I)->begin(), BE = (*I)->end();
+         BI != BE; ++BI) {
+      for (Value::user_iterator U = BI->user_begin(); U != BI->user_end();
+           ++U) {
+        if (!(L->contains (cast<Instruction>(*U)->getParent()))) {
+          DefsUsedOutside.push_back (BI);
+          break;
+        }
+      }
+    }
+  }
+
+  //
+  // Add the range tests to the end of the preheader.
+  //
+  Instruction * InsertPt = TestBB->getTerminator();
+  SCEVExpander Rewriter (*SE, InsertPt->getModule()->getDataLayout(),
+                         "sc.version");
+  Value * Safe = ConstantInt::getTrue (TestBB->getContext());
+  for (unsigned index = 0; index < Checks.size(); ++index) {
+    CallInst * CI = Checks[index];
+    const CheckInfo * Info = findRuntimeCheck (CI->getCalledFunction());
+    Value * Test = addRangeTest (L, CI, Info, Rewriter, InsertPt);
+    Safe = BinaryOperator::CreateAnd (Safe, Test, "sc.safe", InsertPt);
+  }
+
+  //
+  // Give the loop a new preheader and clone the loop with it.  The clone
+  // leaves through the same exit block as the original loop.
+  //
+  BasicBlock * Preheader = SplitBlock (TestBB, InsertPt, DT, LI);
+  TestBB->setName (L->getHeader()->getName() + ".sc.test");
+  Preheader->setName (L->getHeader()->getName() + ".sc.ph");
+
+  ValueToValueMapTy VMap;
+  SmallVector<BasicBlock *, 8> CheckedBlocks;
+  Loop * Checked = cloneLoopWithPreheader (Preheader, TestBB, L, VMap,
+                                           ".sc.checked", LI, DT,
+                                           CheckedBlocks);
+  remapInstructionsInBlocks (CheckedBlocks, VMap);
+
+  Instruction * OldTerm = TestBB->getTerminator();
+  BranchInst::Create (Preheader, Checked->getLoopPreheader(), Safe, OldTerm);
+  OldTerm->eraseFromParent();
+  DT->changeImmediateDominator (Exit, TestBB);
+
+  //
+  // Merge the values that leave the two loops in the exit block.
+  //
+  BasicBlock * CheckedExiting = cast<BasicBlock>(VMap[Exiting]);
+  for (BasicBlock::iterator I = Exit->begin(); isa<PHINode>(I); ++I) {
+    PHINode * PN = cast<PHINode>(I);
+    Value * V = PN->getIncomingValueForBlock (Exiting);
+    ValueToValueMapTy::iterator Mapped = VMap.find (V);
+    if (Mapped != VMap.end())
+      V = Mapped->second;
+    PN->addIncoming (V, CheckedExiting);
+  }
+
+  for (unsigned index = 0; index < DefsUsedOutside.size(); ++index) {
+    Instruction * Def = DefsUsedOutside[index];
+    std::vector<User *> Users;
+    for (Value::user_iterator U = Def->user_begin(); U != Def->user_end();
+         ++U) {
+      Instruction * UI = cast<Instruction>(*U);
+      if (L->contains (UI->getParent()))
+        continue;
+      if (isa<PHINode>(UI) && UI->getParent() == Exit)
+        continue;
+      Users.push_back (UI);
+    }
+
+    if (Users.empty())
+      continue;
+
+    PHINode * PN = PHINode::Create (Def->getType(), 2,
+                                    Def->getName() + ".sc.merge",
+                                    Exit->getFirstNonPHI());
+    for (unsigned user = 0; user < Users.size(); ++user)
+      Users[user]->replaceUsesOfWith (Def, PN);
+    PN->addIncoming (Def, Exiting);
+    PN->addIncoming (VMap[Def], CheckedExiting);
+  }
+
+  //
+  // Remove the checks from the original loop.  A bounds check that passes
+  // returns its destination pointer.
+  //
+  for (unsigned index = 0; index < Checks.size(); ++index) {
+    CallInst * CI = Checks[index];
+    if (!(CI->use_empty())) {
+      const CheckInfo * Info = findRuntimeCheck (CI->getCalledFunction());
+      Value * Dest = Info->getCheckedPointer (CI);
+      if (Dest->getType() != CI->getType())
+        Dest = CastInst::CreatePointerCast (Dest, CI->getType(), "", CI);
+      CI->replaceAllUsesWith (Dest);
+    }
+    CI->eraseFromParent();
+  }
+
+  SE->forgetLoop (L);
+  return;
+}
+
+//
+// Method: runOnFunction()
+//
+// Description:
+//  Entry point for this LLVM pass.
+//
+bool
+LoopVersionChecks::runOnFunction (Function & F) {
+  //
+  // Get references to required passes.
+  //
+  DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  LI = &getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  SE = &getAnalysis<ScalarEvolution>();
+  Bounds = 0;
+
+  //
+  // Find the loops before any are cloned.
+  //
+  std::vector<Loop *> Loops;
+  for (LoopInfo::iterator I = LI->begin(), E = LI->end(); I != E; ++I)
+    collectInnermostLoops (*I, Loops);
+  if (Loops.empty())
+    return false;
+
+  //
+  // Limit the number of instructions that versioning adds to the function.
+  //
+  unsigned FunctionSize = 0;
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    FunctionSize += BB->size();
+  unsigned Budget = (FunctionSize * MaxGrowth) / 100;
+  unsigned Growth = 0;
+
+  bool modified = false;
+  for (unsigned index = 0; index < Loops.size(); ++index) {
+    Loop * L = Loops[index];
+    if (!isEligibleLoop (L))
+      continue;
+
+    std::vector<CallInst *> Checks;
+    findChecks (L, Checks);
+    if (Checks.empty())
+      continue;
+
+    //
+    // A loop is only worth duplicating if it is small relative to the number
+    // of checks removed from it.
+    //
+    unsigned Size = getLoopSize (L);
+    if ((Size > SizePerCheck * Checks.size()) || (Growth + Size > Budget)) {
+      DEBUG (dbgs() << "sc-version: " << F.getName() << ": loop at "
+                    << L->getHeader()->getName() << " too large: "
+                    << Size << " instructions, "
+                    << Checks.size() << " checks\n");
+      ++LoopsTooLarge;
+      continue;
+    }
+
+    DEBUG (dbgs() << "sc-version: " << F.getName() << ": loop at "
+                  << L->getHeader()->getName() << ": "
+                  << Checks.size() << " checks removed\n");
+    versionLoop (L, Checks);
+    Growth += Size;
+    ChecksVersioned += Checks.size();
+    ++LoopsVersioned;
+    modified = true;
+  }
+
+  return modified;
+}
+
+}
@@ -19,6 +19,7 @@
 #include "llvm/IR/Instructions.h"
 
 #include "safecode/OptimizeChecks.h"
+#include "safecode/Parallel.h"
 #include "safecode/Utility.h"
 
 #include <iostream>
@@ -162,39 +163,38 @@ OptimizeChecks::processFunction (Module & M, const CheckInfo & Info) {
     return false;
 
   //
-  // Iterate though all calls to the function and search for pointers that are
-  // checked but only used in comparisons.  If so, then schedule the check
-  // (i.e., the call) for removal.
+  // Find the calls whose results are not used.  Any other use of the
+  // function is of no interest to the organization.
   //
-  bool modified = false;
-  std::vector<Instruction *> CallsToDelete;
-  for (Value::use_iterator FU = F->use_begin(); FU != F->use_end(); ++FU) {
+  std::vector<CallInst *> Calls;
+  for (Value::user_iterator FU = F->user_begin(); FU != F->user_end(); ++FU) {
+    if (CallInst * CI = dyn_cast<CallInst>(*FU))
+      if (CI->use_empty())
+        Calls.push_back (CI);
+  }
+
+  //
+  // Search for pointers that are checked but only used in comparisons.  The
+  // search only reads the IR, so the calls are examined in parallel.
+  //
+  std::vector<char> Removable (Calls.size(), 0);
+  parallelFor (Calls.size(), [&] (unsigned index) {
     //
-    // We are only concerned about call instructions; any other use is of
-    // no interest to the organization.
+    // Get the checked operand with all of the casts peeled away.
     //
-    if (CallInst * CI = dyn_cast<CallInst>(*FU)) {
-      //
-      // If the call instruction has any uses, we cannot remove it.
-      //
-      if (CI->use_begin() != CI->use_end()) continue;
-
-      //
-      // Get the operand that needs to be replaced as well as the operand
-      // with all of the casts peeled away.  Increment the operand index by
-      // one because a call instruction's first operand is the function to
-      // call.
-      //
-      Value * Operand = Info.getCheckedPointer (CI)->stripPointerCasts();
+    Value * Operand = Info.getCheckedPointer (Calls[index]);
+    Removable[index] = onlyUsedInCompares (Operand->stripPointerCasts());
+  });
 
-      //
-      // If the operand is only used in comparisons, mark the run-time check
-      // for removal.
-      //
-      if (onlyUsedInCompares (Operand)) {
-        CallsToDelete.push_back (CI);
-        modified = true;
-      }
+  //
+  // Schedule the checks on such pointers for removal.
+  //
+  bool modified = false;
+  std::vector<Instruction *> CallsToDelete;
+  for (unsigned index = 0; index < Calls.size(); ++index) {
+    if (Removable[index]) {
+      CallsToDelete.push_back (Calls[index]);
+      modified = true;
     }
   }
 
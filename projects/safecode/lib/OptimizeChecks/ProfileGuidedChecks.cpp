@@ -0,0 +1,242 @@
+//===- ProfileGuidedChecks.cpp - Select cheaper checks on hot paths -------===//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass replaces the load/store and bounds checks executed on hot paths
+// by checks that do not need to look up the checked object when the object is
+// a stack or global object of known size.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "sc-profile"
+
+#include "safecode/CheckProfile.h"
+
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <climits>
+#include <vector>
+
+namespace llvm {
+
+char ProfileGuidedChecks::ID = 0;
+
+static RegisterPass<ProfileGuidedChecks>
+X ("sc-profile-checks", "Select cheaper SAFECode checks on hot paths");
+
+// Pass Statistics
+namespace {
+  STATISTIC (MemChecksConverted, "Number of hot load/store checks made fast");
+  STATISTIC (GEPChecksConverted, "Number of hot bounds checks made exact");
+}
+
+//
+// Method: getStaticObject()
+//
+// Description:
+//  Determine whether the specified pointer points into a memory object whose
+//  address and size are known at compile time and which is alive wherever the
+//  pointer can be used: a stack object allocated on entry to the function or
+//  a global variable that cannot be replaced at link time.
+//
+// Outputs:
+//  Size - The size of the object in bytes.
+//
+// Return value:
+//  NULL      - The object is not known.
+//  Otherwise - The pointer to the start of the object.
+//
+Value *
+ProfileGuidedChecks::getStaticObject (Value * Ptr, uint64_t & Size) {
+  Value * Obj = GetUnderlyingObject (Ptr->stripPointerCasts(), *DL);
+
+  if (AllocaInst * AI = dyn_cast<AllocaInst>(Obj)) {
+    if (!(AI->isStaticAlloca()))
+      return 0;
+    ConstantInt * Count = cast<ConstantInt>(AI->getArraySize());
+    Size = DL->getTypeAllocSize (AI->getAllocatedType()) *
+           Count->getZExtValue();
+  } else if (GlobalVariable * GV = dyn_cast<GlobalVariable>(Obj)) {
+    if (GV->isDeclaration() || GV->mayBeOverridden())
+      return 0;
+    Size = DL->getTypeAllocSize (GV->getType()->getElementType());
+  } else {
+    return 0;
+  }
+
+  //
+  // The fast checks take the size of the object as an unsigned int.
+  //
+  if ((Size == 0) || (Size > UINT_MAX))
+    return 0;
+  return Obj;
+}
+
+//
+// Method: convertMemCheck()
+//
+// Description:
+//  Replace a poolcheck() on a pointer into a known object with a
+//  fastlscheck() of the same access.
+//
+// Return value:
+//  true  - The check was replaced.
+//  false - The check was left unmodified.
+//
+bool
+ProfileGuidedChecks::convertMemCheck (CallInst * CI, const CheckInfo * Info) {
+  if (StringRef(Info->completeName).substr(0, 9) != "poolcheck" ||
+      !(Info->lenArg) || !(CI->use_empty()))
+    return false;
+
+  uint64_t Size;
+  Value * Ptr = Info->getCheckedPointer (CI);
+  Value * Obj = getStaticObject (Ptr, Size);
+  if (!Obj)
+    return false;
+
+  //
+  // Build the arguments of the fast check.  The debug version takes the same
+  // source location arguments as the check that it replaces.
+  //
+  Module * M = CI->getParent()->getParent()->getParent();
+  Type * VoidPtrTy = Type::getInt8PtrTy (M->getContext());
+  Type * Int32Ty = Type::getInt32Ty (M->getContext());
+  Value * Len = Info->getCheckedLength (CI);
+  if (Len->getType() != Int32Ty)
+    return false;
+
+  std::vector<Value *> Args;
+  Args.push_back (CastInst::CreatePointerCast (Obj, VoidPtrTy, "base", CI));
+  Args.push_back (CastInst::CreatePointerCast (Ptr, VoidPtrTy, "ptr", CI));
+  Args.push_back (ConstantInt::get (Int32Ty, Size));
+  Args.push_back (Len);
+
+  bool isDebug = StringRef(Info->name).endswith ("_debug");
+  for (unsigned arg = 3; isDebug && arg < CI->getNumArgOperands(); ++arg)
+    Args.push_back (CI->getArgOperand (arg));
+
+  std::vector<Type *> ArgTypes;
+  for (unsigned arg = 0; arg < Args.size(); ++arg)
+    ArgTypes.push_back (Args[arg]->getType());
+  FunctionType * FTy = FunctionType::get (Type::getVoidTy (M->getContext()),
+                                          ArgTypes,
+                                          false);
+  Constant * FastCheck = M->getOrInsertFunction (isDebug ? "fastlscheck_debug"
+                                                         : "fastlscheck",
+                                                 FTy);
+  CallInst * NewCI = CallInst::Create (FastCheck, Args, "", CI);
+  NewCI->setDebugLoc (CI->getDebugLoc());
+
+  CI->eraseFromParent();
+  ++MemChecksConverted;
+  return true;
+}
+
+//
+// Method: convertGEPCheck()
+//
+// Description:
+//  Replace a boundscheck() whose source pointer points into a known object
+//  with an exactcheck2() on the same object.  Both checks return the checked
+//  pointer or a rewritten out of bounds pointer.
+//
+// Return value:
+//  true  - The check was replaced.
+//  false - The check was left unmodified.
+//
+bool
+ProfileGuidedChecks::convertGEPCheck (CallInst * CI, const CheckInfo * Info) {
+  if (StringRef(Info->completeName).substr(0, 11) != "boundscheck")
+    return false;
+
+  uint64_t Size;
+  Value * Src = Info->getSourcePointer (CI);
+  Value * Obj = getStaticObject (Src, Size);
+  if (!Obj)
+    return false;
+
+  Module * M = CI->getParent()->getParent()->getParent();
+  Type * VoidPtrTy = Type::getInt8PtrTy (M->getContext());
+  Type * Int32Ty = Type::getInt32Ty (M->getContext());
+
+  std::vector<Value *> Args;
+  Args.push_back (CastInst::CreatePointerCast (Src, VoidPtrTy, "src", CI));
+  Args.push_back (CastInst::CreatePointerCast (Obj, VoidPtrTy, "base", CI));
+  Args.push_back (CastInst::CreatePointerCast (Info->getCheckedPointer (CI),
+                                               VoidPtrTy, "dest", CI));
+  Args.push_back (ConstantInt::get (Int32Ty, Size));
+
+  bool isDebug = StringRef(Info->name).endswith ("_debug");
+  for (unsigned arg = 3; isDebug && arg < CI->getNumArgOperands(); ++arg)
+    Args.push_back (CI->getArgOperand (arg));
+
+  std::vector<Type *> ArgTypes;
+  for (unsigned arg = 0; arg < Args.size(); ++arg)
+    ArgTypes.push_back (Args[arg]->getType());
+  FunctionType * FTy = FunctionType::get (VoidPtrTy, ArgTypes, false);
+  Constant * ExactCheck = M->getOrInsertFunction (isDebug ? "exactcheck2_debug"
+                                                          : "exactcheck2",
+                                                  FTy);
+  CallInst * NewCI = CallInst::Create (ExactCheck, Args, "", CI);
+  NewCI->setDebugLoc (CI->getDebugLoc());
+
+  Value * Result = NewCI;
+  if (Result->getType() != CI->getType())
+    Result = CastInst::CreatePointerCast (NewCI, CI->getType(), "", CI);
+  CI->replaceAllUsesWith (Result);
+  CI->eraseFromParent();
+  ++GEPChecksConverted;
+  return true;
+}
+
+bool
+ProfileGuidedChecks::runOnModule (Module & M) {
+  CheckProfile & Profile = getAnalysis<CheckProfile>();
+  DL = &(M.getDataLayout());
+
+  //
+  // Find the checks on hot paths first since converting a check modifies the
+  // instruction list.
+  //
+  std::vector<CallInst *> HotChecks;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    for (inst_iterator I = inst_begin (*F), IE = inst_end (*F); I != IE; ++I) {
+      if (CallInst * CI = dyn_cast<CallInst>(&*I)) {
+        Function * Callee = CI->getCalledFunction();
+        if (Callee && isRuntimeCheck (Callee) &&
+            Profile.isHot (CI->getParent()))
+          HotChecks.push_back (CI);
+      }
+    }
+  }
+
+  bool modified = false;
+  for (unsigned index = 0; index < HotChecks.size(); ++index) {
+    CallInst * CI = HotChecks[index];
+    const CheckInfo * Info = findRuntimeCheck (CI->getCalledFunction());
+    if (Info->isMemCheck())
+      modified |= convertMemCheck (CI, Info);
+    else if (Info->isGEPCheck())
+      modified |= convertGEPCheck (CI, Info);
+  }
+
+  DEBUG(dbgs() << "sc-profile: " << HotChecks.size() << " hot checks, "
+               << MemChecksConverted + GEPChecksConverted
+               << " converted\n");
+  return modified;
+}
+
+}
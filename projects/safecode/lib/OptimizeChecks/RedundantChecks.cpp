@@ -0,0 +1,726 @@
+//===- RedundantChecks.cpp - Remove redundant SAFECode checks -------------===//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass removes run-time checks that are implied by checks performed
+// earlier on every path through a function.  It performs a forward dataflow
+// analysis of the checks available at each point of the function.  A check
+// becomes available after it is performed and stops being available when:
+//
+//  o One of the values it checks is redefined (e.g., by a PHI node at the
+//    top of a loop),
+//  o A call that may free the checked memory object is made, or
+//  o For string checks, the string may have been written.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "sc-redundant"
+
+#include "safecode/RedundantChecks.h"
+
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace llvm {
+
+char RedundantCheckElimination::ID = 0;
+
+static RegisterPass<RedundantCheckElimination>
+X ("sc-redundant-checks", "Remove redundant SAFECode run-time checks");
+
+// Pass Statistics
+namespace {
+  STATISTIC (ChecksRemoved,  "Number of redundant run-time checks removed");
+  STATISTIC (FreeingFuncs,   "Number of functions that may free memory");
+}
+
+//
+// Structure: DeallocatorInfo
+//
+// Description:
+//  This structure describes a function that frees or unregisters a memory
+//  object.  A negative argument number means that the function may free any
+//  object (e.g., a pool destruction).
+//
+struct DeallocatorInfo {
+  const char * name;
+  int ptrArg;
+};
+
+static const DeallocatorInfo Deallocators[] = {
+  {"free",                         0},
+  {"cfree",                        0},
+  {"realloc",                      0},
+  {"poolfree",                     1},
+  {"poolrealloc",                  1},
+  {"pooldestroy",                 -1},
+  {"pool_unregister",              1},
+  {"pool_unregister_debug",        1},
+  {"pool_unregister_stack",        1},
+  {"pool_unregister_stack_debug",  1},
+  {0,                              0}
+};
+
+//
+// External functions that are known not to free memory.  Functions that do not
+// write memory and the run-time checks themselves are not listed.
+//
+static const char * NonFreeingFunctions[] = {
+  "malloc", "calloc", "valloc", "memalign",
+  "poolalloc", "poolcalloc", "poolinit", "poolmakeunfreeable",
+  "pool_register", "pool_register_debug",
+  "pool_register_stack", "pool_register_stack_debug",
+  "pool_register_global", "pool_register_global_debug",
+  "pool_register_globals",
+  "memcpy", "memmove", "memset", "strcpy", "strncpy", "strcat", "strncat",
+  "printf", "fprintf", "sprintf", "snprintf", "puts", "putchar",
+  0
+};
+
+//
+// Function: findDeallocator()
+//
+// Description:
+//  Determine whether the specified function frees a memory object.
+//
+// Return value:
+//  NULL      - The function is not a known deallocator.
+//  Otherwise - A pointer to the description of the deallocator.
+//
+static const DeallocatorInfo *
+findDeallocator (const Function * F) {
+  if (F && F->hasName()) {
+    for (unsigned index = 0; Deallocators[index].name; ++index) {
+      if (F->getName() == Deallocators[index].name)
+        return &(Deallocators[index]);
+    }
+  }
+
+  return 0;
+}
+
+//
+// Function: isNonFreeingExternal()
+//
+// Description:
+//  Determine whether the specified external function is known to never free
+//  memory.
+//
+static bool
+isNonFreeingExternal (const Function * F) {
+  if (F->isIntrinsic() || F->onlyReadsMemory() || isRuntimeCheck (F))
+    return true;
+
+  for (unsigned index = 0; NonFreeingFunctions[index]; ++index) {
+    if (F->getName() == NonFreeingFunctions[index])
+      return true;
+  }
+
+  return false;
+}
+
+//
+// Function: dependsOnLiveObjects()
+//
+// Description:
+//  Determine whether the result of a run-time check depends on the set of
+//  memory objects that are alive.  The checks that only perform arithmetic on
+//  their arguments (such as exactcheck2() and fastlscheck()) and the function
+//  pointer checks give the same result whenever they are given the same
+//  arguments.
+//
+static bool
+dependsOnLiveObjects (const CheckInfo * Info) {
+  if (Info->checkType == funccheck)
+    return false;
+
+  StringRef Name (Info->name);
+  if (Name.startswith ("exactcheck2") || Name.startswith ("fastlscheck"))
+    return false;
+
+  return true;
+}
+
+//
+// Function: canBeFreed()
+//
+// Description:
+//  Determine whether another function can free the specified memory object.
+//  Stack objects live until the function that allocated them returns, and
+//  global variables are never freed.
+//
+static bool
+canBeFreed (const Value * Obj) {
+  return !(isa<AllocaInst>(Obj) || isa<GlobalValue>(Obj));
+}
+
+//
+// Method: computeMayFree()
+//
+// Description:
+//  Find every function that may free a memory object when it is called.  The
+//  call graph is processed bottom-up so that the callees of a function (other
+//  than those in the same strongly connected component) are summarized before
+//  the function itself.
+//
+void
+RedundantCheckElimination::computeMayFree (Module & M) {
+  CallGraph & CG = getAnalysis<CallGraphWrapperPass>().getCallGraph();
+
+  MayFree.clear();
+  for (scc_iterator<CallGraph *> SCCI = scc_begin (&CG);
+       !SCCI.isAtEnd(); ++SCCI) {
+    const std::vector<CallGraphNode *> & SCC = *SCCI;
+
+    bool frees = false;
+    for (unsigned index = 0; index < SCC.size() && !frees; ++index) {
+      Function * F = SCC[index]->getFunction();
+      if (!F)
+        continue;
+
+      //
+      // External functions free memory unless we know better.  Deallocators
+      // are external functions that are not in the list of non-freeing
+      // functions.
+      //
+      if (F->isDeclaration()) {
+        frees = !isNonFreeingExternal (F);
+        continue;
+      }
+
+      //
+      // A defined function frees memory if it makes an indirect call or calls
+      // a function that frees memory.
+      //
+      for (CallGraphNode::iterator I = SCC[index]->begin(),
+                                   E = SCC[index]->end(); I != E; ++I) {
+        Function * Callee = I->second->getFunction();
+        if ((!Callee) || MayFree.count (Callee)) {
+          frees = true;
+          break;
+        }
+      }
+    }
+
+    if (frees) {
+      for (unsigned index = 0; index < SCC.size(); ++index) {
+        if (Function * F = SCC[index]->getFunction()) {
+          MayFree.insert (F);
+          if (!(F->isDeclaration()))
+            ++FreeingFuncs;
+        }
+      }
+    }
+  }
+
+  return;
+}
+
+//
+// Method: mayFreeMemory()
+//
+// Description:
+//  Determine whether the specified call may free a memory object.
+//
+bool
+RedundantCheckElimination::mayFreeMemory (CallSite CS) {
+  if (isa<IntrinsicInst>(CS.getInstruction()))
+    return false;
+
+  if (CS.onlyReadsMemory())
+    return false;
+
+  //
+  // Indirect calls and inline assembly code may do anything.
+  //
+  const Function * F = CS.getCalledFunction();
+  if (!F)
+    return true;
+
+  return MayFree.count (F);
+}
+
+//
+// Method: getCheckInfo()
+//
+// Description:
+//  Return the description of the specified check of the current function.
+//
+const CheckInfo *
+RedundantCheckElimination::getCheckInfo (unsigned Index) {
+  return &(RuntimeChecks[CheckKinds[Index]]);
+}
+
+//
+// Method: getNumArgs()
+//
+// Description:
+//  Return the number of arguments of a check that describe what it checks.
+//  The source location arguments of the debug versions of the checks are not
+//  counted.
+//
+unsigned
+RedundantCheckElimination::getNumArgs (unsigned Index) {
+  CallSite CS (Checks[Index]);
+  unsigned NumArgs = CS.arg_size();
+  if (StringRef(getCheckInfo (Index)->name).endswith ("_debug"))
+    NumArgs = (NumArgs > 3) ? NumArgs - 3 : 0;
+  return NumArgs;
+}
+
+//
+// Method: getCheckedObject()
+//
+// Description:
+//  Return the value from which the memory object verified by the check is
+//  derived.  For checks that a pointer stays within the object of a source
+//  pointer, this is the object of the source pointer.
+//
+Value *
+RedundantCheckElimination::getCheckedObject (unsigned Index) {
+  const CheckInfo * Info = getCheckInfo (Index);
+  Value * Ptr = Info->getSourcePointer (Checks[Index]);
+  if (!Ptr)
+    Ptr = Info->getCheckedPointer (Checks[Index]);
+  return GetUnderlyingObject (Ptr->stripPointerCasts(), *DL);
+}
+
+//
+// Method: findChecks()
+//
+// Description:
+//  Number all of the run-time checks within the specified function and record,
+//  for each instruction that computes a value used by a check, the checks that
+//  stop being available when the instruction is executed again.
+//
+void
+RedundantCheckElimination::findChecks (Function & F) {
+  Checks.clear();
+  CheckKinds.clear();
+  CheckIndex.clear();
+  Kills.clear();
+
+  for (inst_iterator I = inst_begin (F), E = inst_end (F); I != E; ++I) {
+    if (CallInst * CI = dyn_cast<CallInst>(&*I)) {
+      if (Function * Callee = CI->getCalledFunction()) {
+        if (const CheckInfo * Info = findRuntimeCheck (Callee)) {
+          CheckIndex[CI] = Checks.size();
+          Checks.push_back (CI);
+          CheckKinds.push_back (Info - RuntimeChecks);
+        }
+      }
+    }
+  }
+
+  unsigned N = Checks.size();
+  for (unsigned index = 0; index < N; ++index) {
+    CallSite CS (Checks[index]);
+    std::vector<Value *> Deps (CS.arg_begin(), CS.arg_end());
+
+    //
+    // The checked ranges are compared by their base pointer, so a check also
+    // depends on the base of its checked pointer.
+    //
+    int64_t Offset = 0;
+    Value * Ptr = getCheckInfo (index)->getCheckedPointer (Checks[index]);
+    Deps.push_back (GetPointerBaseWithConstantOffset (Ptr->stripPointerCasts(),
+                                                      Offset,
+                                                      *DL));
+
+    for (unsigned dep = 0; dep < Deps.size(); ++dep) {
+      if (Instruction * DefI = dyn_cast<Instruction>(Deps[dep])) {
+        BitVector & Kill = Kills[DefI];
+        Kill.resize (N);
+        Kill.set (index);
+      }
+    }
+  }
+
+  return;
+}
+
+//
+// Method: killAliasingChecks()
+//
+// Description:
+//  Record the checks that the specified instruction invalidates.
+//
+// Inputs:
+//  I    - The instruction invalidating the checks.
+//  How  - How the instruction affects memory objects.
+//  Ptr  - For KillFreed, the pointer to the object freed by the instruction.
+//
+void
+RedundantCheckElimination::killAliasingChecks (Instruction * I,
+                                               KillKind How,
+                                               Value * Ptr) {
+  Value * FreedObj = 0;
+  if (How == KillFreed)
+    FreedObj = GetUnderlyingObject (Ptr->stripPointerCasts(), *DL);
+
+  unsigned N = Checks.size();
+  for (unsigned index = 0; index < N; ++index) {
+    const CheckInfo * Info = getCheckInfo (index);
+    if (!dependsOnLiveObjects (Info))
+      continue;
+    if ((How == KillWritten) && (Info->checkType != strcheck))
+      continue;
+
+    //
+    // Determine whether the instruction may affect the checked object.
+    //
+    Value * Obj = getCheckedObject (index);
+    bool affected = true;
+    switch (How) {
+      case KillAll:
+        break;
+
+      case KillFreed:
+        affected = AA->alias (MemoryLocation (FreedObj),
+                              MemoryLocation (Obj)) != NoAlias;
+        break;
+
+      case KillMayFree:
+        affected = canBeFreed (Obj) &&
+                   (AA->getModRefInfo (I, MemoryLocation (Obj)) &
+                    AliasAnalysis::Mod);
+        break;
+
+      case KillWritten:
+        affected = AA->getModRefInfo (I, MemoryLocation (Obj)) &
+                   AliasAnalysis::Mod;
+        break;
+    }
+
+    if (affected) {
+      BitVector & Kill = Kills[I];
+      Kill.resize (N);
+      Kill.set (index);
+    }
+  }
+
+  return;
+}
+
+//
+// Method: computeKills()
+//
+// Description:
+//  Record the checks invalidated by each instruction of the function.
+//
+void
+RedundantCheckElimination::computeKills (Function & F) {
+  for (inst_iterator I = inst_begin (F), E = inst_end (F); I != E; ++I) {
+    Instruction * Inst = &*I;
+
+    //
+    // Atomic operations are treated like calls that may free any object so
+    // that we can catch some of the concurrency bugs in which one thread frees
+    // an object between two accesses by another thread.
+    //
+    if (isa<AtomicCmpXchgInst>(Inst) || isa<AtomicRMWInst>(Inst)) {
+      killAliasingChecks (Inst, KillAll);
+      continue;
+    }
+
+    if (!(Inst->mayWriteToMemory()))
+      continue;
+
+    CallSite CS (Inst);
+    if (CS) {
+      Function * Callee = CS.getCalledFunction();
+      if (Callee && isRuntimeCheck (Callee))
+        continue;
+
+      if (const DeallocatorInfo * Dealloc = findDeallocator (Callee)) {
+        if ((Dealloc->ptrArg >= 0) &&
+            ((unsigned) Dealloc->ptrArg < CS.arg_size()))
+          killAliasingChecks (Inst, KillFreed,
+                              CS.getArgument (Dealloc->ptrArg));
+        else
+          killAliasingChecks (Inst, KillAll);
+      } else if (mayFreeMemory (CS)) {
+        killAliasingChecks (Inst, KillMayFree);
+      }
+    }
+
+    killAliasingChecks (Inst, KillWritten);
+  }
+
+  return;
+}
+
+//
+// Method: sameContext()
+//
+// Description:
+//  Determine whether two checks are made with the same arguments other than
+//  the checked pointer and length.
+//
+bool
+RedundantCheckElimination::sameContext (unsigned Avail, unsigned Index) {
+  const CheckInfo * Info = getCheckInfo (Index);
+  unsigned NumArgs = getNumArgs (Index);
+  if (getNumArgs (Avail) != NumArgs)
+    return false;
+
+  CallSite AvailCS (Checks[Avail]);
+  CallSite CS (Checks[Index]);
+  for (unsigned arg = 0; arg < NumArgs; ++arg) {
+    if ((arg == Info->argno) || (Info->lenArg && (arg == Info->lenArg)))
+      continue;
+
+    if (AvailCS.getArgument(arg)->stripPointerCasts() !=
+        CS.getArgument(arg)->stripPointerCasts())
+      return false;
+  }
+
+  return true;
+}
+
+//
+// Method: subsumes()
+//
+// Description:
+//  Determine whether the available check Avail verifies everything that the
+//  check Index verifies.
+//
+bool
+RedundantCheckElimination::subsumes (unsigned Avail, unsigned Index) {
+  const CheckInfo * AvailInfo = getCheckInfo (Avail);
+  const CheckInfo * Info = getCheckInfo (Index);
+
+  //
+  // A check is only implied by a check of the same kind.  A complete check
+  // also implies the incomplete version of the check since the incomplete
+  // check only accepts more pointers.
+  //
+  if (StringRef(AvailInfo->completeName) != StringRef(Info->completeName))
+    return false;
+  if ((!(AvailInfo->isComplete)) && (Info->isComplete))
+    return false;
+  if (!sameContext (Avail, Index))
+    return false;
+
+  Value * AvailPtr = AvailInfo->getCheckedPointer (Checks[Avail]);
+  Value * Ptr = Info->getCheckedPointer (Checks[Index]);
+  AvailPtr = AvailPtr->stripPointerCasts();
+  Ptr = Ptr->stripPointerCasts();
+
+  if (!(Info->lenArg))
+    return AvailPtr == Ptr;
+
+  //
+  // The same pointer checked with the same length is always implied.
+  //
+  Value * AvailLen = AvailInfo->getCheckedLength (Checks[Avail]);
+  Value * Len = Info->getCheckedLength (Checks[Index]);
+  if ((AvailPtr == Ptr) && (AvailLen == Len))
+    return true;
+
+  //
+  // Otherwise, the range [Ptr, Ptr + Len) must lie within the available range
+  // [AvailPtr, AvailPtr + AvailLen).  Both ranges must be known offsets from
+  // the same base pointer.
+  //
+  ConstantInt * AvailC = dyn_cast<ConstantInt>(AvailLen);
+  ConstantInt * C = dyn_cast<ConstantInt>(Len);
+  if (!(AvailC && C))
+    return false;
+
+  int64_t AvailOffset = 0;
+  int64_t Offset = 0;
+  Value * AvailBase = GetPointerBaseWithConstantOffset (AvailPtr,
+                                                        AvailOffset,
+                                                        *DL);
+  Value * Base = GetPointerBaseWithConstantOffset (Ptr, Offset, *DL);
+  if (AvailBase != Base)
+    return false;
+
+  int64_t Start = Offset - AvailOffset;
+  if (Start < 0)
+    return false;
+  return (uint64_t) Start + C->getZExtValue() <= AvailC->getZExtValue();
+}
+
+//
+// Method: processFunction()
+//
+// Description:
+//  Find and remove the redundant checks within the specified function.
+//
+// Outputs:
+//  Removed - The number of checks removed is added to this value.
+//
+// Return value:
+//  true  - The function was modified.
+//  false - The function was not modified.
+//
+bool
+RedundantCheckElimination::processFunction (Function & F, unsigned & Removed) {
+  findChecks (F);
+  unsigned N = Checks.size();
+  if (N < 2)
+    return false;
+  computeKills (F);
+
+  //
+  // Compute the checks generated and killed by each basic block.
+  //
+  ReversePostOrderTraversal<Function *> RPOT (&F);
+  DenseMap<BasicBlock *, BitVector> Gen, Kill, In, Out;
+  for (ReversePostOrderTraversal<Function *>::rpo_iterator BBI = RPOT.begin();
+       BBI != RPOT.end(); ++BBI) {
+    BasicBlock * BB = *BBI;
+    BitVector & BBGen = Gen[BB];
+    BitVector & BBKill = Kill[BB];
+    BBGen.resize (N);
+    BBKill.resize (N);
+    for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+      DenseMap<const Instruction *, BitVector>::iterator K = Kills.find (I);
+      if (K != Kills.end()) {
+        BBKill |= K->second;
+        BBGen.reset (K->second);
+      }
+
+      if (CallInst * CI = dyn_cast<CallInst>(I)) {
+        DenseMap<const CallInst *, unsigned>::iterator C = CheckIndex.find (CI);
+        if (C != CheckIndex.end())
+          BBGen.set (C->second);
+      }
+    }
+
+    //
+    // Every check is assumed to be available at the end of the other blocks
+    // until the dataflow analysis proves otherwise.
+    //
+    In[BB].resize (N);
+    Out[BB].resize (N, true);
+  }
+
+  //
+  // Compute the checks available at the beginning of each basic block.  A
+  // check is available if it is available at the end of every predecessor.
+  //
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (ReversePostOrderTraversal<Function *>::rpo_iterator BBI = RPOT.begin();
+         BBI != RPOT.end(); ++BBI) {
+      BasicBlock * BB = *BBI;
+      BitVector BBIn (N, BB != &(F.getEntryBlock()));
+      for (pred_iterator PI = pred_begin (BB), PE = pred_end (BB);
+           PI != PE; ++PI) {
+        DenseMap<BasicBlock *, BitVector>::iterator PredOut = Out.find (*PI);
+        if (PredOut != Out.end())
+          BBIn &= PredOut->second;
+      }
+
+      BitVector BBOut = BBIn;
+      BBOut.reset (Kill[BB]);
+      BBOut |= Gen[BB];
+      In[BB] = BBIn;
+      if (BBOut != Out[BB]) {
+        Out[BB] = BBOut;
+        changed = true;
+      }
+    }
+  }
+
+  //
+  // Walk through each basic block once more and find the checks that are
+  // implied by an available check.  Checks whose results are used cannot be
+  // removed since other instructions use the pointers that they return.
+  //
+  std::vector<CallInst *> toBeRemoved;
+  for (ReversePostOrderTraversal<Function *>::rpo_iterator BBI = RPOT.begin();
+       BBI != RPOT.end(); ++BBI) {
+    BasicBlock * BB = *BBI;
+    BitVector Avail = In[BB];
+    for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+      DenseMap<const Instruction *, BitVector>::iterator K = Kills.find (I);
+      if (K != Kills.end())
+        Avail.reset (K->second);
+
+      CallInst * CI = dyn_cast<CallInst>(I);
+      if (!CI)
+        continue;
+      DenseMap<const CallInst *, unsigned>::iterator C = CheckIndex.find (CI);
+      if (C == CheckIndex.end())
+        continue;
+
+      //
+      // The property verified by a removed check still holds after it, so the
+      // check becomes available whether it is removed or not.
+      //
+      unsigned index = C->second;
+      if (CI->use_empty()) {
+        bool redundant = false;
+        for (int avail = Avail.find_first(); avail != -1 && !redundant;
+             avail = Avail.find_next (avail)) {
+          redundant = subsumes (avail, index);
+        }
+
+        if (redundant)
+          toBeRemoved.push_back (CI);
+      }
+
+      Avail.set (index);
+    }
+  }
+
+  for (unsigned index = 0; index < toBeRemoved.size(); ++index) {
+    toBeRemoved[index]->eraseFromParent();
+  }
+
+  DEBUG(dbgs() << "sc-redundant: " << F.getName() << ": removed "
+               << toBeRemoved.size() << " of " << N << " checks\n");
+  Removed += toBeRemoved.size();
+  return !toBeRemoved.empty();
+}
+
+bool
+RedundantCheckElimination::runOnModule (Module & M) {
+  //
+  // Get prerequisite analysis results.
+  //
+  AA = &getAnalysis<AliasAnalysis>();
+  DL = &(M.getDataLayout());
+
+  //
+  // Find the functions that may free memory and then process every function
+  // of the program.
+  //
+  computeMayFree (M);
+
+  unsigned Removed = 0;
+  bool modified = false;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (!(F->isDeclaration()))
+      modified |= processFunction (*F, Removed);
+  }
+
+  ChecksRemoved += Removed;
+  MayFree.clear();
+  Checks.clear();
+  CheckKinds.clear();
+  CheckIndex.clear();
+  Kills.clear();
+  return modified;
+}
+
+}
@@ -139,6 +139,12 @@ INDIRECTCALLCHECKS
  cl::desc("introduce indirect call checks"),
  cl::init(false));
 
+static cl::opt<bool>
+COMPACTMETADATA
+("softboundcets_compact_metadata",
+ cl::desc("use the run-time built with the compact metadata encoding"),
+ cl::init(false));
+
 static cl::opt<bool>
 OPAQUECALLS
 ("softboundcets_opaque_calls",
@@ -785,6 +791,7 @@ bool SoftBoundCETSPass::isFuncDefSoftBound(const std::string &str) {
     m_func_wrappers_available["__ctype_toupper_loc"] = true;
     m_func_wrappers_available["__ctype_tolower_loc"] = true;
     m_func_wrappers_available["qsort"] = true;
+    m_func_wrappers_available["pthread_create"] = true;
     
     m_func_def_softbound["__softboundcets_introspect_metadata"] = true;
     m_func_def_softbound["__softboundcets_copy_metadata"] = true;
@@ -800,6 +807,14 @@ bool SoftBoundCETSPass::isFuncDefSoftBound(const std::string &str) {
     m_func_def_softbound["__softboundcets_deallocate_shadow_stack_space"] = true;
 
     m_func_def_softbound["__softboundcets_trie_allocate"] = true;
+    m_func_def_softbound["__softboundcets_trie_lookup"] = true;
+    m_func_def_softbound["__softboundcets_trie_get_or_allocate"] = true;
+    m_func_def_softbound["__softboundcets_secondary_table_lookup"] = true;
+    m_func_def_softbound["__softboundcets_secondary_table_get_or_allocate"] = true;
+    m_func_def_softbound["__softboundcets_overflow_entry"] = true;
+    m_func_def_softbound["__softboundcets_compact_lock_index"] = true;
+    m_func_def_softbound["__softboundcets_compact_lock"] = true;
+    m_func_def_softbound["__softboundcets_copy_overflow_metadata"] = true;
     m_func_def_softbound["__shrinkBounds"] = true;
     m_func_def_softbound["__softboundcets_spatial_load_dereference_check"] = true;
     m_func_def_softbound["__softboundcets_spatial_store_dereference_check"] = true;
@@ -814,6 +829,9 @@ bool SoftBoundCETSPass::isFuncDefSoftBound(const std::string &str) {
     m_func_def_softbound["__softboundcets_allocation_secondary_trie_allocate"] = true;
     m_func_def_softbound["__softboundcets_allocation_secondary_trie_allocate_range"] = true;
     m_func_def_softbound["__softboundcets_allocate_lock_location"] = true;
+    m_func_def_softbound["__softboundcets_allocate_key"] = true;
+    m_func_def_softbound["__softboundcets_allocate_key_chunk"] = true;
+    m_func_def_softbound["__softboundcets_allocate_lock_chunk"] = true;
     m_func_def_softbound["__softboundcets_memory_deallocation"] = true;
     m_func_def_softbound["__softboundcets_stack_memory_deallocation"] = true;
 
@@ -825,6 +843,9 @@ bool SoftBoundCETSPass::isFuncDefSoftBound(const std::string &str) {
 
     m_func_def_softbound["__softboundcets_global_init"] = true;      
     m_func_def_softbound["__softboundcets_init"] = true;      
+    m_func_def_softbound["__softboundcets_check_metadata_encoding"] = true;
+    m_func_def_softbound["__softboundcets_thread_init"] = true;
+    m_func_def_softbound["__softboundcets_thread_fini"] = true;
     m_func_def_softbound["__softboundcets_abort"] = true;      
     m_func_def_softbound["__softboundcets_printf"] = true;
     
@@ -3498,6 +3519,29 @@ Instruction* SoftBoundCETSPass:: getGlobalInitInstruction(Module& module){
 
 
 
+//
+// Method: addMetadataEncodingCheck()
+//
+// Description: 
+// This function adds a call to the global initializer that checks
+// that the run-time uses the metadata encoding selected for this
+// module, so that a module is never linked with a run-time that
+// lays out the metadata space differently.
+//
+
+void SoftBoundCETSPass::addMetadataEncodingCheck(Module& module) {
+
+  Type* void_ty = Type::getVoidTy(module.getContext());
+  Type* int32_ty = Type::getInt32Ty(module.getContext());
+  Constant* check_function = 
+    module.getOrInsertFunction("__softboundcets_check_metadata_encoding", 
+                               void_ty, int32_ty, NULL);
+
+  SmallVector<Value*, 8> args;
+  args.push_back(ConstantInt::get(int32_ty, COMPACTMETADATA ? 1 : 0));
+  CallInst::Create(check_function, args, "", getGlobalInitInstruction(module));
+}
+
 void SoftBoundCETSPass::handleGEP(GetElementPtrInst* gep_inst) {
   Value* getelementptr_operand = gep_inst->getPointerOperand();
   propagateMetadata(getelementptr_operand, gep_inst, SBCETS_GEP);
@@ -4358,6 +4402,7 @@ bool SoftBoundCETSPass::runOnModule(Module& module) {
   }
   
   initializeSoftBoundVariables(module);
+  addMetadataEncodingCheck(module);
   transformMain(module);
 
   identifyFuncToTrans(module);
@@ -0,0 +1,52 @@
+//===- Parallel.cpp - Run the analysis of SAFECode passes on threads ------===//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the thread count policy of parallelFor().
+//
+//===----------------------------------------------------------------------===//
+
+#include "safecode/Parallel.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Threading.h"
+
+namespace llvm {
+
+// Command line options
+static cl::opt<unsigned>
+AnalysisThreads ("sc-threads",
+                 cl::desc ("Number of threads on which SAFECode passes "
+                           "analyze functions (0 = one per core)"),
+                 cl::init (0));
+
+// The fewest work items worth starting another thread for
+static const unsigned MinItemsPerThread = 16;
+
+//
+// Function: getAnalysisThreads()
+//
+// Description:
+//  Determine how many threads should share the given number of work items.
+//
+unsigned
+getAnalysisThreads (unsigned Items) {
+  if (!llvm_is_multithreaded())
+    return 1;
+
+  unsigned Threads = AnalysisThreads;
+  if (Threads == 0)
+    Threads = std::thread::hardware_concurrency();
+
+  unsigned Useful = Items / MinItemsPerThread;
+  if (Threads > Useful)
+    Threads = Useful;
+  return Threads ? Threads : 1;
+}
+
+}
@@ -0,0 +1,91 @@
+//===- PhaseTimer.cpp - Time the phases of the SAFECode pipeline ----------===//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the pass that times the phases of the SAFECode pass
+// pipeline.
+//
+//===----------------------------------------------------------------------===//
+
+#include "safecode/PhaseTimer.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace llvm {
+
+// The stream to which LLVM prints -time-passes and -stats output
+extern raw_ostream *CreateInfoOutputFile();
+
+char PhaseTimer::ID = 0;
+
+static RegisterPass<PhaseTimer>
+X ("sc-phase-timer", "End the timed SAFECode phases and print their times");
+
+// Command line options
+static cl::opt<bool>
+TimePhases ("sc-time-phases",
+            cl::desc ("Print the compile time of each SAFECode phase"),
+            cl::init (false));
+
+namespace {
+  //
+  // Structure: PhaseTimers
+  //
+  // Description:
+  //  The timers of the phases seen so far and the one that is running.
+  //
+  struct PhaseTimers {
+    TimerGroup Group;
+    StringMap<Timer *> Timers;
+    Timer * Running;
+
+    PhaseTimers () : Group ("SAFECode Phases"), Running (0) {}
+    ~PhaseTimers () {
+      for (StringMap<Timer *>::iterator I = Timers.begin(), E = Timers.end();
+           I != E; ++I)
+        delete I->second;
+    }
+  };
+}
+
+static ManagedStatic<PhaseTimers> Timers;
+
+bool
+PhaseTimer::runOnModule (Module & M) {
+  if (!TimePhases && !TimePassesIsEnabled)
+    return false;
+
+  if (Timers->Running) {
+    Timers->Running->stopTimer();
+    Timers->Running = 0;
+  }
+
+  if (Phase) {
+    Timer *& T = Timers->Timers[Phase];
+    if (!T)
+      T = new Timer (Phase, Timers->Group);
+    T->startTimer();
+    Timers->Running = T;
+  } else {
+    //
+    // Print the phases now rather than at exit since the LTO library may be
+    // unloaded without running the destructors of managed statics.
+    //
+    raw_ostream & OutStream = *CreateInfoOutputFile();
+    Timers->Group.print (OutStream);
+    delete &OutStream;
+  }
+
+  return false;
+}
+
+}
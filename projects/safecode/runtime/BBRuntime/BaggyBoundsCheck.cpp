@@ -24,8 +24,10 @@
 #include "DebugReport.h"
 #include "PoolAllocator.h"
 #include "RewritePtr.h"
+#include "SizeTable.h"
 
 #include "../include/CWE.h"
+#include "../include/SiteCache.h"
 
 #include <cstring>
 #include <cassert>
@@ -80,10 +82,13 @@ unsigned SLOT_SIZE = 4;
 unsigned SLOTSIZE = 16;
 unsigned WORD_SIZE = 64;
 unsigned char * __baggybounds_size_table_begin;
+unsigned char * __baggybounds_page_table_begin;
 #if defined(_LP64)
 const size_t table_size = 1L<<43;
+const size_t page_table_size = 1L<<35;
 #else
 const size_t table_size = 1L<<28;
+const size_t page_table_size = 1L<<20;
 #endif
 
 
@@ -213,17 +218,63 @@ pool_init_runtime(unsigned Dangling, unsigned RewriteOOB, unsigned Terminate) {
     assert(0 && "Table Init Failed");
     abort();
   }
+
+  // Initialize the table of objects larger than a page
+  __baggybounds_page_table_begin =
+    (unsigned char*) mmap(0,
+                          page_table_size,
+                          PROT_READ|PROT_WRITE,
+                          MAP_PRIVATE|MAP_ANON|MAP_NORESERVE,
+                          -1,
+                          0);
+
+  if (__baggybounds_page_table_begin == MAP_FAILED) {
+    fprintf (stderr, "Baggy Bounds Page Table initialization failed!\n");
+    fflush (stderr);
+    assert(0 && "Table Init Failed");
+    abort();
+  }
   //printf("__baggybounds_size_table_begin is %p\n", __baggybounds_size_table_begin);
   return;
 }
 
+//
+// Function: fillTable()
+//
+// Description:
+//  Set the specified number of table entries to the given value.  The number
+//  of entries is a power of two and the first entry is aligned to it, so
+//  small runs of entries can be written a word at a time without calling
+//  memset().
+//
+static inline void
+fillTable (unsigned char * Entry, unsigned char Value, uintptr_t Count) {
+  if (Count < sizeof (uint64_t)) {
+    for (uintptr_t index = 0; index < Count; ++index)
+      Entry[index] = Value;
+    return;
+  }
+
+  if (Count > 8 * sizeof (uint64_t)) {
+    memset (Entry, Value, Count);
+    return;
+  }
+
+  uint64_t Pattern = Value * 0x0101010101010101ull;
+  uint64_t * Word = (uint64_t *) Entry;
+  uint64_t * End = (uint64_t *) (Entry + Count);
+  while (Word != End)
+    *Word++ = Pattern;
+}
+
 //
 // Function: __internal_register
 //
 // Description:
 //   Register the memory starting at the specified pointer of the specified 
 //   size. This function stores the binary logarithm of the aligned size
-//   in the baggy bounds table.
+//   in the baggy bounds table.  Objects larger than a page are recorded with
+//   one entry per page in the page table.
 //
 void
 __internal_register(DebugPoolTy *Pool,
@@ -233,37 +284,64 @@ __internal_register(DebugPoolTy *Pool,
                     const char* SourceFilep,
                     unsigned lineno) {
   uintptr_t Source = (uintptr_t)allocaptr;
-  unsigned char size= 0;
   //
   // Compute the binary logarithm of the aligned size.
   //
-  while((unsigned)(1<<size) < NumBytes) {
-    size++;
-  }
-  //
-  // If size is smaller than SLOT_SIZE, it is set to be SLOT_SIZE.
-  //
-  size = (size < SLOT_SIZE) ? SLOT_SIZE : size;
+  unsigned char size = __baggybounds_log2 (NumBytes);
   //
   // Get the base of the Source.
   //
-  uintptr_t Source1 = Source & ~((1<<size)-1);
+  uintptr_t Source1 = Source & ~((((uintptr_t) 1) << size) - 1);
   if(Source1 != Source) {
     fprintf(stderr, "Memory object %p, %p, %u not aligned\n", (void*)Source,
           (void*)Source1, NumBytes);
     assert(0 && "Memory objects not aligned");
   }
-  Source = Source & ~((1<<size)-1);
-  unsigned long index = Source >> SLOT_SIZE;
-  unsigned range = 1 << (size - SLOT_SIZE);
+  Source = Source1;
 
   //
   // Store the binary logarithm of the aligned size in the baggy bounds table.
   //
-  memset(__baggybounds_size_table_begin + index, size, range);
+  if (size > BB_PAGE_SHIFT) {
+    fillTable (__baggybounds_page_table_begin + (Source >> BB_PAGE_SHIFT),
+               size,
+               ((uintptr_t) 1) << (size - BB_PAGE_SHIFT));
+  } else {
+    fillTable (__baggybounds_size_table_begin + (Source >> SLOT_SIZE),
+               size,
+               ((uintptr_t) 1) << (size - SLOT_SIZE));
+  }
   return;
 }
 
+//
+// Function: __internal_unregister
+//
+// Description:
+//   Remove the object containing the specified pointer from the baggy bounds
+//   table.
+//
+static inline void
+__internal_unregister (void * allocaptr) {
+  uintptr_t Source = (uintptr_t)allocaptr;
+  unsigned char e = __baggybounds_lookup (Source);
+  if (e == 0)
+    return;
+
+  uintptr_t base = Source & ~((((uintptr_t) 1) << e) - 1);
+  if (e > BB_PAGE_SHIFT) {
+    fillTable (__baggybounds_page_table_begin + (base >> BB_PAGE_SHIFT),
+               0,
+               ((uintptr_t) 1) << (e - BB_PAGE_SHIFT));
+  } else {
+    fillTable (__baggybounds_size_table_begin + (base >> SLOT_SIZE),
+               0,
+               ((uintptr_t) 1) << (e - SLOT_SIZE));
+  }
+
+  advanceSiteCacheEpoch ();
+}
+
 //
 // Function: sc_bb_poolargvregister()
 //
@@ -282,11 +360,7 @@ __sc_bb_poolargvregister(int argc, char **argv) {
   //
   // Align the size of argv variable to be a power of 2.
   //
-  while((unsigned)(1<<size) < argv_adjustedsize) {
-      size++;
-  }
-  if (size < SLOT_SIZE)
-    size = SLOT_SIZE;
+  size = __baggybounds_log2 (argv_adjustedsize);
   unsigned int alignedSize = 1 << size;
   
   //
@@ -313,18 +387,13 @@ __sc_bb_poolargvregister(int argc, char **argv) {
     //
     //Adjust the size of each argv string to include its metadata.
     //
-    size = 0;
     unsigned int argv_index_size = (strlen(argv[index])+ 1)*sizeof(char);
     unsigned int adjustedSize = argv_index_size + sizeof(BBMetaData);
    
     //
     // Align the size of each argv string to be a power of 2.
     //
-    while((unsigned)(1<<size) < adjustedSize) {
-      size++;
-    }
-    if (size < SLOT_SIZE)
-      size = SLOT_SIZE;
+    size = __baggybounds_log2 (adjustedSize);
     alignedSize = 1 << size;
     
     //
@@ -527,18 +596,7 @@ __sc_bb_poolunregister_debug (DebugPoolTy *Pool,
                               TAG,
                               const char* SourceFilep,
                               unsigned lineno) {
-  uintptr_t Source = (uintptr_t)allocaptr;
-  unsigned  e;
-  e = __baggybounds_size_table_begin[Source >> SLOT_SIZE];
-  if(e == 0 ) {
-    return;
-  }
-  uintptr_t size = 1 << e;
-  uintptr_t base = Source & ~(size -1);
-  unsigned long index = base >> SLOT_SIZE;
-  unsigned int slots = 1<<(e - SLOT_SIZE);
-
-  memset(__baggybounds_size_table_begin + index, 0, slots);
+  __internal_unregister (allocaptr);
 }
 
 void
@@ -553,18 +611,7 @@ __sc_bb_poolunregister_stack_debug (DebugPoolTy *Pool,
                                     TAG,
                                     const char* SourceFilep,
                                     unsigned lineno) {
-  uintptr_t Source = (uintptr_t)allocaptr;
-
-  unsigned  e;
-  e = __baggybounds_size_table_begin[Source >> SLOT_SIZE];
-  if(e == 0 ) {
-    return;
-  }
-  uintptr_t size = 1 << e;
-  uintptr_t base = Source & ~(size -1);
-  unsigned long index = base >> SLOT_SIZE;
-  unsigned int slots = 1<<(e - SLOT_SIZE);
-  memset(__baggybounds_size_table_begin + index, 0, slots);
+  __internal_unregister (allocaptr);
 }
 
 void *
@@ -572,12 +619,7 @@ __sc_bb_src_poolalloc(DebugPoolTy *Pool,
                       unsigned NumBytes, TAG,
                       const char * SourceFilep,
                       unsigned lineno) {
-  unsigned char size= 0;
-  while((unsigned)(1<<size) < NumBytes) {
-    size++;
-  }
-  if (size < SLOT_SIZE)
-    size = SLOT_SIZE;
+  unsigned char size = __baggybounds_log2 (NumBytes);
   unsigned int alloc = 1 << size;
   void *p;
   int result;
@@ -593,12 +635,7 @@ __sc_bb_poolmemalign(DebugPoolTy *Pool,
                      unsigned Alignment,
                      unsigned NumBytes) {
 
-  unsigned char size= 0;
-  while((unsigned)(1<<size) < NumBytes) {
-    size++;
-  }
-  if (size < SLOT_SIZE)
-    size = SLOT_SIZE;
+  unsigned char size = __baggybounds_log2 (NumBytes);
   if (size < Alignment)
     size = Alignment;
   unsigned int alloc = 1 << size;
@@ -618,11 +655,7 @@ __sc_bb_src_poolcalloc(DebugPoolTy *Pool,
                        const char* SourceFilep,
                        unsigned lineno) {
 
-  unsigned char size= 0;
-  while((unsigned)(1<<size) < (NumBytes*Number)) {
-    size++;
-  }
-  if (size < SLOT_SIZE) size = SLOT_SIZE;
+  unsigned char size = __baggybounds_log2 (NumBytes*Number);
   unsigned int alloc = 1<< size;
   void *p;
   int result;
@@ -676,11 +709,11 @@ __sc_bb_poolrealloc(DebugPoolTy *Pool,
   __sc_bb_poolregister(Pool, New, NumBytes);
 
   uintptr_t Source = (uintptr_t)Node;
-  unsigned  char e = __baggybounds_size_table_begin[Source >> SLOT_SIZE];
-  unsigned int size_old = 1 << e;
+  unsigned  char e = __baggybounds_lookup(Source);
+  uintptr_t size_old = ((uintptr_t) 1) << e;
   uintptr_t Source_new = (uintptr_t)New;
-  unsigned  char e_new = __baggybounds_size_table_begin[Source_new >> SLOT_SIZE];
-  unsigned int size_new = 1 << e_new;
+  unsigned  char e_new = __baggybounds_lookup(Source_new);
+  uintptr_t size_new = ((uintptr_t) 1) << e_new;
 
   if(size_new > size_old)
     memcpy(New, Node, size_old);
@@ -694,12 +727,7 @@ __sc_bb_poolrealloc(DebugPoolTy *Pool,
 
 unsigned char baggybounds_getdata(void* ptr) {
   uintptr_t x = (uintptr_t)ptr;
-  return __baggybounds_size_table_begin[x >> SLOT_SIZE];
-}
-
-void baggybounds_getdata(void* ptr, unsigned char data) {
-  uintptr_t x = (uintptr_t)ptr;
-  __baggybounds_size_table_begin[x >> SLOT_SIZE] = data;
+  return __baggybounds_lookup(x);
 }
 
 void *
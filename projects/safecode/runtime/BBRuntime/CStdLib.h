@@ -21,6 +21,7 @@
 
 #include "DebugReport.h"
 #include "PoolAllocator.h"
+#include "SizeTable.h"
 #include "safecode/Runtime/BBMetaData.h"
 
 #include <iostream>
@@ -34,7 +35,6 @@
 #define DEFAULTS DEFAULT_TAG, DEFAULT_SRC_INFO
 #define SRC_INFO_ARGS SourceFile, lineNo
 
-extern unsigned char* __baggybounds_size_table_begin;
 extern unsigned SLOT_SIZE;
 
 using namespace safecode;
@@ -193,11 +193,10 @@ pool_find(DebugPoolTy *pool, void *address, void *&poolBegin, void *&poolEnd) {
       ExternalObjects->find(address, poolBegin, poolEnd))
     return true;*/
   unsigned char e;
-  e = __baggybounds_size_table_begin[(uintptr_t)address>>SLOT_SIZE];
+  e = __baggybounds_lookup((uintptr_t)address);
   if (e == 0) return false;
-  //if (e > 12) return false;
-  poolBegin =(void *) ((uintptr_t)address & ~((1<<e)-1));
-  BBMetaData *data = (BBMetaData *)((uintptr_t)poolBegin + (1<<e) - sizeof(BBMetaData));
+  poolBegin =(void *) ((uintptr_t)address & ~((((uintptr_t) 1)<<e)-1));
+  BBMetaData *data = (BBMetaData *)((uintptr_t)poolBegin + (((uintptr_t) 1)<<e) - sizeof(BBMetaData));
   if (data->size == 0) return false;
   poolEnd = (void *) ((uintptr_t)poolBegin + data->size);
   return true;
@@ -16,6 +16,7 @@
 #include "ConfigData.h"
 #include "PoolAllocator.h"
 #include "RewritePtr.h"
+#include "SizeTable.h"
 
 #include "safecode/Config/config.h"
 #include "safecode/Runtime/BBRuntime.h"
@@ -26,7 +27,6 @@
 #include <cstdio>
 
 extern FILE * ReportLog;
-extern unsigned char* __baggybounds_size_table_begin;
 extern unsigned SLOT_SIZE;
 
 using namespace NAMESPACE_SC;
@@ -160,10 +160,10 @@ exactcheck_check (void * Source,
      * Retrieve the original bounds of the object.
      */
     unsigned char e;
-    e = __baggybounds_size_table_begin[(uintptr_t)RealSrc >> SLOT_SIZE];
+    e = __baggybounds_lookup((uintptr_t)RealSrc);
 
-    uintptr_t RealObjStart = (uintptr_t)RealSrc & ~((1<<e)-1);
-    BBMetaData *data = (BBMetaData*)(RealObjStart + (1<<e) - sizeof(BBMetaData));
+    uintptr_t RealObjStart = (uintptr_t)RealSrc & ~((((uintptr_t) 1)<<e)-1);
+    BBMetaData *data = (BBMetaData*)(RealObjStart + (((uintptr_t) 1)<<e) - sizeof(BBMetaData));
     uintptr_t RealObjEnd = RealObjStart + data->size - 1;
 
 
@@ -21,11 +21,14 @@
 #include "DebugReport.h"
 #include "PoolAllocator.h"
 #include "RewritePtr.h"
+#include "SizeTable.h"
 
 #include "safecode/Runtime/BBMetaData.h"
 #include "safecode/Runtime/BBRuntime.h"
 
 #include "../include/CWE.h"
+#include "../include/SiteCache.h"
+#include "../include/TargetSet.h"
 
 #include <map>
 #include <cstdarg>
@@ -38,7 +41,6 @@
 #include <stdio.h>
 
 extern FILE * ReportLog;
-extern unsigned char* __baggybounds_size_table_begin; 
 extern unsigned SLOT_SIZE;
 extern unsigned SLOTSIZE;
 extern unsigned WORD_SIZE;
@@ -65,19 +67,14 @@ _barebone_pointers_in_bounds(uintptr_t Source, uintptr_t Dest) {
   // Look for the bounds in the table.
   //
   unsigned char e;
-  e = __baggybounds_size_table_begin[Source >> SLOT_SIZE];
+  e = __baggybounds_lookup(Source);
   // The object is not registed, so it cannot be checked.
   if (e == 0) return 0; 
   //
-  // Currently we does not support alignment that is larger than one page size
-  // in 32bit Linux
-  //
-  if (e > 12) return 0;
-  //
   // Get the bounds for the object in which Source was found.
   //
-  uintptr_t begin = Source & ~((1<<e)-1);
-  BBMetaData *data = (BBMetaData*)(begin + (1<<e) - sizeof(BBMetaData));
+  uintptr_t begin = Source & ~((((uintptr_t) 1)<<e)-1);
+  BBMetaData *data = (BBMetaData*)(begin + (((uintptr_t) 1)<<e) - sizeof(BBMetaData));
   if (data->size == 0) return 0;
   uintptr_t end = begin + data->size;
   //
@@ -180,15 +177,15 @@ bb_poolcheck_debug (DebugPoolTy *Pool,
   // object.  If so, then the check succeeds, so just return to the caller.
   //
   unsigned char e;
-  e = __baggybounds_size_table_begin[(uintptr_t)Node >> SLOT_SIZE];
+  e = __baggybounds_lookup((uintptr_t)Node);
   if (e == 0) return;
 
-  uintptr_t ObjStart = (uintptr_t)Node & ~((1<<e)-1);
-  BBMetaData *data = (BBMetaData*)(ObjStart + (1<<e) - sizeof(BBMetaData));
+  uintptr_t ObjStart = (uintptr_t)Node & ~((((uintptr_t) 1)<<e)-1);
+  BBMetaData *data = (BBMetaData*)(ObjStart + (((uintptr_t) 1)<<e) - sizeof(BBMetaData));
   uintptr_t ObjEnd = ObjStart + data->size - 1;
 
   uintptr_t NodeEnd = (uintptr_t)Node + length -1;
-  if (!(ObjStart <= NodeEnd) && (NodeEnd <= ObjEnd)) {
+  if (!((ObjStart <= NodeEnd) && (NodeEnd <= ObjEnd))) {
     DebugViolationInfo v;
     v.type = ViolationInfo::FAULT_LOAD_STORE,
     v.faultPC = __builtin_return_address(0),
@@ -236,15 +233,15 @@ bb_poolcheckui_debug (DebugPoolTy *Pool,
   // object.  If so, then the check succeeds, so just return to the caller.
   //
   unsigned char e;
-  e = __baggybounds_size_table_begin[(uintptr_t)Node >> SLOT_SIZE];
+  e = __baggybounds_lookup((uintptr_t)Node);
   if (e == 0) return;
 
-  uintptr_t ObjStart = (uintptr_t)Node & ~((1<<e)-1);
-  BBMetaData *data = (BBMetaData*)(ObjStart + (1<<e) - sizeof(BBMetaData));
+  uintptr_t ObjStart = (uintptr_t)Node & ~((((uintptr_t) 1)<<e)-1);
+  BBMetaData *data = (BBMetaData*)(ObjStart + (((uintptr_t) 1)<<e) - sizeof(BBMetaData));
   uintptr_t ObjEnd = ObjStart + data->size - 1;
 
   uintptr_t NodeEnd = (uintptr_t)Node + length -1;
-  if (!(ObjStart <= NodeEnd) && (NodeEnd <= ObjEnd)) {
+  if (!((ObjStart <= NodeEnd) && (NodeEnd <= ObjEnd))) {
     DebugViolationInfo v;
     v.type = ViolationInfo::FAULT_LOAD_STORE,
     v.faultPC = __builtin_return_address(0),
@@ -424,6 +421,46 @@ bb_poolcheckalign (DebugPoolTy *Pool, void *Node, unsigned Offset) {
   bb_poolcheckalign_debug(Pool, Node, Offset, 0, NULL, 0);
 }
 
+// The epoch of the caches of the check sites in instrumented code
+uintptr_t __sc_site_cache_epoch = 1;
+
+// Whether instrumented code has filled a site cache yet
+unsigned __sc_site_caches_used = 0;
+
+//
+// Function: __sc_fill_site_cache()
+//
+// Description:
+//  Cache the object containing the specified pointer in the cache of a check
+//  site.  Pointers that are not within a registered object are not cached;
+//  the checks accept them without knowing their object.
+//
+// Inputs:
+//  Pool  - The pool argument of the check.
+//  Node  - The pointer that missed in the cache.
+//  Cache - The cache of the check site.
+//
+void
+__sc_fill_site_cache (void * Pool, void * Node, SiteCache * Cache) {
+  useSiteCaches ();
+  uintptr_t Epoch = readSiteCacheEpoch ();
+
+  unsigned char e = __baggybounds_lookup ((uintptr_t) Node);
+  if (e == 0)
+    return;
+
+  uintptr_t ObjStart = (uintptr_t)Node & ~((((uintptr_t) 1)<<e)-1);
+  BBMetaData *data = (BBMetaData*)(ObjStart + (((uintptr_t) 1)<<e) - sizeof(BBMetaData));
+  if (data->size == 0)
+    return;
+
+  Cache->Pool = Pool;
+  Cache->lower = (void *) ObjStart;
+  Cache->upper = (void *) (ObjStart + data->size);
+  Cache->Epoch = Epoch;
+  return;
+}
+
 /*void *
 pchk_getActualValue (DebugPoolTy * Pool, void * ptr) {
   uintptr_t Source = (uintptr_t)ptr;
@@ -470,6 +507,38 @@ __sc_bb_funccheck (void *f,
   return;
 }
 
+//
+// Function: __sc_bb_funccheck_set()
+//
+// Description:
+//  Determine whether the specified function pointer is one of the functions
+//  in the given set.
+//
+// Inputs:
+//  f         - The function pointer that we are testing.
+//  Set       - The set of potential targets.
+//
+extern "C" void
+__sc_bb_funccheck_set (void *f,
+                       TargetSet * Set,
+                       TAG,
+                       const char * SourceFilep,
+                       unsigned lineno) {
+  if (isInTargetSet (f, Set))
+    return;
+
+  DebugViolationInfo v;
+  v.type = ViolationInfo::FAULT_CALL,
+    v.faultPC = __builtin_return_address(0),
+    v.faultPtr = f,
+    v.CWE = CWEBufferOverflow,
+    v.SourceFile = SourceFilep,
+    v.lineNo = lineno;
+
+  ReportMemoryViolation(&v);
+  return;
+}
+
 //
 // Function: fastlscheck()
 //
@@ -546,10 +615,10 @@ bb_poolcheck_freeui_debug (DebugPoolTy *Pool,
   // debug information since we're in debug mode.
   //
   unsigned char e;
-  e = __baggybounds_size_table_begin[(uintptr_t)ptr >> SLOT_SIZE];
+  e = __baggybounds_lookup((uintptr_t)ptr);
 
-  uintptr_t ObjStart = (uintptr_t)ptr & ~((1<<e)-1);
-  BBMetaData *data = (BBMetaData*)(ObjStart + (1<<e) - sizeof(BBMetaData));
+  uintptr_t ObjStart = (uintptr_t)ptr & ~((((uintptr_t) 1)<<e)-1);
+  BBMetaData *data = (BBMetaData*)(ObjStart + (((uintptr_t) 1)<<e) - sizeof(BBMetaData));
   uintptr_t ObjLen = data->size;
 
   //
@@ -671,6 +740,39 @@ funccheck_debug (void *f,
   return;
 }
 
+//
+// Function: funccheck_set()
+//
+// Description:
+//  Determine whether the specified function pointer is one of the functions
+//  in the given set.
+//
+// Inputs:
+//  f         - The function pointer that we are testing.
+//  Set       - The set of potential targets.
+//
+extern "C" void
+funccheck_set (void *f, TargetSet * Set) {
+  __sc_bb_funccheck_set(f, Set, 0, NULL, 0);
+  return;
+}
+
+//
+// Function: funccheck_set_debug()
+//
+// Description:
+//  This is the debug version of funccheck_set().
+//
+extern "C" void
+funccheck_set_debug (void *f,
+                     TargetSet * Set,
+                     TAG,
+                     const char * SourceFilep,
+                     unsigned lineno) {
+  __sc_bb_funccheck_set(f, Set, 0, SourceFilep, lineno);
+  return;
+}
+
 //
 // Function: funccheckui()
 //
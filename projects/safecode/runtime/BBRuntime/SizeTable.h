@@ -0,0 +1,62 @@
+//===- SizeTable.h - Baggy bounds size tables -------------------*- C++ -*-===//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the tables that record the binary logarithm of the
+// aligned size of every registered object.
+//
+// Objects of at most one page are recorded in the slot table, which has one
+// entry for every 16 byte slot of memory.  Larger objects are recorded in the
+// page table, which has one entry for every page, so that registering them
+// costs one table byte per page instead of one per slot.  A lookup examines
+// the page table only if the slot table has no entry for the address.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _BB_SIZETABLE_H_
+#define _BB_SIZETABLE_H_
+
+#include <stdint.h>
+
+extern unsigned char * __baggybounds_size_table_begin;
+extern unsigned char * __baggybounds_page_table_begin;
+extern unsigned SLOT_SIZE;
+
+// The log2 of the number of bytes covered by an entry of the page table
+static const unsigned BB_PAGE_SHIFT = 12;
+
+//
+// Function: __baggybounds_log2()
+//
+// Description:
+//  Return the binary logarithm of the specified size rounded up to a power of
+//  two, but no smaller than SLOT_SIZE.
+//
+static inline unsigned char
+__baggybounds_log2 (uintptr_t NumBytes) {
+  if (NumBytes <= (((uintptr_t) 1) << SLOT_SIZE))
+    return SLOT_SIZE;
+  return (sizeof (unsigned long) * 8) - __builtin_clzl (NumBytes - 1);
+}
+
+//
+// Function: __baggybounds_lookup()
+//
+// Description:
+//  Return the binary logarithm of the aligned size of the object containing
+//  the specified address or 0 if no object is registered there.
+//
+static inline unsigned char
+__baggybounds_lookup (uintptr_t p) {
+  unsigned char e = __baggybounds_size_table_begin[p >> SLOT_SIZE];
+  if (__builtin_expect (e != 0, 1))
+    return e;
+  return __baggybounds_page_table_begin[p >> BB_PAGE_SHIFT];
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include <unistd.h>
 #include "safecode/Runtime/BBRuntime.h"
+#include "../include/GlobalTable.h"
 
 #define TAG unsigned tag
 using namespace NAMESPACE_SC;
@@ -44,6 +45,22 @@ pool_register_global_debug (DebugPoolTy *Pool,
   __sc_bb_src_poolregister_global_debug(Pool, allocaptr, NumBytes, tag, SourceFilep, lineno);
 }
 
+//
+// Function: pool_register_globals()
+//
+// Description:
+//  Register the globals of a table made by the RegisterGlobalVariables pass.
+//  Baggy bounds registration only writes the size table, so there is nothing
+//  to gain from sorting the table first.
+//
+extern "C" void
+pool_register_globals (GlobalTableEntry * Table, unsigned Count) {
+  for (unsigned index = 0; index < Count; ++index)
+    __sc_bb_poolregister_global((DebugPoolTy *) Table[index].Pool,
+                                Table[index].Start,
+                                Table[index].Size);
+}
+
 extern "C" void
 pool_unregister (DebugPoolTy *Pool, void * allocaptr) {
   __sc_bb_poolunregister(Pool, allocaptr);
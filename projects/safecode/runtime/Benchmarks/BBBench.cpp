@@ -0,0 +1,146 @@
+//===- BBBench.cpp - Microbenchmarks of the baggy bounds checks -----------===//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file measures the cost of the checks of the baggy bounds run-time for
+// varying numbers and sizes of registered objects.
+//
+//===----------------------------------------------------------------------===//
+
+#include "safecode/Runtime/BBRuntime.h"
+#include "safecode/Runtime/BBMetaData.h"
+
+#include "../include/SiteCache.h"
+
+#include "BenchSupport.h"
+
+using namespace NAMESPACE_SC;
+
+// The baggy bounds run-time keeps one table for all pools
+static DebugPoolTy * const Pool = 0;
+
+// The site caches of the checks measured with an inlined cache test
+static __thread SiteCache PoolcheckCache;
+static __thread SiteCache BoundscheckCache;
+
+//
+// Function: siteCacheHit()
+//
+// Description:
+//  Test the range [lo, hi) against a site cache the way that the code emitted
+//  by the InlineFastChecks pass with -inline-cached-checks does.
+//
+static inline bool
+siteCacheHit (SiteCache * Cache, void * Pool, char * lo, char * hi) {
+  uintptr_t Epoch = __atomic_load_n (&__sc_site_cache_epoch, __ATOMIC_RELAXED);
+  return (Cache->Pool == Pool) && (Cache->Epoch == Epoch) &&
+         ((char *) Cache->lower <= lo) && (lo <= hi) &&
+         (hi <= (char *) Cache->upper);
+}
+
+static void
+loopNone (BenchWorkload * W, unsigned long ops) {
+  for (unsigned long i = 0; i < ops; ++i) {
+    char * obj = W->Objects[benchNext (W)];
+    benchTouch (obj + benchOffset (W, i));
+  }
+}
+
+static void
+loopPoolcheck (BenchWorkload * W, unsigned long ops) {
+  for (unsigned long i = 0; i < ops; ++i) {
+    char * p = W->Objects[benchNext (W)] + benchOffset (W, i);
+    bb_poolcheck (Pool, p);
+    benchTouch (p);
+  }
+}
+
+static void
+loopBoundscheck (BenchWorkload * W, unsigned long ops) {
+  for (unsigned long i = 0; i < ops; ++i) {
+    char * obj = W->Objects[benchNext (W)];
+    char * p = (char *) bb_boundscheck (Pool, obj, obj + benchOffset (W, i));
+    benchTouch (p);
+  }
+}
+
+static void
+loopPoolcheckCached (BenchWorkload * W, unsigned long ops) {
+  for (unsigned long i = 0; i < ops; ++i) {
+    char * p = W->Objects[benchNext (W)] + benchOffset (W, i);
+    if (!siteCacheHit (&PoolcheckCache, Pool, p, p + 1)) {
+      bb_poolcheck (Pool, p);
+      __sc_fill_site_cache (Pool, p, &PoolcheckCache);
+    }
+    benchTouch (p);
+  }
+}
+
+static void
+loopBoundscheckCached (BenchWorkload * W, unsigned long ops) {
+  for (unsigned long i = 0; i < ops; ++i) {
+    char * obj = W->Objects[benchNext (W)];
+    char * p = obj + benchOffset (W, i);
+    if (!(siteCacheHit (&BoundscheckCache, Pool, obj, obj + 1) &&
+          siteCacheHit (&BoundscheckCache, Pool, p, p + 1))) {
+      p = (char *) bb_boundscheck (Pool, obj, p);
+      __sc_fill_site_cache (Pool, obj, &BoundscheckCache);
+    }
+    benchTouch (p);
+  }
+}
+
+int
+main (int argc, char ** argv) {
+  BenchOptions Opts;
+  benchParseOptions (argc, argv, &Opts);
+  pool_init_runtime (0, 0, 0);
+
+  for (unsigned c = 0; c < BENCH_NUM_COUNTS; ++c) {
+    for (unsigned s = 0; s < BENCH_NUM_SIZES; ++s) {
+      BenchWorkload W;
+      W.NumObjects = BenchObjectCounts[c];
+      W.Size = BenchObjectSizes[s];
+      W.Objects = (char **) malloc (W.NumObjects * sizeof (char *));
+
+      //
+      // Allocate and register the objects the way that instrumented code
+      // does: the allocation has room for the object's meta-data, which
+      // records the size of the object at the end of its aligned slot.
+      //
+      for (unsigned index = 0; index < W.NumObjects; ++index) {
+        unsigned Size = W.Size + sizeof (BBMetaData);
+        unsigned AlignedSize = 1;
+        while (AlignedSize < Size)
+          AlignedSize <<= 1;
+        W.Objects[index] = (char *) __sc_bb_poolalloc (Pool, Size);
+        memset (W.Objects[index], 0, Size);
+        __sc_bb_poolregister (Pool, W.Objects[index], W.Size);
+
+        char * End = W.Objects[index] + AlignedSize;
+        ((BBMetaData *) (End - sizeof (BBMetaData)))->size = W.Size;
+      }
+
+      benchMeasureAll (&Opts, "bb", "none", &W, loopNone);
+      benchMeasureAll (&Opts, "bb", "bb_poolcheck", &W, loopPoolcheck);
+      benchMeasureAll (&Opts, "bb", "bb_boundscheck", &W, loopBoundscheck);
+      benchMeasureAll (&Opts, "bb", "bb_poolcheck_cached", &W,
+                       loopPoolcheckCached);
+      benchMeasureAll (&Opts, "bb", "bb_boundscheck_cached", &W,
+                       loopBoundscheckCached);
+
+      for (unsigned index = 0; index < W.NumObjects; ++index) {
+        __sc_bb_poolunregister (Pool, W.Objects[index]);
+        __sc_bb_poolfree (Pool, W.Objects[index]);
+      }
+      free (W.Objects);
+    }
+  }
+
+  return 0;
+}
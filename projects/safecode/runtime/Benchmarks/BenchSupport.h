@@ -0,0 +1,300 @@
+/*===- BenchSupport.h - Support code for the run-time check benchmarks ----===*/
+/*                                                                            */
+/*                          The SAFECode Compiler                             */
+/*                                                                            */
+/* This file was developed by the LLVM research group and is distributed      */
+/* under the University of Illinois Open Source License. See LICENSE.TXT for  */
+/* details.                                                                   */
+/*                                                                            */
+/*===----------------------------------------------------------------------===*/
+/*                                                                            */
+/* This file defines the workloads, timers, and output format shared by the   */
+/* microbenchmarks of the run-time checks.  It is written in C so that it can */
+/* be used by the benchmarks of both the C and the C++ run-time libraries.    */
+/*                                                                            */
+/* Every measurement is printed as one line of comma separated values:        */
+/*                                                                            */
+/*   runtime,check,objects,size,locality,ops,ns_per_op,misses_per_op          */
+/*                                                                            */
+/* The cache miss count is "NA" if the hardware counter cannot be read.  The  */
+/* check "none" measures the workload with no check and is the cost that the  */
+/* other checks of the same configuration should be compared against.        */
+/*                                                                            */
+/*===----------------------------------------------------------------------===*/
+
+#ifndef _SC_BENCHSUPPORT_H
+#define _SC_BENCHSUPPORT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+/* The order in which a workload visits its objects */
+enum {
+  BENCH_SAME,      /* Every access is to the same object */
+  BENCH_SEQUENTIAL,/* Objects are visited in the order in which they were made */
+  BENCH_RANDOM,    /* Objects are visited in a pseudo-random order */
+  BENCH_NUM_LOCALITIES
+};
+
+static const char * const BenchLocalityNames[BENCH_NUM_LOCALITIES] = {
+  "same", "sequential", "random"
+};
+
+/* The numbers of live objects and the object sizes that are measured */
+static const unsigned BenchObjectCounts[] = {16, 1024, 16384};
+static const unsigned BenchObjectSizes[] = {16, 256, 4096};
+#define BENCH_NUM_COUNTS (sizeof (BenchObjectCounts) / sizeof (unsigned))
+#define BENCH_NUM_SIZES  (sizeof (BenchObjectSizes) / sizeof (unsigned))
+
+/* The numbers of targets of the measured indirect function call checks */
+static const unsigned BenchTargetCounts[] = {1, 4, 16, 64, 256, 1024};
+#define BENCH_NUM_TARGETS (sizeof (BenchTargetCounts) / sizeof (unsigned))
+
+/*
+ * Structure: BenchWorkload
+ *
+ * Description:
+ *  A set of live objects of the same size and the state of a walk over them.
+ *  The size of the objects is a power of two so that offsets within an object
+ *  can be computed with a mask.
+ */
+typedef struct BenchWorkload {
+  char ** Objects;
+  unsigned NumObjects;
+  unsigned Size;
+  unsigned Locality;
+
+  /* The state of the walk; reset before every measurement */
+  unsigned Cursor;
+  uint64_t Seed;
+} BenchWorkload;
+
+/*
+ * Structure: BenchOptions
+ *
+ * Description:
+ *  The options given on the command line of a benchmark.
+ *
+ *  -o <ops>  - The number of checks performed by each measurement.
+ *  -r <runs> - The number of measurements of which the fastest is reported.
+ *  -H        - Do not print the header line.
+ */
+typedef struct BenchOptions {
+  unsigned long Ops;
+  unsigned Runs;
+  int Header;
+} BenchOptions;
+
+/* The signature of a loop that performs the given number of checks */
+typedef void (*BenchLoop) (BenchWorkload * W, unsigned long ops);
+
+/*
+ * Function: benchNext()
+ *
+ * Description:
+ *  Return the index of the next object visited by the workload.
+ */
+static inline unsigned
+benchNext (BenchWorkload * W) {
+  switch (W->Locality) {
+    case BENCH_SAME:
+      return 0;
+    case BENCH_SEQUENTIAL:
+      if (++(W->Cursor) == W->NumObjects)
+        W->Cursor = 0;
+      return W->Cursor;
+    default:
+      W->Seed = W->Seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      return (unsigned) ((W->Seed >> 33) % W->NumObjects);
+  }
+}
+
+/*
+ * Function: benchOffset()
+ *
+ * Description:
+ *  Return the offset within an object of the access made by the ith check.
+ *  Successive checks touch successive words of the object.
+ */
+static inline unsigned
+benchOffset (BenchWorkload * W, unsigned long i) {
+  return (unsigned) ((i * sizeof (void *)) & (W->Size - 1));
+}
+
+/*
+ * Function: benchParseOptions()
+ *
+ * Description:
+ *  Read the command line options of a benchmark; exit on an invalid option.
+ */
+static inline void
+benchParseOptions (int argc, char ** argv, BenchOptions * Opts) {
+  int opt;
+
+  Opts->Ops = 1ul << 20;
+  Opts->Runs = 3;
+  Opts->Header = 1;
+  while ((opt = getopt (argc, argv, "o:r:H")) != -1) {
+    switch (opt) {
+      case 'o':
+        Opts->Ops = strtoul (optarg, 0, 0);
+        break;
+      case 'r':
+        Opts->Runs = (unsigned) strtoul (optarg, 0, 0);
+        break;
+      case 'H':
+        Opts->Header = 0;
+        break;
+      default:
+        fprintf (stderr, "usage: %s [-o ops] [-r runs] [-H]\n", argv[0]);
+        exit (1);
+    }
+  }
+
+  if (Opts->Ops == 0)
+    Opts->Ops = 1;
+  if (Opts->Runs == 0)
+    Opts->Runs = 1;
+  if (Opts->Header)
+    printf ("runtime,check,objects,size,locality,ops,ns_per_op,misses_per_op\n");
+}
+
+/*
+ * Function: benchNow()
+ *
+ * Description:
+ *  Return the value of a monotonic clock in nanoseconds.
+ */
+static inline double
+benchNow (void) {
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * Function: benchOpenCounter()
+ *
+ * Description:
+ *  Open a counter of the cache misses of the calling thread.
+ *
+ * Return value:
+ *  -1 - The hardware counter is not available.
+ *  Otherwise, the file descriptor of the counter is returned.
+ */
+static inline int
+benchOpenCounter (void) {
+#ifdef __linux__
+  struct perf_event_attr attr;
+  memset (&attr, 0, sizeof (attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof (attr);
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int) syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+  return -1;
+#endif
+}
+
+/*
+ * Function: benchMeasure()
+ *
+ * Description:
+ *  Run the loop of a check over a workload and print the fastest of several
+ *  measurements.  A shorter run precedes the measurements so that the caches
+ *  and the run-time's own data structures are warm.
+ */
+static inline void
+benchMeasure (const BenchOptions * Opts, const char * Runtime,
+              const char * Check, BenchWorkload * W, BenchLoop Loop) {
+  static int Counter = -2;
+  double Best = 0;
+  uint64_t BestMisses = 0;
+  unsigned run;
+
+  if (Counter == -2)
+    Counter = benchOpenCounter ();
+
+  W->Cursor = 0;
+  W->Seed = 1;
+  Loop (W, Opts->Ops / 8 + 1);
+
+  for (run = 0; run < Opts->Runs; ++run) {
+    uint64_t Misses = 0;
+    double Start;
+    double Elapsed;
+
+    W->Cursor = 0;
+    W->Seed = 1;
+#ifdef __linux__
+    if (Counter != -1) {
+      ioctl (Counter, PERF_EVENT_IOC_RESET, 0);
+      ioctl (Counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+    Start = benchNow ();
+    Loop (W, Opts->Ops);
+    Elapsed = benchNow () - Start;
+#ifdef __linux__
+    if (Counter != -1) {
+      ioctl (Counter, PERF_EVENT_IOC_DISABLE, 0);
+      if (read (Counter, &Misses, sizeof (Misses)) != sizeof (Misses))
+        Misses = 0;
+    }
+#endif
+
+    if ((run == 0) || (Elapsed < Best)) {
+      Best = Elapsed;
+      BestMisses = Misses;
+    }
+  }
+
+  printf ("%s,%s,%u,%u,%s,%lu,%.2f,", Runtime, Check, W->NumObjects, W->Size,
+          BenchLocalityNames[W->Locality], Opts->Ops, Best / Opts->Ops);
+  if (Counter == -1)
+    printf ("NA\n");
+  else
+    printf ("%.3f\n", (double) BestMisses / Opts->Ops);
+  fflush (stdout);
+}
+
+/*
+ * Function: benchMeasureAll()
+ *
+ * Description:
+ *  Measure the loop of a check over the workload with every locality.
+ */
+static inline void
+benchMeasureAll (const BenchOptions * Opts, const char * Runtime,
+                 const char * Check, BenchWorkload * W, BenchLoop Loop) {
+  for (W->Locality = 0; W->Locality < BENCH_NUM_LOCALITIES; ++(W->Locality))
+    benchMeasure (Opts, Runtime, Check, W, Loop);
+}
+
+/*
+ * Function: benchTouch()
+ *
+ * Description:
+ *  Access a byte in the way a checked load would.  The loops of the checks
+ *  make the access that they check so that their cost can be compared with
+ *  the loop of the "none" check.
+ */
+static inline void
+benchTouch (const char * p) {
+  __asm__ __volatile__ ("" : : "r" (*(const volatile char *) p));
+}
+
+#endif
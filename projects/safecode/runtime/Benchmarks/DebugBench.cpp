@@ -0,0 +1,218 @@
+//===- DebugBench.cpp - Microbenchmarks of the DebugRuntime checks --------===//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file measures the cost of the checks of the DebugRuntime for pools
+// with varying numbers and sizes of registered objects.
+//
+//===----------------------------------------------------------------------===//
+
+#include "../include/DebugRuntime.h"
+#include "../include/SiteCache.h"
+#include "../include/TargetSet.h"
+
+#include "BenchSupport.h"
+
+using namespace llvm;
+
+// The pool in which the objects of the current workload are registered
+static DebugPoolTy * Pool;
+
+// The site caches of the checks measured with an inlined cache test
+static __thread SiteCache PoolcheckCache;
+static __thread SiteCache BoundscheckCache;
+
+// The targets of the indirect function call check, terminated by null
+static void * Targets[1025];
+static char TargetFunctions[1024];
+
+// The same targets as a TargetSet, with room for the sorted copy
+static uintptr_t TargetSetSpace[2 + 2 * 1024];
+static TargetSet * Set = (TargetSet *) TargetSetSpace;
+
+//
+// Function: siteCacheHit()
+//
+// Description:
+//  Test the range [lo, hi) against a site cache the way that the code emitted
+//  by the InlineFastChecks pass with -inline-cached-checks does.
+//
+static inline bool
+siteCacheHit (SiteCache * Cache, void * Pool, char * lo, char * hi) {
+  uintptr_t Epoch = __atomic_load_n (&__sc_site_cache_epoch, __ATOMIC_RELAXED);
+  return (Cache->Pool == Pool) && (Cache->Epoch == Epoch) &&
+         ((char *) Cache->lower <= lo) && (lo <= hi) &&
+         (hi <= (char *) Cache->upper);
+}
+
+static void
+loopNone (BenchWorkload * W, unsigned long ops) {
+  for (unsigned long i = 0; i < ops; ++i) {
+    char * obj = W->Objects[benchNext (W)];
+    benchTouch (obj + benchOffset (W, i));
+  }
+}
+
+static void
+loopPoolcheck (BenchWorkload * W, unsigned long ops) {
+  for (unsigned long i = 0; i < ops; ++i) {
+    char * p = W->Objects[benchNext (W)] + benchOffset (W, i);
+    poolcheck (Pool, p, 1);
+    benchTouch (p);
+  }
+}
+
+static void
+loopBoundscheck (BenchWorkload * W, unsigned long ops) {
+  for (unsigned long i = 0; i < ops; ++i) {
+    char * obj = W->Objects[benchNext (W)];
+    char * p = (char *) boundscheck (Pool, obj, obj + benchOffset (W, i));
+    benchTouch (p);
+  }
+}
+
+static void
+loopPoolcheckCached (BenchWorkload * W, unsigned long ops) {
+  for (unsigned long i = 0; i < ops; ++i) {
+    char * p = W->Objects[benchNext (W)] + benchOffset (W, i);
+    if (!siteCacheHit (&PoolcheckCache, Pool, p, p + 1)) {
+      poolcheck (Pool, p, 1);
+      __sc_fill_site_cache (Pool, p, &PoolcheckCache);
+    }
+    benchTouch (p);
+  }
+}
+
+static void
+loopBoundscheckCached (BenchWorkload * W, unsigned long ops) {
+  for (unsigned long i = 0; i < ops; ++i) {
+    char * obj = W->Objects[benchNext (W)];
+    char * p = obj + benchOffset (W, i);
+    if (!(siteCacheHit (&BoundscheckCache, Pool, obj, obj + 1) &&
+          siteCacheHit (&BoundscheckCache, Pool, p, p + 1))) {
+      p = (char *) boundscheck (Pool, obj, p);
+      __sc_fill_site_cache (Pool, obj, &BoundscheckCache);
+    }
+    benchTouch (p);
+  }
+}
+
+static void
+loopExactcheck2 (BenchWorkload * W, unsigned long ops) {
+  for (unsigned long i = 0; i < ops; ++i) {
+    char * obj = W->Objects[benchNext (W)];
+    char * p = (char *) exactcheck2 (obj, obj, obj + benchOffset (W, i),
+                                     W->Size);
+    benchTouch (p);
+  }
+}
+
+static void
+loopFastlscheck (BenchWorkload * W, unsigned long ops) {
+  for (unsigned long i = 0; i < ops; ++i) {
+    char * obj = W->Objects[benchNext (W)];
+    char * p = obj + benchOffset (W, i);
+    fastlscheck (obj, p, W->Size, 1);
+    benchTouch (p);
+  }
+}
+
+//
+// Function: loopFunccheck()
+//
+// Description:
+//  Check calls through pointers to the targets of the workload.  The objects
+//  of the workload are the target functions themselves.
+//
+static void
+loopFunccheck (BenchWorkload * W, unsigned long ops) {
+  for (unsigned long i = 0; i < ops; ++i)
+    funccheck (W->Objects[benchNext (W)], Targets);
+}
+
+//
+// Function: loopFunccheckSet()
+//
+// Description:
+//  Check calls through pointers to the targets of the workload against a
+//  sorted set of the targets.
+//
+static void
+loopFunccheckSet (BenchWorkload * W, unsigned long ops) {
+  for (unsigned long i = 0; i < ops; ++i)
+    funccheck_set (W->Objects[benchNext (W)], Set);
+}
+
+int
+main (int argc, char ** argv) {
+  BenchOptions Opts;
+  benchParseOptions (argc, argv, &Opts);
+  pool_init_runtime (0, 0, 0);
+
+  for (unsigned c = 0; c < BENCH_NUM_COUNTS; ++c) {
+    for (unsigned s = 0; s < BENCH_NUM_SIZES; ++s) {
+      BenchWorkload W;
+      W.NumObjects = BenchObjectCounts[c];
+      W.Size = BenchObjectSizes[s];
+      W.Objects = (char **) malloc (W.NumObjects * sizeof (char *));
+
+      Pool = (DebugPoolTy *) __sc_dbg_newpool (0);
+      for (unsigned index = 0; index < W.NumObjects; ++index) {
+        W.Objects[index] = (char *) calloc (1, W.Size);
+        pool_register (Pool, W.Objects[index], W.Size);
+      }
+
+      benchMeasureAll (&Opts, "debug", "none", &W, loopNone);
+      benchMeasureAll (&Opts, "debug", "poolcheck", &W, loopPoolcheck);
+      benchMeasureAll (&Opts, "debug", "boundscheck", &W, loopBoundscheck);
+      benchMeasureAll (&Opts, "debug", "poolcheck_cached", &W,
+                       loopPoolcheckCached);
+      benchMeasureAll (&Opts, "debug", "boundscheck_cached", &W,
+                       loopBoundscheckCached);
+      benchMeasureAll (&Opts, "debug", "exactcheck2", &W, loopExactcheck2);
+      benchMeasureAll (&Opts, "debug", "fastlscheck", &W, loopFastlscheck);
+
+      for (unsigned index = 0; index < W.NumObjects; ++index) {
+        pool_unregister (Pool, W.Objects[index]);
+        free (W.Objects[index]);
+      }
+      __sc_dbg_pooldestroy (Pool);
+      free (W.Objects);
+    }
+  }
+
+  //
+  // The cost of a function call check depends only on the number of targets.
+  //
+  for (unsigned t = 0; t < BENCH_NUM_TARGETS; ++t) {
+    BenchWorkload W;
+    W.NumObjects = BenchTargetCounts[t];
+    W.Size = 0;
+    W.Objects = (char **) malloc (W.NumObjects * sizeof (char *));
+    for (unsigned index = 0; index < W.NumObjects; ++index) {
+      Targets[index] = &TargetFunctions[index];
+      W.Objects[index] = &TargetFunctions[index];
+    }
+    Targets[W.NumObjects] = 0;
+
+    //
+    // Give the targets to the set in reverse address order so that the set
+    // really has to sort them.
+    //
+    Set->Count = W.NumObjects;
+    Set->State = TargetsUnsorted;
+    for (unsigned index = 0; index < W.NumObjects; ++index)
+      Set->Targets[index] = Targets[W.NumObjects - index - 1];
+
+    benchMeasureAll (&Opts, "debug", "funccheck", &W, loopFunccheck);
+    benchMeasureAll (&Opts, "debug", "funccheck_set", &W, loopFunccheckSet);
+    free (W.Objects);
+  }
+
+  return 0;
+}
@@ -0,0 +1,171 @@
+/*===- SoftBoundBench.c - Microbenchmarks of the SoftBound+CETS checks ----===*/
+/*                                                                            */
+/*                          The SAFECode Compiler                             */
+/*                                                                            */
+/* This file was developed by the LLVM research group and is distributed      */
+/* under the University of Illinois Open Source License. See LICENSE.TXT for  */
+/* details.                                                                   */
+/*                                                                            */
+/*===----------------------------------------------------------------------===*/
+/*                                                                            */
+/* This file measures the cost of the dereference checks and of the metadata  */
+/* accesses of the SoftBound+CETS run-time for varying numbers and sizes of   */
+/* live objects.  The checks are the inline functions of softboundcets.h, so  */
+/* this file must be compiled with the configuration flags of the run-time.   */
+/*                                                                            */
+/*===----------------------------------------------------------------------===*/
+
+#include "softboundcets.h"
+
+#include "BenchSupport.h"
+
+/* The lock and key of every object of the current workload */
+static void ** Locks;
+static size_t * Keys;
+
+static void
+loopNone (BenchWorkload * W, unsigned long ops) {
+  unsigned long i;
+  for (i = 0; i < ops; ++i) {
+    char * obj = W->Objects[benchNext (W)];
+    benchTouch (obj + benchOffset (W, i));
+  }
+}
+
+static void
+loopSpatialLoad (BenchWorkload * W, unsigned long ops) {
+  unsigned long i;
+  for (i = 0; i < ops; ++i) {
+    char * obj = W->Objects[benchNext (W)];
+    char * p = obj + benchOffset (W, i);
+    __softboundcets_spatial_load_dereference_check (obj, obj + W->Size, p, 1);
+    benchTouch (p);
+  }
+}
+
+static void
+loopSpatialStore (BenchWorkload * W, unsigned long ops) {
+  unsigned long i;
+  for (i = 0; i < ops; ++i) {
+    char * obj = W->Objects[benchNext (W)];
+    char * p = obj + benchOffset (W, i);
+    __softboundcets_spatial_store_dereference_check (obj, obj + W->Size, p, 1);
+    benchTouch (p);
+  }
+}
+
+static void
+loopTemporalLoad (BenchWorkload * W, unsigned long ops) {
+  unsigned long i;
+  for (i = 0; i < ops; ++i) {
+    unsigned index = benchNext (W);
+    char * obj = W->Objects[index];
+    __softboundcets_temporal_load_dereference_check (Locks[index], Keys[index],
+                                                     obj, obj + W->Size);
+    benchTouch (obj + benchOffset (W, i));
+  }
+}
+
+static void
+loopTemporalStore (BenchWorkload * W, unsigned long ops) {
+  unsigned long i;
+  for (i = 0; i < ops; ++i) {
+    unsigned index = benchNext (W);
+    char * obj = W->Objects[index];
+    __softboundcets_temporal_store_dereference_check (Locks[index], Keys[index],
+                                                      obj, obj + W->Size);
+    benchTouch (obj + benchOffset (W, i));
+  }
+}
+
+/*
+ * Function: loopMetadataStore()
+ *
+ * Description:
+ *  Record the metadata of a pointer stored into a word of an object.  The
+ *  stored pointer points to the object itself.
+ */
+static void
+loopMetadataStore (BenchWorkload * W, unsigned long ops) {
+  unsigned long i;
+  for (i = 0; i < ops; ++i) {
+    unsigned index = benchNext (W);
+    char * obj = W->Objects[index];
+    __softboundcets_metadata_store (obj + benchOffset (W, i), obj,
+                                    obj + W->Size, Keys[index], Locks[index]);
+  }
+}
+
+/*
+ * Function: loopMetadataLoad()
+ *
+ * Description:
+ *  Read the metadata of a pointer loaded from a word of an object.  A walk
+ *  with the same locality visits the same words as the preceding walk of
+ *  loopMetadataStore(), so every load finds the metadata that was stored.
+ */
+static void
+loopMetadataLoad (BenchWorkload * W, unsigned long ops) {
+  unsigned long i;
+  for (i = 0; i < ops; ++i) {
+    char * obj = W->Objects[benchNext (W)];
+    void * base;
+    void * bound;
+    size_t key;
+    void * lock;
+    __softboundcets_metadata_load (obj + benchOffset (W, i), &base, &bound,
+                                   &key, &lock);
+    benchTouch (bound);
+  }
+}
+
+int
+softboundcets_pseudo_main (int argc, char ** argv) {
+  BenchOptions Opts;
+  unsigned c;
+  unsigned s;
+  unsigned index;
+
+  benchParseOptions (argc, argv, &Opts);
+
+  for (c = 0; c < BENCH_NUM_COUNTS; ++c) {
+    for (s = 0; s < BENCH_NUM_SIZES; ++s) {
+      BenchWorkload W;
+      W.NumObjects = BenchObjectCounts[c];
+      W.Size = BenchObjectSizes[s];
+      W.Objects = (char **) malloc (W.NumObjects * sizeof (char *));
+      Locks = (void **) malloc (W.NumObjects * sizeof (void *));
+      Keys = (size_t *) malloc (W.NumObjects * sizeof (size_t));
+
+      for (index = 0; index < W.NumObjects; ++index) {
+        W.Objects[index] = (char *) calloc (1, W.Size);
+        __softboundcets_memory_allocation (W.Objects[index], &Locks[index],
+                                           &Keys[index]);
+      }
+
+      benchMeasureAll (&Opts, "softboundcets", "none", &W, loopNone);
+      benchMeasureAll (&Opts, "softboundcets", "spatial_load_dereference_check",
+                       &W, loopSpatialLoad);
+      benchMeasureAll (&Opts, "softboundcets", "spatial_store_dereference_check",
+                       &W, loopSpatialStore);
+      benchMeasureAll (&Opts, "softboundcets", "temporal_load_dereference_check",
+                       &W, loopTemporalLoad);
+      benchMeasureAll (&Opts, "softboundcets", "temporal_store_dereference_check",
+                       &W, loopTemporalStore);
+      benchMeasureAll (&Opts, "softboundcets", "metadata_store",
+                       &W, loopMetadataStore);
+      benchMeasureAll (&Opts, "softboundcets", "metadata_load",
+                       &W, loopMetadataLoad);
+
+      for (index = 0; index < W.NumObjects; ++index) {
+        __softboundcets_memory_deallocation (Locks[index], Keys[index]);
+        free (W.Objects[index]);
+      }
+      free (Keys);
+      free (Locks);
+      free (W.Objects);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# Compare two result files of the run-time check benchmarks.
+#
+# usage: compare.sh old.csv new.csv [percent]
+#
+# Print every measurement whose time per check in the new results exceeds the
+# time in the old results by more than the given percentage (10 by default)
+# and exit with a non-zero status if there is any.  Measurements that are in
+# only one of the files are ignored.
+#
+
+if [ $# -lt 2 ]
+then
+  echo "usage: $0 old.csv new.csv [percent]"
+  exit 2
+fi
+
+awk -F, -v limit="${3:-10}" '
+  $1 == "runtime" { next }
+  { key = $1 "," $2 "," $3 "," $4 "," $5 }
+  FNR == NR { old[key] = $7; next }
+  (key in old) && (old[key] > 0) {
+    change = ($7 - old[key]) * 100 / old[key]
+    if (change > limit) {
+      printf "%s: %.2f -> %.2f ns (+%.0f%%)\n", key, old[key], $7, change
+      slower++
+    }
+  }
+  END { exit (slower > 0) }
+' "$1" "$2"
@@ -31,6 +31,17 @@ struct ConfigData {
 
   // Flags whether we should track external memory allocations
   unsigned TrackExternalMallocs;
+
+  // Flags whether registered objects are indexed by page instead of by splay
+  // trees
+  unsigned PageTableIndex;
+
+  // Flags whether the run-time must be safe to use from multiple threads
+  unsigned ThreadSafe;
+
+  // The number of entries and the associativity of each thread's object cache
+  unsigned CacheSize;
+  unsigned CacheWays;
 };
 
 extern struct ConfigData ConfigData;
@@ -13,7 +13,8 @@
 //
 //===----------------------------------------------------------------------===//
 
-#include "../include/SplayTree.h"
+#include "../include/DebugRuntime.h"
+#include "../include/SiteCache.h"
 
 #if defined(__APPLE__)
 #include <malloc/malloc.h>
@@ -21,8 +22,8 @@
 
 namespace llvm {
 
-// Splay tree for recording external allocations
-RangeSplaySet<> * ExternalObjects;
+// Set for recording external allocations
+RangeObjectSet * ExternalObjects;
 
 #if defined(__APPLE__)
 // The real allocation functions
@@ -144,6 +145,7 @@ track_free (malloc_zone_t * zone, void * p) {
   // Record the allocation and return to the caller.
   //
   ExternalObjects->remove(p);
+  advanceSiteCacheEpoch ();
   return;
 }
 #else
@@ -0,0 +1,280 @@
+//===- ObjectCache.cpp - Per-thread cache of recently found objects -------===//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the creation, invalidation, and statistics of the
+// per-thread object caches used by the run-time checks.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ObjectCache.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern FILE * ReportLog;
+
+// The epoch of the caches of the check sites in instrumented code
+uintptr_t __sc_site_cache_epoch = 1;
+
+// Whether instrumented code has filled a site cache yet
+unsigned __sc_site_caches_used = 0;
+
+namespace llvm {
+
+__thread ObjectCache * ThreadCache = 0;
+
+// Lock protecting the list of caches and the statistics of exited threads
+static pthread_mutex_t CacheListLock = PTHREAD_MUTEX_INITIALIZER;
+
+// The caches of all live threads
+static ObjectCache * CacheList = 0;
+
+// Statistics of threads that have exited
+static unsigned long RetiredHits = 0;
+static unsigned long RetiredMisses = 0;
+
+// Key used to free the cache of a thread when the thread exits
+static pthread_key_t CacheKey;
+static pthread_once_t CacheKeyOnce = PTHREAD_ONCE_INIT;
+
+// The free sequence numbers; see ObjectCache.h
+uintptr_t CacheFreeSequence = 0;
+uintptr_t CacheRangeStamps[CacheRangeCount];
+
+// The source of pool epochs; an epoch is never used by two pools
+static uintptr_t NextEpoch = 0;
+
+//
+// Function: destroyThreadCache()
+//
+// Description:
+//  Record the statistics of an exiting thread and free its cache.
+//
+static void
+destroyThreadCache (void * data) {
+  ObjectCache * Cache = (ObjectCache *) data;
+
+  pthread_mutex_lock (&CacheListLock);
+  for (ObjectCache ** p = &CacheList; *p; p = &((*p)->Next)) {
+    if (*p == Cache) {
+      *p = Cache->Next;
+      break;
+    }
+  }
+  RetiredHits += Cache->Hits;
+  RetiredMisses += Cache->Misses;
+  pthread_mutex_unlock (&CacheListLock);
+
+  ThreadCache = 0;
+  free (Cache->Entries);
+  free (Cache);
+}
+
+//
+// Function: createCacheKey()
+//
+// Description:
+//  Create the key that frees the caches of exiting threads.  A check may run
+//  before the run-time is initialized, so this is done once by whichever of
+//  initObjectCache() and createThreadCache() runs first.
+//
+static void
+createCacheKey (void) {
+  pthread_key_create (&CacheKey, destroyThreadCache);
+}
+
+//
+// Function: reportCacheStatistics()
+//
+// Description:
+//  Print the number of cache hits and misses of all threads.  This is called
+//  when the program exits.
+//
+static void
+reportCacheStatistics (void) {
+  pthread_mutex_lock (&CacheListLock);
+  unsigned long Hits = RetiredHits;
+  unsigned long Misses = RetiredMisses;
+  for (ObjectCache * Cache = CacheList; Cache; Cache = Cache->Next) {
+    Hits += Cache->Hits;
+    Misses += Cache->Misses;
+  }
+  pthread_mutex_unlock (&CacheListLock);
+
+  FILE * out = ReportLog ? ReportLog : stderr;
+  fprintf (out, "Object cache: %u entries, %u ways: %lu hits, %lu misses\n",
+           ConfigData.CacheSize, ConfigData.CacheWays, Hits, Misses);
+  fflush (out);
+}
+
+//
+// Function: initObjectCache()
+//
+// Description:
+//  Configure the object caches from the environment.
+//
+//  SCCACHESIZE  - The number of entries in each thread's cache (rounded down
+//                 to a power of two); zero disables the cache.
+//  SCCACHEWAYS  - The associativity of the cache; one makes it direct-mapped.
+//  SCCACHESTATS - If set to a value other than zero, print the number of
+//                 cache hits and misses when the program exits.
+//
+void
+initObjectCache (void) {
+  if (char * size = getenv ("SCCACHESIZE"))
+    ConfigData.CacheSize = strtoul (size, 0, 0);
+  if (char * ways = getenv ("SCCACHEWAYS"))
+    ConfigData.CacheWays = strtoul (ways, 0, 0);
+
+  //
+  // Round the sizes to powers of two with at least one set.
+  //
+  while (ConfigData.CacheSize & (ConfigData.CacheSize - 1))
+    ConfigData.CacheSize &= ConfigData.CacheSize - 1;
+  while (ConfigData.CacheWays & (ConfigData.CacheWays - 1))
+    ConfigData.CacheWays &= ConfigData.CacheWays - 1;
+  if (ConfigData.CacheWays == 0)
+    ConfigData.CacheWays = 1;
+  if (ConfigData.CacheWays > ConfigData.CacheSize)
+    ConfigData.CacheWays = ConfigData.CacheSize;
+
+  pthread_once (&CacheKeyOnce, createCacheKey);
+
+  char * stats = getenv ("SCCACHESTATS");
+  if (stats && (strcmp (stats, "0") != 0))
+    atexit (reportCacheStatistics);
+}
+
+//
+// Function: createThreadCache()
+//
+// Description:
+//  Allocate an empty object cache for the calling thread.
+//
+ObjectCache *
+createThreadCache (void) {
+  ObjectCache * Cache = (ObjectCache *) calloc (1, sizeof (ObjectCache));
+  Cache->Ways = ConfigData.CacheWays;
+  Cache->SetMask = (ConfigData.CacheSize / ConfigData.CacheWays) - 1;
+  Cache->Entries = (ObjectCacheEntry *) calloc (ConfigData.CacheSize,
+                                                sizeof (ObjectCacheEntry));
+  Cache->Last = Cache->Entries;
+
+  pthread_mutex_lock (&CacheListLock);
+  Cache->Next = CacheList;
+  CacheList = Cache;
+  pthread_mutex_unlock (&CacheListLock);
+
+  pthread_once (&CacheKeyOnce, createCacheKey);
+  pthread_setspecific (CacheKey, Cache);
+  ThreadCache = Cache;
+  return Cache;
+}
+
+//
+// Function: stampFreedRange()
+//
+// Description:
+//  Stamp the address ranges covered by a freed object with a new free
+//  sequence number so that no thread uses an entry for an object starting in
+//  them that was filled before the object was freed.  The object must have
+//  been removed from its object set already; a search that starts after the
+//  new number is taken no longer finds it.
+//
+static void
+stampFreedRange (void * start, void * end) {
+  uintptr_t Sequence = __atomic_add_fetch (&CacheFreeSequence, 1,
+                                           __ATOMIC_SEQ_CST);
+
+  uintptr_t first = ((uintptr_t) start) >> CacheGranuleShift;
+  uintptr_t last = ((uintptr_t) end) >> CacheGranuleShift;
+  if (last - first >= CacheRangeCount)
+    last = first + CacheRangeCount - 1;
+
+  for (uintptr_t range = first; range <= last; ++range) {
+    uintptr_t * Stamp = getRangeStamp ((void *) (range << CacheGranuleShift));
+
+    //
+    // Frees in the same range may race; never lower a stamp.
+    //
+    uintptr_t Old = __atomic_load_n (Stamp, __ATOMIC_RELAXED);
+    while ((Old < Sequence) &&
+           !__atomic_compare_exchange_n (Stamp, &Old, Sequence, true,
+                                         __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+      ;
+  }
+}
+
+//
+// Function: invalidateCache()
+//
+// Description:
+//  Remove an object that is no longer valid from the object caches.  Entries
+//  for the object can only be in the sets of the address ranges that the
+//  object covers, so only those sets are searched.  The caches of other
+//  threads cannot be searched; their entries for objects in the ranges are
+//  made stale instead.  The caches of the check sites are not searched; they
+//  are all invalidated.
+//
+// Inputs:
+//  Pool  - The pool from which the object was removed.
+//  start - The address of the first byte of the object.
+//  end   - The address of the last byte of the object.
+//
+void
+invalidateCache (DebugPoolTy * Pool, void * start, void * end) {
+  advanceSiteCacheEpoch ();
+
+  if (!ConfigData.CacheSize)
+    return;
+
+  //
+  // Other threads may have cached the object; make their entries for it
+  // stale.
+  //
+  if (ConfigData.ThreadSafe)
+    stampFreedRange (start, end);
+
+  ObjectCache * Cache = ThreadCache;
+  if (!Cache)
+    return;
+
+  uintptr_t first = ((uintptr_t) start) >> CacheGranuleShift;
+  uintptr_t last = ((uintptr_t) end) >> CacheGranuleShift;
+  uintptr_t sets = Cache->SetMask + 1;
+  if (last - first >= sets)
+    last = first + sets - 1;
+
+  for (uintptr_t granule = first; granule <= last; ++granule) {
+    void * p = (void *) (granule << CacheGranuleShift);
+    ObjectCacheEntry * Entry = getCacheSet (Cache, Pool, p);
+    for (unsigned way = 0; way < Cache->Ways; ++way) {
+      if ((Entry[way].Pool == Pool) &&
+          (Entry[way].lower <= end) && (start <= Entry[way].upper))
+        Entry[way].Pool = 0;
+    }
+  }
+}
+
+//
+// Function: resetCacheEpoch()
+//
+// Description:
+//  Give the pool a new epoch so that no thread's cache hits on an entry made
+//  before the call.
+//
+void
+resetCacheEpoch (DebugPoolTy * Pool) {
+  uintptr_t Epoch = __atomic_add_fetch (&NextEpoch, 1, __ATOMIC_RELAXED);
+  __atomic_store_n (&(Pool->CacheEpoch), Epoch, __ATOMIC_RELEASE);
+}
+
+}
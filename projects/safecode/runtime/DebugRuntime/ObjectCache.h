@@ -0,0 +1,209 @@
+//===- ObjectCache.h - Per-thread cache of recently found objects -*- C++ -*-=//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the cache of memory objects used by the run-time checks
+// to avoid searching the object sets of a pool.  Each thread has its own
+// set-associative cache; a direct-mapped cache is a cache with one way.
+//
+// An entry is tagged with its pool and with the pool's epoch at the time the
+// entry was made; destroying or creating a pool advances its epoch.
+// Unregistering an object removes it from the cache of the calling thread.
+// In thread-safe mode, the caches of other threads cannot be searched, so
+// unregistering an object also stamps the address ranges that it covers with
+// a new free sequence number.  An entry is only used if no object starting in
+// its range was freed after the miss that filled it, so the other threads
+// lose only the entries near the freed object.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef OBJECTCACHE_H
+#define OBJECTCACHE_H
+
+#include "ConfigData.h"
+
+#include "../include/DebugRuntime.h"
+#include "../include/SiteCache.h"
+
+#include <stdint.h>
+
+namespace llvm {
+
+//
+// Structure: ObjectCacheEntry
+//
+// Description:
+//  A cached memory object and the pool and pool epoch in which it was found.
+//
+struct ObjectCacheEntry {
+  DebugPoolTy * Pool;
+  void * lower;
+  void * upper;
+  uintptr_t Epoch;
+
+  // The free sequence number read by the miss that filled the entry
+  uintptr_t Sequence;
+};
+
+//
+// Structure: ObjectCache
+//
+// Description:
+//  The object cache of a single thread.
+//
+struct ObjectCache {
+  // The cache entries, stored set by set
+  ObjectCacheEntry * Entries;
+
+  // The number of sets less one and the number of entries in each set
+  unsigned SetMask;
+  unsigned Ways;
+
+  // The entry that produced the most recent hit or fill
+  ObjectCacheEntry * Last;
+
+  // The way of each set to replace next is chosen round-robin
+  unsigned Victim;
+
+  // The pool epoch read by the most recent miss; a fill after the miss uses
+  // it so that an object freed during the search is never tagged as current
+  uintptr_t FillEpoch;
+  uintptr_t FillSequence;
+
+  // Statistics on how well the cache performs
+  unsigned long Hits;
+  unsigned long Misses;
+
+  // The next cache in the list of caches of live threads
+  ObjectCache * Next;
+};
+
+// The log2 of the number of bytes of address space mapped to the same set
+static const unsigned CacheGranuleShift = 8;
+
+// The number of address ranges stamped with the free sequence number of the
+// last object freed in them; a power of two
+static const unsigned CacheRangeCount = 4096;
+
+// The number of objects freed so far, and the stamps of the address ranges
+extern uintptr_t CacheFreeSequence;
+extern uintptr_t CacheRangeStamps[CacheRangeCount];
+
+// The cache of the calling thread; allocated by its first check
+extern __thread ObjectCache * ThreadCache;
+
+extern ObjectCache * createThreadCache (void);
+extern void initObjectCache (void);
+extern void invalidateCache (DebugPoolTy * Pool, void * start, void * end);
+extern void resetCacheEpoch (DebugPoolTy * Pool);
+
+static inline ObjectCacheEntry *
+getCacheSet (ObjectCache * Cache, DebugPoolTy * Pool, void * p) {
+  uintptr_t set = (((uintptr_t) p) >> CacheGranuleShift) ^
+                  (((uintptr_t) Pool) >> 4);
+  return Cache->Entries + (set & Cache->SetMask) * Cache->Ways;
+}
+
+static inline uintptr_t *
+getRangeStamp (void * p) {
+  uintptr_t range = ((uintptr_t) p) >> CacheGranuleShift;
+  return CacheRangeStamps + (range & (CacheRangeCount - 1));
+}
+
+static inline bool
+matchesEntry (ObjectCacheEntry * Entry, DebugPoolTy * Pool, void * p,
+              uintptr_t Epoch) {
+  return ((Entry->Pool == Pool) &&
+          (Entry->lower <= p) && (p <= Entry->upper) &&
+          (Entry->Epoch == Epoch) &&
+          (__atomic_load_n (getRangeStamp (Entry->lower), __ATOMIC_ACQUIRE) <=
+           Entry->Sequence));
+}
+
+//
+// Function: isInCache()
+//
+// Description:
+//  Determine whether the object containing the specified pointer is in the
+//  calling thread's object cache.
+//
+// Outputs:
+//  Start - The address of the first valid byte of the cached object.
+//  End   - The address of the last valid byte of the cached object.
+//
+// Return value:
+//  true  - The object was found in the cache.
+//  false - The object was not found in the cache.
+//
+static inline bool
+isInCache (DebugPoolTy * Pool, void * p, void * & Start, void * & End) {
+  if (!ConfigData.CacheSize)
+    return false;
+
+  ObjectCache * Cache = ThreadCache;
+  if (!Cache)
+    Cache = createThreadCache ();
+
+  uintptr_t Epoch = __atomic_load_n (&(Pool->CacheEpoch), __ATOMIC_ACQUIRE);
+
+  //
+  // Loops usually access the same object repeatedly, so try the most recently
+  // used entry before searching the set.
+  //
+  ObjectCacheEntry * Entry = Cache->Last;
+  if (!matchesEntry (Entry, Pool, p, Epoch)) {
+    Entry = getCacheSet (Cache, Pool, p);
+    ObjectCacheEntry * SetEnd = Entry + Cache->Ways;
+    while ((Entry != SetEnd) && !matchesEntry (Entry, Pool, p, Epoch))
+      ++Entry;
+
+    if (Entry == SetEnd) {
+      ++(Cache->Misses);
+      Cache->FillEpoch = Epoch;
+      Cache->FillSequence = __atomic_load_n (&CacheFreeSequence,
+                                             __ATOMIC_ACQUIRE);
+      return false;
+    }
+    Cache->Last = Entry;
+  }
+
+  ++(Cache->Hits);
+  Start = Entry->lower;
+  End = Entry->upper;
+  return true;
+}
+
+//
+// Function: updateCache()
+//
+// Description:
+//  Record that the specified pointer was found within the given object.  This
+//  must follow a call to isInCache() for the same pointer that missed.
+//
+static inline void
+updateCache (DebugPoolTy * Pool, void * p, void * Start, void * End) {
+  if (!ConfigData.CacheSize)
+    return;
+
+  ObjectCache * Cache = ThreadCache;
+  if (!Cache)
+    Cache = createThreadCache ();
+
+  ObjectCacheEntry * Entry = getCacheSet (Cache, Pool, p) + Cache->Victim;
+  Cache->Victim = (Cache->Victim + 1 == Cache->Ways) ? 0 : Cache->Victim + 1;
+
+  Entry->Pool = Pool;
+  Entry->lower = Start;
+  Entry->upper = End;
+  Entry->Epoch = Cache->FillEpoch;
+  Entry->Sequence = Cache->FillSequence;
+  Cache->Last = Entry;
+}
+
+}
+#endif
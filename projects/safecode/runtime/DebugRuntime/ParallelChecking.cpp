@@ -0,0 +1,378 @@
+//===- ParallelChecking.cpp - Perform run-time checks on another thread ---===//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the __sc_par_* functions that the SpeculativeChecking
+// passes call instead of the run-time checks.  Each application thread gets a
+// CheckQueue and a checking thread the first time that it defers a check; the
+// checking thread performs the checks with the functions of this run-time
+// while the application thread continues.  A sync point waits until every
+// check deferred by the calling thread has been performed.
+//
+// Checks are performed in the order in which they were deferred, so the
+// unregistration and deallocation of an object are deferred as well: an
+// object is never freed before the checks on it issued earlier have been done.
+// Registrations may be performed directly or deferred.
+//
+// The checking thread looks up objects while the application thread registers
+// them, so __sc_par_pool_init_runtime() makes the run-time thread-safe.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ConfigData.h"
+
+#include "../include/CheckQueue.h"
+#include "../include/DebugRuntime.h"
+
+#include <new>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace llvm;
+
+//
+// Structure: CheckingThread
+//
+// Description:
+//  The queue of an application thread and the thread that empties it.
+//
+struct CheckingThread {
+  CheckQueue Queue;
+  pthread_t Thread;
+};
+
+// The checking thread of the calling application thread
+static __thread CheckingThread * MyChecker = 0;
+
+// Key whose destructor stops the checking thread when its owner exits
+static pthread_key_t CheckerKey;
+static pthread_once_t CheckerKeyOnce = PTHREAD_ONCE_INIT;
+
+//
+// Function: stopChecker()
+//
+// Description:
+//  Wait for the deferred checks of a checking thread, stop it, and free it.
+//
+static void
+stopChecker (void * Checker) {
+  CheckingThread * CT = (CheckingThread *) Checker;
+  CT->Queue.stop ();
+  pthread_join (CT->Thread, 0);
+  CT->~CheckingThread ();
+  free (CT);
+}
+
+//
+// Function: waitAtExit()
+//
+// Description:
+//  Perform the checks deferred by the thread that calls exit().  The
+//  destructors of thread-specific data do not run for that thread.
+//
+static void
+waitAtExit (void) {
+  if (MyChecker)
+    MyChecker->Queue.wait ();
+}
+
+static void
+createCheckerKey (void) {
+  pthread_key_create (&CheckerKey, stopChecker);
+  atexit (waitAtExit);
+}
+
+//
+// Function: runChecker()
+//
+// Description:
+//  The body of a checking thread.
+//
+static void *
+runChecker (void * Checker) {
+  ((CheckingThread *) Checker)->Queue.run ();
+  return 0;
+}
+
+//
+// Function: getQueue()
+//
+// Description:
+//  Return the queue of the calling thread, starting its checking thread if
+//  it does not have one yet.  If no thread can be started, return NULL; the
+//  caller then performs the check itself.
+//
+static inline CheckQueue *
+getQueue (void) {
+  if (MyChecker)
+    return &(MyChecker->Queue);
+
+  pthread_once (&CheckerKeyOnce, createCheckerKey);
+
+  //
+  // The queue is aligned to cache lines, which operator new does not
+  // guarantee.
+  //
+  void * Memory;
+  if (posix_memalign (&Memory, 64, sizeof (CheckingThread)))
+    return 0;
+  CheckingThread * CT = new (Memory) CheckingThread ();
+  if (pthread_create (&(CT->Thread), 0, runChecker, CT)) {
+    CT->~CheckingThread ();
+    free (CT);
+    return 0;
+  }
+
+  pthread_setspecific (CheckerKey, CT);
+  MyChecker = CT;
+  return &(CT->Queue);
+}
+
+//
+// Stubs that perform deferred requests on the checking thread
+//
+static void
+stubPoolcheck (uintptr_t * Args) {
+  poolcheck ((DebugPoolTy *) Args[0], (void *) Args[1], Args[2]);
+}
+
+static void
+stubPoolcheckui (uintptr_t * Args) {
+  poolcheckui ((DebugPoolTy *) Args[0], (void *) Args[1], Args[2]);
+}
+
+static void
+stubPoolcheckalign (uintptr_t * Args) {
+  poolcheckalign ((DebugPoolTy *) Args[0], (void *) Args[1], Args[2]);
+}
+
+static void
+stubBoundscheck (uintptr_t * Args) {
+  boundscheck ((DebugPoolTy *) Args[0], (void *) Args[1], (void *) Args[2]);
+}
+
+static void
+stubBoundscheckui (uintptr_t * Args) {
+  boundscheckui ((DebugPoolTy *) Args[0], (void *) Args[1], (void *) Args[2]);
+}
+
+static void
+stubFunccheck (uintptr_t * Args) {
+  funccheck ((void *) Args[0], (void **) Args[1]);
+}
+
+static void
+stubPoolregister (uintptr_t * Args) {
+  pool_register ((DebugPoolTy *) Args[0], (void *) Args[1], Args[2]);
+}
+
+static void
+stubPoolregisterStack (uintptr_t * Args) {
+  pool_register_stack ((DebugPoolTy *) Args[0], (void *) Args[1], Args[2]);
+}
+
+static void
+stubPoolunregister (uintptr_t * Args) {
+  pool_unregister ((DebugPoolTy *) Args[0], (void *) Args[1]);
+}
+
+static void
+stubPoolunregisterStack (uintptr_t * Args) {
+  pool_unregister_stack ((DebugPoolTy *) Args[0], (void *) Args[1]);
+}
+
+static void
+stubPoolfree (uintptr_t * Args) {
+  __sc_dbg_src_poolfree ((DebugPoolTy *) Args[0],
+                         (void *) Args[1],
+                         0,
+                         "UNKNOWN",
+                         0);
+}
+
+static void
+stubCodeDup (uintptr_t * Args) {
+  typedef void (*CodeDupTy) (void *);
+  ((CodeDupTy) Args[0]) ((void *) Args[1]);
+}
+
+//
+// Function: defer()
+//
+// Description:
+//  Defer a request to the checking thread of the calling thread, or perform
+//  it now if there is no checking thread.
+//
+static inline void
+defer (CheckStub Stub, uintptr_t Arg0, uintptr_t Arg1, uintptr_t Arg2 = 0) {
+  if (CheckQueue * Queue = getQueue ()) {
+    Queue->enqueue (Stub, Arg0, Arg1, Arg2);
+  } else {
+    uintptr_t Args[3] = {Arg0, Arg1, Arg2};
+    Stub (Args);
+  }
+}
+
+//
+// Function: __sc_par_pool_init_runtime()
+//
+// Description:
+//  Initialize the run-time for asynchronous checking.  Lookups happen on the
+//  checking threads while the application registers objects, so the run-time
+//  must use its thread-safe, page-indexed object sets.
+//
+//  Out of bounds pointers cannot be rewritten: the application has already
+//  used the pointer by the time a deferred bounds check computes the rewrite
+//  pointer.  Rewriting is therefore turned off, so that the checking threads
+//  report out of bounds pointers instead of making rewrite pointers that
+//  nothing uses.
+//
+void
+__sc_par_pool_init_runtime (unsigned Dangling,
+                            unsigned RewriteOOB,
+                            unsigned Terminate) {
+  ConfigData.ThreadSafe = true;
+  ConfigData.PageTableIndex = true;
+  pool_init_runtime (Dangling, 0, Terminate);
+}
+
+//
+// Functions: __sc_par_poolcheck(), __sc_par_poolcheckui(),
+//            __sc_par_poolcheckalign(), __sc_par_funccheck()
+//
+// Description:
+//  Defer a check to the checking thread.
+//
+void
+__sc_par_poolcheck (DebugPoolTy * Pool, void * Node, unsigned length) {
+  defer (stubPoolcheck, (uintptr_t) Pool, (uintptr_t) Node, length);
+}
+
+void
+__sc_par_poolcheckui (DebugPoolTy * Pool, void * Node, unsigned length) {
+  defer (stubPoolcheckui, (uintptr_t) Pool, (uintptr_t) Node, length);
+}
+
+void
+__sc_par_poolcheckalign (DebugPoolTy * Pool, void * Node, unsigned Offset) {
+  defer (stubPoolcheckalign, (uintptr_t) Pool, (uintptr_t) Node, Offset);
+}
+
+void
+__sc_par_funccheck (void * f, void * targets[]) {
+  defer (stubFunccheck, (uintptr_t) f, (uintptr_t) targets);
+}
+
+//
+// Functions: __sc_par_boundscheck(), __sc_par_boundscheckui()
+//
+// Description:
+//  Defer a bounds check to the checking thread.  The result of the check is
+//  not known yet, so the pointer is returned unchanged; out of bounds pointers
+//  are reported but never rewritten, which is why __sc_par_pool_init_runtime()
+//  turns rewriting off.
+//
+void *
+__sc_par_boundscheck (DebugPoolTy * Pool, void * Source, void * Dest) {
+  defer (stubBoundscheck, (uintptr_t) Pool, (uintptr_t) Source,
+         (uintptr_t) Dest);
+  return Dest;
+}
+
+void *
+__sc_par_boundscheckui (DebugPoolTy * Pool, void * Source, void * Dest) {
+  defer (stubBoundscheckui, (uintptr_t) Pool, (uintptr_t) Source,
+         (uintptr_t) Dest);
+  return Dest;
+}
+
+//
+// Functions: __sc_par_poolregister(), __sc_par_poolregister_stack(),
+//            __sc_par_poolunregister(), __sc_par_poolunregister_stack()
+//
+// Description:
+//  Defer a change to the set of registered objects so that it is ordered
+//  with the deferred checks.
+//
+void
+__sc_par_poolregister (DebugPoolTy * Pool,
+                       void * allocaptr,
+                       unsigned NumBytes) {
+  defer (stubPoolregister, (uintptr_t) Pool, (uintptr_t) allocaptr, NumBytes);
+}
+
+void
+__sc_par_poolregister_stack (DebugPoolTy * Pool,
+                             void * allocaptr,
+                             unsigned NumBytes) {
+  defer (stubPoolregisterStack, (uintptr_t) Pool, (uintptr_t) allocaptr,
+         NumBytes);
+}
+
+void
+__sc_par_poolunregister (DebugPoolTy * Pool, void * allocaptr) {
+  defer (stubPoolunregister, (uintptr_t) Pool, (uintptr_t) allocaptr);
+}
+
+void
+__sc_par_poolunregister_stack (DebugPoolTy * Pool, void * allocaptr) {
+  defer (stubPoolunregisterStack, (uintptr_t) Pool, (uintptr_t) allocaptr);
+}
+
+//
+// Function: __sc_par_poolfree()
+//
+// Description:
+//  Defer the deallocation of an object.  The memory is not reused until the
+//  checking thread has performed the checks on the object deferred before
+//  the deallocation.
+//
+void
+__sc_par_poolfree (DebugPoolTy * Pool, void * Node) {
+  defer (stubPoolfree, (uintptr_t) Pool, (uintptr_t) Node);
+}
+
+//
+// Function: __sc_par_enqueue_code_dup()
+//
+// Description:
+//  Run a checking version of a region of code made by the CodeDuplication
+//  pass on the checking thread.
+//
+void
+__sc_par_enqueue_code_dup (void * code, void * args) {
+  defer (stubCodeDup, (uintptr_t) code, (uintptr_t) args);
+}
+
+//
+// Function: __sc_par_wait_for_completion()
+//
+// Description:
+//  A sync point: wait until the checks deferred by the calling thread have
+//  been performed.
+//
+void
+__sc_par_wait_for_completion (void) {
+  if (MyChecker)
+    MyChecker->Queue.wait ();
+}
+
+//
+// Function: __sc_par_store_check()
+//
+// Description:
+//  Make sure that a store does not overwrite the queue of the calling thread;
+//  a corrupted queue would make the checking thread run arbitrary code.
+//
+void
+__sc_par_store_check (void * ptr) {
+  if (MyChecker && MyChecker->Queue.contains (ptr))
+    __builtin_trap ();
+}
@@ -16,24 +16,76 @@
 #define _SC_POOLALLOCATOR_RUNTIME_H_
 
 #include "../include/DebugRuntime.h"
+#include "ConfigData.h"
 
 #include "llvm/ADT/DenseMap.h"
 
 #include <map>
+#include <pthread.h>
 
 namespace llvm {
 
 extern DebugPoolTy dummyPool;
 
-// Splay tree of external objects
-extern RangeSplaySet<> * ExternalObjects;
+// Set of external objects
+extern RangeObjectSet * ExternalObjects;
 
-// Records Out of Bounds pointer rewrites; also used by OOB rewrites for
-// exactcheck() calls
-extern DebugPoolTy OOBPool;
+// Lock protecting the debug meta-data, the shadow map, and the rewrite
+// pointer tables in thread-safe mode
+extern pthread_mutex_t MetaDataLock;
 
-// Record from which object an OOB pointer originates
-//extern llvm::DenseMap<void *, std::pair<const void *, const void * > > RewrittenObjs;
+//
+// Class: MetaDataGuard
+//
+// Description:
+//  Hold the meta-data lock for the lifetime of the object if the run-time is
+//  thread-safe.  The lock is recursive, so guards may nest.
+//
+class MetaDataGuard {
+ public:
+  MetaDataGuard () {
+    if (ConfigData.ThreadSafe) pthread_mutex_lock (&MetaDataLock);
+  }
+
+  ~MetaDataGuard () {
+    if (ConfigData.ThreadSafe) pthread_mutex_unlock (&MetaDataLock);
+  }
+};
+
+//
+// Class: PoolAllocGuard
+//
+// Description:
+//  Hold the allocator lock of a pool for the lifetime of the object if the
+//  run-time is thread-safe.  The bitmap pool allocator is not thread-safe, so
+//  allocations, deallocations, and searches of its slabs are serialized.
+//
+class PoolAllocGuard {
+  DebugPoolTy * Pool;
+
+ public:
+  explicit PoolAllocGuard (DebugPoolTy * P)
+    : Pool ((ConfigData.ThreadSafe) ? P : 0) {
+    if (Pool) pthread_mutex_lock (&(Pool->AllocLock));
+  }
+
+  ~PoolAllocGuard () {
+    if (Pool) pthread_mutex_unlock (&(Pool->AllocLock));
+  }
+};
+
+//
+// Function: slabPoolcheck()
+//
+// Description:
+//  Search the slabs of the pool for an object containing the pointer.  This
+//  is used to find singleton objects that are not registered with the pool.
+//
+static inline void *
+slabPoolcheck (DebugPoolTy * Pool, void * Node) {
+  PoolAllocGuard Guard (Pool);
+  return __pa_bitmap_poolcheck (Pool, Node);
+}
 
 
 }
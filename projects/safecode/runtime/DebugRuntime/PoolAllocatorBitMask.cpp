@@ -39,13 +39,17 @@
 #include "PageManager.h"
 #include "DebugReport.h"
 #include "RewritePtr.h"
+#include "ObjectCache.h"
 
 #include "../include/CWE.h"
 #include "../include/DebugRuntime.h"
+#include "../include/GlobalTable.h"
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <fstream>
+#include <vector>
 
 // This must be defined for Snow Leopard to get the ucontext definitions
 #if defined(__APPLE__)
@@ -77,7 +81,10 @@ namespace llvm {
 DebugPoolTy dummyPool;
 
 // Structure defining configuration data
-struct ConfigData ConfigData = {false, true, false};
+struct ConfigData ConfigData = {false, true, false, false, false, 64, 4};
+
+// Lock protecting debug meta-data in thread-safe mode
+pthread_mutex_t MetaDataLock;
 
 // Invalid address range
 uintptr_t InvalidUpper = 0x00000000;
@@ -119,6 +126,25 @@ static PDebugMetaData createPtrMetaData (unsigned,
                                          const char * SourceFile = "UNKNOWN",
                                          unsigned lineno = 0);
 
+//
+// Functions: lockedPoolalloc(), lockedPoolfree()
+//
+// Description:
+//  Allocate and free memory with the underlying pool allocator, serializing
+//  the allocator if the run-time is thread-safe.
+//
+static inline void *
+lockedPoolalloc (DebugPoolTy * Pool, unsigned NumBytes) {
+  PoolAllocGuard Guard (Pool);
+  return poolalloc (Pool, NumBytes);
+}
+
+static inline void
+lockedPoolfree (DebugPoolTy * Pool, void * Node) {
+  PoolAllocGuard Guard (Pool);
+  poolfree (Pool, Node);
+}
+
 //===----------------------------------------------------------------------===//
 //
 //  Pool allocator library implementation
@@ -163,9 +189,48 @@ pool_init_runtime (unsigned Dangling, unsigned RewriteOOB, unsigned Terminate) {
   StopOnError = Terminate;
 
   //
-  // Allocate a range of memory for rewrite pointers.
+  // Select the data structure used to index registered objects.  Splay trees
+  // are the default; a page-indexed table can be requested from the
+  // environment for programs with many live objects.
+  //
+  char * index = getenv ("SCOBJECTINDEX");
+  if (index && (strcmp (index, "pagetable") == 0))
+    ConfigData.PageTableIndex = true;
+
+  //
+  // Determine whether the run-time must be thread-safe.  Lookups in splay
+  // trees modify the tree, so thread-safe mode always uses the page-indexed
+  // table in order to permit lookups without locking.
+  //
+  char * threads = getenv ("SCTHREADSAFE");
+  if (threads && (strcmp (threads, "0") != 0)) {
+    ConfigData.ThreadSafe = true;
+    ConfigData.PageTableIndex = true;
+  }
+
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init (&attr);
+  pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init (&MetaDataLock, &attr);
+  pthread_mutexattr_destroy (&attr);
+
+  //
+  // Configure the per-thread caches of recently found objects.
+  //
+  initObjectCache ();
+
+  //
+  // Allocate a range of memory for rewrite pointers.  SCREWRITERANGE can make
+  // it smaller (in bytes, rounded up to whole pages) to test that the rewrite
+  // pointers of unregistered objects are handed out again.
   //
-  const unsigned invalidsize = 1 * 1024 * 1024 * 1024;
+  unsigned invalidsize = 1 * 1024 * 1024 * 1024;
+  if (char * range = getenv ("SCREWRITERANGE")) {
+    unsigned long size = strtoul (range, 0, 0);
+    unsigned long page = sysconf (_SC_PAGESIZE);
+    if (size && (size < invalidsize))
+      invalidsize = (size + page - 1) & ~(page - 1);
+  }
   void * Addr = mmap (0, invalidsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
   if (Addr == MAP_FAILED) {
      perror ("mmap:");
@@ -240,9 +305,10 @@ pool_init_runtime (unsigned Dangling, unsigned RewriteOOB, unsigned Terminate) {
 #endif
 
   //
-  // Initialize the splay tree of external objects.
+  // Initialize the set of external objects.
   //
-  ExternalObjects = new RangeSplaySet<>;
+  ExternalObjects = new RangeObjectSet (ConfigData.PageTableIndex,
+                                        ConfigData.ThreadSafe);
   return;
 }
 
@@ -288,8 +354,7 @@ pool_init_logfile (const char * name) {
 void *
 __sc_dbg_newpool(unsigned NodeSize) {
   DebugPoolTy * Pool = new DebugPoolTy();
-  poolinit(static_cast<BitmapPoolTy*>(Pool), NodeSize);
-  return Pool;
+  return __sc_dbg_poolinit(Pool, NodeSize, 0);
 }
 
 //
@@ -310,13 +375,20 @@ __sc_dbg_pooldestroy(DebugPoolTy * Pool) {
   // Deallocate all object meta-data stored in the pool.
   //
   Pool->Objects.clear();
-  Pool->OOB.clear();
   Pool->DPTree.clear();
 
+  //
+  // The memory of the pool descriptor may be used for another pool; make sure
+  // that no cached object of this pool is found in the new one.
+  //
+  resetCacheEpoch (Pool);
+  advanceSiteCacheEpoch ();
+
   //
   // Let the pool allocator run-time free all objects allocated within the
   // pool.
   //
+  PoolAllocGuard Guard (Pool);
   pooldestroy(Pool);
 }
 
@@ -441,12 +513,14 @@ _internal_poolregister (DebugPoolTy *Pool,
   // If there was no pool specified, use the splay tree associated with
   // externally allocated objects.
   //
-  RangeSplaySet<> * SPTree = (Pool ? &(Pool->Objects) : ExternalObjects);
+  RangeObjectSet * SPTree = (Pool ? &(Pool->Objects) : ExternalObjects);
 
   //
-  // Add the object to the pool's splay of valid objects.
-  //
+  // Add the object to the pool's set of valid objects.  Hold the set's lock
+  // so that other threads never see the intermediate states of a merge.
   //
+  void * Replaced = 0;
+  SPTree->lock();
   if (!(SPTree->insert(allocaptr, (char*) allocaptr + NumBytes - 1))) {
   // Note that the linker
   // may merge together global objects that are identical (or for which one is
@@ -491,11 +565,24 @@ _internal_poolregister (DebugPoolTy *Pool,
         void * end;
         SPTree->find (allocaptr, start, end);
         SPTree->remove (start);
+        if (Pool)
+          invalidateCache (Pool, start, end);
+        else
+          advanceSiteCacheEpoch ();
+        Replaced = start;
         SPTree->insert(allocaptr, (char*) allocaptr + NumBytes - 1);
         break;
       }
     }
   }
+  SPTree->unlock();
+
+  //
+  // Forget the rewrite pointers computed from a replaced object.  This takes
+  // the meta-data lock, so it must not be done while holding the set's lock.
+  //
+  if (Replaced)
+    dropRewritePtrs (Replaced);
 
   return;
 }
@@ -586,6 +673,7 @@ pool_register_debug (DebugPoolTy *Pool,
   // Generate a generation number for this object registration.  We only do
   // this for heap allocations.
   //
+  MetaDataGuard Guard;
   unsigned allocID = ((*allocSeqMap)[tag] += 1);
 
   //
@@ -700,6 +788,7 @@ pool_register_stack_debug (DebugPoolTy *Pool,
   // Create the meta data object containing the debug information for this
   // pointer.
   //
+  MetaDataGuard Guard;
   PDebugMetaData debugmetadataPtr;
   debugmetadataPtr = createPtrMetaData (0,
                                         0,
@@ -757,6 +846,81 @@ pool_register_global (DebugPoolTy *Pool, void * allocaptr, unsigned NumBytes) {
                           Global);
 }
 
+//
+// Function: compareGlobalEntries()
+//
+// Description:
+//  Order the entries of a table of globals by pool and then by address.
+//
+static bool
+compareGlobalEntries (const GlobalTableEntry & A, const GlobalTableEntry & B) {
+  if (A.Pool != B.Pool)
+    return A.Pool < B.Pool;
+  return A.Start < B.Start;
+}
+
+//
+// Function: pool_register_globals()
+//
+// Description:
+//  This function is externally visible and is called by code to register all
+//  of the global variables of a program or module with a single call.
+//
+//  The entries are sorted by address first so that each pool's set is built
+//  in address order with its lock held once.  Globals that the linker has
+//  made overlap are merged here rather than by removing and reinserting them
+//  in the set.
+//
+// Inputs:
+//  Table - The table of globals made by the RegisterGlobalVariables pass.
+//  Count - The number of entries in the table.
+//
+void
+pool_register_globals (GlobalTableEntry * Table, unsigned Count) {
+  //
+  // The table is constant, so sort a copy of it.  Leave out the entries that
+  // would not be registered anyway.
+  //
+  std::vector<GlobalTableEntry> Entries;
+  Entries.reserve (Count);
+  for (unsigned index = 0; index < Count; ++index)
+    if (Table[index].Start && Table[index].Size)
+      Entries.push_back (Table[index]);
+  std::sort (Entries.begin(), Entries.end(), compareGlobalEntries);
+
+  unsigned index = 0;
+  while (index < Entries.size()) {
+    DebugPoolTy * Pool = (DebugPoolTy *) Entries[index].Pool;
+    RangeObjectSet * SPTree = (Pool ? &(Pool->Objects) : ExternalObjects);
+
+    SPTree->lock ();
+    while ((index < Entries.size()) && (Entries[index].Pool == Pool)) {
+      //
+      // Merge the global with the ones that follow it if they overlap.
+      //
+      char * Start = (char *) Entries[index].Start;
+      char * End = Start + Entries[index].Size - 1;
+      while ((++index < Entries.size()) &&
+             (Entries[index].Pool == Pool) &&
+             ((char *) Entries[index].Start <= End)) {
+        char * NextEnd = (char *) Entries[index].Start
+                         + Entries[index].Size - 1;
+        if (NextEnd > End)
+          End = NextEnd;
+      }
+
+      _internal_poolregister (Pool,
+                              Start,
+                              End - Start + 1,
+                              0,
+                              "UNKNOWN",
+                              0,
+                              Global);
+    }
+    SPTree->unlock ();
+  }
+}
+
 //
 // Function: __sc_dbg_src_poolregister_global_debug()
 //
@@ -785,6 +949,7 @@ pool_register_global_debug (DebugPoolTy *Pool,
   // Create the meta data object containing the debug information for this
   // pointer.
   //
+  MetaDataGuard Guard;
   PDebugMetaData debugmetadataPtr;
   debugmetadataPtr = createPtrMetaData (0,
                                         0,
@@ -826,6 +991,7 @@ poolcheck_freeui_debug (DebugPoolTy *Pool,
   void * ObjEnd = 0;
   bool found = false;
   PDebugMetaData debugmetadataptr = 0;
+  MetaDataGuard Guard;
   found = dummyPool.DPTree.find (ptr, ObjStart, ObjEnd, debugmetadataptr);
 
   //
@@ -911,6 +1077,7 @@ poolcheck_free_debug (DebugPoolTy *Pool,
   void * ObjEnd = 0;
   bool found = false;
   PDebugMetaData debugmetadataptr = 0;
+  MetaDataGuard Guard;
   found = dummyPool.DPTree.find (ptr, ObjStart, ObjEnd, debugmetadataptr);
 
   //
@@ -1010,7 +1177,7 @@ poolcheck_free (DebugPoolTy *Pool, void * ptr) {
   //
 #if 1
   if (!found && Pool) {
-    if ((ObjStart = __pa_bitmap_poolcheck (Pool, ptr))) {
+    if ((ObjStart = slabPoolcheck (Pool, ptr))) {
       ObjEnd = (unsigned char *) ObjStart + Pool->NodeSize - 1;
       found = true;
     }
@@ -1084,7 +1251,7 @@ poolcheck_freeui (DebugPoolTy *Pool, void * ptr) {
   //
 #if 1
   if (!found && Pool) {
-    if ((ObjStart = __pa_bitmap_poolcheck (Pool, ptr))) {
+    if ((ObjStart = slabPoolcheck (Pool, ptr))) {
       ObjEnd = (unsigned char *) ObjStart + Pool->NodeSize - 1;
       found = true;
     }
@@ -1133,6 +1300,8 @@ updateMDOnFree (DebugPoolTy *Pool,
                 unsigned tag,
                 const char * SourceFilep,
                 unsigned lineno) {
+  MetaDataGuard Guard;
+
   //
   // Increment the ID number for this deallocation.
   //
@@ -1233,25 +1402,30 @@ _internal_poolunregister (DebugPoolTy *Pool,
   // If there was no pool specified, use the splay tree associated with
   // externally allocated objects.
   //
-  RangeSplaySet<> * SPTree = (Pool ? &(Pool->Objects) : ExternalObjects);
+  RangeObjectSet * SPTree = (Pool ? &(Pool->Objects) : ExternalObjects);
 
   //
   // Remove the object from the pool's splay tree.
   //
+  void * start = allocaptr;
+  void * end = allocaptr;
+  SPTree->lock ();
+  SPTree->find (allocaptr, start, end);
   SPTree->remove (allocaptr);
+  SPTree->unlock ();
 
   //
-  // Eject the pointer from the pool's cache if necessary.
+  // Eject the object from the object caches if necessary.
   //
-  if (Pool) {
-    if ((Pool->objectCache[0].lower <= allocaptr) &&
-        (allocaptr <= Pool->objectCache[0].upper))
-      Pool->objectCache[0].lower = Pool->objectCache[0].upper = 0;
+  if (Pool)
+    invalidateCache (Pool, start, end);
+  else
+    advanceSiteCacheEpoch ();
 
-    if ((Pool->objectCache[1].lower <= allocaptr) &&
-        (allocaptr <= Pool->objectCache[1].upper))
-      Pool->objectCache[1].lower = Pool->objectCache[1].upper = 0;
-  }
+  //
+  // Forget the rewrite pointers computed from the object.
+  //
+  dropRewritePtrs (start);
 
   //
   // Generate some debugging output.
@@ -1314,7 +1488,7 @@ __sc_dbg_src_poolalloc (DebugPoolTy *Pool,
   if (NumBytes == 0) NumBytes = 1;
 
   // Perform the allocation and determine its offset within the physical page.
-  void * canonptr = poolalloc(Pool, NumBytes);
+  void * canonptr = lockedPoolalloc (Pool, NumBytes);
   return canonptr;
 }
 
@@ -1334,7 +1508,7 @@ __sc_dbg_src_poolfree (DebugPoolTy *Pool,
   // Free the object within the pool; the poolunregister() function will
   // detect invalid frees.
   //
-  poolfree (Pool, Node);
+  lockedPoolfree (Pool, Node);
 }
 
 
@@ -1507,17 +1681,17 @@ bus_error_handler (int sig, siginfo_t * info, void * context) {
   // perhaps it is an Out of Bounds Rewrite Pointer.  Check for that now.
   //
   if (0 == fs) {
-    void * start = faultAddr;
-    void * tag = 0;
-    void * end;
-    if (OOBPool.OOB.find (faultAddr, start, end, tag)) {
-      const char * Filename = (const char *)(RewriteSourcefile()[faultAddr]);
-      unsigned lineno = RewriteLineno()[faultAddr];
+    MetaDataGuard Guard;
+    if (RewriteEntry * Entry = findRewritePtr (faultAddr)) {
+      const char * Filename = Entry->SourceFile;
+      unsigned lineno = Entry->lineno;
+      const void * tag = Entry->Orig;
 
       //
       // Get the bounds of the original object.
       //
-      getOOBObject (faultAddr, start, end);
+      void * start = Entry->ObjStart;
+      void * end = Entry->ObjEnd;
       OutOfBoundsViolation v;
       v.type = ViolationInfo::FAULT_LOAD_STORE,
         v.faultPC = (const void*)program_counter,
@@ -1612,6 +1786,7 @@ getCanonicalPtr (void * ShadowPtr) {
   //
   void * start, * end;
   void * CanonPtr = 0;
+  MetaDataGuard Guard;
   bool found = ShadowMap().find (ShadowPtr, start, end, CanonPtr);
   return (found ? CanonPtr : ShadowPtr);
 }
@@ -1652,6 +1827,7 @@ pool_shadow (void * CanonPtr, unsigned NumBytes) {
   //
   // Record the mapping from shadow pointer to canonical pointer.
   //
+  MetaDataGuard Guard;
   ShadowMap().insert (shadowptr, 
                         (char*) shadowptr + NumBytes - 1,
                         CanonPtr);
@@ -1692,6 +1868,7 @@ pool_unshadow (void * Node) {
   // pointer to the canonical page.
   //
   PDebugMetaData debugmetadataptr = 0;
+  MetaDataGuard Guard;
   bool found = dummyPool.DPTree.find (Node, start, end, debugmetadataptr);
 
   // Assert that we either didn't find the object or we found the object *and*
@@ -1799,7 +1976,7 @@ poolrealloc (DebugPoolTy *Pool, void *Node, unsigned NumBytes) {
   // shadow object (if necessary), and register the object as a heap object.
   //
   if (Node == 0) {
-    void * New = poolalloc(Pool, NumBytes);
+    void * New = lockedPoolalloc (Pool, NumBytes);
     return New;
   }
 
@@ -1807,7 +1984,7 @@ poolrealloc (DebugPoolTy *Pool, void *Node, unsigned NumBytes) {
   // Reallocate an object to 0 bytes means that we wish to free it.
   //
   if (NumBytes == 0) {
-    poolfree(Pool, Node);
+    lockedPoolfree (Pool, Node);
     return 0;
   }
 
@@ -1830,7 +2007,7 @@ poolrealloc (DebugPoolTy *Pool, void *Node, unsigned NumBytes) {
   // Allocate a new object.  If we fail, return NULL.
   //
   void *New;
-  if ((New = poolalloc(Pool, NumBytes)) == 0)
+  if ((New = lockedPoolalloc (Pool, NumBytes)) == 0)
     return 0;
 
   //
@@ -1850,7 +2027,7 @@ poolrealloc (DebugPoolTy *Pool, void *Node, unsigned NumBytes) {
   // Invalidate the old object and its bounds and return the pointer to the
   // new object.
   //
-  poolfree(Pool, Node);
+  lockedPoolfree (Pool, Node);
   return New;
 }
 
@@ -1865,7 +2042,7 @@ __sc_dbg_poolrealloc_debug (DebugPoolTy *Pool,
   // shadow object (if necessary), and register the object as a heap object.
   //
   if (Node == 0) {
-    void * New = poolalloc(Pool, NumBytes);
+    void * New = lockedPoolalloc (Pool, NumBytes);
     if (ConfigData.RemapObjects) New = pool_shadow (New, NumBytes);
     pool_register_debug (Pool, New, NumBytes, tag, SourceFilep, lineno);
     return New;
@@ -1877,7 +2054,7 @@ __sc_dbg_poolrealloc_debug (DebugPoolTy *Pool,
   if (NumBytes == 0) {
     pool_unregister_debug (Pool, Node, tag, SourceFilep, lineno);
     if (ConfigData.RemapObjects) Node = pool_unshadow (Node);
-    poolfree(Pool, Node);
+    lockedPoolfree (Pool, Node);
     return 0;
   }
 
@@ -1900,7 +2077,7 @@ __sc_dbg_poolrealloc_debug (DebugPoolTy *Pool,
   // Allocate a new object.  If we fail, return NULL.
   //
   void *New;
-  if ((New = poolalloc(Pool, NumBytes)) == 0)
+  if ((New = lockedPoolalloc (Pool, NumBytes)) == 0)
     return 0;
 
   //
@@ -1929,7 +2106,7 @@ __sc_dbg_poolrealloc_debug (DebugPoolTy *Pool,
   //
   _internal_poolunregister(Pool, Node, Heap, tag, SourceFilep, lineno);
   if (ConfigData.RemapObjects) Node = pool_unshadow (Node);
-  poolfree(Pool, Node);
+  lockedPoolfree (Pool, Node);
   return New;
 }
 
@@ -2072,6 +2249,7 @@ __sc_dbg_poolinit(DebugPoolTy *Pool, unsigned NodeSize, unsigned) {
   // Call the underlying allocator's poolinit() function to initialze the pool.
   //
   poolinit(Pool, NodeSize);
+  pthread_mutex_init (&(Pool->AllocLock), NULL);
 
   //
   // Call the in-place new operator for the splay tree of objects and, if
@@ -2086,18 +2264,15 @@ __sc_dbg_poolinit(DebugPoolTy *Pool, unsigned NodeSize, unsigned) {
   // run-time so in-place new operators must be used to initialize C++ classes
   // within the pool.
   //
-  new (&(Pool->Objects)) RangeSplaySet<>();
-  new (&(Pool->OOB)) RangeSplayMap<void *>();
+  new (&(Pool->Objects)) RangeObjectSet(ConfigData.PageTableIndex,
+                                        ConfigData.ThreadSafe);
   new (&(Pool->DPTree)) RangeSplayMap<PDebugMetaData>();
 
   //
-  // Initialize the object cache.
+  // Give the pool a fresh epoch so that cached objects of a pool previously
+  // using the same memory are not found.
   //
-  Pool->objectCache[0].lower = 0;
-  Pool->objectCache[0].upper = 0;
-  Pool->objectCache[1].lower = 0;
-  Pool->objectCache[1].upper = 0;
-  Pool->cacheIndex = 0;
+  resetCacheEpoch (Pool);
 
   return Pool;
 }
@@ -16,47 +16,212 @@
 #include "DebugReport.h"
 #include "RewritePtr.h"
 
-#include "llvm/ADT/DenseMap.h"
-
 #include "../include/DebugRuntime.h"
 
 #include <cstdio>
-#include <map>
+#include <cstdlib>
+#include <cstring>
 
 extern FILE * ReportLog;
 using namespace llvm; 
 
 namespace llvm {
 
-DebugPoolTy OOBPool;
+//
+// Rewrite pointers are recorded in a hash table whose entries are chained
+// three ways: by rewrite pointer, by original value, and by the start of the
+// object from which the pointer was computed.  An entry lives until its
+// object is unregistered, so a rewrite pointer stays valid for as long as its
+// object does, however many other pointers are rewritten.  The table grows
+// when it is full.
+//
+// Each entry gets a rewrite pointer from the reserved range the first time
+// that it is used and keeps it: when the entry is used again after its object
+// was unregistered, it hands out the same rewrite pointer.  The range is thus
+// only used up if it holds fewer addresses than there are live rewrite
+// pointers; pointers are then no longer rewritten.  A rewrite pointer of an
+// unregistered object may stand for a newer pointer once its entry is reused,
+// as any dangling pointer may point to a newer object.
+//
+
+// The entries; unused ones are linked through NextByOrig
+static RewriteEntry * RewriteEntries;
 
+// The heads of the hash chains; each has RewriteCapacity buckets
+static unsigned * ByRewrite;
+static unsigned * ByOrig;
+static unsigned * ByObject;
+
+// The number of entries; a power of two
+static unsigned RewriteCapacity;
+
+// The number of entries in use, and the head of the list of unused ones
+static unsigned RewriteCount;
+static unsigned RewriteFree;
+
+// The offset within the reserved range of the next rewrite pointer that no
+// entry has yet
+static uintptr_t NextRewrite;
+
+static inline uintptr_t
+hashPointer (const void * p) {
+  uintptr_t h = (uintptr_t) p;
+  h ^= h >> 17;
+  h *= 0x9E3779B1;
+  return (h ^ (h >> 15)) & (RewriteCapacity - 1);
+}
+
+//
+// Function: findRewritePtr()
+//
+// Description:
+//  Find the entry recording the given rewrite pointer.
+//
+// Return value:
+//  NULL      - The pointer is not a live rewrite pointer.
+//  Otherwise - The entry of the rewrite pointer is returned.
 //
-// Functions for returning global variables used for rewrite pointer book
-// keeping.  We use functions to guarantee that the global variables are
-// initialized before they are used (otherwise, we rely on global constructors
-// which may or may not be run before the first pointer rewrite needs to be
-// done).
+RewriteEntry *
+findRewritePtr (void * p) {
+  if (!isRewritePtr (p) || !RewriteCount)
+    return 0;
 
-// Map between rewrite pointer and source file information
-llvm::DenseMap<void *, const char*>  & RewriteSourcefile (void) {
-  static llvm::DenseMap<void *, const char*>  internalRewriteSourcefile;
-  return internalRewriteSourcefile;
+  for (unsigned index = ByRewrite[hashPointer (p)]; index; ) {
+    RewriteEntry * Entry = &(RewriteEntries[index - 1]);
+    if (Entry->Rewrite == p)
+      return Entry;
+    index = Entry->NextByRewrite;
+  }
+  return 0;
 }
 
-llvm::DenseMap<void *, unsigned> & RewriteLineno (void) {
-  static llvm::DenseMap<void *, unsigned>     internalRewriteLineno;
-  return internalRewriteLineno;
+//
+// Function: findOrigPtr()
+//
+// Description:
+//  Find the entry, if any, for the given original pointer value.
+//
+static RewriteEntry *
+findOrigPtr (const void * p) {
+  if (!RewriteCount)
+    return 0;
+
+  for (unsigned index = ByOrig[hashPointer (p)]; index; ) {
+    RewriteEntry * Entry = &(RewriteEntries[index - 1]);
+    if (Entry->Orig == p)
+      return Entry;
+    index = Entry->NextByOrig;
+  }
+  return 0;
 }
 
-std::map<const void *, const void *> & RewrittenPointers (void) {
-  static std::map<const void *, const void *> internalRewrittenPointers;
-  return internalRewrittenPointers;
+//
+// Functions: linkEntry(), unlinkEntry()
+//
+// Description:
+//  Add an entry to or remove it from the chain of the given key.
+//
+static inline void
+linkEntry (unsigned * Heads, unsigned RewriteEntry::*Next,
+           const void * Key, unsigned index) {
+  unsigned & Head = Heads[hashPointer (Key)];
+  RewriteEntries[index - 1].*Next = Head;
+  Head = index;
 }
 
-// Record from which object an OOB pointer originates
-llvm::DenseMap<void *, std::pair<void *, void * > > & RewrittenObjs (void) {
-  static llvm::DenseMap<void *, std::pair<void *, void * > > intRewrittenObjs;
-  return intRewrittenObjs;
+static inline void
+unlinkEntry (unsigned * Heads, unsigned RewriteEntry::*Next,
+             const void * Key, unsigned index) {
+  unsigned * Link = &(Heads[hashPointer (Key)]);
+  while (*Link != index)
+    Link = &(RewriteEntries[*Link - 1].*Next);
+  *Link = RewriteEntries[index - 1].*Next;
+}
+
+//
+// Function: growTable()
+//
+// Description:
+//  Double the number of entries of the table and rehash the entries in use.
+//
+// Return value:
+//  false - The memory for the larger table could not be allocated.
+//
+static bool
+growTable (void) {
+  unsigned Capacity = RewriteCapacity ? 2 * RewriteCapacity : 1024;
+  RewriteEntry * Entries = (RewriteEntry *) realloc (RewriteEntries,
+                                                     Capacity *
+                                                     sizeof (RewriteEntry));
+  unsigned * Heads = (unsigned *) calloc (3 * Capacity, sizeof (unsigned));
+  if (!Entries || !Heads) {
+    if (Entries) RewriteEntries = Entries;
+    free (Heads);
+    return false;
+  }
+  memset (Entries + RewriteCapacity, 0,
+          (Capacity - RewriteCapacity) * sizeof (RewriteEntry));
+
+  free (ByRewrite);
+  RewriteEntries = Entries;
+  ByRewrite = Heads;
+  ByOrig = Heads + Capacity;
+  ByObject = Heads + 2 * Capacity;
+  unsigned OldCapacity = RewriteCapacity;
+  RewriteCapacity = Capacity;
+
+  //
+  // All old entries are in use, since the table only grows when it is full.
+  //
+  for (unsigned index = 1; index <= OldCapacity; ++index) {
+    RewriteEntry & Entry = RewriteEntries[index - 1];
+    linkEntry (ByRewrite, &RewriteEntry::NextByRewrite, Entry.Rewrite, index);
+    linkEntry (ByOrig, &RewriteEntry::NextByOrig, Entry.Orig, index);
+    linkEntry (ByObject, &RewriteEntry::NextByObject, Entry.ObjStart, index);
+  }
+
+  for (unsigned index = Capacity; index > OldCapacity; --index) {
+    RewriteEntries[index - 1].NextByOrig = RewriteFree;
+    RewriteFree = index;
+  }
+  return true;
+}
+
+//
+// Function: dropRewritePtrs()
+//
+// Description:
+//  Remove the entries of the rewrite pointers computed from an object that is
+//  being unregistered.  Their rewrite pointers are no longer found; they are
+//  treated like any other invalid pointer.
+//
+void
+dropRewritePtrs (void * ObjStart) {
+  if (!__atomic_load_n (&RewriteCount, __ATOMIC_RELAXED))
+    return;
+
+  MetaDataGuard Guard;
+  if (!RewriteCount)
+    return;
+
+  unsigned * Link = &(ByObject[hashPointer (ObjStart)]);
+  while (unsigned index = *Link) {
+    RewriteEntry & Entry = RewriteEntries[index - 1];
+    if (Entry.ObjStart != ObjStart) {
+      Link = &(Entry.NextByObject);
+      continue;
+    }
+
+    *Link = Entry.NextByObject;
+    unlinkEntry (ByRewrite, &RewriteEntry::NextByRewrite, Entry.Rewrite, index);
+    unlinkEntry (ByOrig, &RewriteEntry::NextByOrig, Entry.Orig, index);
+    void * Rewrite = Entry.Rewrite;
+    memset (&Entry, 0, sizeof (RewriteEntry));
+    Entry.Rewrite = Rewrite;
+    Entry.NextByOrig = RewriteFree;
+    RewriteFree = index;
+    --RewriteCount;
+  }
 }
 
 //
@@ -83,63 +248,72 @@ rewrite_ptr (DebugPoolTy * Pool,
              void * ObjEnd,
              const char * SourceFile,
              unsigned lineno) {
-
-  static unsigned char * invalidptr = 0;
+  MetaDataGuard Guard;
 
   //
-  // If this pointer has already been rewritten, do not rewrite it again.
+  // If this pointer has already been rewritten for the same object, do not
+  // rewrite it again.
   //
-  if (RewrittenPointers().find (p) != RewrittenPointers().end()) {
-    return const_cast<void*>(RewrittenPointers()[p]);
-  }
+  RewriteEntry * Entry = findOrigPtr (p);
+  if (Entry && (Entry->ObjStart == ObjStart) && (Entry->ObjEnd == ObjEnd))
+    return Entry->Rewrite;
 
   //
-  // Calculate a new rewrite pointer.
+  // An entry for the pointer that was made for a different object (whose
+  // memory has been reused) is updated in place.
   //
-  if (invalidptr == 0) invalidptr = (unsigned char*)InvalidLower;
-  ++invalidptr;
+  if (Entry) {
+    unsigned index = (Entry - RewriteEntries) + 1;
+    unlinkEntry (ByObject, &RewriteEntry::NextByObject, Entry->ObjStart, index);
+    linkEntry (ByObject, &RewriteEntry::NextByObject, ObjStart, index);
+  } else {
+    if (!RewriteFree && !growTable ()) {
+      fprintf (stderr, "rewrite: cannot grow the rewrite table\n");
+      fflush (stderr);
+      return const_cast<void*>(p);
+    }
 
-  //
-  // Ensure that we haven't run out of rewrite pointers.
-  //
-  void* P = invalidptr;
-  if ((uintptr_t) P == InvalidUpper) {
-    fprintf (stderr, "rewrite: out of rewrite ptrs: %p %p, pc=%p\n",
-             (void *) InvalidLower, (void *) InvalidUpper, invalidptr);
-    fflush (stderr);
-    return const_cast<void*>(p);
-  }
+    unsigned index = RewriteFree;
+    Entry = &(RewriteEntries[index - 1]);
 
-  //
-  // If no pool was specified (as is the case for an ExactCheck), use a
-  // special Out of Bounds Pointer pool.
-  //
-  if (!Pool) Pool = &OOBPool;
+    //
+    // An entry that has never been used needs a rewrite pointer of its own.
+    // Ensure that we haven't run out of rewrite pointers.
+    //
+    if (!Entry->Rewrite) {
+      if (NextRewrite >= InvalidUpper - InvalidLower - 1) {
+        static bool Warned = false;
+        if (!Warned) {
+          fprintf (stderr, "rewrite: out of rewrite ptrs: %p %p\n",
+                   (void *) InvalidLower, (void *) InvalidUpper);
+          fflush (stderr);
+          Warned = true;
+        }
+        return const_cast<void*>(p);
+      }
+      Entry->Rewrite = (void *) (InvalidLower + 1 + NextRewrite++);
+    }
 
-  //
-  // Determine if this pointer value has already been rewritten.  If so, just
-  // return the previously rewritten value.  Otherwise, insert a mapping from
-  // rewrite pointer to original pointer into the pool.
-  //
-  Pool->OOB.insert (invalidptr, ((unsigned char *)(invalidptr)), const_cast<void*>(p));
+    RewriteFree = Entry->NextByOrig;
+    Entry->Orig = p;
+    linkEntry (ByRewrite, &RewriteEntry::NextByRewrite, Entry->Rewrite, index);
+    linkEntry (ByOrig, &RewriteEntry::NextByOrig, p, index);
+    linkEntry (ByObject, &RewriteEntry::NextByObject, ObjStart, index);
+    __atomic_store_n (&RewriteCount, RewriteCount + 1, __ATOMIC_RELAXED);
+  }
+
+  Entry->ObjStart = ObjStart;
+  Entry->ObjEnd = ObjEnd;
+  Entry->SourceFile = SourceFile;
+  Entry->lineno = lineno;
 
-  //
-  // If debugging tool support is enabled, then insert it into the global
-  // OOB pool as well; this will ensure that we can find the pointer on a
-  // memory protection violation (on faults, we don't have Pool handle
-  // information).
-  //
   if (logregs) {
-    fprintf (ReportLog, "rewrite: %p: %p -> %p\n", (void*) Pool, p, invalidptr);
+    fprintf (ReportLog, "rewrite: %p: %p -> %p\n", (void*) Pool, p,
+             Entry->Rewrite);
     fflush (ReportLog);
   }
 
-  OOBPool.OOB.insert (invalidptr, ((unsigned char *)(invalidptr)), const_cast<void*>(p));
-  RewriteSourcefile()[invalidptr] = SourceFile;
-  RewriteLineno()[invalidptr] = lineno;
-  RewrittenPointers()[p] = invalidptr;
-  RewrittenObjs()[invalidptr] = std::make_pair(ObjStart, ObjEnd);
-  return invalidptr;
+  return Entry->Rewrite;
 }
 
 }
@@ -160,32 +334,18 @@ pchk_getActualValue (DebugPoolTy * Pool, void * p) {
     return p;
   }
 
-  void * src = 0;
-  void* tag = 0;
-  void * end = 0;
-
   //
-  // Look for the pointer in the pool's OOB pointer list.  If we find it,
+  // Look for the pointer in the table of rewrite pointers.  If we find it,
   // return its actual value.
   //
-  if (Pool && (Pool->OOB.find(p, src, end, tag))) {
-    if (logregs) {
-      fprintf (ReportLog, "getActualValue(1): %p: %p -> %p\n", (void*)Pool, p, tag);
-      fflush (ReportLog);
-    }
-    return tag;
-  }
-
-  //
-  // If we can't find the pointer in the pool's OOB list, perhaps it's in the
-  // global OOB Pool (this can happen when it's rewritten by an exact check).
-  //
-  if (OOBPool.OOB.find (p, src, end, tag)) {
+  MetaDataGuard Guard;
+  if (RewriteEntry * Entry = findRewritePtr (p)) {
     if (logregs) {
-      fprintf (ReportLog, "getActualValue(2): %p: %p -> %p\n", (void*)&OOBPool, p, tag);
+      fprintf (ReportLog, "getActualValue(1): %p: %p -> %p\n", (void*)Pool, p,
+               Entry->Orig);
       fflush (ReportLog);
     }
-    return tag;
+    return const_cast<void*>(Entry->Orig);
   }
 
   //
@@ -194,7 +354,7 @@ pchk_getActualValue (DebugPoolTy * Pool, void * p) {
   // just return the pointer.
   //
   if (logregs) {
-    fprintf (ReportLog, "getActualValue(3): %p: %p -> %p\n", (void*)Pool, p, p);
+    fprintf (ReportLog, "getActualValue(2): %p: %p -> %p\n", (void*)Pool, p, p);
     fflush (ReportLog);
   }
   return p;
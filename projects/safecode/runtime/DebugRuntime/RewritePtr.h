@@ -38,12 +38,35 @@ namespace llvm {
 extern uintptr_t InvalidUpper;
 extern uintptr_t InvalidLower;
 
-// Map between rewrite pointer and source file information
-extern llvm::DenseMap<void *, const char*>  & RewriteSourcefile (void);
-extern llvm::DenseMap<void *, unsigned>     & RewriteLineno (void);
-extern std::map<const void *, const void *> & RewrittenPointers (void);
-extern llvm::DenseMap<void *,
-                      std::pair<void *, void * > > & RewrittenObjs (void);
+//
+// Structure: RewriteEntry
+//
+// Description:
+//  The record of a single Out of Bounds (OOB) rewrite pointer.
+//
+struct RewriteEntry {
+  // The original, out of bounds value of the pointer
+  const void * Orig;
+
+  // The rewrite pointer that stands for the original value
+  void * Rewrite;
+
+  // The bounds of the object from which the pointer was computed
+  void * ObjStart;
+  void * ObjEnd;
+
+  // The location of the check that rewrote the pointer
+  const char * SourceFile;
+  unsigned lineno;
+
+  // The next entries in the hash chains of the table (index + 1, or zero)
+  unsigned NextByRewrite;
+  unsigned NextByOrig;
+  unsigned NextByObject;
+};
+
+extern RewriteEntry * findRewritePtr (void * p);
+extern void dropRewritePtrs (void * ObjStart);
 
 //
 // Function: isRewritePtr()
@@ -86,9 +109,13 @@ isRewritePtr (void * p) {
 static inline bool
 getOOBObject (void * p, void * & start, void * & end) {
   if (isRewritePtr (p)) {
-    // FIXME: the casts are hacks to deal with the C++ type system
-    start = const_cast<void*>(RewrittenObjs()[p].first);
-    end   = const_cast<void*>(RewrittenObjs()[p].second);
+    MetaDataGuard Guard;
+    if (RewriteEntry * Entry = findRewritePtr (p)) {
+      start = Entry->ObjStart;
+      end   = Entry->ObjEnd;
+    } else {
+      start = end = 0;
+    }
     return true;
   }
 
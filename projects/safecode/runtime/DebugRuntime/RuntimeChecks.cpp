@@ -33,9 +33,12 @@
 #include "PageManager.h"
 #include "ConfigData.h"
 #include "RewritePtr.h"
+#include "ObjectCache.h"
 
 #include "../include/CWE.h"
 #include "../include/DebugRuntime.h"
+#include "../include/SiteCache.h"
+#include "../include/TargetSet.h"
 
 #include <errno.h>
 
@@ -50,25 +53,6 @@ extern FILE * ReportLog;
 
 using namespace llvm;
 
-static inline unsigned char
-isInCache (DebugPoolTy * Pool, void * p) {
-  if ((Pool->objectCache[0].lower <= p) && (p <= Pool->objectCache[0].upper))
-    return 0;
-
-  if ((Pool->objectCache[1].lower <= p) && (p <= Pool->objectCache[1].upper))
-    return 1;
-
-  return 2;
-}
-
-static inline void
-updateCache (DebugPoolTy * Pool, void * Start, void * End) {
-  Pool->objectCache[Pool->cacheIndex].lower = Start;
-  Pool->objectCache[Pool->cacheIndex].upper = End;
-  Pool->cacheIndex = (Pool->cacheIndex) ? 0 : 1;
-  return;
-}
-
 //
 // Provide dummy implementations of the common infrastructure run-time checks
 // to appease libLTO linking on Mac OS X.
@@ -134,21 +118,16 @@ _barebone_poolcheck (DebugPoolTy * Pool, void * Node, unsigned length,
   // Otherwise, look through the splay trees for an object in which the
   // pointer points.
   //
-  bool found = false;
-  unsigned char index = isInCache (Pool, Node);
-  if (index < 2) {
-    found = true;
-    ObjStart = Pool->objectCache[index].lower;
-    ObjEnd = Pool->objectCache[index].upper; 
-  } else {
-    found = Pool->Objects.find (Node, ObjStart, ObjEnd);
-  }
+  if (isInCache (Pool, Node, ObjStart, ObjEnd))
+    return true;
+
+  bool found = Pool->Objects.find (Node, ObjStart, ObjEnd);
 
   //
   // If the memory access is within bounds, update the cache and return.
   //
   if ((found) && (ObjStart <= Node) && (Node <= ObjEnd)) {
-    updateCache (Pool, ObjStart, ObjEnd);
+    updateCache (Pool, Node, ObjStart, ObjEnd);
     return true;
   }
 
@@ -157,9 +136,9 @@ _barebone_poolcheck (DebugPoolTy * Pool, void * Node, unsigned length,
   // itself.
   //
 #if 1
-  if ((ObjStart = __pa_bitmap_poolcheck (Pool, Node))) {
+  if ((ObjStart = slabPoolcheck (Pool, Node))) {
     ObjEnd = (unsigned char *) ObjStart + Pool->NodeSize - 1;
-    updateCache (Pool, ObjStart, ObjEnd);
+    updateCache (Pool, Node, ObjStart, ObjEnd);
     return true;
   }
 #endif
@@ -170,6 +149,40 @@ _barebone_poolcheck (DebugPoolTy * Pool, void * Node, unsigned length,
   return false;
 }
 
+//
+// Function: __sc_fill_site_cache()
+//
+// Description:
+//  Cache the object containing the specified pointer in the cache of a check
+//  site.  The object is found the same way that poolcheck() finds it.  If the
+//  pointer is not within a known object, the cache is left unmodified.
+//
+// Inputs:
+//  Pool  - The pool argument of the check.
+//  Node  - The pointer that missed in the cache.
+//  Cache - The cache of the check site.
+//
+void
+__sc_fill_site_cache (void * Pool, void * Node, SiteCache * Cache) {
+  useSiteCaches ();
+  uintptr_t Epoch = readSiteCacheEpoch ();
+
+  void * ObjStart;
+  void * ObjEnd;
+  if (!_barebone_poolcheck ((DebugPoolTy *) Pool, Node, 1, ObjStart, ObjEnd)) {
+    if (!(ExternalObjects->find (Node, ObjStart, ObjEnd)))
+      return;
+    if (!((ObjStart <= Node) && (Node <= ObjEnd)))
+      return;
+  }
+
+  Cache->Pool = Pool;
+  Cache->lower = ObjStart;
+  Cache->upper = (unsigned char *) ObjEnd + 1;
+  Cache->Epoch = Epoch;
+  return;
+}
+
 //
 // Function: poolcheck_debug()
 //
@@ -306,13 +319,7 @@ poolcheckalign_debug (DebugPoolTy *Pool, void *Node, unsigned Offset, TAG, const
   //
   void * S = 0;
   void * end = 0;
-  bool found = false;
-  unsigned char index = isInCache (Pool, Node);
-  if (index < 2) {
-    S   = Pool->objectCache[index].lower;
-    end = Pool->objectCache[index].upper;
-    found = true;
-  }
+  bool found = isInCache (Pool, Node, S, end);
 
   //
   // Look for the object in the splay of regular objects.
@@ -326,7 +333,7 @@ poolcheckalign_debug (DebugPoolTy *Pool, void *Node, unsigned Offset, TAG, const
   //
   if (!found) {
 #if 1
-    if (void * start = __pa_bitmap_poolcheck (Pool, Node)) {
+    if (void * start = slabPoolcheck (Pool, Node)) {
       S = start;
       end = (unsigned char *)start + Pool->NodeSize - 1;
       found = true;
@@ -441,13 +448,15 @@ poolcheckui_debug (DebugPoolTy *Pool,
 
   //
   // If it's a rewrite pointer, convert it back into its original value so
-  // that we can print the real faulting address.
+  // that we can print the real faulting address.  Only rewrite pointers take
+  // the meta-data lock; a pointer that is simply unregistered (the common case
+  // for incomplete checks) must not serialize the threads.
   //
   ObjStart = 0;
   ObjEnd = 0;
   if (isRewritePtr (Node)) {
-    ObjStart = RewrittenObjs()[Node].first;
-    ObjEnd   = RewrittenObjs()[Node].second;
+    MetaDataGuard Guard;
+    getOOBObject (Node, ObjStart, ObjEnd);
     Node = pchk_getActualValue (Pool, Node);
   }
 
@@ -469,6 +478,7 @@ poolcheckui_debug (DebugPoolTy *Pool,
     //
     // Attempt to get information on where the memory object was allocated.
     //
+    MetaDataGuard Guard;
     void * start;
     void * end;
     PDebugMetaData debugmetadataptr = 0;
@@ -538,18 +548,15 @@ boundscheck_lookup (DebugPoolTy * Pool, void * & Source, void * & End ) {
     //
     // First check the cache of objects to see if the pointer is in there.
     //
-    unsigned char index = isInCache (Pool, Source);
-    if (index < 2) {
-      Source = Pool->objectCache[index].lower;
-      End    = Pool->objectCache[index].upper;
+    void * Key = Source;
+    if (isInCache (Pool, Key, Source, End))
       return true;
-    }
 
     //
     // Search the splay tree.  If we find the object, add it to the cache.
     //
-    if (Pool->Objects.find(Source, Source, End)) {
-      updateCache (Pool, Source, End);
+    if (Pool->Objects.find(Key, Source, End)) {
+      updateCache (Pool, Key, Source, End);
       return true;
     }
 
@@ -558,10 +565,10 @@ boundscheck_lookup (DebugPoolTy * Pool, void * & Source, void * & End ) {
     // get the object bounds and recheck the pointer.
     //
 #if 1
-    if (void * start = __pa_bitmap_poolcheck (Pool, Source)) {
+    if (void * start = slabPoolcheck (Pool, Key)) {
       Source = start;
       End = (unsigned char *)start + Pool->NodeSize - 1;
-      updateCache (Pool, Source, End);
+      updateCache (Pool, Key, Source, End);
       return true;
     }
 #endif
@@ -598,6 +605,12 @@ boundscheck_check (bool found, void * ObjStart, void * ObjEnd,
                    DebugPoolTy * Pool,
                    void * Source, void * Dest, bool CanFail,
                    const char * SourceFile, unsigned int lineno) {
+  //
+  // The slow path consults the rewrite pointer tables and debug meta-data;
+  // serialize it in thread-safe mode.
+  //
+  MetaDataGuard Guard;
+
   //
   // Determine if this is a rewrite pointer that is being indexed.  If so,
   // compute the original value, re-do the indexing operation, and rewrite the
@@ -1021,6 +1034,66 @@ funccheck_debug (void *f,
   return;
 }
 
+//
+// Function: funccheck_set()
+//
+// Description:
+//  Determine whether the specified function pointer is one of the functions
+//  in the given set.  The compiler uses this check instead of funccheck() for
+//  calls with many targets.
+//
+// Inputs:
+//  f         - The function pointer that we are testing.
+//  Set       - The set of potential targets.
+//
+void
+funccheck_set (void *f, TargetSet * Set) {
+  if (isInTargetSet (f, Set))
+    return;
+
+  DebugViolationInfo v;
+  v.type = ViolationInfo::FAULT_CALL,
+    v.faultPC = __builtin_return_address(0),
+    v.faultPtr = f,
+    v.CWE = CWEBufferOverflow,
+    v.SourceFile = "Unknown",
+    v.lineNo = 0;
+
+  ReportMemoryViolation(&v);
+  return;
+}
+
+//
+// Function: funccheck_set_debug()
+//
+// Description:
+//  This is the debug version of funccheck_set().
+//
+// Inputs:
+//  f         - The function pointer that we are testing.
+//  Set       - The set of potential targets.
+//
+void
+funccheck_set_debug (void *f,
+                     TargetSet * Set,
+                     TAG,
+                     const char * SourceFilep,
+                     unsigned lineno) {
+  if (isInTargetSet (f, Set))
+    return;
+
+  DebugViolationInfo v;
+  v.type = ViolationInfo::FAULT_CALL,
+    v.faultPC = __builtin_return_address(0),
+    v.faultPtr = f,
+    v.CWE = CWEBufferOverflow,
+    v.SourceFile = SourceFilep,
+    v.lineNo = lineno;
+
+  ReportMemoryViolation(&v);
+  return;
+}
+
 //
 // Function: funccheckui()
 //
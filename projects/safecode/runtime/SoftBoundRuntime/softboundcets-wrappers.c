@@ -97,6 +97,7 @@
 
 #include <fcntl.h>
 #include <wctype.h>
+#include <pthread.h>
 
 
 typedef size_t key_type;
@@ -2206,6 +2207,116 @@ softboundcets_qsort(void* base, size_t nmemb, size_t size,
   my_qsort(base, nmemb, size, compar);
 }
 
+/* The start routine and argument of a thread created by the program,
+ * along with the metadata of the argument */
+typedef struct {
+  void* (*start_routine)(void*);
+  void* arg;
+  void* base;
+  void* bound;
+  size_t key;
+  void* lock;
+} __softboundcets_thread_start_t;
+
+static void __softboundcets_thread_cleanup(void* unused){
+  if(__SOFTBOUNDCETS_MULTITHREADED){
+    __softboundcets_thread_fini();
+  }
+}
+
+/* Runs in the new thread: sets up the thread's shadow stack and
+ * passes the argument with its metadata to the start routine */
+static void* __softboundcets_thread_start(void* start_arg){
+
+  __softboundcets_thread_start_t start = 
+    *((__softboundcets_thread_start_t*) start_arg);
+  __softboundcets_safe_free(start_arg);
+
+  if(__SOFTBOUNDCETS_MULTITHREADED){
+    __softboundcets_thread_init();
+  }
+
+  void* ret_ptr;
+  pthread_cleanup_push(__softboundcets_thread_cleanup, NULL);
+
+  __softboundcets_allocate_shadow_stack_space(2);
+
+#ifdef __SOFTBOUNDCETS_SPATIAL
+
+  __softboundcets_store_base_shadow_stack(start.base, 1);
+  __softboundcets_store_bound_shadow_stack(start.bound, 1);
+
+#elif __SOFTBOUNDCETS_TEMPORAL
+
+  __softboundcets_store_key_shadow_stack(start.key, 1);
+  __softboundcets_store_lock_shadow_stack(start.lock, 1);
+
+#elif __SOFTBOUNDCETS_SPATIAL_TEMPORAL
+
+  __softboundcets_store_base_shadow_stack(start.base, 1);
+  __softboundcets_store_bound_shadow_stack(start.bound, 1);
+  __softboundcets_store_key_shadow_stack(start.key, 1);
+  __softboundcets_store_lock_shadow_stack(start.lock, 1);
+
+#else
+
+  __softboundcets_store_base_shadow_stack(start.base, 1);
+  __softboundcets_store_bound_shadow_stack(start.bound, 1);
+  __softboundcets_store_key_shadow_stack(start.key, 1);
+  __softboundcets_store_lock_shadow_stack(start.lock, 1);
+
+#endif
+
+  ret_ptr = start.start_routine(start.arg);
+  __softboundcets_deallocate_shadow_stack_space();
+
+  pthread_cleanup_pop(1);
+  return ret_ptr;
+}
+
+__WEAK_INLINE int 
+softboundcets_pthread_create(pthread_t* thread, const pthread_attr_t* attr,
+                             void* (*start_routine)(void*), void* arg){
+
+  __softboundcets_thread_start_t* start = 
+    __softboundcets_safe_calloc(1, sizeof(__softboundcets_thread_start_t));
+  start->start_routine = start_routine;
+  start->arg = arg;
+
+  /* The argument is the fourth pointer argument */
+#ifdef __SOFTBOUNDCETS_SPATIAL
+
+  start->base = __softboundcets_load_base_shadow_stack(4);
+  start->bound = __softboundcets_load_bound_shadow_stack(4);
+
+#elif __SOFTBOUNDCETS_TEMPORAL
+
+  start->key = __softboundcets_load_key_shadow_stack(4);
+  start->lock = __softboundcets_load_lock_shadow_stack(4);
+
+#elif __SOFTBOUNDCETS_SPATIAL_TEMPORAL
+
+  start->base = __softboundcets_load_base_shadow_stack(4);
+  start->bound = __softboundcets_load_bound_shadow_stack(4);
+  start->key = __softboundcets_load_key_shadow_stack(4);
+  start->lock = __softboundcets_load_lock_shadow_stack(4);
+
+#else
+
+  start->base = __softboundcets_load_base_shadow_stack(4);
+  start->bound = __softboundcets_load_bound_shadow_stack(4);
+  start->key = __softboundcets_load_key_shadow_stack(4);
+  start->lock = __softboundcets_load_lock_shadow_stack(4);
+
+#endif
+
+  int ret = pthread_create(thread, attr, __softboundcets_thread_start, start);
+  if(ret != 0){
+    __softboundcets_safe_free(start);
+  }
+  return ret;
+}
+
 #if defined(__linux__)
 
 __WEAK_INLINE 
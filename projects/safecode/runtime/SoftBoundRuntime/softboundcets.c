@@ -53,14 +53,24 @@
 #include "softboundcets.h"
 
 __softboundcets_trie_entry_t** __softboundcets_trie_primary_table;
+#ifdef __SOFTBOUNDCETS_COMPACT_METADATA
+__softboundcets_overflow_entry_t** __softboundcets_trie_overflow_table;
+#endif
 
 size_t* __softboundcets_free_map_table = NULL;
 
-size_t* __softboundcets_shadow_stack_ptr = NULL;
+__SOFTBOUNDCETS_THREAD_LOCAL size_t* __softboundcets_shadow_stack_ptr = NULL;
+
+__SOFTBOUNDCETS_THREAD_LOCAL size_t* __softboundcets_lock_next_location = NULL;
+__SOFTBOUNDCETS_THREAD_LOCAL size_t* __softboundcets_lock_new_location = NULL;
+__SOFTBOUNDCETS_THREAD_LOCAL size_t* __softboundcets_lock_new_limit = NULL;
+__SOFTBOUNDCETS_THREAD_LOCAL size_t __softboundcets_key_id_counter = 2;
+__SOFTBOUNDCETS_THREAD_LOCAL size_t __softboundcets_key_id_limit = 0;
 
-size_t* __softboundcets_lock_next_location = NULL;
-size_t* __softboundcets_lock_new_location = NULL;
-size_t __softboundcets_key_id_counter = 2;
+/* The first key and the index of the first heap lock location that
+ * no thread has taken yet (multithreaded mode only) */
+static size_t __softboundcets_key_id_next_chunk = 2;
+static size_t __softboundcets_lock_next_chunk = 0;
 
 #ifdef __SOFTBOUNDCETS_STATISTICS_MODE
 size_t __softboundcets_statistics_metadata_memcopies = 0;
@@ -81,7 +91,12 @@ size_t __softboundcets_deref_check_count = 0;
 size_t* __softboundcets_global_lock = 0;
 
 size_t* __softboundcets_temporal_space_begin = 0;
-size_t* __softboundcets_stack_temporal_space_begin = NULL;
+__SOFTBOUNDCETS_THREAD_LOCAL size_t* __softboundcets_stack_temporal_space_begin = NULL;
+
+/* The start of the calling thread's shadow stack and stack key/lock
+ * space, which are released when the thread exits */
+static __SOFTBOUNDCETS_THREAD_LOCAL size_t* __softboundcets_shadow_stack_begin = NULL;
+static __SOFTBOUNDCETS_THREAD_LOCAL size_t* __softboundcets_stack_temporal_space_start = NULL;
 
 void* malloc_address = NULL;
 
@@ -159,6 +174,90 @@ static int softboundcets_initialized = 0;
 __NO_INLINE void __softboundcets_stub(void) {
   return;
 }
+
+/* Allocates the shadow stack and the stack key/lock space of the
+ * calling thread */
+void __softboundcets_thread_init(void)
+{
+  size_t stack_temporal_table_length = (__SOFTBOUNDCETS_N_STACK_TEMPORAL_ENTRIES) * sizeof(void*);
+  __softboundcets_stack_temporal_space_begin = mmap(0, stack_temporal_table_length, 
+                                                    PROT_READ| PROT_WRITE, 
+                                                    SOFTBOUNDCETS_MMAP_FLAGS, -1, 0);
+  assert(__softboundcets_stack_temporal_space_begin != (void*) -1);
+  __softboundcets_stack_temporal_space_start = __softboundcets_stack_temporal_space_begin;
+
+  size_t shadow_stack_size = __SOFTBOUNDCETS_SHADOW_STACK_ENTRIES * sizeof(size_t);
+  __softboundcets_shadow_stack_ptr = mmap(0, shadow_stack_size, 
+                                          PROT_READ|PROT_WRITE, 
+                                          SOFTBOUNDCETS_MMAP_FLAGS, -1, 0);
+  assert(__softboundcets_shadow_stack_ptr != (void*)-1);
+  __softboundcets_shadow_stack_begin = __softboundcets_shadow_stack_ptr;
+
+  *((size_t*)__softboundcets_shadow_stack_ptr) = 0; /* prev stack size */
+  size_t * current_size_shadow_stack_ptr =  __softboundcets_shadow_stack_ptr +1 ;
+  *(current_size_shadow_stack_ptr) = 0;
+
+  if(__SOFTBOUNDCETS_SHADOW_STACK_DEBUG){
+    printf("[mmap_shadow_stack]mmaped shadowstack pointer = %p\n", 
+           __softboundcets_shadow_stack_ptr);
+  }
+}
+
+/* Releases the shadow stack and the stack key/lock space of the
+ * calling thread. Its unused keys and heap lock locations are not
+ * returned. */
+void __softboundcets_thread_fini(void)
+{
+  size_t stack_temporal_table_length = (__SOFTBOUNDCETS_N_STACK_TEMPORAL_ENTRIES) * sizeof(void*);
+  munmap(__softboundcets_stack_temporal_space_start, stack_temporal_table_length);
+
+  size_t shadow_stack_size = __SOFTBOUNDCETS_SHADOW_STACK_ENTRIES * sizeof(size_t);
+  munmap(__softboundcets_shadow_stack_begin, shadow_stack_size);
+
+  __softboundcets_shadow_stack_ptr = NULL;
+  __softboundcets_stack_temporal_space_begin = NULL;
+}
+
+/* Gives the calling thread a new chunk of keys */
+void __softboundcets_allocate_key_chunk(void)
+{
+  __softboundcets_key_id_counter = 
+    __sync_fetch_and_add(&__softboundcets_key_id_next_chunk, 
+                         __SOFTBOUNDCETS_KEY_CHUNK_ENTRIES);
+  __softboundcets_key_id_limit = 
+    __softboundcets_key_id_counter + __SOFTBOUNDCETS_KEY_CHUNK_ENTRIES;
+}
+
+/* Gives the calling thread a new chunk of heap lock locations */
+void __softboundcets_allocate_lock_chunk(void)
+{
+  size_t index = __sync_fetch_and_add(&__softboundcets_lock_next_chunk, 
+                                      __SOFTBOUNDCETS_LOCK_CHUNK_ENTRIES);
+  if(index + __SOFTBOUNDCETS_LOCK_CHUNK_ENTRIES > __SOFTBOUNDCETS_N_TEMPORAL_ENTRIES){
+    __softboundcets_printf("[lock_allocate] out of temporal free entries \n");
+    __softboundcets_abort();
+  }
+
+  __softboundcets_lock_new_location = __softboundcets_temporal_space_begin + index;
+  __softboundcets_lock_new_limit = 
+    __softboundcets_lock_new_location + __SOFTBOUNDCETS_LOCK_CHUNK_ENTRIES;
+}
+/* Aborts if the module was instrumented for a metadata encoding other
+ * than the one the run-time was built with */
+void __softboundcets_check_metadata_encoding(int is_compact)
+{
+#ifdef __SOFTBOUNDCETS_COMPACT_METADATA
+  int runtime_is_compact = 1;
+#else
+  int runtime_is_compact = 0;
+#endif
+
+  if (is_compact != runtime_is_compact) {
+    __softboundcets_printf("Softboundcets: Inconsistent specification of metadata encoding\n");
+    abort();
+  }
+}
+
 void __softboundcets_init( int is_trie) 
 {
   if (__SOFTBOUNDCETS_DEBUG) {
@@ -189,19 +288,17 @@ void __softboundcets_init( int is_trie)
 
   size_t temporal_table_length = (__SOFTBOUNDCETS_N_TEMPORAL_ENTRIES)* sizeof(void*);
 
-  __softboundcets_lock_new_location = mmap(0, temporal_table_length, 
-                                           PROT_READ| PROT_WRITE,
-                                           SOFTBOUNDCETS_MMAP_FLAGS, -1, 0);
+  __softboundcets_temporal_space_begin = mmap(0, temporal_table_length, 
+                                              PROT_READ| PROT_WRITE,
+                                              SOFTBOUNDCETS_MMAP_FLAGS, -1, 0);
   
-  assert(__softboundcets_lock_new_location != (void*) -1);
-  __softboundcets_temporal_space_begin = (size_t *)__softboundcets_lock_new_location;
-
+  assert(__softboundcets_temporal_space_begin != (void*) -1);
 
-  size_t stack_temporal_table_length = (__SOFTBOUNDCETS_N_STACK_TEMPORAL_ENTRIES) * sizeof(void*);
-  __softboundcets_stack_temporal_space_begin = mmap(0, stack_temporal_table_length, 
-                                                    PROT_READ| PROT_WRITE, 
-                                                    SOFTBOUNDCETS_MMAP_FLAGS, -1, 0);
-  assert(__softboundcets_stack_temporal_space_begin != (void*) -1);
+  /* In the multithreaded mode, the lock locations are handed out in
+   * chunks when a thread first allocates memory */
+  if(!__SOFTBOUNDCETS_MULTITHREADED){
+    __softboundcets_lock_new_location = __softboundcets_temporal_space_begin;
+  }
 
 
   size_t global_lock_size = (__SOFTBOUNDCETS_N_GLOBAL_LOCK_SIZE) * sizeof(void*);
@@ -214,20 +311,9 @@ void __softboundcets_init( int is_trie)
 
 
 
-  size_t shadow_stack_size = __SOFTBOUNDCETS_SHADOW_STACK_ENTRIES * sizeof(size_t);
-  __softboundcets_shadow_stack_ptr = mmap(0, shadow_stack_size, 
-                                          PROT_READ|PROT_WRITE, 
-                                          SOFTBOUNDCETS_MMAP_FLAGS, -1, 0);
-  assert(__softboundcets_shadow_stack_ptr != (void*)-1);
-
-  *((size_t*)__softboundcets_shadow_stack_ptr) = 0; /* prev stack size */
-  size_t * current_size_shadow_stack_ptr =  __softboundcets_shadow_stack_ptr +1 ;
-  *(current_size_shadow_stack_ptr) = 0;
-
-  if(__SOFTBOUNDCETS_SHADOW_STACK_DEBUG){
-    printf("[mmap_shadow_stack]mmaped shadowstack pointer = %p\n", 
-           __softboundcets_shadow_stack_ptr);
-  }
+  /* The spaces of the main thread; other threads get theirs in the
+   * pthread_create wrapper */
+  __softboundcets_thread_init();
 
   if(__SOFTBOUNDCETS_FREE_MAP) {
     size_t length_free_map = (__SOFTBOUNDCETS_N_FREE_MAP_ENTRIES) * sizeof(size_t);
@@ -244,6 +330,14 @@ void __softboundcets_init( int is_trie)
                                               PROT_READ| PROT_WRITE, 
                                               SOFTBOUNDCETS_MMAP_FLAGS, -1, 0);
     assert(__softboundcets_trie_primary_table != (void *)-1);  
+
+#ifdef __SOFTBOUNDCETS_COMPACT_METADATA
+    size_t length_overflow = (__SOFTBOUNDCETS_TRIE_PRIMARY_TABLE_ENTRIES) * sizeof(__softboundcets_overflow_entry_t*);
+    __softboundcets_trie_overflow_table = mmap(0, length_overflow, 
+                                               PROT_READ| PROT_WRITE, 
+                                               SOFTBOUNDCETS_MMAP_FLAGS, -1, 0);
+    assert(__softboundcets_trie_overflow_table != (void *)-1);  
+#endif
     
     int* temp = malloc(1);
     __softboundcets_allocation_secondary_trie_allocate_range(0, (size_t)temp);
@@ -98,10 +98,17 @@ typedef struct {
 
 #elif __SOFTBOUNDCETS_SPATIAL_TEMPORAL
 
+#ifdef __SOFTBOUNDCETS_COMPACT_METADATA
+  void* base;
+  unsigned int bound_offset;
+  unsigned int lock_index;
+  size_t key;
+#else
   void* base;
   void* bound;
   size_t key;
   void* lock;
+#endif
 #define __SOFTBOUNDCETS_METADATA_NUM_FIELDS 4
 
 #define __BASE_INDEX 0
@@ -127,6 +134,31 @@ typedef struct {
 
 } __softboundcets_trie_entry_t;
 
+/* In the compact metadata mode, a trie entry stores the bound as a
+ * 32-bit offset from the base and the lock as a 32-bit index into the
+ * lock space. Metadata that cannot be encoded this way is kept in an
+ * overflow trie with entries of the following full-width type, and
+ * the bound offset of its compact entry is set to
+ * __SOFTBOUNDCETS_COMPACT_BOUND_OVERFLOW. */
+
+#ifdef __SOFTBOUNDCETS_COMPACT_METADATA
+
+#if defined(__SOFTBOUNDCETS_SPATIAL) || defined(__SOFTBOUNDCETS_TEMPORAL)
+#error "Softboundcets error: compact metadata requires spatial and temporal checking"
+#endif
+
+typedef struct {
+  void* base;
+  void* bound;
+  size_t key;
+  void* lock;
+} __softboundcets_overflow_entry_t;
+
+#define __SOFTBOUNDCETS_COMPACT_BOUND_UNBOUNDED 0xfffffffeU
+#define __SOFTBOUNDCETS_COMPACT_BOUND_OVERFLOW  0xffffffffU
+
+#endif
+
 
 #if defined(__APPLE__)
 #define SOFTBOUNDCETS_MMAP_FLAGS (MAP_ANON|MAP_NORESERVE|MAP_PRIVATE)
@@ -188,6 +220,21 @@ static const int __SOFTBOUNDCETS_PREALLOCATE_TRIE = 1;
 static const int __SOFTBOUNDCETS_PREALLOCATE_TRIE = 0;
 #endif
 
+/* In the multithreaded mode (-D__SOFTBOUNDCETS_MULTITHREADED), each
+ * thread has its own shadow stack, stack key/lock space, and chunks
+ * of keys and heap lock locations; secondary trie tables and free
+ * map entries are installed with compare-and-swap.  Threads must be
+ * created through the pthread_create wrapper.
+ */
+#ifdef __SOFTBOUNDCETS_MULTITHREADED
+#undef __SOFTBOUNDCETS_MULTITHREADED
+static const int __SOFTBOUNDCETS_MULTITHREADED = 1;
+#define __SOFTBOUNDCETS_THREAD_LOCAL __thread
+#else
+static const int __SOFTBOUNDCETS_MULTITHREADED = 0;
+#define __SOFTBOUNDCETS_THREAD_LOCAL
+#endif
+
 #ifdef __SOFTBOUNDCETS_SPATIAL_TEMPORAL 
 #define __SOFTBOUNDCETS_FREE_MAP
 #endif
@@ -219,6 +266,8 @@ static const size_t __SOFTBOUNDCETS_SHADOW_STACK_ENTRIES = ((size_t) 128 * (size
 static const size_t __SOFTBOUNDCETS_N_FREE_MAP_ENTRIES = ((size_t) 32 * (size_t) 1024* (size_t) 1024);
 // each secondary entry has 2^ 22 entries 
 static const size_t __SOFTBOUNDCETS_TRIE_SECONDARY_TABLE_ENTRIES = ((size_t) 4 * (size_t) 1024 * (size_t) 1024); 
+/* Bound given by the pass to pointers whose object is unknown */
+static const size_t __SOFTBOUNDCETS_INFINITE_BOUND = ((size_t) 2147483647);
 
 #else
 
@@ -237,9 +286,16 @@ static const size_t __SOFTBOUNDCETS_SHADOW_STACK_ENTRIES = ((size_t) 128 * (size
 static const size_t __SOFTBOUNDCETS_N_FREE_MAP_ENTRIES = ((size_t) 32 * (size_t) 1024* (size_t) 1024);
 // each secondary entry has 2^ 22 entries 
 static const size_t __SOFTBOUNDCETS_TRIE_SECONDARY_TABLE_ENTRIES = ((size_t) 4 * (size_t) 1024 * (size_t) 1024); 
+/* Bound given by the pass to pointers whose object is unknown */
+static const size_t __SOFTBOUNDCETS_INFINITE_BOUND = ((size_t) 1 << 48);
 
 #endif
 
+/* Number of keys and heap lock locations a thread takes at a time in
+ * the multithreaded mode */
+static const size_t __SOFTBOUNDCETS_KEY_CHUNK_ENTRIES = ((size_t) 1024 * (size_t) 64);
+static const size_t __SOFTBOUNDCETS_LOCK_CHUNK_ENTRIES = ((size_t) 1024 * (size_t) 4);
+
 
 #define __WEAK_INLINE __attribute__((__weak__,__always_inline__)) 
 
@@ -252,15 +308,23 @@ static const size_t __SOFTBOUNDCETS_TRIE_SECONDARY_TABLE_ENTRIES = ((size_t) 4 *
 #define __NO_INLINE __attribute__((__weak__,__noinline__))
 
 extern __softboundcets_trie_entry_t** __softboundcets_trie_primary_table;
+#ifdef __SOFTBOUNDCETS_COMPACT_METADATA
+extern __softboundcets_overflow_entry_t** __softboundcets_trie_overflow_table;
+#endif
 
-extern size_t* __softboundcets_shadow_stack_ptr;
+extern __SOFTBOUNDCETS_THREAD_LOCAL size_t* __softboundcets_shadow_stack_ptr;
 extern size_t* __softboundcets_temporal_space_begin;
 
-extern size_t* __softboundcets_stack_temporal_space_begin;
+extern __SOFTBOUNDCETS_THREAD_LOCAL size_t* __softboundcets_stack_temporal_space_begin;
 extern size_t* __softboundcets_free_map_table;
 
 
 extern void __softboundcets_init(int is_trie);
+extern void __softboundcets_check_metadata_encoding(int is_compact);
+extern void __softboundcets_thread_init(void);
+extern void __softboundcets_thread_fini(void);
+extern void __softboundcets_allocate_key_chunk(void);
+extern void __softboundcets_allocate_lock_chunk(void);
 extern __SOFTBOUNDCETS_NORETURN void __softboundcets_abort();
 extern void __softboundcets_printf(const char* str, ...);
 extern size_t* __softboundcets_global_lock; 
@@ -450,6 +514,115 @@ __WEAK_INLINE __softboundcets_trie_entry_t* __softboundcets_trie_allocate(){
   return secondary_entry;
 }
 
+/* Returns the secondary table in a slot of a primary table or NULL if
+ * it has not been allocated yet */
+__WEAK_INLINE void* __softboundcets_secondary_table_lookup(void** slot){
+
+  if(__SOFTBOUNDCETS_MULTITHREADED){
+    return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+  }
+  return *slot;
+}
+
+/* Returns the secondary table in a slot of a primary table, mapping
+ * one of the given length if needed. In the multithreaded mode, the
+ * table is installed with a compare-and-swap; a thread that loses the
+ * race frees its table and uses the one that was installed. */
+__WEAK_INLINE void* 
+__softboundcets_secondary_table_get_or_allocate(void** slot, size_t length){
+
+  void* secondary_entry = __softboundcets_secondary_table_lookup(slot);
+  if(secondary_entry != NULL)
+    return secondary_entry;
+
+  secondary_entry = __softboundcets_safe_mmap(0, length, PROT_READ| PROT_WRITE, SOFTBOUNDCETS_MMAP_FLAGS, -1, 0);
+  if(!__SOFTBOUNDCETS_MULTITHREADED){
+    *slot = secondary_entry;
+    return secondary_entry;
+  }
+
+  void* installed = NULL;
+  if(__atomic_compare_exchange_n(slot, &installed, secondary_entry, 0,
+                                 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+    return secondary_entry;
+  }
+
+  munmap(secondary_entry, length);
+  return installed;
+}
+
+/* Returns the secondary trie table of the primary index or NULL if it
+ * has not been allocated yet */
+__WEAK_INLINE __softboundcets_trie_entry_t* 
+__softboundcets_trie_lookup(size_t primary_index){
+
+  return __softboundcets_secondary_table_lookup((void**) &__softboundcets_trie_primary_table[primary_index]);
+}
+
+/* Returns the secondary trie table of the primary index, allocating
+ * it if needed */
+__WEAK_INLINE __softboundcets_trie_entry_t* 
+__softboundcets_trie_get_or_allocate(size_t primary_index){
+
+  size_t length = (__SOFTBOUNDCETS_TRIE_SECONDARY_TABLE_ENTRIES) * sizeof(__softboundcets_trie_entry_t);
+  return __softboundcets_secondary_table_get_or_allocate((void**) &__softboundcets_trie_primary_table[primary_index], length);
+}
+
+#ifdef __SOFTBOUNDCETS_COMPACT_METADATA
+
+/* Returns the overflow entry of a pointer stored at the address,
+ * allocating its secondary table if needed */
+__WEAK_INLINE __softboundcets_overflow_entry_t* 
+__softboundcets_overflow_entry(size_t addr_of_ptr){
+
+  size_t length = (__SOFTBOUNDCETS_TRIE_SECONDARY_TABLE_ENTRIES) * sizeof(__softboundcets_overflow_entry_t);
+  __softboundcets_overflow_entry_t* overflow_secondary_table = 
+    __softboundcets_secondary_table_get_or_allocate((void**) &__softboundcets_trie_overflow_table[addr_of_ptr >> 25], length);
+  return &overflow_secondary_table[(addr_of_ptr >> 3) & 0x3fffff];
+}
+
+/* Returns the index of the lock in the lock space, which is counted in
+ * lock locations from the beginning of the heap lock space, plus one
+ * so that zero stands for a NULL lock. Returns zero with *fits cleared
+ * if the lock has no 32-bit index. */
+__WEAK_INLINE unsigned int __softboundcets_compact_lock_index(void* lock, int* fits){
+
+  *fits = 1;
+  if(lock == NULL)
+    return 0;
+
+  ptrdiff_t offset = (char*) lock - (char*) __softboundcets_temporal_space_begin;
+  ptrdiff_t index = offset / (ptrdiff_t) sizeof(size_t) + 1;
+  if((offset % (ptrdiff_t) sizeof(size_t)) != 0 || index == 0 ||
+     index < INT_MIN || index > INT_MAX){
+    *fits = 0;
+    return 0;
+  }
+  return (unsigned int) (int) index;
+}
+
+__WEAK_INLINE void* __softboundcets_compact_lock(unsigned int lock_index){
+
+  if(lock_index == 0)
+    return NULL;
+  return __softboundcets_temporal_space_begin + ((int) lock_index - 1);
+}
+
+/* Copies the overflow metadata of the pointer at from_ptr to dest_ptr
+ * if the compact entry copied to dest_ptr refers to it */
+__WEAK_INLINE void 
+__softboundcets_copy_overflow_metadata(__softboundcets_trie_entry_t* dest_entry, 
+                                       size_t dest_ptr, size_t from_ptr){
+
+  if(dest_entry->bound_offset != __SOFTBOUNDCETS_COMPACT_BOUND_OVERFLOW)
+    return;
+
+  *__softboundcets_overflow_entry(dest_ptr) = 
+    *__softboundcets_overflow_entry(from_ptr);
+}
+
+#endif
+
 __WEAK_INLINE void __softboundcets_introspect_metadata(void* ptr, void* base, void* bound, int arg_no){
   
   printf("[introspect_metadata]ptr=%p, base=%p, bound=%p, arg_no=%d\n", ptr, base, bound, arg_no);
@@ -506,18 +679,10 @@ __METADATA_INLINE void __softboundcets_copy_metadata(void* dest, void* from, siz
       size_t dest_secondary_index = (((dest_sizet + index) >> 3) & 0x3fffff);
       size_t from_secondary_index = (((from_sizet + index) >> 3) & 0x3fffff);
       
-      __softboundcets_trie_entry_t* temp_from_strie = __softboundcets_trie_primary_table[temp_from_pindex];
-
-      if(temp_from_strie == NULL){
-        temp_from_strie = __softboundcets_trie_allocate();
-        __softboundcets_trie_primary_table[temp_from_pindex] = temp_from_strie;
-      }
-     __softboundcets_trie_entry_t* temp_to_strie = __softboundcets_trie_primary_table[temp_to_pindex];
-
-      if(temp_to_strie == NULL){
-        temp_to_strie = __softboundcets_trie_allocate();
-        __softboundcets_trie_primary_table[temp_to_pindex] = temp_to_strie;
-      }
+      __softboundcets_trie_entry_t* temp_from_strie = 
+        __softboundcets_trie_get_or_allocate(temp_from_pindex);
+      __softboundcets_trie_entry_t* temp_to_strie = 
+        __softboundcets_trie_get_or_allocate(temp_to_pindex);
 
       void* dest_entry_ptr = &temp_to_strie[dest_secondary_index];
       void* from_entry_ptr = &temp_from_strie[from_secondary_index];
@@ -527,7 +692,11 @@ __METADATA_INLINE void __softboundcets_copy_metadata(void* dest, void* from, siz
 #elif __SOFTBOUNDCETS_TEMPORAL
       memcpy(dest_entry_ptr, from_entry_ptr, 16);
 #elif __SOFTBOUNDCETS_SPATIAL_TEMPORAL
-      memcpy(dest_entry_ptr, from_entry_ptr, 32);
+      memcpy(dest_entry_ptr, from_entry_ptr, sizeof(__softboundcets_trie_entry_t));
+#ifdef __SOFTBOUNDCETS_COMPACT_METADATA
+      __softboundcets_copy_overflow_metadata(dest_entry_ptr, dest_sizet + index, 
+                                             from_sizet + index);
+#endif
 #else
       memcpy(dest_entry_ptr, from_entry_ptr, 32);
 #endif
@@ -536,17 +705,12 @@ __METADATA_INLINE void __softboundcets_copy_metadata(void* dest, void* from, siz
 
   }
     
-  trie_secondary_table_dest_begin = __softboundcets_trie_primary_table[dest_primary_index_begin];
-  trie_secondary_table_from_begin = __softboundcets_trie_primary_table[from_primary_index_begin];
+  trie_secondary_table_from_begin = __softboundcets_trie_lookup(from_primary_index_begin);
   
   if(trie_secondary_table_from_begin == NULL)
     return;
 
-  if(trie_secondary_table_dest_begin == NULL){
-    trie_secondary_table_dest_begin = __softboundcets_trie_allocate();
-    __softboundcets_trie_primary_table[dest_primary_index_begin] = trie_secondary_table_dest_begin;
-    //    printf("[copy_metadata] allocating secondary trie for dest_primary_index=%zx, orig_dest=%p, orig_from=%p\n", dest_primary_index_begin, dest, from);
-  }
+  trie_secondary_table_dest_begin = __softboundcets_trie_get_or_allocate(dest_primary_index_begin);
 
   size_t dest_secondary_index = ((dest_ptr>> 3) & 0x3fffff);
   size_t from_secondary_index = ((from_ptr>> 3) & 0x3fffff);
@@ -567,7 +731,14 @@ __METADATA_INLINE void __softboundcets_copy_metadata(void* dest, void* from, siz
   memcpy(dest_entry_ptr, from_entry_ptr, 16* (size>>3));
 #elif __SOFTBOUNDCETS_SPATIAL_TEMPORAL
   //  printf("doing 32 byte metadata\n");
-  memcpy(dest_entry_ptr, from_entry_ptr, 32* (size >> 3));
+  memcpy(dest_entry_ptr, from_entry_ptr, sizeof(__softboundcets_trie_entry_t)* (size >> 3));
+#ifdef __SOFTBOUNDCETS_COMPACT_METADATA
+  size_t index;
+  for(index = 0; index < (size >> 3); index++){
+    __softboundcets_copy_overflow_metadata(&trie_secondary_table_dest_begin[dest_secondary_index + index],
+                                           dest_ptr + 8 * index, from_ptr + 8 * index);
+  }
+#endif
 #else
   //  printf("doing 32 byte metadata\n");
   memcpy(dest_entry_ptr, from_entry_ptr, 32* (size>> 3));
@@ -729,13 +900,12 @@ __METADATA_INLINE void __softboundcets_metadata_store(void* addr_of_ptr, void* b
   
   
   primary_index = (ptr >> 25);
-  trie_secondary_table = __softboundcets_trie_primary_table[primary_index];
+  trie_secondary_table = __softboundcets_trie_lookup(primary_index);
  
  
   if(!__SOFTBOUNDCETS_PREALLOCATE_TRIE) {
     if(trie_secondary_table == NULL){
-      trie_secondary_table =  __softboundcets_trie_allocate();
-      __softboundcets_trie_primary_table[primary_index] = trie_secondary_table;
+      trie_secondary_table = __softboundcets_trie_get_or_allocate(primary_index);
     }    
     //    __softboundcetswithss_printf("addr_of_ptr=%zx, primary_index =%zx, trie_secondary_table=%p\n", addr_of_ptr, primary_index, trie_secondary_table);
     assert(trie_secondary_table != NULL);
@@ -762,12 +932,40 @@ __METADATA_INLINE void __softboundcets_metadata_store(void* addr_of_ptr, void* b
 
 
 #elif __SOFTBOUNDCETS_SPATIAL_TEMPORAL
+
+#ifdef __SOFTBOUNDCETS_COMPACT_METADATA
+
+  size_t bound_offset = (size_t) bound - (size_t) base;
+  int lock_fits;
+  unsigned int lock_index = __softboundcets_compact_lock_index(lock, &lock_fits);
+
+  if(base == NULL && (size_t) bound == __SOFTBOUNDCETS_INFINITE_BOUND){
+    bound_offset = __SOFTBOUNDCETS_COMPACT_BOUND_UNBOUNDED;
+  }
+  else if(bound < base || bound_offset >= __SOFTBOUNDCETS_COMPACT_BOUND_UNBOUNDED || 
+          !lock_fits){
+    __softboundcets_overflow_entry_t* overflow_ptr = __softboundcets_overflow_entry(ptr);
+    overflow_ptr->base = base;
+    overflow_ptr->bound = bound;
+    overflow_ptr->key = key;
+    overflow_ptr->lock = lock;
+    bound_offset = __SOFTBOUNDCETS_COMPACT_BOUND_OVERFLOW;
+  }
+
+  entry_ptr->base = base;
+  entry_ptr->bound_offset = (unsigned int) bound_offset;
+  entry_ptr->lock_index = lock_index;
+  entry_ptr->key = key;
+
+#else
   
   entry_ptr->base = base;
   entry_ptr->bound = bound;
   entry_ptr->key = key;
   entry_ptr->lock = lock;
 
+#endif
+
 #else
 
   entry_ptr->base = base;
@@ -816,7 +1014,7 @@ __METADATA_INLINE void __softboundcets_metadata_load(void* addr_of_ptr, void** b
     //assert(__softboundcetswithss_trie_primary_table[primary_index] == trie_secondary_table);
 
     size_t primary_index = ( ptr >> 25);
-    trie_secondary_table = __softboundcets_trie_primary_table[primary_index];
+    trie_secondary_table = __softboundcets_trie_lookup(primary_index);
 
 
     if(!__SOFTBOUNDCETS_PREALLOCATE_TRIE) {      
@@ -860,10 +1058,34 @@ __METADATA_INLINE void __softboundcets_metadata_load(void* addr_of_ptr, void** b
 
 #elif __SOFTBOUNDCETS_SPATIAL_TEMPORAL
 
+#ifdef __SOFTBOUNDCETS_COMPACT_METADATA
+      unsigned int bound_offset = entry_ptr->bound_offset;
+
+      if(bound_offset < __SOFTBOUNDCETS_COMPACT_BOUND_UNBOUNDED){
+        *((void**) base) = entry_ptr->base;
+        *((void**) bound) = (char*) entry_ptr->base + bound_offset;
+        *((size_t*) key) = entry_ptr->key;
+        *((void**) lock) = __softboundcets_compact_lock(entry_ptr->lock_index);
+      }
+      else if(bound_offset == __SOFTBOUNDCETS_COMPACT_BOUND_UNBOUNDED){
+        *((void**) base) = NULL;
+        *((void**) bound) = (void*) __SOFTBOUNDCETS_INFINITE_BOUND;
+        *((size_t*) key) = entry_ptr->key;
+        *((void**) lock) = __softboundcets_compact_lock(entry_ptr->lock_index);
+      }
+      else {
+        __softboundcets_overflow_entry_t* overflow_ptr = __softboundcets_overflow_entry(ptr);
+        *((void**) base) = overflow_ptr->base;
+        *((void**) bound) = overflow_ptr->bound;
+        *((size_t*) key) = overflow_ptr->key;
+        *((void**) lock) = overflow_ptr->lock;
+      }
+#else
       *((void**) base) = entry_ptr->base;
       *((void**) bound) = entry_ptr->bound;
       *((size_t*) key) = entry_ptr->key;
       *((void**) lock) = (void*) entry_ptr->lock;
+#endif
       
 #else
 
@@ -882,9 +1104,11 @@ __METADATA_INLINE void __softboundcets_metadata_load(void* addr_of_ptr, void** b
 }
 /******************************************************************************/
 
-extern size_t __softboundcets_key_id_counter;
-extern size_t* __softboundcets_lock_next_location;
-extern size_t* __softboundcets_lock_new_location;
+extern __SOFTBOUNDCETS_THREAD_LOCAL size_t __softboundcets_key_id_counter;
+extern __SOFTBOUNDCETS_THREAD_LOCAL size_t __softboundcets_key_id_limit;
+extern __SOFTBOUNDCETS_THREAD_LOCAL size_t* __softboundcets_lock_next_location;
+extern __SOFTBOUNDCETS_THREAD_LOCAL size_t* __softboundcets_lock_new_location;
+extern __SOFTBOUNDCETS_THREAD_LOCAL size_t* __softboundcets_lock_new_limit;
 
 #ifdef __SOFTBOUNDCETS_SPATIAL_TEMPORAL
 __WEAK_INLINE void 
@@ -1000,6 +1224,11 @@ __WEAK_INLINE void*  __softboundcets_allocate_lock_location() {
   
   void* temp= NULL;
   if(__softboundcets_lock_next_location == NULL) {
+    if(__SOFTBOUNDCETS_MULTITHREADED &&
+       __softboundcets_lock_new_location == __softboundcets_lock_new_limit) {
+      __softboundcets_allocate_lock_chunk();
+    }
+
     if(__SOFTBOUNDCETS_DEBUG) {
       __softboundcets_printf("[lock_allocate] new_lock_location=%p\n", 
                              __softboundcets_lock_new_location);
@@ -1025,6 +1254,17 @@ __WEAK_INLINE void*  __softboundcets_allocate_lock_location() {
   }
 }
 
+/* Returns a key that has not been used before. In the multithreaded
+ * mode, each thread hands out keys from its own chunk of keys. */
+__WEAK_INLINE size_t __softboundcets_allocate_key() {
+
+  if(__SOFTBOUNDCETS_MULTITHREADED &&
+     __softboundcets_key_id_counter >= __softboundcets_key_id_limit) {
+    __softboundcets_allocate_key_chunk();
+  }
+  return __softboundcets_key_id_counter++;
+}
+
 __WEAK_INLINE void 
 __softboundcets_allocation_secondary_trie_allocate_range(void* initial_ptr, 
                                                          size_t size) {
@@ -1043,13 +1283,7 @@ __softboundcets_allocation_secondary_trie_allocate_range(void* initial_ptr,
   size_t end_primary_index = end_addr_of_ptr >> 25;
   
   for(; start_primary_index <= end_primary_index; start_primary_index++){
-    
-    __softboundcets_trie_entry_t* 
-      trie_secondary_table = __softboundcets_trie_primary_table[start_primary_index];    
-    if(trie_secondary_table == NULL) {
-      trie_secondary_table =  __softboundcets_trie_allocate();
-      __softboundcets_trie_primary_table[start_primary_index] = trie_secondary_table;
-    }
+    __softboundcets_trie_get_or_allocate(start_primary_index);
   }
 }
 
@@ -1066,23 +1300,11 @@ __softboundcets_allocation_secondary_trie_allocate(void* addr_of_ptr) {
   size_t primary_index = ( ptr >> 25);
   //  size_t secondary_index = ((ptr >> 3) & 0x3fffff);
   
-  __softboundcets_trie_entry_t* 
-    trie_secondary_table = __softboundcets_trie_primary_table[primary_index];
+  __softboundcets_trie_get_or_allocate(primary_index);
+  __softboundcets_trie_get_or_allocate(primary_index + 1);
 
-  if(trie_secondary_table == NULL) {
-    trie_secondary_table =  __softboundcets_trie_allocate();
-    __softboundcets_trie_primary_table[primary_index] = trie_secondary_table;
-  }
-
-  __softboundcets_trie_entry_t* 
-    trie_secondary_table_second_entry = __softboundcets_trie_primary_table[primary_index +1];
-
-  if(trie_secondary_table_second_entry == NULL) {
-    __softboundcets_trie_primary_table[primary_index+1] = __softboundcets_trie_allocate();
-  }
-
-  if(primary_index != 0 && (__softboundcets_trie_primary_table[primary_index -1] == NULL)){
-    __softboundcets_trie_primary_table[primary_index-1] = __softboundcets_trie_allocate();    
+  if(primary_index != 0){
+    __softboundcets_trie_get_or_allocate(primary_index - 1);
   }
 
   return;
@@ -1100,7 +1322,7 @@ __softboundcets_stack_memory_allocation(void** ptr_lock, size_t* ptr_key) {
   *((size_t*) ptr_key) = 1;
   *((size_t**) ptr_lock) = __softboundcets_global_lock;
 #else
-  size_t temp_id = __softboundcets_key_id_counter++;
+  size_t temp_id = __softboundcets_allocate_key();
   *((size_t**) ptr_lock) = (size_t*)__softboundcets_stack_temporal_space_begin++;
   *((size_t*)ptr_key) = temp_id;
   **((size_t**)ptr_lock) = temp_id;  
@@ -1115,7 +1337,7 @@ __softboundcets_memory_allocation(void* ptr, void** ptr_lock, size_t* ptr_key){
   __softboundcets_statistics_heap_allocations++;
 #endif
 
-  size_t temp_id = __softboundcets_key_id_counter++;
+  size_t temp_id = __softboundcets_allocate_key();
 
   *((size_t**) ptr_lock) = (size_t*)__softboundcets_allocate_lock_location();  
   *((size_t*) ptr_key) = temp_id;
@@ -1151,8 +1373,15 @@ __WEAK_INLINE void __softboundcets_add_to_free_map(size_t ptr_key, void* ptr) {
 
     if(tag == 0 || tag == 2) {
       //      printf("entry_ptr=%zx, ptr=%zx, key=%zx\n", entry_ptr, ptr, ptr_key);
-      *entry_ptr = (size_t)(ptr);
-      return;
+      if(!__SOFTBOUNDCETS_MULTITHREADED) {
+        *entry_ptr = (size_t)(ptr);
+        return;
+      }
+      /* Another thread may claim the entry first; then look at it again */
+      if(__sync_bool_compare_and_swap(entry_ptr, tag, (size_t)(ptr))) {
+        return;
+      }
+      continue;
     }
     if(counter >= (__SOFTBOUNDCETS_N_FREE_MAP_ENTRIES)) {
       __softboundcets_abort();
@@ -147,6 +147,7 @@ extern "C" {
   void * __sc_bb_poolmemalign(PPOOL, unsigned Alignment, unsigned NumBytes);
 
   void __sc_bb_funccheck (void *f, void * targets[], TAG, SRC_INFO);
+  void __sc_bb_funccheck_set (void *f, struct TargetSet * Set, TAG, SRC_INFO);
 
   void bb_poolcheck(PPOOL, void *Node);
   void bb_poolcheckui(PPOOL, void *Node);
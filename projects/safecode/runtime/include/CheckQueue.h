@@ -0,0 +1,316 @@
+//===- CheckQueue.h - Queues of deferred run-time checks --------*- C++ -*-===//
+//
+//                       The SAFECode Compiler Project
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the queue through which an application thread passes
+// run-time checks to the thread that performs them when SAFECode checks
+// asynchronously.  Each queue has exactly one producer (the application
+// thread) and one consumer (its checking thread), so it is a ring buffer that
+// needs no locks, and no atomic read-modify-write operations unless one side
+// has to wake the other.
+//
+// The queue counts the requests ever enqueued (Head) and ever performed
+// (Tail).  The producer waits for the checks done so far by waiting for Tail
+// to reach the value that Head had; the counters never wrap in practice.
+//
+// A side that finds nothing to do spins for a short while and then sleeps on
+// a futex until the other side wakes it.  The consumer announces that it is
+// going to sleep with a flag that the producer reads after every enqueue;
+// the producer does not fence there, so a request enqueued while the consumer
+// goes to sleep may wait for the sleep to time out.  Waiting for the checks
+// and stopping the consumer fence, so they always wake it.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _CHECKQUEUE_H_
+#define _CHECKQUEUE_H_
+
+#include <stdint.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#include <time.h>
+#endif
+
+// The function that performs a request on the checking thread
+typedef void (*CheckStub) (uintptr_t * Args);
+
+//
+// Structure: CheckRequest
+//
+// Description:
+//  A deferred run-time check and its arguments.
+//
+struct CheckRequest {
+  CheckStub Stub;
+  uintptr_t Args[3];
+};
+
+// The number of spins after which a waiting thread goes to sleep
+static const unsigned CheckQueueSpins = 256;
+
+// The longest that a thread sleeps before it looks at the queue again
+static const long CheckQueueSleepNS = 1000000;
+
+// The number of requests that the consumer performs between publications of
+// its progress; a power of two
+static const uint64_t CheckQueuePublish = 32;
+
+//
+// Function: checkQueuePause()
+//
+// Description:
+//  Spin once while waiting for the other side of a queue, which is normally
+//  running on another core.
+//
+static inline void
+checkQueuePause (void) {
+#if defined(__i386__) || defined(__x86_64__)
+  __builtin_ia32_pause ();
+#endif
+}
+
+//
+// Function: checkQueueSleep()
+//
+// Description:
+//  Sleep until another thread wakes the sleeper flag, unless the flag no
+//  longer holds Value, or until CheckQueueSleepNS have passed.
+//
+static inline void
+checkQueueSleep (unsigned * Flag, unsigned Value) {
+  struct timespec Timeout = {0, CheckQueueSleepNS};
+#if defined(__linux__)
+  syscall (SYS_futex, Flag, FUTEX_WAIT_PRIVATE, Value, &Timeout, 0, 0);
+#else
+  if (__atomic_load_n (Flag, __ATOMIC_ACQUIRE) == Value)
+    nanosleep (&Timeout, 0);
+#endif
+}
+
+//
+// Function: checkQueueWake()
+//
+// Description:
+//  Wake the thread sleeping on a sleeper flag.  Without futexes, the sleeper
+//  notices the cleared flag when its sleep times out.
+//
+static inline void
+checkQueueWake (unsigned * Flag) {
+#if defined(__linux__)
+  syscall (SYS_futex, Flag, FUTEX_WAKE_PRIVATE, 1, 0, 0, 0);
+#endif
+}
+
+//
+// Class: CheckQueue
+//
+// Description:
+//  A single-producer, single-consumer ring of check requests.  The counters
+//  that each side writes are on cache lines of their own, and each side keeps
+//  a private copy of the other side's counter that it refreshes only when the
+//  ring looks full or empty.
+//
+class CheckQueue {
+ public:
+  // The number of requests in the ring; a power of two
+  static const uint64_t Size = 1 << 14;
+
+ private:
+  // Written by the producer
+  uint64_t Head __attribute__ ((aligned (64)));
+  uint64_t CachedTail;
+
+  // Written by the consumer
+  uint64_t Tail __attribute__ ((aligned (64)));
+  uint64_t CachedHead;
+
+  // Set by the producer to make the consumer return once the ring is empty
+  unsigned Stop __attribute__ ((aligned (64)));
+
+  // Set by each side before it sleeps and cleared by the side that wakes it
+  unsigned ConsumerSleeping;
+  unsigned ProducerSleeping;
+
+  CheckRequest Ring[Size] __attribute__ ((aligned (64)));
+
+ public:
+  CheckQueue () : Head (0), CachedTail (0), Tail (0), CachedHead (0),
+                  Stop (0), ConsumerSleeping (0), ProducerSleeping (0) {}
+
+ private:
+  //
+  // Method: wakeConsumer()
+  //
+  // Description:
+  //  Wake the consumer if it is sleeping.  With Sync, fence first so that a
+  //  consumer that goes to sleep concurrently sees the requests published
+  //  so far or is woken.
+  //
+  void wakeConsumer (bool Sync) {
+    if (Sync)
+      __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    if (__atomic_load_n (&ConsumerSleeping, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n (&ConsumerSleeping, 0, __ATOMIC_SEQ_CST))
+      checkQueueWake (&ConsumerSleeping);
+  }
+
+  //
+  // Method: waitForTail()
+  //
+  // Description:
+  //  Wait until the consumer has performed the requests before Target.  Only
+  //  the producer may call this method.
+  //
+  void waitForTail (uint64_t Target) {
+    wakeConsumer (true);
+
+    unsigned Spins = 0;
+    while ((CachedTail = __atomic_load_n (&Tail, __ATOMIC_ACQUIRE)) < Target) {
+      if (++Spins < CheckQueueSpins) {
+        checkQueuePause ();
+        continue;
+      }
+
+      __atomic_store_n (&ProducerSleeping, 1, __ATOMIC_SEQ_CST);
+      if (__atomic_load_n (&Tail, __ATOMIC_SEQ_CST) < Target)
+        checkQueueSleep (&ProducerSleeping, 1);
+      __atomic_store_n (&ProducerSleeping, 0, __ATOMIC_RELAXED);
+      Spins = 0;
+    }
+  }
+
+  //
+  // Method: publishTail()
+  //
+  // Description:
+  //  Publish the progress of the consumer and wake the producer if it is
+  //  waiting for it.  Only the consumer may call this method.
+  //
+  void publishTail (uint64_t Index) {
+    __atomic_store_n (&Tail, Index, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n (&ProducerSleeping, __ATOMIC_SEQ_CST) &&
+        __atomic_exchange_n (&ProducerSleeping, 0, __ATOMIC_SEQ_CST))
+      checkQueueWake (&ProducerSleeping);
+  }
+
+ public:
+
+  //
+  // Method: enqueue()
+  //
+  // Description:
+  //  Add a request to the ring, waiting for the consumer if it is full.  Only
+  //  the producer may call this method.
+  //
+  void enqueue (CheckStub Stub,
+                uintptr_t Arg0 = 0,
+                uintptr_t Arg1 = 0,
+                uintptr_t Arg2 = 0) {
+    uint64_t Index = Head;
+    if (Index - CachedTail == Size)
+      waitForTail (Index - Size + 1);
+
+    CheckRequest & Request = Ring[Index & (Size - 1)];
+    Request.Stub = Stub;
+    Request.Args[0] = Arg0;
+    Request.Args[1] = Arg1;
+    Request.Args[2] = Arg2;
+    __atomic_store_n (&Head, Index + 1, __ATOMIC_RELEASE);
+    wakeConsumer (false);
+  }
+
+  //
+  // Method: wait()
+  //
+  // Description:
+  //  Wait until the consumer has performed every request enqueued so far.
+  //  Only the producer may call this method.
+  //
+  void wait () {
+    uint64_t Target = Head;
+    if (CachedTail == Target)
+      return;
+    waitForTail (Target);
+  }
+
+  //
+  // Method: stop()
+  //
+  // Description:
+  //  Tell the consumer to return from run() once the ring is empty.  Only the
+  //  producer may call this method.
+  //
+  void stop () {
+    __atomic_store_n (&Stop, 1, __ATOMIC_RELEASE);
+    wakeConsumer (true);
+  }
+
+  //
+  // Method: run()
+  //
+  // Description:
+  //  Perform requests as they arrive until stop() is called.  The consumer
+  //  publishes its progress every CheckQueuePublish requests, so that it
+  //  touches the producer's cache line rarely but a producer waiting for a
+  //  few requests does not wait for the whole batch.
+  //
+  void run () {
+    uint64_t Index = Tail;
+    unsigned Spins = 0;
+    while (1) {
+      if (Index == CachedHead) {
+        CachedHead = __atomic_load_n (&Head, __ATOMIC_ACQUIRE);
+        if (Index == CachedHead) {
+          if (__atomic_load_n (&Stop, __ATOMIC_ACQUIRE) &&
+              (Index == __atomic_load_n (&Head, __ATOMIC_ACQUIRE)))
+            return;
+
+          if (++Spins < CheckQueueSpins) {
+            checkQueuePause ();
+            continue;
+          }
+
+          __atomic_store_n (&ConsumerSleeping, 1, __ATOMIC_SEQ_CST);
+          if ((Index == __atomic_load_n (&Head, __ATOMIC_SEQ_CST)) &&
+              !__atomic_load_n (&Stop, __ATOMIC_SEQ_CST))
+            checkQueueSleep (&ConsumerSleeping, 1);
+          __atomic_store_n (&ConsumerSleeping, 0, __ATOMIC_RELAXED);
+          Spins = 0;
+          continue;
+        }
+      }
+
+      Spins = 0;
+      while (Index != CachedHead) {
+        CheckRequest & Request = Ring[Index & (Size - 1)];
+        Request.Stub (Request.Args);
+        if ((++Index & (CheckQueuePublish - 1)) == 0)
+          publishTail (Index);
+      }
+      if (Index & (CheckQueuePublish - 1))
+        publishTail (Index);
+    }
+  }
+
+  //
+  // Method: contains()
+  //
+  // Description:
+  //  Determine whether an address is within the queue itself.
+  //
+  bool contains (const void * p) const {
+    return (this <= p) && (p < (const void *) (this + 1));
+  }
+};
+
+#endif
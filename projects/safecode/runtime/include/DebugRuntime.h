@@ -15,9 +15,12 @@
 #define _SAFECODE_RUNTIME_H_
 
 #include "BitmapAllocator.h"
+#include "PageTable.h"
 #include "SplayTree.h"
 
 #include <iosfwd>
+#include <pthread.h>
+#include <sched.h>
 #include <stdint.h>
 
 namespace llvm {
@@ -78,23 +81,242 @@ typedef struct DebugMetaData {
 } DebugMetaData;
 typedef DebugMetaData * PDebugMetaData;
 
+//
+// Class: RangeObjectSet
+//
+// Description:
+//  The set of registered memory objects of a pool.  The objects are indexed
+//  either by a splay tree (the default) or by a page-indexed table; the choice
+//  is made when the set is constructed and is fixed for its lifetime.  The
+//  page-indexed table does not modify itself on lookups, so it is better
+//  suited for programs with many live objects.
+//
+//  A thread-safe set serializes modifications with a per-set lock.  Lookups
+//  in a page-indexed table do not take the lock; they are validated with the
+//  sequence counter of the page looked up, which is odd while a modification
+//  of the page is in progress, and are retried if a modification of the page
+//  overlapped them.  The pages share a small number of counters, so lookups
+//  only wait for writers that modify a page with the same counter, not for
+//  every registration in the pool.  Lookups in a splay tree modify the tree
+//  and therefore must take the lock.
+//
+class RangeObjectSet {
+  // The number of sequence counters of the pages; a power of two no larger
+  // than the number of bits in Dirty
+  static const unsigned NumStripes = 64;
+
+  RangeSplaySet<> Splay;
+  RangePageSet Pages;
+  bool UsePageTable;
+  bool ThreadSafe;
+
+  // Lock serializing modifications of a thread-safe set
+  pthread_mutex_t Lock;
+
+  // The thread holding the lock and the number of times it has acquired it
+  pthread_t Owner;
+  unsigned LockDepth;
+
+  // The counters whose pages the lock holder has modified; they stay odd
+  // until the outermost lock is released
+  uint64_t Dirty;
+
+  // Sequence counters validating lock-free lookups, indexed by page number
+  unsigned Sequence[NumStripes];
+
+  // Determine whether the calling thread is modifying the set
+  bool isOwner () const {
+    return LockDepth && pthread_equal (Owner, pthread_self ());
+  }
+
+  static unsigned stripeOf (void * p) {
+    return (((uintptr_t) p) >> 12) & (NumStripes - 1);
+  }
+
+  //
+  // Method: markPages()
+  //
+  // Description:
+  //  Make the counters of the pages from start to end odd before the lock
+  //  holder modifies the pages.
+  //
+  void markPages (void * start, void * end) {
+    if (!ThreadSafe) return;
+    uintptr_t first = ((uintptr_t) start) >> 12;
+    uintptr_t last = ((uintptr_t) end) >> 12;
+    if (last - first >= NumStripes)
+      last = first + NumStripes - 1;
+
+    bool marked = false;
+    for (uintptr_t pn = first; pn <= last; ++pn) {
+      unsigned stripe = pn & (NumStripes - 1);
+      if (Dirty & (((uint64_t) 1) << stripe))
+        continue;
+      Dirty |= ((uint64_t) 1) << stripe;
+      __atomic_store_n (&Sequence[stripe], Sequence[stripe] + 1,
+                        __ATOMIC_RELAXED);
+      marked = true;
+    }
+    if (marked)
+      __atomic_thread_fence (__ATOMIC_RELEASE);
+  }
+
+ public:
+  explicit RangeObjectSet (bool usePageTable = false, bool threadSafe = false)
+    : Pages (threadSafe),
+      UsePageTable (usePageTable),
+      ThreadSafe (threadSafe),
+      LockDepth (0),
+      Dirty (0) {
+    for (unsigned stripe = 0; stripe < NumStripes; ++stripe)
+      Sequence[stripe] = 0;
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init (&attr);
+    pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init (&Lock, &attr);
+    pthread_mutexattr_destroy (&attr);
+  }
+
+  //
+  // Methods: lock(), unlock()
+  //
+  // Description:
+  //  Acquire and release the lock of a thread-safe set.  The lock may be held
+  //  across several operations to make them appear atomic to other threads;
+  //  the counters of the modified pages stay odd until the outermost lock is
+  //  released.
+  //
+  void lock () {
+    if (!ThreadSafe) return;
+    pthread_mutex_lock (&Lock);
+    if (LockDepth++ == 0)
+      Owner = pthread_self ();
+  }
+
+  void unlock () {
+    if (!ThreadSafe) return;
+    if (--LockDepth == 0) {
+      while (Dirty) {
+        unsigned stripe = __builtin_ctzll (Dirty);
+        Dirty &= Dirty - 1;
+        __atomic_store_n (&Sequence[stripe], Sequence[stripe] + 1,
+                          __ATOMIC_RELEASE);
+      }
+    }
+    pthread_mutex_unlock (&Lock);
+  }
+
+  bool insert (void * start, void * end) {
+    lock ();
+    bool inserted;
+    if (UsePageTable) {
+      markPages (start, end);
+      inserted = Pages.insert (start, end);
+    } else {
+      inserted = Splay.insert (start, end);
+    }
+    unlock ();
+    return inserted;
+  }
+
+  bool remove (void * key) {
+    lock ();
+    bool removed;
+    if (UsePageTable) {
+      void * start;
+      void * end;
+      removed = Pages.find (key, start, end);
+      if (removed) {
+        markPages (start, end);
+        Pages.remove (key);
+      }
+    } else {
+      removed = Splay.remove (key);
+    }
+    unlock ();
+    return removed;
+  }
+
+  unsigned count () {
+    lock ();
+    unsigned total = (UsePageTable) ? Pages.count () : Splay.count ();
+    unlock ();
+    return total;
+  }
+
+  void clear () {
+    lock ();
+    markPages (0, (void *) (((uintptr_t) NumStripes << 12) - 1));
+    Splay.clear ();
+    Pages.clear ();
+    unlock ();
+  }
+
+  bool find (void * key, void *& start, void *& end) {
+    if (!ThreadSafe)
+      return (UsePageTable) ? Pages.find (key, start, end)
+                            : Splay.find (key, start, end);
+
+    if ((!UsePageTable) || isOwner ()) {
+      lock ();
+      bool found = (UsePageTable) ? Pages.find (key, start, end)
+                                  : Splay.find (key, start, end);
+      unlock ();
+      return found;
+    }
+
+    //
+    // Wait only while the page of the key is being modified; writers hold
+    // its counter odd for a short time, so spin before yielding.
+    //
+    unsigned * Counter = &(Sequence[stripeOf (key)]);
+    unsigned spins = 0;
+    while (1) {
+      unsigned before = __atomic_load_n (Counter, __ATOMIC_ACQUIRE);
+      if (before & 1) {
+        if (++spins & 63) {
+#if defined(__i386__) || defined(__x86_64__)
+          __builtin_ia32_pause ();
+#endif
+        } else {
+          sched_yield ();
+        }
+        continue;
+      }
+
+      void * s = 0;
+      void * e = 0;
+      bool found = Pages.find (key, s, e);
+      __atomic_thread_fence (__ATOMIC_ACQUIRE);
+      if (__atomic_load_n (Counter, __ATOMIC_RELAXED) == before) {
+        if (found) {
+          start = s;
+          end = e;
+        }
+        return found;
+      }
+    }
+  }
+
+  bool find (void * key) {
+    void * start;
+    void * end;
+    return find (key, start, end);
+  }
+};
+
 struct DebugPoolTy : public BitmapPoolTy {
-  // Splay tree used for object registration
-  RangeSplaySet<> Objects;
+  // Set of objects registered with the pool
+  RangeObjectSet Objects;
 
-  // Splay tree used for out of bound objects
-  RangeSplayMap<void *> OOB;
+  // Lock serializing the underlying pool allocator in thread-safe mode
+  pthread_mutex_t AllocLock;
 
   // Splay tree used by dangling pointer runtime
   RangeSplayMap<PDebugMetaData> DPTree;
 
-  // Cache of recently found memory objects
-  struct {
-    void * lower;
-    void * upper;
-  } objectCache[2];
-
-  unsigned char cacheIndex;
+  // Epoch of the pool's entries in the object caches; see ObjectCache.h
+  uintptr_t CacheEpoch;
 };
 
 void * rewrite_ptr (DebugPoolTy * Pool, const void * p, void * ObjStart,
@@ -129,6 +351,7 @@ extern "C" {
   void pool_register_stack_debug(PPOOL, void * p, unsigned size, TAG, SRC_INFO);
   void pool_register_global (PPOOL, void * p, unsigned size);
   void pool_register_global_debug(PPOOL, void * p, unsigned size, TAG, SRC_INFO);
+  void pool_register_globals (struct GlobalTableEntry * Table, unsigned Count);
 
   void pool_reregister (PPOOL, void * p, void * q, unsigned size);
   void pool_reregister_debug (PPOOL, void * p, void * q, unsigned size, TAG, SRC_INFO);
@@ -183,6 +406,8 @@ extern "C" {
   void funccheckui (void *f, void * targets[]);
   void funccheck_debug   (void *f, void * targets[], TAG, SRC_INFO);
   void funccheckui_debug (void *f, void * targets[], TAG, SRC_INFO);
+  void funccheck_set (void *f, struct TargetSet * Set);
+  void funccheck_set_debug (void *f, struct TargetSet * Set, TAG, SRC_INFO);
 
   // Change memory protections to detect dangling pointers
   void * pool_shadow (void * Node, unsigned NumBytes);
@@ -193,6 +418,25 @@ extern "C" {
   void poolcheck_freeui (PPOOL, void * ptr);
   void poolcheck_free_debug   (PPOOL, void * ptr, TAG, SRC_INFO);
   void poolcheck_freeui_debug (PPOOL, void * ptr, TAG, SRC_INFO);
+
+  // Asynchronous checking on per-thread checking threads
+  void __sc_par_pool_init_runtime (unsigned Dangling,
+                                   unsigned RewriteOOB,
+                                   unsigned Terminate);
+  void __sc_par_poolcheck (PPOOL, void * Node, unsigned length);
+  void __sc_par_poolcheckui (PPOOL, void * Node, unsigned length);
+  void __sc_par_poolcheckalign (PPOOL, void * Node, unsigned Offset);
+  void * __sc_par_boundscheck (PPOOL, void * Source, void * Dest);
+  void * __sc_par_boundscheckui (PPOOL, void * Source, void * Dest);
+  void __sc_par_funccheck (void * f, void * targets[]);
+  void __sc_par_poolregister (PPOOL, void * allocaptr, unsigned NumBytes);
+  void __sc_par_poolregister_stack (PPOOL, void * allocaptr, unsigned NumBytes);
+  void __sc_par_poolunregister (PPOOL, void * allocaptr);
+  void __sc_par_poolunregister_stack (PPOOL, void * allocaptr);
+  void __sc_par_poolfree (PPOOL, void * Node);
+  void __sc_par_enqueue_code_dup (void * code, void * args);
+  void __sc_par_wait_for_completion (void);
+  void __sc_par_store_check (void * ptr);
 }
 
 #undef PPOOL
@@ -0,0 +1,36 @@
+//===- GlobalTable.h - Tables of registered global variables ----*- C++ -*-===//
+//
+//                       The SAFECode Compiler Project
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the entries of the tables of global variables that the
+// RegisterGlobalVariables pass passes to pool_register_globals().
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _GLOBALTABLE_H_
+#define _GLOBALTABLE_H_
+
+//
+// Structure: GlobalTableEntry
+//
+// Description:
+//  A global variable to register.  The compiler emits this structure as
+//  { i8*, i8*, i32 }, so its layout must not change.
+//
+// Fields:
+//  Pool  - The pool into which to register the global, or NULL.
+//  Start - The address of the global.
+//  Size  - The size of the global in bytes.
+//
+typedef struct GlobalTableEntry {
+  void * Pool;
+  void * Start;
+  unsigned Size;
+} GlobalTableEntry;
+
+#endif
@@ -0,0 +1,386 @@
+//===-- PageTable.h - Page-indexed table of object ranges -------*- C++ -*-===//
+//
+//                          The SAFECode Compiler
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a set of memory object ranges that is indexed by
+// virtual page number.  It provides the same interface as RangeSplaySet, but
+// lookups never modify the data structure: a lookup is three dependent loads
+// through a radix tree of pages followed by a binary search of the (usually
+// very short) list of objects that overlap the page.
+//
+// The table can optionally recycle the memory of its buckets instead of
+// returning it to the system.  A recycled bucket always holds a count that is
+// no larger than its capacity, so a reader that races with a writer (and
+// validates its result afterwards, e.g., with a sequence lock) never reads
+// outside of a bucket.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SUPPORT_PAGETABLE_H
+#define SUPPORT_PAGETABLE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+class RangePageSet {
+  //
+  // The radix tree covers a 48-bit address space: 12 bits of page offset and
+  // three 12-bit levels of page number.  Address bits above bit 47 alias into
+  // the same table; this is harmless because each bucket records the exact
+  // bounds of its objects.
+  //
+  static const unsigned PageShift = 12;
+  static const unsigned LevelBits = 12;
+  static const uintptr_t LevelSize = ((uintptr_t) 1) << LevelBits;
+  static const uintptr_t LevelMask = LevelSize - 1;
+
+  struct range {
+    void * start;
+    void * end;
+  };
+
+  //
+  // Structure: bucket
+  //
+  // Description:
+  //  The set of objects overlapping a single page, sorted by start address.
+  //  An object that spans several pages has an entry in each page's bucket.
+  //
+  struct bucket {
+    unsigned count;
+    unsigned capacity;
+    range entries[1];
+  };
+
+  // The largest number of bucket size classes kept for recycling
+  static const unsigned NumClasses = 32;
+
+  // The root of the radix tree; allocated on the first insertion
+  void ** Root;
+
+  // Flags whether the memory of buckets is recycled instead of freed
+  bool Recycle;
+
+  // Lists of retired buckets, indexed by the log2 of their capacity
+  bucket * Retired[NumClasses];
+
+  // Disallow copying; the table owns its radix tree
+  RangePageSet (const RangePageSet &);
+  RangePageSet & operator= (const RangePageSet &);
+
+  static uintptr_t pageOf (void * p) {
+    return ((uintptr_t) p) >> PageShift;
+  }
+
+  // Return the page number with the aliased high bits removed
+  static uintptr_t tableIndex (uintptr_t pn) {
+    return pn & ((((LevelMask << LevelBits) | LevelMask) << LevelBits) |
+                 LevelMask);
+  }
+
+  static void ** newLevel (void) {
+    return (void **) calloc (LevelSize, sizeof (void *));
+  }
+
+  //
+  // Method: lookupBucket()
+  //
+  // Description:
+  //  Return the bucket for the specified page number or NULL if no object
+  //  overlaps the page.  This never allocates or modifies the table.
+  //
+  bucket * lookupBucket (uintptr_t pn) const {
+    void ** Top = (void **) __atomic_load_n (&Root, __ATOMIC_ACQUIRE);
+    if (!Top) return 0;
+    void ** Middle = (void **)
+      __atomic_load_n (&Top[(pn >> (2 * LevelBits)) & LevelMask],
+                       __ATOMIC_ACQUIRE);
+    if (!Middle) return 0;
+    void ** Leaf = (void **)
+      __atomic_load_n (&Middle[(pn >> LevelBits) & LevelMask],
+                       __ATOMIC_ACQUIRE);
+    if (!Leaf) return 0;
+    return (bucket *) Leaf[pn & LevelMask];
+  }
+
+  //
+  // Method: getBucketSlot()
+  //
+  // Description:
+  //  Return the location holding the bucket pointer for the specified page
+  //  number, allocating interior levels of the radix tree as needed.  New
+  //  levels are published after they are cleared, since readers of other
+  //  pages walk the same interior levels without waiting for this writer.
+  //
+  bucket ** getBucketSlot (uintptr_t pn) {
+    if (!Root) __atomic_store_n (&Root, newLevel(), __ATOMIC_RELEASE);
+    void ** & Middle = (void ** &) Root[(pn >> (2 * LevelBits)) & LevelMask];
+    if (!Middle) __atomic_store_n (&Middle, newLevel(), __ATOMIC_RELEASE);
+    void ** & Leaf = (void ** &) Middle[(pn >> LevelBits) & LevelMask];
+    if (!Leaf) __atomic_store_n (&Leaf, newLevel(), __ATOMIC_RELEASE);
+    return (bucket **) &(Leaf[pn & LevelMask]);
+  }
+
+  //
+  // Method: search()
+  //
+  // Description:
+  //  Find the last entry in the bucket whose start address is less than or
+  //  equal to the key.
+  //
+  // Return value:
+  //  -1        - All entries in the bucket start after the key.
+  //  Otherwise - The index of the entry.
+  //
+  static int search (const bucket * b, void * key) {
+    int lo = 0;
+    int hi = (int) b->count;
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (b->entries[mid].start <= key)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo - 1;
+  }
+
+  static unsigned classOf (unsigned capacity) {
+    unsigned index = 0;
+    while (capacity > 4) {
+      capacity >>= 1;
+      ++index;
+    }
+    return index;
+  }
+
+  //
+  // Method: allocBucket()
+  //
+  // Description:
+  //  Allocate an empty bucket of the specified capacity, reusing a retired
+  //  bucket if possible.
+  //
+  bucket * allocBucket (unsigned capacity) {
+    bucket * b = 0;
+    if (Recycle && (b = Retired[classOf (capacity)])) {
+      Retired[classOf (capacity)] = (bucket *) (b->entries[0].start);
+      return b;
+    }
+
+    b = (bucket *) malloc (sizeof (bucket) + (capacity - 1) * sizeof (range));
+    b->count = 0;
+    b->capacity = capacity;
+    return b;
+  }
+
+  //
+  // Method: freeBucket()
+  //
+  // Description:
+  //  Release the memory of a bucket.  A recycled bucket is emptied before it is
+  //  placed on the list of retired buckets so that concurrent readers find no
+  //  entries within it.
+  //
+  void freeBucket (bucket * b) {
+    if (Recycle) {
+      b->count = 0;
+      b->entries[0].start = Retired[classOf (b->capacity)];
+      Retired[classOf (b->capacity)] = b;
+    } else {
+      free (b);
+    }
+  }
+
+  void addToBucket (bucket ** slot, void * start, void * end) {
+    bucket * b = *slot;
+    if (!b) {
+      b = allocBucket (4);
+      *slot = b;
+    } else if (b->count == b->capacity) {
+      //
+      // Copy the entries into a larger bucket.  The old bucket is not resized
+      // in place so that the capacity of a bucket never changes.
+      //
+      bucket * larger = allocBucket (b->capacity * 2);
+      memcpy (larger->entries, b->entries, b->count * sizeof (range));
+      larger->count = b->count;
+      *slot = larger;
+      freeBucket (b);
+      b = larger;
+    }
+
+    int index = search (b, start) + 1;
+    memmove (&(b->entries[index + 1]),
+             &(b->entries[index]),
+             (b->count - index) * sizeof (range));
+    b->entries[index].start = start;
+    b->entries[index].end = end;
+    ++(b->count);
+  }
+
+  void removeFromBucket (uintptr_t pn, void * start) {
+    if (!Root) return;
+    void ** Middle = (void **) Root[(pn >> (2 * LevelBits)) & LevelMask];
+    if (!Middle) return;
+    void ** Leaf = (void **) Middle[(pn >> LevelBits) & LevelMask];
+    if (!Leaf) return;
+    bucket * & b = (bucket * &) Leaf[pn & LevelMask];
+    if (!b) return;
+
+    int index = search (b, start);
+    if ((index < 0) || (b->entries[index].start != start))
+      return;
+    memmove (&(b->entries[index]),
+             &(b->entries[index + 1]),
+             (b->count - index - 1) * sizeof (range));
+    if (--(b->count) == 0) {
+      bucket * empty = b;
+      b = 0;
+      freeBucket (empty);
+    }
+  }
+
+ public:
+  explicit RangePageSet (bool recycle = false) : Root(0), Recycle(recycle) {
+    for (unsigned index = 0; index < NumClasses; ++index)
+      Retired[index] = 0;
+  }
+
+  ~RangePageSet () { clear(); }
+
+  //
+  // Method: insert()
+  //
+  // Description:
+  //  Insert an object into the set.  Like RangeSplaySet::insert(), the
+  //  insertion fails if the first byte of the object is already within a
+  //  registered object.
+  //
+  // Inputs:
+  //  start - The first valid address of the object.
+  //  end   - The last valid address of the object.
+  //
+  // Return value:
+  //  true  - The insert succeeded.
+  //  false - The insert failed.
+  //
+  bool insert (void * start, void * end) {
+    if (find (start))
+      return false;
+
+    uintptr_t last = pageOf (end);
+    for (uintptr_t pn = pageOf (start); ; ++pn) {
+      addToBucket (getBucketSlot (pn), start, end);
+      if (pn == last) break;
+    }
+    return true;
+  }
+
+  //
+  // Method: remove()
+  //
+  // Description:
+  //  Remove the object containing the specified address from the set.
+  //
+  bool remove (void * key) {
+    void * start;
+    void * end;
+    if (!find (key, start, end))
+      return false;
+
+    uintptr_t last = pageOf (end);
+    for (uintptr_t pn = pageOf (start); ; ++pn) {
+      removeFromBucket (pn, start);
+      if (pn == last) break;
+    }
+    return true;
+  }
+
+  //
+  // Method: count()
+  //
+  // Description:
+  //  Return the number of objects in the set.  Each object is counted in the
+  //  bucket of the page on which it starts.
+  //
+  unsigned count () const {
+    if (!Root) return 0;
+    unsigned total = 0;
+    for (uintptr_t i = 0; i < LevelSize; ++i) {
+      void ** Middle = (void **) Root[i];
+      if (!Middle) continue;
+      for (uintptr_t j = 0; j < LevelSize; ++j) {
+        void ** Leaf = (void **) Middle[j];
+        if (!Leaf) continue;
+        for (uintptr_t k = 0; k < LevelSize; ++k) {
+          bucket * b = (bucket *) Leaf[k];
+          if (!b) continue;
+          uintptr_t pn = (((i << LevelBits) | j) << LevelBits) | k;
+          for (unsigned index = 0; index < b->count; ++index)
+            if (tableIndex (pageOf (b->entries[index].start)) == pn)
+              ++total;
+        }
+      }
+    }
+    return total;
+  }
+
+  void clear () {
+    if (!Root) return;
+    for (uintptr_t i = 0; i < LevelSize; ++i) {
+      void ** Middle = (void **) Root[i];
+      if (!Middle) continue;
+      for (uintptr_t j = 0; j < LevelSize; ++j) {
+        void ** Leaf = (void **) Middle[j];
+        if (!Leaf) continue;
+        for (uintptr_t k = 0; k < LevelSize; ++k)
+          free (Leaf[k]);
+        free (Leaf);
+      }
+      free (Middle);
+    }
+    free (Root);
+    Root = 0;
+
+    for (unsigned index = 0; index < NumClasses; ++index) {
+      while (bucket * b = Retired[index]) {
+        Retired[index] = (bucket *) (b->entries[0].start);
+        free (b);
+      }
+    }
+  }
+
+  //
+  // Method: find()
+  //
+  // Description:
+  //  Find the object containing the specified address.  When registrations
+  //  overlap, the object with the greatest start address not above the key
+  //  is the one examined.
+  //
+  bool find (void * key, void *& start, void *& end) const {
+    bucket * b = lookupBucket (pageOf (key));
+    if (!b) return false;
+    int index = search (b, key);
+    if ((index < 0) || (key > b->entries[index].end))
+      return false;
+    start = b->entries[index].start;
+    end = b->entries[index].end;
+    return true;
+  }
+
+  bool find (void * key) const {
+    void * start;
+    void * end;
+    return find (key, start, end);
+  }
+};
+
+#endif
@@ -0,0 +1,116 @@
+//===- SiteCache.h - Caches of checked objects in checked code -*- C++ -*-===//
+//
+//                       The SAFECode Compiler Project
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the interface between the run-times and the code that the
+// InlineFastChecks pass emits for poolcheck() and boundscheck() calls.  Each
+// such call site has a thread-local cache of the last object that it checked.
+// The inlined code compares the checked pointers against the cached object and
+// only calls the run-time when they are not within it; it then calls
+// __sc_fill_site_cache() to cache the object of the pointer.
+//
+// A cached object is valid as long as the epoch recorded with it is the
+// current epoch.  The run-times advance the epoch whenever an object is
+// unregistered, so no object is ever found in a cache after it was freed.
+// Programs built without site caches never fill one, so the epoch is only
+// advanced once the first cache has been filled; until then, unregistering
+// an object does not write to the shared epoch.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _SITECACHE_H_
+#define _SITECACHE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Structure: SiteCache
+//
+// Description:
+//  The cache of a check site.  The compiler emits this structure as
+//  { i8*, i8*, i8*, intptr }, so its layout must not change.
+//
+// Fields:
+//  Pool  - The pool argument of the check that filled the cache.
+//  lower - The address of the first byte of the cached object.
+//  upper - The address of the first byte after the cached object.
+//  Epoch - The epoch at which the object was looked up.
+//
+typedef struct SiteCache {
+  void * Pool;
+  void * lower;
+  void * upper;
+  uintptr_t Epoch;
+} SiteCache;
+
+// The current epoch; it starts at one so that an empty cache never hits
+extern uintptr_t __sc_site_cache_epoch;
+
+// Set when the first site cache is filled
+extern unsigned __sc_site_caches_used;
+
+// Look up the object of a pointer that missed in a site cache and cache it
+void __sc_fill_site_cache (void * Pool, void * Node, SiteCache * Cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+//
+// Function: advanceSiteCacheEpoch()
+//
+// Description:
+//  Invalidate the objects cached by every check site.  This must be called
+//  when an object is unregistered.
+//
+static inline void
+advanceSiteCacheEpoch (void) {
+  //
+  // The fence orders the removal of the object before the test of the flag,
+  // pairing with the fence in useSiteCaches(): either the first fill sees
+  // the object removed, or the epoch is advanced.
+  //
+  __atomic_thread_fence (__ATOMIC_SEQ_CST);
+  if (__atomic_load_n (&__sc_site_caches_used, __ATOMIC_RELAXED))
+    __atomic_add_fetch (&__sc_site_cache_epoch, 1, __ATOMIC_RELEASE);
+}
+
+//
+// Function: useSiteCaches()
+//
+// Description:
+//  Record that site caches are in use, so that unregistering an object
+//  advances the epoch from now on.  This must be called before an object is
+//  looked up to fill a cache.
+//
+static inline void
+useSiteCaches (void) {
+  if (!__atomic_load_n (&__sc_site_caches_used, __ATOMIC_RELAXED)) {
+    __atomic_store_n (&__sc_site_caches_used, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+  }
+}
+
+//
+// Function: readSiteCacheEpoch()
+//
+// Description:
+//  Read the epoch to record with an object that is about to be looked up.  It
+//  must be read before the lookup so that an object unregistered during the
+//  lookup is cached with an old epoch.
+//
+static inline uintptr_t
+readSiteCacheEpoch (void) {
+  return __atomic_load_n (&__sc_site_cache_epoch, __ATOMIC_ACQUIRE);
+}
+
+#endif
@@ -0,0 +1,87 @@
+//===- TargetSet.h - Sets of valid indirect call targets --------*- C++ -*-===//
+//
+//                       The SAFECode Compiler Project
+//
+// This file was developed by the LLVM research group and is distributed under
+// the University of Illinois Open Source License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the table of targets that the CompleteChecks pass passes
+// to funccheck_set() for indirect calls with many targets.  The addresses of
+// the targets are not known until link time, so the run-time sorts a copy of
+// the targets the first time that the set is used and then finds targets
+// with a binary search.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _TARGETSET_H_
+#define _TARGETSET_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <functional>
+
+//
+// Structure: TargetSet
+//
+// Description:
+//  A set of indirect call targets.  The compiler emits this structure as
+//  { intptr, intptr, [2 * Count x i8*] }, so its layout must not change.
+//
+// Fields:
+//  Count   - The number of targets.
+//  State   - Whether the sorted copy of the targets has been made.
+//  Targets - The targets in no particular order, followed by Count slots that
+//            hold the targets in address order once State is TargetsSorted.
+//
+typedef struct TargetSet {
+  uintptr_t Count;
+  uintptr_t State;
+  void * Targets[];
+} TargetSet;
+
+// The values of TargetSet::State
+enum {
+  TargetsUnsorted = 0,
+  TargetsSorting  = 1,
+  TargetsSorted   = 2
+};
+
+//
+// Function: isInTargetSet()
+//
+// Description:
+//  Determine whether a function pointer is in a set of targets.  The first
+//  thread to use the set sorts it; other threads search the unsorted targets
+//  with a linear scan until the sorted copy is ready.
+//
+static inline bool
+isInTargetSet (void * f, TargetSet * Set) {
+  uintptr_t Count = Set->Count;
+  void ** Sorted = Set->Targets + Count;
+  std::less<void *> Less;
+
+  uintptr_t State = __atomic_load_n (&Set->State, __ATOMIC_ACQUIRE);
+  if (State != TargetsSorted) {
+    uintptr_t Expected = TargetsUnsorted;
+    if ((State == TargetsUnsorted) &&
+        __atomic_compare_exchange_n (&Set->State, &Expected, TargetsSorting,
+                                     false, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED)) {
+      std::copy (Set->Targets, Set->Targets + Count, Sorted);
+      std::sort (Sorted, Sorted + Count, Less);
+      __atomic_store_n (&Set->State, TargetsSorted, __ATOMIC_RELEASE);
+    } else {
+      for (uintptr_t index = 0; index < Count; ++index)
+        if (Set->Targets[index] == f)
+          return true;
+      return false;
+    }
+  }
+
+  return std::binary_search (Sorted, Sorted + Count, f, Less);
+}
+
+#endif
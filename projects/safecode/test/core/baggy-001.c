@@ -0,0 +1,39 @@
+// RUN: test.sh -e -r bb -t %t %s
+//
+// TEST: baggy-001
+//
+// Description:
+//  Test that the baggy bounds run-time catches a load one element past the
+//  end of a heap object that is larger than a page.  Such objects are found
+//  through the page table of the run-time instead of the slot table.  The
+//  test is not instrumented; it calls the run-time the way that instrumented
+//  code does.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ELEMENTS 2000
+
+void pool_init_runtime (unsigned, unsigned, unsigned);
+void pool_register (void *, void *, unsigned);
+void * bb_boundscheck_debug (void *, void *, void *, unsigned,
+                             const char *, unsigned);
+void bb_poolcheck_debug (void *, void *, unsigned, unsigned,
+                         const char *, unsigned);
+
+int
+main (int argc, char ** argv) {
+  pool_init_runtime (0, 1, 1);
+
+  int * array = malloc (ELEMENTS * sizeof (int));
+  pool_register (0, array, ELEMENTS * sizeof (int));
+
+  //
+  // Index one element past the end of the array and load from the result.
+  //
+  int * p = bb_boundscheck_debug (0, array, array + ELEMENTS,
+                                  1, __FILE__, __LINE__);
+  bb_poolcheck_debug (0, p, sizeof (int), 2, __FILE__, __LINE__);
+  return 0;
+}
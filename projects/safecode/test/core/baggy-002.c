@@ -0,0 +1,33 @@
+// RUN: test.sh -e -r bb -t %t %s
+//
+// TEST: baggy-002
+//
+// Description:
+//  Test that the baggy bounds run-time catches a load that starts within a
+//  heap object that is larger than a page but ends past the end of it.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ELEMENTS 2000
+
+void pool_init_runtime (unsigned, unsigned, unsigned);
+void pool_register (void *, void *, unsigned);
+void bb_poolcheck_debug (void *, void *, unsigned, unsigned,
+                         const char *, unsigned);
+
+int
+main (int argc, char ** argv) {
+  pool_init_runtime (0, 1, 1);
+
+  int * array = malloc (ELEMENTS * sizeof (int));
+  pool_register (0, array, ELEMENTS * sizeof (int));
+
+  //
+  // Load two elements starting at the last element of the array.
+  //
+  bb_poolcheck_debug (0, array + ELEMENTS - 1, 2 * sizeof (int),
+                      1, __FILE__, __LINE__);
+  return 0;
+}
@@ -0,0 +1,43 @@
+// RUN: test.sh -p -r bb -t %t %s
+//
+// TEST: baggy-003
+//
+// Description:
+//  Test that the baggy bounds run-time accepts indexing and loads anywhere
+//  within a heap object that is larger than a page, up to and including its
+//  last element.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ELEMENTS 2000
+
+void pool_init_runtime (unsigned, unsigned, unsigned);
+void pool_register (void *, void *, unsigned);
+void * bb_boundscheck_debug (void *, void *, void *, unsigned,
+                             const char *, unsigned);
+void bb_poolcheck_debug (void *, void *, unsigned, unsigned,
+                         const char *, unsigned);
+
+int
+main (int argc, char ** argv) {
+  pool_init_runtime (0, 1, 1);
+
+  int * array = malloc (ELEMENTS * sizeof (int));
+  pool_register (0, array, ELEMENTS * sizeof (int));
+
+  for (unsigned index = 0; index < ELEMENTS; ++index) {
+    int * p = bb_boundscheck_debug (0, array, array + index,
+                                    1, __FILE__, __LINE__);
+    if (p != array + index) {
+      printf ("index %u was rewritten\n", index);
+      return 1;
+    }
+    bb_poolcheck_debug (0, p, sizeof (int), 2, __FILE__, __LINE__);
+  }
+
+  bb_poolcheck_debug (0, array, ELEMENTS * sizeof (int),
+                      3, __FILE__, __LINE__);
+  return 0;
+}
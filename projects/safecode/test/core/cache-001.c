@@ -0,0 +1,32 @@
+// RUN: env SCCACHESIZE=4 SCCACHEWAYS=1 test.sh -e -t %t %s
+//
+// TEST: cache-001
+//
+// Description:
+//  Test that a freed object is removed from the object cache.  The memory of
+//  a freed object is reused for a smaller object; an access that is within
+//  the bounds of the old object but not of the new one must be detected.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int
+main (int argc, char ** argv) {
+  char * objs[3];
+  int index;
+  int sum = 0;
+
+  for (index = 0; index < 3; ++index)
+    objs[index] = malloc (64);
+
+  for (index = 0; index < 192; ++index)
+    sum += objs[index % 3][index / 3];
+
+  free (objs[0]);
+  objs[0] = malloc (16);
+
+  sum += objs[0][argc + 31];
+  printf ("%d\n", sum);
+  return 0;
+}
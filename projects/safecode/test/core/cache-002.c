@@ -0,0 +1,54 @@
+// RUN: env SCTHREADSAFE=1 SCCACHESIZE=4 SCCACHEWAYS=1 test.sh -e -t %t -l -lpthread %s
+//
+// TEST: cache-002
+//
+// Description:
+//  Test that an object freed by one thread is no longer found in the object
+//  cache of another thread.  A second thread caches the object; the main
+//  thread frees it and reuses its memory for a smaller object; an access by
+//  the second thread that is within the bounds of the old object but not of
+//  the new one must be detected.
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static pthread_barrier_t barrier;
+static char * obj;
+static int offset;
+
+static void *
+reader (void * arg) {
+  long sum = 0;
+  int index;
+
+  for (index = 0; index < 64; ++index)
+    sum += obj[index];
+
+  pthread_barrier_wait (&barrier);
+  pthread_barrier_wait (&barrier);
+
+  sum += obj[offset];
+  return (void *) sum;
+}
+
+int
+main (int argc, char ** argv) {
+  pthread_t thread;
+  void * sum;
+
+  obj = calloc (64, 1);
+  offset = argc + 31;
+  pthread_barrier_init (&barrier, 0, 2);
+  pthread_create (&thread, 0, reader, 0);
+
+  pthread_barrier_wait (&barrier);
+  free (obj);
+  obj = calloc (16, 1);
+  pthread_barrier_wait (&barrier);
+
+  pthread_join (thread, &sum);
+  printf ("%ld\n", (long) sum);
+  return 0;
+}
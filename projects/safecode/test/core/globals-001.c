@@ -0,0 +1,43 @@
+// RUN: test.sh -p -t %t %s
+//
+// TEST: globals-001
+//
+// Description:
+//  Test that pool_register_globals() merges globals that overlap into one
+//  object.  The table registers [m, m + 8) and [m + 4, m + 12) out of order;
+//  a pointer into the second range computed from m must be within the merged
+//  object.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+struct GlobalTableEntry {
+  void * Pool;
+  void * Start;
+  unsigned Size;
+};
+
+extern void pool_register_globals (struct GlobalTableEntry * Table,
+                                   unsigned Count);
+
+int
+main (int argc, char ** argv) {
+  char * m = mmap (0, 4096, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (m == MAP_FAILED)
+    return 1;
+
+  struct GlobalTableEntry Table[3] = {
+    {0, m + 4, 8},
+    {0, m + 32, 4},
+    {0, m, 8}
+  };
+  pool_register_globals (Table, 3);
+
+  char * p = m + argc + 9;
+  *p = 1;
+  printf ("%d\n", m[10]);
+  return 0;
+}
@@ -0,0 +1,17 @@
+// RUN: env SCOBJECTINDEX=pagetable test.sh -e -t %t %s
+//
+// TEST: pagetable-001
+//
+// Description:
+//  Test that an off-by-one read on a heap object spanning several pages is
+//  detected when objects are indexed by the page table.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int
+main (int argc, char ** argv) {
+  char * array = malloc (sizeof (char) * 3 * 4096);
+  return array[3 * 4096];
+}
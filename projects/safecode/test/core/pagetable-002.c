@@ -0,0 +1,33 @@
+// RUN: env SCOBJECTINDEX=pagetable test.sh -p -t %t %s
+//
+// TEST: pagetable-002
+//
+// Description:
+//  Test that in-bounds accesses to many small heap objects and to a global
+//  are not flagged when objects are indexed by the page table.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static char global[64];
+
+int
+main (int argc, char ** argv) {
+  char * objs[1000];
+  int index;
+  int sum = 0;
+
+  for (index = 0; index < 1000; ++index) {
+    objs[index] = malloc (24);
+    objs[index][23] = index;
+  }
+
+  for (index = 0; index < 1000; ++index) {
+    sum += objs[index][23] + global[index % 64];
+    free (objs[index]);
+  }
+
+  printf ("%d\n", sum);
+  return 0;
+}
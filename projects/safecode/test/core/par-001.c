@@ -0,0 +1,88 @@
+// RUN: env SCTHREADSAFE=1 test.sh -p -t %t -l -lpthread %s
+//
+// TEST: par-001
+//
+// Description:
+//  Stress test of the asynchronous checking run-time.  Each thread registers
+//  objects, defers in-bounds load/store and bounds checks on them, and
+//  unregisters them again through the __sc_par_* functions, waiting for its
+//  checking thread at the end of every round.  The checks of a thread must be
+//  performed in order with its registrations, so no check should fail.
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/mman.h>
+
+#define THREADS 8
+#define OBJECTS 64
+#define ROUNDS  200
+
+extern void __sc_par_pool_init_runtime (unsigned Dangling,
+                                        unsigned RewriteOOB,
+                                        unsigned Terminate);
+extern void __sc_par_poolcheck (void * Pool, void * Node, unsigned length);
+extern void * __sc_par_boundscheckui (void * Pool, void * Source, void * Dest);
+extern void __sc_par_poolregister (void * Pool,
+                                   void * allocaptr,
+                                   unsigned NumBytes);
+extern void __sc_par_poolunregister (void * Pool, void * allocaptr);
+extern void __sc_par_wait_for_completion (void);
+
+static void *
+worker (void * arg) {
+  char * m = arg;
+  int round;
+  int index;
+
+  for (round = 0; round < ROUNDS; ++round) {
+    //
+    // Each round moves the objects, so a check performed after the
+    // unregistration of its object, or before the registration, fails.
+    //
+    char * base = m + (round % 2) * (OBJECTS * 32);
+
+    for (index = 0; index < OBJECTS; ++index)
+      __sc_par_poolregister (0, base + index * 32, 16 + (index % 2) * 16);
+
+    for (index = 0; index < OBJECTS; ++index) {
+      char * obj = base + index * 32;
+      __sc_par_poolcheck (0, obj + 12, 4);
+      if (__sc_par_boundscheckui (0, obj, obj + 15) != obj + 15)
+        return (void *) 1;
+    }
+
+    for (index = 0; index < OBJECTS; ++index)
+      __sc_par_poolunregister (0, base + index * 32);
+
+    __sc_par_wait_for_completion ();
+  }
+
+  return 0;
+}
+
+int
+main (int argc, char ** argv) {
+  pthread_t threads[THREADS];
+  void * result;
+  int failed = 0;
+  int index;
+
+  __sc_par_pool_init_runtime (0, 0, 0);
+
+  for (index = 0; index < THREADS; ++index) {
+    char * m = mmap (0, 2 * OBJECTS * 32, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED)
+      return 1;
+    pthread_create (&threads[index], 0, worker, m);
+  }
+
+  for (index = 0; index < THREADS; ++index) {
+    pthread_join (threads[index], &result);
+    failed |= (result != 0);
+  }
+
+  printf ("%d\n", failed);
+  return failed;
+}
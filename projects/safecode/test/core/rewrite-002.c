@@ -0,0 +1,42 @@
+// RUN: test.sh -p -t %t %s
+//
+// TEST: rewrite-002
+//
+// Description:
+//  Test that a long-running loop computing one-past-the-end pointers for many
+//  heap objects keeps working after the rewrite pointer table has recycled
+//  its entries many times.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define OBJECTS 1024
+
+int
+main (int argc, char ** argv) {
+  char * objs[OBJECTS];
+  unsigned long sum = 0;
+  int round;
+  int index;
+
+  for (index = 0; index < OBJECTS; ++index)
+    objs[index] = calloc (16 + (index % 16), 1);
+
+  for (round = 0; round < 1000; ++round) {
+    for (index = 0; index < OBJECTS; ++index) {
+      char * obj = objs[index];
+      char * end = obj + 16 + (index % 16);
+      char * p;
+      for (p = end - 1; p >= obj; p -= 8)
+        sum += *p;
+      sum += (unsigned long) (end - obj);
+    }
+
+    free (objs[round % OBJECTS]);
+    objs[round % OBJECTS] = calloc (16 + (round % 16), 1);
+  }
+
+  printf ("%lu\n", sum);
+  return 0;
+}
@@ -0,0 +1,47 @@
+// RUN: test.sh -p -t %t %s
+//
+// TEST: rewrite-003
+//
+// Description:
+//  Test that a rewrite pointer stays valid while its object is live, however
+//  many other pointers are rewritten after it.  The first object's
+//  out-of-bounds pointer is kept while more than 32768 (the old size of the
+//  rewrite table) other pointers are rewritten, some of them for objects
+//  that are freed again, and is then moved back into its object and used.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define OBJECTS 4096
+#define ROUNDS  16
+
+int
+main (int argc, char ** argv) {
+  char * objs[OBJECTS];
+  char * first = calloc (16, 1);
+  char * firstEnd;
+  unsigned long sum = 0;
+  int round;
+  int index;
+
+  first[15] = 42;
+  firstEnd = first + 16 + argc;
+
+  for (index = 0; index < OBJECTS; ++index)
+    objs[index] = calloc (8, 1);
+
+  for (round = 0; round < ROUNDS; ++round) {
+    for (index = 0; index < OBJECTS; ++index) {
+      char * end = objs[index] + 8 + round + argc;
+      sum += (unsigned long) (end - objs[index]);
+    }
+
+    free (objs[round]);
+    objs[round] = calloc (8, 1);
+  }
+
+  firstEnd -= 1 + argc;
+  printf ("%lu %d\n", sum, *firstEnd);
+  return 0;
+}
@@ -0,0 +1,52 @@
+// RUN: env SCREWRITERANGE=4096 test.sh -p -t %t %s
+//
+// TEST: rewrite-004
+//
+// Description:
+//  Test that the rewrite pointers of unregistered objects are handed out
+//  again.  The reserved range is shrunk to one page, and far more out of
+//  bounds pointers than it holds are made while the objects that they were
+//  computed from are freed and allocated again.  Each out of bounds pointer
+//  is kept until its object is about to be freed and is then moved back
+//  into the object and used, so every one of them must still be rewritten
+//  and resolved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define WINDOW  64
+#define POINTERS 65536
+
+int
+main (int argc, char ** argv) {
+  char * objs[WINDOW];
+  char * ends[WINDOW];
+  unsigned long sum = 0;
+  int index;
+
+  for (index = 0; index < WINDOW; ++index) {
+    objs[index] = malloc (16);
+    objs[index][15] = index;
+    ends[index] = objs[index] + 16 + argc;
+  }
+
+  for (index = 0; index < POINTERS; ++index) {
+    int slot = index % WINDOW;
+    char * last = ends[slot] - argc - 1;
+    if (*last != (char) slot)
+      return 1;
+    sum += *last;
+
+    free (objs[slot]);
+    objs[slot] = malloc (16);
+    objs[slot][15] = slot;
+    ends[slot] = objs[slot] + 16 + argc;
+  }
+
+  for (index = 0; index < WINDOW; ++index)
+    free (objs[index]);
+
+  printf ("%lu\n", sum);
+  return 0;
+}
@@ -0,0 +1,312 @@
+// RUN: test.sh -p -r softbound -C -D__SOFTBOUNDCETS_MULTITHREADED -t %t -l -lpthread %s
+//
+// TEST: softbound-001
+//
+// Description:
+//  Test the multithreaded mode of the SoftBound+CETS run-time.  The test is
+//  not instrumented; it calls the run-time the way that instrumented code
+//  does.  Threads are created through the pthread_create() wrapper, which
+//  must pass the metadata of the thread argument on the shadow stack of the
+//  new thread.  Each thread then
+//   - pushes frames onto its shadow stack and checks that the metadata in
+//     them is not changed by the other threads,
+//   - allocates and frees stack and heap objects and checks their keys,
+//   - stores and loads the metadata of pointers in secondary trie tables that
+//     all threads allocate at the same time, and loads the metadata of a
+//     table of pointers that all threads share.
+//  Half of the threads exit with pthread_exit().  After each round, the
+//  shadow stacks and stack key/lock spaces of the exited threads must have
+//  been released by __softboundcets_thread_fini().
+//
+
+#include "softboundcets.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define THREADS 8
+#define ROUNDS  4
+#define SHARED  64
+#define FRAMES  64
+#define OBJECTS 64
+#define TABLES  16
+
+// The size of the address range whose metadata is in one secondary table
+#define TABLE_SPAN (((size_t) 1) << 25)
+
+int softboundcets_pthread_create (pthread_t *, const pthread_attr_t *,
+                                  void * (*) (void *), void *);
+
+struct object {
+  char * base;
+  char * bound;
+  size_t key;
+  void * lock;
+};
+
+struct thread_info {
+  unsigned id;
+  int exit_early;
+  struct object self;
+  void * shadow_stack;
+  void * stack_locks;
+};
+
+// Objects whose pointers are stored in the table shared by all threads
+static struct object shared[SHARED];
+static char * table[SHARED];
+
+// Addresses in secondary trie tables that no other pointer uses
+static char * region;
+
+static unsigned failures = 0;
+
+static void
+fail (unsigned id, const char * what) {
+  fprintf (stderr, "thread %u: %s\n", id, what);
+  __sync_fetch_and_add (&failures, 1);
+}
+
+static void
+newObject (struct object * O, size_t size) {
+  O->base = malloc (size);
+  O->bound = O->base + size;
+  __softboundcets_memory_allocation (O->base, &O->lock, &O->key);
+}
+
+static void
+freeObject (struct object * O) {
+  __softboundcets_memory_deallocation (O->lock, O->key);
+  __softboundcets_check_remove_from_free_map (O->key, O->base);
+  free (O->base);
+}
+
+static int
+sameMetadata (const struct object * O, void * base, void * bound,
+              size_t key, void * lock) {
+  return (base == O->base) && (bound == O->bound) &&
+         (key == O->key) && (lock == O->lock);
+}
+
+//
+// Function: nested()
+//
+// Description:
+//  Push a frame holding the metadata of the thread's own object onto the
+//  shadow stack, recurse, and check that the frame is unchanged when the
+//  recursion returns.  Every frame also has a stack object with a key and
+//  lock from the thread's stack key/lock space.
+//
+static void
+nested (struct thread_info * T, unsigned depth) {
+  if (depth == 0)
+    return;
+
+  void * stack_lock;
+  size_t stack_key;
+  __softboundcets_stack_memory_allocation (&stack_lock, &stack_key);
+
+  __softboundcets_allocate_shadow_stack_space (2);
+  __softboundcets_store_base_shadow_stack (T->self.base, 1);
+  __softboundcets_store_bound_shadow_stack (T->self.bound, 1);
+  __softboundcets_store_key_shadow_stack (T->self.key, 1);
+  __softboundcets_store_lock_shadow_stack (T->self.lock, 1);
+
+  sched_yield ();
+  nested (T, depth - 1);
+
+  if (!sameMetadata (&T->self,
+                     __softboundcets_load_base_shadow_stack (1),
+                     __softboundcets_load_bound_shadow_stack (1),
+                     __softboundcets_load_key_shadow_stack (1),
+                     __softboundcets_load_lock_shadow_stack (1)))
+    fail (T->id, "shadow stack frame changed");
+  __softboundcets_deallocate_shadow_stack_space ();
+
+  if (*((size_t *) stack_lock) != stack_key)
+    fail (T->id, "stack key changed");
+  __softboundcets_temporal_load_dereference_check (stack_lock, stack_key,
+                                                   0, 0);
+  __softboundcets_stack_memory_deallocation (stack_key);
+}
+
+static void *
+run (void * arg) {
+  struct thread_info * T = (struct thread_info *) arg;
+
+  //
+  // The wrapper passes the metadata of the argument as the first pointer
+  // argument.
+  //
+  if (!sameMetadata (&T->self,
+                     __softboundcets_load_base_shadow_stack (1),
+                     __softboundcets_load_bound_shadow_stack (1),
+                     __softboundcets_load_key_shadow_stack (1),
+                     __softboundcets_load_lock_shadow_stack (1)))
+    fail (T->id, "wrong metadata for the thread argument");
+
+  // Record the spaces that __softboundcets_thread_fini() must release
+  T->shadow_stack = __softboundcets_shadow_stack_ptr;
+  T->stack_locks = __softboundcets_stack_temporal_space_begin;
+
+  nested (T, FRAMES);
+
+  //
+  // Store the metadata of private objects in the secondary tables that the
+  // other threads fill at the same time, then read it back.
+  //
+  struct object objects[OBJECTS];
+  for (unsigned index = 0; index < OBJECTS; ++index) {
+    newObject (&objects[index], 16 + index);
+    char * slot = region + (index % TABLES) * TABLE_SPAN +
+                  (T->id * OBJECTS + index) * sizeof (void *);
+    __softboundcets_metadata_store (slot, objects[index].base,
+                                    objects[index].bound, objects[index].key,
+                                    objects[index].lock);
+    if ((index % 8) == 0)
+      sched_yield ();
+  }
+
+  for (unsigned index = 0; index < OBJECTS; ++index) {
+    char * slot = region + (index % TABLES) * TABLE_SPAN +
+                  (T->id * OBJECTS + index) * sizeof (void *);
+    void * base;
+    void * bound;
+    size_t key;
+    void * lock;
+    __softboundcets_metadata_load (slot, &base, &bound, &key, &lock);
+    if (!sameMetadata (&objects[index], base, bound, key, lock))
+      fail (T->id, "wrong metadata for a private pointer");
+    __softboundcets_temporal_store_dereference_check (lock, key, base, bound);
+    __softboundcets_spatial_store_dereference_check (base, bound, base, 16);
+  }
+
+  //
+  // Read the metadata of the shared table.
+  //
+  for (unsigned index = 0; index < SHARED; ++index) {
+    void * base;
+    void * bound;
+    size_t key;
+    void * lock;
+    __softboundcets_metadata_load (&table[index], &base, &bound, &key, &lock);
+    if (!sameMetadata (&shared[index], base, bound, key, lock))
+      fail (T->id, "wrong metadata for a shared pointer");
+    __softboundcets_temporal_load_dereference_check (lock, key, base, bound);
+    __softboundcets_spatial_load_dereference_check (base, bound, table[index],
+                                                    1);
+  }
+
+  for (unsigned index = 0; index < OBJECTS; ++index)
+    freeObject (&objects[index]);
+
+  if (T->exit_early) {
+    __softboundcets_allocate_shadow_stack_space (1);
+    pthread_exit (0);
+  }
+  return 0;
+}
+
+//
+// Function: isMapped()
+//
+// Description:
+//  Determine whether the page containing the specified address is mapped.
+//
+static int
+isMapped (void * p) {
+  uintptr_t page = ((uintptr_t) p) & ~((uintptr_t) getpagesize () - 1);
+  return (msync ((void *) page, getpagesize (), MS_ASYNC) == 0) ||
+         (errno != ENOMEM);
+}
+
+int
+softboundcets_pseudo_main (int argc, char ** argv) {
+  region = mmap (0, TABLES * TABLE_SPAN, PROT_NONE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (region == MAP_FAILED) {
+    perror ("mmap");
+    return 1;
+  }
+
+  for (unsigned index = 0; index < SHARED; ++index) {
+    newObject (&shared[index], 32);
+    table[index] = shared[index].base + (index % 32);
+    __softboundcets_metadata_store (&table[index], shared[index].base,
+                                    shared[index].bound, shared[index].key,
+                                    shared[index].lock);
+  }
+
+  //
+  // The frame of the main thread must survive the other threads.
+  //
+  struct object mine;
+  newObject (&mine, 64);
+  __softboundcets_allocate_shadow_stack_space (2);
+  __softboundcets_store_base_shadow_stack (mine.base, 1);
+  __softboundcets_store_bound_shadow_stack (mine.bound, 1);
+  __softboundcets_store_key_shadow_stack (mine.key, 1);
+  __softboundcets_store_lock_shadow_stack (mine.lock, 1);
+
+  for (unsigned round = 0; round < ROUNDS; ++round) {
+    pthread_t threads[THREADS];
+    struct thread_info * info[THREADS];
+
+    for (unsigned index = 0; index < THREADS; ++index) {
+      struct thread_info * T = calloc (1, sizeof (struct thread_info));
+      T->id = round * THREADS + index;
+      T->exit_early = index % 2;
+      T->self.base = (char *) T;
+      T->self.bound = (char *) (T + 1);
+      __softboundcets_memory_allocation (T, &T->self.lock, &T->self.key);
+      info[index] = T;
+
+      //
+      // Pass the metadata of the argument to the wrapper in the fourth
+      // pointer argument, as instrumented code does.
+      //
+      __softboundcets_allocate_shadow_stack_space (5);
+      __softboundcets_store_base_shadow_stack (T->self.base, 4);
+      __softboundcets_store_bound_shadow_stack (T->self.bound, 4);
+      __softboundcets_store_key_shadow_stack (T->self.key, 4);
+      __softboundcets_store_lock_shadow_stack (T->self.lock, 4);
+      int error = softboundcets_pthread_create (&threads[index], 0, run, T);
+      __softboundcets_deallocate_shadow_stack_space ();
+      if (error) {
+        fprintf (stderr, "pthread_create: %d\n", error);
+        return 1;
+      }
+    }
+
+    for (unsigned index = 0; index < THREADS; ++index)
+      pthread_join (threads[index], 0);
+
+    for (unsigned index = 0; index < THREADS; ++index) {
+      struct thread_info * T = info[index];
+      if (isMapped (T->shadow_stack))
+        fail (T->id, "shadow stack not released");
+      if (isMapped (T->stack_locks))
+        fail (T->id, "stack key/lock space not released");
+      __softboundcets_memory_deallocation (T->self.lock, T->self.key);
+      __softboundcets_check_remove_from_free_map (T->self.key, T);
+      free (T);
+    }
+  }
+
+  if (!sameMetadata (&mine,
+                     __softboundcets_load_base_shadow_stack (1),
+                     __softboundcets_load_bound_shadow_stack (1),
+                     __softboundcets_load_key_shadow_stack (1),
+                     __softboundcets_load_lock_shadow_stack (1)))
+    fail (0, "shadow stack frame of the main thread changed");
+  __softboundcets_deallocate_shadow_stack_space ();
+
+  printf ("%u threads, %u failures\n", ROUNDS * THREADS, failures);
+  return failures != 0;
+}
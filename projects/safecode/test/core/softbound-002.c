@@ -0,0 +1,252 @@
+// RUN: test.sh -p -r softbound -C -D__SOFTBOUNDCETS_COMPACT_METADATA -t %t %s
+//
+// TEST: softbound-002
+//
+// Description:
+//  Test the compact metadata encoding of the SoftBound+CETS run-time.  The
+//  test stores the metadata of pointers whose bounds and locks fit in the
+//  compact trie entries and of pointers whose metadata must be kept in the
+//  overflow trie:
+//   - a bound that is 4GB or more above the base,
+//   - a bound below the base,
+//   - a lock whose index in the lock space does not fit in 32 bits, and
+//   - a lock that is not at a lock location.
+//  It checks that loads return the stored metadata, that only the entries
+//  that cannot be encoded are marked as overflowed, and that copying the
+//  metadata of an overflowed entry, both within one secondary table and
+//  across two of them, copies the overflow entry as well.
+//
+
+#include "softboundcets.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+// The size of the address range whose metadata is in one secondary table
+#define TABLE_SPAN (((size_t) 1) << 25)
+
+#define GB (((size_t) 1) << 30)
+
+struct metadata {
+  void * base;
+  void * bound;
+  size_t key;
+  void * lock;
+};
+
+static unsigned failures = 0;
+
+static void
+fail (unsigned line, const char * what) {
+  fprintf (stderr, "line %u: %s\n", line, what);
+  ++failures;
+}
+
+//
+// Function: entryOf()
+//
+// Description:
+//  Return the compact trie entry of the pointer stored at the address.
+//
+static __softboundcets_trie_entry_t *
+entryOf (void * addr) {
+  size_t ptr = (size_t) addr;
+  __softboundcets_trie_entry_t * table = __softboundcets_trie_lookup (ptr >> 25);
+  return table ? &table[(ptr >> 3) & 0x3fffff] : 0;
+}
+
+static void
+store (void * addr, struct metadata M) {
+  __softboundcets_metadata_store (addr, M.base, M.bound, M.key, M.lock);
+}
+
+//
+// Function: checkAt()
+//
+// Description:
+//  Check that the metadata of the pointer stored at the address is the
+//  expected metadata and that its compact entry is overflowed only if the
+//  metadata cannot be encoded.
+//
+static void
+checkAt (unsigned line, void * addr, struct metadata M, int overflowed) {
+  struct metadata L;
+  __softboundcets_metadata_load (addr, &L.base, &L.bound, &L.key, &L.lock);
+  if ((L.base != M.base) || (L.bound != M.bound) ||
+      (L.key != M.key) || (L.lock != M.lock))
+    fail (line, "wrong metadata");
+
+  __softboundcets_trie_entry_t * E = entryOf (addr);
+  if (!E)
+    fail (line, "no trie entry");
+  else if ((E->bound_offset == __SOFTBOUNDCETS_COMPACT_BOUND_OVERFLOW) !=
+           overflowed)
+    fail (line, overflowed ? "entry not overflowed" : "entry overflowed");
+}
+
+#define check(addr, M, overflowed) checkAt (__LINE__, addr, M, overflowed)
+
+int
+softboundcets_pseudo_main (int argc, char ** argv) {
+  __softboundcets_check_metadata_encoding (1);
+
+  //
+  // Reserve addresses to hold the pointers that span the boundary of two
+  // secondary tables.
+  //
+  char * region = mmap (0, 3 * TABLE_SPAN, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (region == MAP_FAILED) {
+    perror ("mmap");
+    return 1;
+  }
+  char * boundary = (char *) ((((uintptr_t) region) + TABLE_SPAN) &
+                              ~(TABLE_SPAN - 1));
+  void ** slots = (void **) (boundary - TABLE_SPAN / 2);
+
+  struct metadata object;
+  object.base = malloc (64);
+  object.bound = (char *) object.base + 64;
+  __softboundcets_memory_allocation (object.base, &object.lock, &object.key);
+
+  //
+  // Metadata that fits in a compact entry.
+  //
+  store (&slots[0], object);
+  check (&slots[0], object, 0);
+
+  struct metadata unbounded = { 0, (void *) __SOFTBOUNDCETS_INFINITE_BOUND,
+                                1, __softboundcets_global_lock };
+  store (&slots[1], unbounded);
+  check (&slots[1], unbounded, 0);
+
+  struct metadata empty = { 0, 0, 0, 0 };
+  store (&slots[2], empty);
+  check (&slots[2], empty, 0);
+
+  struct metadata largest = object;
+  largest.bound = (char *) largest.base + 0xfffffffdU;
+  store (&slots[3], largest);
+  check (&slots[3], largest, 0);
+
+  //
+  // Bounds that do not fit: the offsets that are reserved as markers and
+  // those of 4GB or more.
+  //
+  struct metadata bound = object;
+  bound.bound = (char *) bound.base + __SOFTBOUNDCETS_COMPACT_BOUND_UNBOUNDED;
+  store (&slots[4], bound);
+  check (&slots[4], bound, 1);
+
+  bound.bound = (char *) bound.base + __SOFTBOUNDCETS_COMPACT_BOUND_OVERFLOW;
+  store (&slots[5], bound);
+  check (&slots[5], bound, 1);
+
+  bound.bound = (char *) bound.base + 4 * GB;
+  store (&slots[6], bound);
+  check (&slots[6], bound, 1);
+  __softboundcets_spatial_load_dereference_check (bound.base, bound.bound,
+                                                  (char *) bound.base + 3 * GB,
+                                                  sizeof (size_t));
+
+  bound.bound = (char *) bound.base + 4 * GB + 64;
+  store (&slots[7], bound);
+  check (&slots[7], bound, 1);
+
+  struct metadata below = object;
+  below.base = (char *) object.base + 32;
+  below.bound = object.base;
+  store (&slots[8], below);
+  check (&slots[8], below, 1);
+
+  //
+  // Locks that do not fit: locks far above and below the lock space and a
+  // lock that is not at a lock location.
+  //
+  size_t * space = __softboundcets_temporal_space_begin;
+  struct metadata lock = object;
+  lock.lock = space + (((size_t) 1) << 31);
+  store (&slots[9], lock);
+  check (&slots[9], lock, 1);
+
+  lock.lock = space + (((size_t) 1) << 31) - 2;
+  store (&slots[10], lock);
+  check (&slots[10], lock, 0);
+
+  lock.lock = space - (((size_t) 1) << 32);
+  store (&slots[11], lock);
+  check (&slots[11], lock, 1);
+
+  lock.lock = (char *) object.lock + 4;
+  store (&slots[12], lock);
+  check (&slots[12], lock, 1);
+
+  //
+  // A compact store over an overflowed entry replaces it.
+  //
+  store (&slots[7], object);
+  check (&slots[7], object, 0);
+
+  //
+  // Copies of overflowed entries within a secondary table.  The copy must
+  // not alias the overflow entry of the source.
+  //
+  __softboundcets_copy_metadata (&slots[16], &slots[4], 9 * sizeof (void *));
+  bound.bound = (char *) bound.base + __SOFTBOUNDCETS_COMPACT_BOUND_UNBOUNDED;
+  check (&slots[16], bound, 1);
+  bound.bound = (char *) bound.base + __SOFTBOUNDCETS_COMPACT_BOUND_OVERFLOW;
+  check (&slots[17], bound, 1);
+  bound.bound = (char *) bound.base + 4 * GB;
+  check (&slots[18], bound, 1);
+  check (&slots[19], object, 0);
+  check (&slots[20], below, 1);
+  lock.lock = space + (((size_t) 1) << 31);
+  check (&slots[21], lock, 1);
+  lock.lock = space + (((size_t) 1) << 31) - 2;
+  check (&slots[22], lock, 0);
+  lock.lock = space - (((size_t) 1) << 32);
+  check (&slots[23], lock, 1);
+  lock.lock = (char *) object.lock + 4;
+  check (&slots[24], lock, 1);
+
+  store (&slots[6], object);
+  check (&slots[6], object, 0);
+  bound.bound = (char *) bound.base + 4 * GB;
+  check (&slots[18], bound, 1);
+
+  //
+  // Copies of overflowed entries across secondary tables: the source and
+  // the destination both straddle the boundary between two tables.
+  //
+  void ** before = (void **) boundary - 2;
+  store (&before[0], below);
+  store (&before[1], object);
+  store (&before[2], bound);
+  store (&before[3], lock);
+  check (&before[0], below, 1);
+  check (&before[2], bound, 1);
+
+  void ** copy = (void **) (boundary + TABLE_SPAN) - 1;
+  __softboundcets_copy_metadata (copy, before, 4 * sizeof (void *));
+  check (&copy[0], below, 1);
+  check (&copy[1], object, 0);
+  check (&copy[2], bound, 1);
+  check (&copy[3], lock, 1);
+
+  //
+  // Copies out of the overflow trie into addresses whose compact entries
+  // were overflowed before the copy.
+  //
+  __softboundcets_copy_metadata (&slots[8], &slots[0], 2 * sizeof (void *));
+  check (&slots[8], object, 0);
+  check (&slots[9], unbounded, 0);
+
+  __softboundcets_memory_deallocation (object.lock, object.key);
+  __softboundcets_check_remove_from_free_map (object.key, object.base);
+  free (object.base);
+
+  printf ("%u failures\n", failures);
+  return failures != 0;
+}
@@ -0,0 +1,38 @@
+// RUN: test.sh -e -t %t %s
+//
+// TEST: stack-001
+//
+// Description:
+//  Test that an overflow of one of several stack arrays in a recursive
+//  function is detected.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static char * escaped;
+
+int
+fill (int depth, int index) {
+  char first[16];
+  char second[32];
+  int third[8];
+
+  escaped = first;
+  escaped = second;
+  escaped = (char *) third;
+
+  first[depth % 16] = depth;
+  third[depth % 8] = depth;
+  if (depth)
+    return fill (depth - 1, index) + first[depth % 16] + third[depth % 8];
+
+  second[index] = 1;
+  return second[index];
+}
+
+int
+main (int argc, char ** argv) {
+  printf ("%d\n", fill (10, argc + 31));
+  return 0;
+}
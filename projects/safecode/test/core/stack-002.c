@@ -0,0 +1,46 @@
+// RUN: test.sh -p -t %t %s
+//
+// TEST: stack-002
+//
+// Description:
+//  Test that in-bounds accesses to several stack arrays in a recursive
+//  function are not flagged and that the arrays are unregistered on every
+//  return path.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static char * escaped;
+
+int
+fill (int depth, int index) {
+  char first[16];
+  char second[32];
+  int third[8];
+
+  escaped = first;
+  escaped = second;
+  escaped = (char *) third;
+
+  first[index % 16] = depth;
+  second[index % 32] = depth;
+  third[index % 8] = depth;
+  if (depth & 1)
+    return first[index % 16] + second[index % 32];
+  if (depth)
+    return fill (depth - 1, index + 1) + third[index % 8];
+  return 0;
+}
+
+int
+main (int argc, char ** argv) {
+  int sum = 0;
+  int depth;
+
+  for (depth = 0; depth < 100; ++depth)
+    sum += fill (depth, argc);
+
+  printf ("%d\n", sum);
+  return 0;
+}
@@ -0,0 +1,97 @@
+// RUN: env SCTHREADSAFE=1 test.sh -p -t %t -l -lpthread %s
+//
+// TEST: threads-001
+//
+// Description:
+//  Stress test of the thread-safe run-time.  Each thread repeatedly allocates
+//  objects, checks in-bounds accesses to them and to a shared set of objects,
+//  and frees them again.  No check should fail.
+//
+//  The heap objects of all threads are in one pool, so every allocation and
+//  deallocation modifies the object set that every check searches.  The test
+//  records how the checks scale: for 1, 2, 4, 8, 16, and 32 threads it prints
+//  the check throughput and its ratio to the throughput of one thread, and it
+//  ends with a line listing the ratios.  Lookups only wait for writers that
+//  modify the same pages, so the ratios should grow with the number of
+//  threads up to the number of processors.
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#define SHARED  256
+#define PRIVATE 64
+#define ROUNDS  200
+
+static char * shared[SHARED];
+
+static void *
+worker (void * arg) {
+  unsigned seed = (unsigned) (unsigned long) arg;
+  long sum = 0;
+  int round;
+  int index;
+
+  for (round = 0; round < ROUNDS; ++round) {
+    char * objs[PRIVATE];
+
+    for (index = 0; index < PRIVATE; ++index) {
+      objs[index] = malloc (16 + (index % 8) * 16);
+      objs[index][15] = index;
+    }
+
+    for (index = 0; index < PRIVATE * 8; ++index) {
+      seed = seed * 1103515245 + 12345;
+      char * obj = shared[(seed >> 8) % SHARED];
+      sum += obj[(seed >> 4) % 32] + objs[index % PRIVATE][15];
+    }
+
+    for (index = 0; index < PRIVATE; ++index)
+      free (objs[index]);
+  }
+
+  return (void *) sum;
+}
+
+static double
+now (void) {
+  struct timeval tv;
+  gettimeofday (&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int
+main (int argc, char ** argv) {
+  pthread_t threads[32];
+  double rates[6];
+  int nthreads;
+  int step;
+  int index;
+
+  for (index = 0; index < SHARED; ++index)
+    shared[index] = calloc (32, 1);
+
+  for (step = 0, nthreads = 1; nthreads <= 32; ++step, nthreads *= 2) {
+    double start = now ();
+    for (index = 0; index < nthreads; ++index)
+      pthread_create (&threads[index], 0, worker, (void *) (long) index);
+    for (index = 0; index < nthreads; ++index)
+      pthread_join (threads[index], 0);
+    double elapsed = now () - start;
+    double accesses = (double) nthreads * ROUNDS * PRIVATE * 8 * 2;
+    rates[step] = accesses / elapsed;
+    printf ("threads %d accesses/sec %.0f scaling %.2f\n",
+            nthreads, rates[step], rates[step] / rates[0]);
+  }
+
+  printf ("scaling");
+  for (step = 0, nthreads = 1; nthreads <= 32; ++step, nthreads *= 2)
+    printf (" %d:%.2f", nthreads, rates[step] / rates[0]);
+  printf ("\n");
+
+  for (index = 0; index < SHARED; ++index)
+    free (shared[index]);
+  return 0;
+}
@@ -0,0 +1,56 @@
+; RUN: scopt -compchecks -sc-inline-funccheck-limit=3 -S %s \
+; RUN:   | FileCheck --check-prefix=INLINE %s
+; RUN: scopt -compchecks -sc-inline-funccheck-limit=1 \
+; RUN:   -sc-sorted-funccheck-limit=2 -S %s \
+; RUN:   | FileCheck --check-prefix=SET %s
+;
+; Test that a check of an indirect call with no more targets than
+; -sc-inline-funccheck-limit compares the function pointer with each target
+; inline and only calls funccheck() when none of them match, and that a check
+; with at least -sc-sorted-funccheck-limit targets calls funccheck_set() with
+; a TargetSet of the targets.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@table = internal constant [3 x void ()*] [void ()* @f1, void ()* @f2, void ()* @f3]
+
+declare void @funccheck(i8*, i8*)
+
+define internal void @f1() {
+  ret void
+}
+
+define internal void @f2() {
+  ret void
+}
+
+define internal void @f3() {
+  ret void
+}
+
+; INLINE-NOT: @TargetSet
+; INLINE-LABEL: define void @dispatch(
+; INLINE-DAG: icmp eq i8* %fp.cast, bitcast (void ()* @f1 to i8*)
+; INLINE-DAG: icmp eq i8* %fp.cast, bitcast (void ()* @f2 to i8*)
+; INLINE-DAG: icmp eq i8* %fp.cast, bitcast (void ()* @f3 to i8*)
+; INLINE: br i1 %funccheck.match{{[0-9]*}}, label %{{.*}}, label %funccheck.fail
+; INLINE: funccheck.fail:
+; INLINE-NEXT: call void @funccheck(i8* %fp.cast, i8* {{.*}}@TargetList
+; INLINE-NOT: @funccheck_set
+;
+; SET: @TargetSet = internal global { i64, i64, [6 x i8*] } { i64 3, i64 0,
+; SET-LABEL: define void @dispatch(
+; SET-NOT: icmp eq i8* %fp.cast
+; SET: call void @funccheck_set(i8* %fp.cast, i8* bitcast ({ i64, i64, [6 x i8*] }* @TargetSet to i8*))
+; SET-NEXT: call void %fp()
+; SET-NOT: call void @funccheck(
+define void @dispatch(i64 %i) {
+entry:
+  %slot = getelementptr inbounds [3 x void ()*], [3 x void ()*]* @table, i64 0, i64 %i
+  %fp = load void ()*, void ()** %slot
+  %fp.cast = bitcast void ()* %fp to i8*
+  call void @funccheck(i8* %fp.cast, i8* null)
+  call void %fp()
+  ret void
+}
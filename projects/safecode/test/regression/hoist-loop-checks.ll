@@ -0,0 +1,140 @@
+; RUN: scopt -sc-hoist-loop-checks -S %s | FileCheck %s
+;
+; Test that bounds checks of pointers that advance by a fixed stride are
+; replaced with checks of the first and last pointers in the loop preheader,
+; and that checks that are not performed on every iteration, checks against
+; a different object on each iteration, and checks in loops that may free
+; memory stay in the loop.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare i8* @boundscheckui(i8*, i8*, i8*)
+declare void @free(i8*)
+
+; The check of %p is performed on every iteration; it is replaced by checks
+; of %buf and of the pointer of the last iteration.
+;
+; CHECK-LABEL: @hoisted(
+; CHECK: ph:
+; CHECK-NEXT: call i8* @boundscheckui(i8* %pool, i8* %buf, i8* %buf)
+; CHECK: call i8* @boundscheckui(i8* %pool, i8* %buf, i8* {{%[^ ]+}})
+; CHECK-NEXT: br label %loop
+; CHECK: loop:
+; CHECK-NOT: @boundscheckui
+; CHECK: ret void
+define void @hoisted(i8* %pool, i8* %buf, i64 %n) {
+entry:
+  %nonempty = icmp sgt i64 %n, 0
+  br i1 %nonempty, label %ph, label %exit
+
+ph:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %ph ], [ %inc, %loop ]
+  %p = getelementptr inbounds i8, i8* %buf, i64 %i
+  call i8* @boundscheckui(i8* %pool, i8* %buf, i8* %p)
+  store i8 0, i8* %p
+  %inc = add nsw i64 %i, 1
+  %more = icmp slt i64 %inc, %n
+  br i1 %more, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; The check is only performed on even iterations.
+;
+; CHECK-LABEL: @conditional(
+; CHECK: ph:
+; CHECK-NOT: @boundscheckui
+; CHECK: then:
+; CHECK-NEXT: call i8* @boundscheckui(i8* %pool, i8* %buf, i8* %p)
+define void @conditional(i8* %pool, i8* %buf, i64 %n) {
+entry:
+  %nonempty = icmp sgt i64 %n, 0
+  br i1 %nonempty, label %ph, label %exit
+
+ph:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %ph ], [ %inc, %latch ]
+  %p = getelementptr inbounds i8, i8* %buf, i64 %i
+  %odd = and i64 %i, 1
+  %even = icmp eq i64 %odd, 0
+  br i1 %even, label %then, label %latch
+
+then:
+  call i8* @boundscheckui(i8* %pool, i8* %buf, i8* %p)
+  store i8 0, i8* %p
+  br label %latch
+
+latch:
+  %inc = add nsw i64 %i, 1
+  %more = icmp slt i64 %inc, %n
+  br i1 %more, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; The object whose bounds are checked is loaded on each iteration.
+;
+; CHECK-LABEL: @varying(
+; CHECK: ph:
+; CHECK-NOT: @boundscheckui
+; CHECK: loop:
+; CHECK: call i8* @boundscheckui(i8* %pool, i8* %obj, i8* %p)
+define void @varying(i8* %pool, i8** %objs, i64 %n) {
+entry:
+  %nonempty = icmp sgt i64 %n, 0
+  br i1 %nonempty, label %ph, label %exit
+
+ph:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %ph ], [ %inc, %loop ]
+  %slot = getelementptr inbounds i8*, i8** %objs, i64 %i
+  %obj = load i8*, i8** %slot
+  %p = getelementptr inbounds i8, i8* %obj, i64 4
+  call i8* @boundscheckui(i8* %pool, i8* %obj, i8* %p)
+  store i8 0, i8* %p
+  %inc = add nsw i64 %i, 1
+  %more = icmp slt i64 %inc, %n
+  br i1 %more, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; The loop may free the object that is checked.
+;
+; CHECK-LABEL: @frees(
+; CHECK: ph:
+; CHECK-NOT: @boundscheckui
+; CHECK: loop:
+; CHECK: call i8* @boundscheckui(i8* %pool, i8* %buf, i8* %p)
+define void @frees(i8* %pool, i8* %buf, i8* %other, i64 %n) {
+entry:
+  %nonempty = icmp sgt i64 %n, 0
+  br i1 %nonempty, label %ph, label %exit
+
+ph:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %ph ], [ %inc, %loop ]
+  %p = getelementptr inbounds i8, i8* %buf, i64 %i
+  call i8* @boundscheckui(i8* %pool, i8* %buf, i8* %p)
+  store i8 0, i8* %p
+  call void @free(i8* %other)
+  %inc = add nsw i64 %i, 1
+  %more = icmp slt i64 %inc, %n
+  br i1 %more, label %loop, label %exit
+
+exit:
+  ret void
+}
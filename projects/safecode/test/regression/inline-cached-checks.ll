@@ -0,0 +1,73 @@
+; RUN: scopt -inline-fastchecks -inline-cached-checks -S %s | FileCheck %s
+; RUN: scopt -inline-fastchecks -S %s | FileCheck --check-prefix=OFF %s
+;
+; Test that -inline-cached-checks gives each poolcheck() and boundscheck() call
+; a thread-local cache with the layout of the run-times' SiteCache structure,
+; tests the checked pointers against the cached object inline, and only calls
+; the run-time and refills the cache on a miss.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare void @poolcheck(i8*, i8*, i32)
+declare i8* @boundscheck(i8*, i8*, i8*)
+
+; CHECK: @sc.sitecache = internal thread_local global { i8*, i8*, i8*, i64 } zeroinitializer
+; CHECK: @sc.sitecache{{[0-9]+}} = internal thread_local global { i8*, i8*, i8*, i64 } zeroinitializer
+; OFF-NOT: sc.sitecache
+
+; A load/store check hits if the pool and epoch match and all of the accessed
+; bytes are within the cached object.
+;
+; CHECK-LABEL: @ls(
+; CHECK: load atomic i64, i64* @__sc_site_cache_epoch monotonic
+; CHECK: icmp eq i8* %{{[0-9]+}}, %pool
+; CHECK: icmp eq i64
+; CHECK: [[PTR:%[0-9]+]] = ptrtoint i8* %p to i64
+; CHECK: [[END:%[0-9]+]] = add i64 [[PTR]], 4
+; CHECK: icmp ule i64 %{{[0-9]+}}, [[PTR]]
+; CHECK: icmp ule i64 [[PTR]], [[END]]
+; CHECK: icmp ule i64 [[END]], %{{[0-9]+}}
+; CHECK: br i1 %{{[0-9]+}}, label %cache.cont, label %cache.miss
+; CHECK: {{^}}cache.miss:
+; CHECK-NEXT: call void @poolcheck(i8* %pool, i8* %p, i32 4)
+; CHECK-NEXT: call void @__sc_fill_site_cache(i8* %pool, i8* %p, { i8*, i8*, i8*, i64 }* @sc.sitecache
+; CHECK: {{^}}cache.cont:
+; CHECK-NEXT: store i32 0
+;
+; OFF-LABEL: @ls(
+; OFF-NEXT: entry:
+; OFF-NEXT: call void @poolcheck(i8* %pool, i8* %p, i32 4)
+define void @ls(i8* %pool, i8* %p) {
+entry:
+  call void @poolcheck(i8* %pool, i8* %p, i32 4)
+  %q = bitcast i8* %p to i32*
+  store i32 0, i32* %q
+  ret void
+}
+
+; A bounds check hits if both the source and the destination are within the
+; cached object; its result is then the destination.
+;
+; CHECK-LABEL: @bounds(
+; CHECK: load atomic i64, i64* @__sc_site_cache_epoch monotonic
+; CHECK: [[SRC:%[0-9]+]] = ptrtoint i8* %src to i64
+; CHECK: [[DEST:%[0-9]+]] = ptrtoint i8* %d to i64
+; CHECK: icmp ule i64 %{{[0-9]+}}, [[SRC]]
+; CHECK: icmp ult i64 [[SRC]], %{{[0-9]+}}
+; CHECK: icmp ule i64 %{{[0-9]+}}, [[DEST]]
+; CHECK: icmp ult i64 [[DEST]], %{{[0-9]+}}
+; CHECK: br i1 %{{[0-9]+}}, label %cache.cont, label %cache.miss
+; CHECK: {{^}}cache.miss:
+; CHECK-NEXT: %r = call i8* @boundscheck(i8* %pool, i8* %src, i8* %d)
+; CHECK-NEXT: call void @__sc_fill_site_cache(i8* %pool, i8* %src, { i8*, i8*, i8*, i64 }* @sc.sitecache
+; CHECK: {{^}}cache.cont:
+; CHECK-NEXT: [[RESULT:%[0-9]+]] = phi i8* [ %d, %entry ], [ %r, %cache.miss ]
+; CHECK-NEXT: store i8 0, i8* [[RESULT]]
+define void @bounds(i8* %pool, i8* %src, i64 %i) {
+entry:
+  %d = getelementptr i8, i8* %src, i64 %i
+  %r = call i8* @boundscheck(i8* %pool, i8* %src, i8* %d)
+  store i8 0, i8* %r
+  ret void
+}
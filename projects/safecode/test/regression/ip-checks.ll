@@ -0,0 +1,79 @@
+; RUN: scopt -sc-ip-checks -S %s | FileCheck %s
+; RUN: scopt -sc-ip-checks -sc-specialize-safe-callers -S %s \
+; RUN:   | FileCheck --check-prefix=SPEC %s
+;
+; Test that the checks on an argument of an internal function are removed
+; when every call passes a stack object or global variable large enough for
+; all of the checks, and that they are kept when one call passes a smaller
+; object or when the function may be called from elsewhere.  With
+; -sc-specialize-safe-callers, the calls that pass large enough objects call a
+; copy of the function without the checks.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@g = internal global [8 x i8] zeroinitializer
+
+declare void @poolcheck(i8*, i8*, i64)
+
+; Both calls pass at least the 8 bytes that the checks need.
+;
+; CHECK-LABEL: define internal void @fill(
+; CHECK-NOT: @poolcheck
+; CHECK: ret void
+define internal void @fill(i8* %pool, i8* %a) {
+entry:
+  call void @poolcheck(i8* %pool, i8* %a, i64 4)
+  store i8 0, i8* %a
+  %a4 = getelementptr inbounds i8, i8* %a, i64 4
+  call void @poolcheck(i8* %pool, i8* %a4, i64 4)
+  store i8 0, i8* %a4
+  ret void
+}
+
+; One call passes a 4 byte object.
+;
+; CHECK-LABEL: define internal void @partial(
+; CHECK: call void @poolcheck(i8* %pool, i8* %a, i64 4)
+; CHECK: call void @poolcheck(i8* %pool, i8* %a4, i64 4)
+define internal void @partial(i8* %pool, i8* %a) {
+entry:
+  call void @poolcheck(i8* %pool, i8* %a, i64 4)
+  store i8 0, i8* %a
+  %a4 = getelementptr inbounds i8, i8* %a, i64 4
+  call void @poolcheck(i8* %pool, i8* %a4, i64 4)
+  store i8 0, i8* %a4
+  ret void
+}
+
+; The function can be called from other modules.
+;
+; CHECK-LABEL: define void @exported(
+; CHECK: call void @poolcheck(i8* %pool, i8* %a, i64 4)
+define void @exported(i8* %pool, i8* %a) {
+entry:
+  call void @poolcheck(i8* %pool, i8* %a, i64 4)
+  store i8 0, i8* %a
+  ret void
+}
+
+; SPEC-LABEL: define void @caller(
+; SPEC: call void @fill(i8* %pool, i8* %big0)
+; SPEC: call void @partial.sc.safe(i8* %pool, i8* %big0)
+; SPEC: call void @partial(i8* %pool, i8* %small0)
+; SPEC-LABEL: define internal void @partial.sc.safe(
+; SPEC-NOT: @poolcheck
+; SPEC: ret void
+define void @caller(i8* %pool) {
+entry:
+  %big = alloca [16 x i8]
+  %small = alloca [4 x i8]
+  %big0 = getelementptr inbounds [16 x i8], [16 x i8]* %big, i64 0, i64 0
+  %small0 = getelementptr inbounds [4 x i8], [4 x i8]* %small, i64 0, i64 0
+  call void @fill(i8* %pool, i8* %big0)
+  call void @fill(i8* %pool, i8* getelementptr inbounds ([8 x i8], [8 x i8]* @g, i64 0, i64 0))
+  call void @partial(i8* %pool, i8* %big0)
+  call void @partial(i8* %pool, i8* %small0)
+  call void @exported(i8* %pool, i8* %big0)
+  ret void
+}
@@ -0,0 +1,86 @@
+; RUN: scopt -sc-profile-checks -S %s | FileCheck %s
+; RUN: scopt -sc-check-report -sc-profile-checks -sc-check-report \
+; RUN:   -disable-output %s 2>&1 | FileCheck --check-prefix=REPORT %s
+;
+; Test that -sc-profile-checks replaces the checks of a stack object of known
+; size on a hot path with fastlscheck() and exactcheck2(), that the debug
+; versions of the new checks keep the tag and source location of the checks
+; that they replace, and that checks on cold paths and checks of objects of
+; unknown size are left alone.  There is no profile, so the branch weights
+; decide which blocks are hot: %hot runs on 1000 of 1001 calls and %cold on
+; one, which is below the default threshold of 1% of the highest count.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@file = private unnamed_addr constant [7 x i8] c"test.c\00"
+
+declare void @poolcheck(i8*, i8*, i32)
+declare void @poolcheck_debug(i8*, i8*, i32, i32, i8*, i32)
+declare i8* @boundscheck(i8*, i8*, i8*)
+declare i8* @boundscheck_debug(i8*, i8*, i8*, i32, i8*, i32)
+
+; CHECK-LABEL: @checks(
+; CHECK: hot:
+; CHECK-NOT: call void @poolcheck(i8* %pool, i8* %p, i32 4)
+; CHECK: call void @fastlscheck(i8* {{%[^,]+}}, i8* {{%[^,]+}}, i32 64, i32 4)
+; CHECK-NOT: call void @poolcheck_debug(
+; CHECK: call void @fastlscheck_debug(i8* {{%[^,]+}}, i8* {{%[^,]+}}, i32 64, i32 4, i32 5, i8* getelementptr inbounds ([7 x i8], [7 x i8]* @file, i64 0, i64 0), i32 10)
+; CHECK-NOT: call i8* @boundscheck_debug(
+; CHECK: [[Q:%[^ ]+]] = call i8* @exactcheck2_debug(i8* {{%[^,]+}}, i8* {{%[^,]+}}, i8* {{%[^,]+}}, i32 64, i32 6, i8* getelementptr inbounds ([7 x i8], [7 x i8]* @file, i64 0, i64 0), i32 11)
+; CHECK: bitcast i8* [[Q]] to i32*
+; CHECK-NOT: call i8* @boundscheck(
+; CHECK: call i8* @exactcheck2(i8* {{%[^,]+}}, i8* {{%[^,]+}}, i8* {{%[^,]+}}, i32 64)
+; CHECK: call void @poolcheck(i8* %pool, i8* %heap, i32 4)
+; CHECK: cold:
+; CHECK-NEXT: call void @poolcheck(i8* %pool, i8* %p, i32 4)
+; CHECK-NEXT: call i8* @boundscheck_debug(i8* %pool, i8* %b, i8* %q, i32 7, i8* getelementptr inbounds ([7 x i8], [7 x i8]* @file, i64 0, i64 0), i32 20)
+; CHECK-NOT: @fastlscheck
+; CHECK-NOT: @exactcheck2
+; CHECK: ret void
+define void @checks(i8* %pool, i8* %heap, i1 %c) {
+entry:
+  %buf = alloca [16 x i32]
+  %b = bitcast [16 x i32]* %buf to i8*
+  %p = getelementptr inbounds i8, i8* %b, i64 8
+  %q = getelementptr inbounds i8, i8* %b, i64 12
+  br i1 %c, label %hot, label %cold, !prof !0
+
+hot:
+  call void @poolcheck(i8* %pool, i8* %p, i32 4)
+  call void @poolcheck_debug(i8* %pool, i8* %p, i32 4, i32 5, i8* getelementptr inbounds ([7 x i8], [7 x i8]* @file, i64 0, i64 0), i32 10)
+  %q.d = call i8* @boundscheck_debug(i8* %pool, i8* %b, i8* %q, i32 6, i8* getelementptr inbounds ([7 x i8], [7 x i8]* @file, i64 0, i64 0), i32 11)
+  %q.i = bitcast i8* %q.d to i32*
+  store i32 0, i32* %q.i
+  %q.c = call i8* @boundscheck(i8* %pool, i8* %b, i8* %q)
+  call void @poolcheck(i8* %pool, i8* %heap, i32 4)
+  br label %done
+
+cold:
+  call void @poolcheck(i8* %pool, i8* %p, i32 4)
+  %q.cold = call i8* @boundscheck_debug(i8* %pool, i8* %b, i8* %q, i32 7, i8* getelementptr inbounds ([7 x i8], [7 x i8]* @file, i64 0, i64 0), i32 20)
+  br label %done
+
+done:
+  ret void
+}
+
+; The report before the conversion counts the original checks; the report
+; after it counts the same number of checks, five of which are now fast.
+;
+; REPORT: SAFECode estimated check executions per call, no profile
+; REPORT: {{^ *}}1 {{[0-9]+}} - boundscheck{{$}}
+; REPORT-NEXT: {{^ *}}2 {{[0-9]+}} - boundscheck_debug{{$}}
+; REPORT-NEXT: {{^ *}}3 {{[0-9]+}} - poolcheck{{$}}
+; REPORT-NEXT: {{^ *}}1 {{[0-9]+}} - poolcheck_debug{{$}}
+; REPORT-NEXT: {{^ *}}7 {{[0-9]+}} - total
+; REPORT: SAFECode estimated check executions per call, no profile
+; REPORT: {{^ *}}1 {{[0-9]+}} - boundscheck_debug{{$}}
+; REPORT-NEXT: {{^ *}}1 {{[0-9]+}} - exactcheck2{{$}}
+; REPORT-NEXT: {{^ *}}1 {{[0-9]+}} - exactcheck2_debug{{$}}
+; REPORT-NEXT: {{^ *}}1 {{[0-9]+}} - fastlscheck{{$}}
+; REPORT-NEXT: {{^ *}}1 {{[0-9]+}} - fastlscheck_debug{{$}}
+; REPORT-NEXT: {{^ *}}2 {{[0-9]+}} - poolcheck{{$}}
+; REPORT-NEXT: {{^ *}}7 {{[0-9]+}} - total
+
+!0 = !{!"branch_weights", i32 1000, i32 1}
@@ -0,0 +1,84 @@
+; RUN: scopt -basicaa -sc-redundant-checks -S %s | FileCheck %s
+;
+; Test that a check is removed when a check of a range that contains its range
+; is performed on every path reaching it, and that it is kept when one path
+; does not perform such a check, when the range is not contained, or when the
+; object may have been freed in between.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare void @poolcheck(i8*, i8*, i64)
+declare void @free(i8*)
+declare void @opaque()
+
+; The second check of %p and the check of the range [%p + 4, %p + 8) are
+; implied by the first check; the check of [%p + 4, %p + 12) is not.
+;
+; CHECK-LABEL: @contained(
+; CHECK: call void @poolcheck(i8* %pool, i8* %p, i64 8)
+; CHECK-NOT: call void @poolcheck(i8* %pool, i8* %p, i64 8)
+; CHECK-NOT: call void @poolcheck(i8* %pool, i8* %q, i64 4)
+; CHECK: call void @poolcheck(i8* %pool, i8* %q, i64 8)
+; CHECK: ret void
+define void @contained(i8* %pool, i8* %p) {
+entry:
+  call void @poolcheck(i8* %pool, i8* %p, i64 8)
+  call void @poolcheck(i8* %pool, i8* %p, i64 8)
+  %q = getelementptr inbounds i8, i8* %p, i64 4
+  call void @poolcheck(i8* %pool, i8* %q, i64 4)
+  call void @poolcheck(i8* %pool, i8* %q, i64 8)
+  ret void
+}
+
+; The check in %join is only implied on the path through %then.  The check in
+; %else is implied by the check in %entry.
+;
+; CHECK-LABEL: @paths(
+; CHECK: entry:
+; CHECK-NEXT: call void @poolcheck(i8* %pool, i8* %p, i64 4)
+; CHECK: then:
+; CHECK-NEXT: call void @poolcheck(i8* %pool, i8* %q, i64 4)
+; CHECK: else:
+; CHECK-NOT: @poolcheck
+; CHECK: join:
+; CHECK-NEXT: call void @poolcheck(i8* %pool, i8* %q, i64 4)
+define void @paths(i8* %pool, i8* %p, i8* %q, i1 %c) {
+entry:
+  call void @poolcheck(i8* %pool, i8* %p, i64 4)
+  br i1 %c, label %then, label %else
+
+then:
+  call void @poolcheck(i8* %pool, i8* %q, i64 4)
+  br label %join
+
+else:
+  call void @poolcheck(i8* %pool, i8* %p, i64 4)
+  br label %join
+
+join:
+  call void @poolcheck(i8* %pool, i8* %q, i64 4)
+  ret void
+}
+
+; Freeing %p invalidates the check of %p.  A call to an unknown function may
+; free %p as well, but it cannot free the stack object %buf.
+;
+; CHECK-LABEL: @freed(
+; CHECK: call void @poolcheck(i8* %pool, i8* %p, i64 4)
+; CHECK-NEXT: call void @free(i8* %p)
+; CHECK-NEXT: call void @poolcheck(i8* %pool, i8* %p, i64 4)
+; CHECK: call void @poolcheck(i8* %pool, i8* %buf, i64 4)
+; CHECK-NEXT: call void @opaque()
+; CHECK-NEXT: ret void
+define void @freed(i8* %pool, i8* %p) {
+entry:
+  %buf = alloca i8, i64 4
+  call void @poolcheck(i8* %pool, i8* %p, i64 4)
+  call void @free(i8* %p)
+  call void @poolcheck(i8* %pool, i8* %p, i64 4)
+  call void @poolcheck(i8* %pool, i8* %buf, i64 4)
+  call void @opaque()
+  call void @poolcheck(i8* %pool, i8* %buf, i64 4)
+  ret void
+}
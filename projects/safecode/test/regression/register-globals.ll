@@ -0,0 +1,24 @@
+; RUN: scopt -reg-globals -S %s | FileCheck %s
+;
+; Test that the global variables are listed in a constant table in the
+; sc_globals section with a null pool, their addresses, and their sizes, and
+; that sc.register_globals() passes the whole table to the run-time with one
+; call.  Globals in llvm.* and tables that are already registered are left
+; out.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@buf = internal global [16 x i8] zeroinitializer
+@count = global i32 0
+@llvm.used = appending global [1 x i8*] [i8* bitcast (i32* @count to i8*)], section "llvm.metadata"
+
+; CHECK: @sc.registered_globals = internal constant [2 x { i8*, i8*, i32 }]
+; CHECK-SAME: { i8* null, i8* {{.*}}@buf{{.*}}, i32 16 }
+; CHECK-SAME: { i8* null, i8* bitcast (i32* @count to i8*), i32 4 }
+; CHECK-SAME: section "sc_globals"
+;
+; CHECK-LABEL: define {{.*}}@sc.register_globals()
+; CHECK: call void @pool_register_globals(i8* bitcast ([2 x { i8*, i8*, i32 }]* @sc.registered_globals to i8*), i32 2)
+; CHECK-NOT: @pool_register_global(
+; CHECK: ret void
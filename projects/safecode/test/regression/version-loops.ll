@@ -0,0 +1,124 @@
+; RUN: scopt -sc-version-loops -S %s > %t
+; RUN: FileCheck %s < %t
+; RUN: FileCheck --check-prefix=FAST %s < %t
+; RUN: FileCheck --check-prefix=CHECKED %s < %t
+;
+; Test that a loop whose checks can be tested in its preheader is versioned:
+; the loop run when the tests pass has no checks, and the copy run when they
+; fail keeps them.  Loops that may free memory and checks of objects loaded in
+; the loop are left alone.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare void @poolcheck(i8*, i8*, i64)
+declare void @free(i8*)
+
+; The check is only performed on even iterations, but it can still be tested
+; in the preheader.
+;
+; CHECK-LABEL: @versioned(
+; CHECK: loop.sc.test:
+; CHECK: call void @__sc_fill_site_cache(i8* %pool, i8* %buf,
+; CHECK: br i1 %sc.safe{{[0-9]*}}, label %loop.sc.ph, label %loop.sc.ph.sc.checked
+;
+; FAST-LABEL: @versioned(
+; FAST: {{^}}then:
+; FAST-NEXT: store i8 0, i8* %p
+;
+; CHECKED-LABEL: @versioned(
+; CHECKED: {{^}}then.sc.checked:
+; CHECKED-NEXT: call void @poolcheck(i8* %pool, i8* %p.sc.checked, i64 1)
+define void @versioned(i8* %pool, i8* %buf, i64 %n) {
+entry:
+  %nonempty = icmp sgt i64 %n, 0
+  br i1 %nonempty, label %ph, label %exit
+
+ph:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %ph ], [ %inc, %latch ]
+  %p = getelementptr inbounds i8, i8* %buf, i64 %i
+  %odd = and i64 %i, 1
+  %even = icmp eq i64 %odd, 0
+  br i1 %even, label %then, label %latch
+
+then:
+  call void @poolcheck(i8* %pool, i8* %p, i64 1)
+  store i8 0, i8* %p
+  br label %latch
+
+latch:
+  %inc = add nsw i64 %i, 1
+  %more = icmp slt i64 %inc, %n
+  br i1 %more, label %loop, label %done
+
+done:
+  br label %exit
+
+exit:
+  ret void
+}
+
+; The loop may free the checked object.
+;
+; CHECK-LABEL: @frees(
+; CHECK-NOT: __sc_fill_site_cache
+; CHECK: call void @poolcheck(i8* %pool, i8* %p, i64 1)
+; CHECK: ret void
+define void @frees(i8* %pool, i8* %buf, i8* %other, i64 %n) {
+entry:
+  %nonempty = icmp sgt i64 %n, 0
+  br i1 %nonempty, label %ph, label %exit
+
+ph:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %ph ], [ %inc, %loop ]
+  %p = getelementptr inbounds i8, i8* %buf, i64 %i
+  call void @poolcheck(i8* %pool, i8* %p, i64 1)
+  store i8 0, i8* %p
+  call void @free(i8* %other)
+  %inc = add nsw i64 %i, 1
+  %more = icmp slt i64 %inc, %n
+  br i1 %more, label %loop, label %done
+
+done:
+  br label %exit
+
+exit:
+  ret void
+}
+
+; The checked object is loaded on each iteration.
+;
+; CHECK-LABEL: @varying(
+; CHECK-NOT: __sc_fill_site_cache
+; CHECK: call void @poolcheck(i8* %pool, i8* %obj, i64 1)
+; CHECK: ret void
+define void @varying(i8* %pool, i8** %objs, i64 %n) {
+entry:
+  %nonempty = icmp sgt i64 %n, 0
+  br i1 %nonempty, label %ph, label %exit
+
+ph:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %ph ], [ %inc, %loop ]
+  %slot = getelementptr inbounds i8*, i8** %objs, i64 %i
+  %obj = load i8*, i8** %slot
+  call void @poolcheck(i8* %pool, i8* %obj, i64 1)
+  store i8 0, i8* %obj
+  %inc = add nsw i64 %i, 1
+  %more = icmp slt i64 %inc, %n
+  br i1 %more, label %loop, label %done
+
+done:
+  br label %exit
+
+exit:
+  ret void
+}
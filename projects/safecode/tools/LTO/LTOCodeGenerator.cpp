@@ -50,8 +50,14 @@
 #include "poolalloc/RunTimeAssociate.h"
 
 #include "safecode/CompleteChecks.h"
+#include "safecode/CheckProfile.h"
+#include "safecode/HoistLoopChecks.h"
+#include "safecode/IPCheckElimination.h"
+#include "safecode/LoopVersionChecks.h"
+#include "safecode/RedundantChecks.h"
 #include "safecode/LowerSafecodeIntrinsic.h"
 #include "safecode/OptimizeChecks.h"
+#include "safecode/PhaseTimer.h"
 #include "safecode/SAFECodeMSCInfo.h"
 #include "safecode/SafeLoadStoreOpts.h"
 
@@ -75,6 +81,10 @@ static cl::opt<bool>
 DisableGVNLoadPRE("disable-gvn-loadpre", cl::init(false),
   cl::desc("Do not run the GVN load PRE pass"));
 
+static cl::opt<bool>
+ReportChecks("sc-report-checks", cl::init(false),
+  cl::desc("Report the estimated number of executed SAFECode checks"));
+
 const char* LTOCodeGenerator::getVersionString() {
 #ifdef LLVM_VERSION_INFO
   return PACKAGE_NAME " version " PACKAGE_VERSION ", " LLVM_VERSION_INFO;
@@ -459,11 +469,27 @@ bool LTOCodeGenerator::generateObjectFile(raw_ostream &out,
       passes.add(createExactCheckOptPass());
 #endif
 
+      if (ReportChecks)
+        passes.add(new DynamicCheckReport("before optimization"));
+
+      // Time each phase with -sc-time-phases or -time-passes.
+      passes.add(new PhaseTimer("Local check optimization"));
       passes.add(new DominatorTree());
       passes.add(new ScalarEvolution());
       passes.add(createOptimizeImpliedFastLSChecksPass());
+      passes.add(new RedundantCheckElimination());
+      passes.add(new PhaseTimer("Interprocedural check optimization"));
+      passes.add(new IPCheckElimination());
+      passes.add(new PhaseTimer("Loop check optimization"));
+      passes.add(new HoistLoopChecks());
+      passes.add(new LoopVersionChecks());
+      passes.add(new ProfileGuidedChecks());
+
+      if (ReportChecks)
+        passes.add(new DynamicCheckReport("after optimization"));
 
       if (mergedModule->getFunction("main")) {
+        passes.add(new PhaseTimer("Check completion"));
         passes.add(new CompleteChecks());
       }
     
@@ -473,6 +499,7 @@ bool LTOCodeGenerator::generateObjectFile(raw_ostream &out,
       MapEnd = &RuntimeDebug[sizeof(RuntimeDebug) / sizeof(RuntimeDebug[0])];
     
       // Add the automatic pool allocation passes
+      passes.add(new PhaseTimer("Pool allocation"));
       passes.add(new OptimizeSafeLoadStore());
       passes.add(new PA::AllNodesHeuristic());
       //passes.add(new PoolAllocate());
@@ -482,6 +509,9 @@ bool LTOCodeGenerator::generateObjectFile(raw_ostream &out,
       passes.add(new LowerSafecodeIntrinsic(MapStart, MapEnd));
 #endif
 
+     // End the last phase and report the time of each phase.
+     passes.add(new PhaseTimer());
+
      // Run our queue of passes all at once now, efficiently.
      passes.run(*mergedModule);
 